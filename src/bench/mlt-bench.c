@@ -0,0 +1,509 @@
+/*
+ * mlt-bench.c -- MLT render throughput benchmark
+ * Copyright (C) 2020 Meltytech, LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <framework/mlt.h>
+
+#define MAX_VALUES 16
+
+/** The measurements of one render. */
+
+typedef struct
+{
+	int error;
+	int frames;
+	double seconds;
+	double cpu_seconds;
+	double p50, p90, p99, max; // inter-frame interval in milliseconds
+	int64_t pool_peak;
+	long max_rss;
+} bench_result;
+
+/** The frame times collected while rendering. */
+
+typedef struct
+{
+	double *times;
+	int count;
+	int size;
+	int limit;
+} bench_timing;
+
+typedef mlt_producer ( *graph_builder )( mlt_profile profile, mlt_consumer consumer, int frames );
+
+static double now( )
+{
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static double cpu_time( struct rusage *usage )
+{
+	return usage->ru_utime.tv_sec + usage->ru_utime.tv_usec / 1000000.0
+		+ usage->ru_stime.tv_sec + usage->ru_stime.tv_usec / 1000000.0;
+}
+
+static mlt_producer make_producer( mlt_profile profile, const char *resource, int frames )
+{
+	mlt_producer producer = mlt_factory_producer( profile, NULL, resource );
+	if ( producer )
+	{
+		mlt_properties_set_int( MLT_PRODUCER_PROPERTIES( producer ), "length", frames );
+		mlt_producer_set_in_and_out( producer, 0, frames - 1 );
+	}
+	return producer;
+}
+
+/** Build a tractor with two video tracks and a transition between them.
+ */
+
+static mlt_producer make_tractor( mlt_profile profile, const char *a, const char *b, const char *transition, const char *geometry, int frames )
+{
+	mlt_tractor tractor = mlt_tractor_new( );
+	mlt_producer track0 = make_producer( profile, a, frames );
+	mlt_producer track1 = make_producer( profile, b, frames );
+	mlt_transition mix = mlt_factory_transition( profile, transition, geometry );
+
+	if ( !track0 || !track1 || !mix )
+	{
+		mlt_producer_close( track0 );
+		mlt_producer_close( track1 );
+		mlt_transition_close( mix );
+		mlt_tractor_close( tractor );
+		return NULL;
+	}
+	mlt_tractor_set_track( tractor, track0, 0 );
+	mlt_tractor_set_track( tractor, track1, 1 );
+	mlt_transition_set_in_and_out( mix, 0, frames - 1 );
+	mlt_field_plant_transition( mlt_tractor_field( tractor ), mix, 0, 1 );
+	mlt_producer_close( track0 );
+	mlt_producer_close( track1 );
+	mlt_transition_close( mix );
+	mlt_producer_set_in_and_out( mlt_tractor_producer( tractor ), 0, frames - 1 );
+	return mlt_tractor_producer( tractor );
+}
+
+static mlt_producer graph_colour( mlt_profile profile, mlt_consumer consumer, int frames )
+{
+	mlt_properties_set_int( MLT_CONSUMER_PROPERTIES( consumer ), "audio_off", 1 );
+	return make_producer( profile, "colour:0xff8000ff", frames );
+}
+
+static mlt_producer graph_noise( mlt_profile profile, mlt_consumer consumer, int frames )
+{
+	mlt_properties_set_int( MLT_CONSUMER_PROPERTIES( consumer ), "audio_off", 1 );
+	return make_producer( profile, "noise:", frames );
+}
+
+static mlt_producer graph_count( mlt_profile profile, mlt_consumer consumer, int frames )
+{
+	mlt_properties_set_int( MLT_CONSUMER_PROPERTIES( consumer ), "audio_off", 1 );
+	return make_producer( profile, "count:", frames );
+}
+
+static mlt_producer graph_convert( mlt_profile profile, mlt_consumer consumer, int frames )
+{
+	// Ask for a different size and format than produced to exercise resize and imageconvert.
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( consumer );
+	mlt_properties_set_int( properties, "audio_off", 1 );
+	mlt_properties_set_int( properties, "width", profile->width * 3 / 4 );
+	mlt_properties_set_int( properties, "height", profile->height * 3 / 4 );
+	mlt_properties_set( properties, "mlt_image_format", "rgb24a" );
+	mlt_properties_set( properties, "rescale", "bilinear" );
+	return make_producer( profile, "noise:", frames );
+}
+
+static mlt_producer graph_composite( mlt_profile profile, mlt_consumer consumer, int frames )
+{
+	mlt_properties_set_int( MLT_CONSUMER_PROPERTIES( consumer ), "audio_off", 1 );
+	return make_tractor( profile, "colour:blue", "noise:", "composite", "10%/10%:80%x80%:75", frames );
+}
+
+static mlt_producer graph_affine( mlt_profile profile, mlt_consumer consumer, int frames )
+{
+	mlt_producer producer;
+	mlt_properties_set_int( MLT_CONSUMER_PROPERTIES( consumer ), "audio_off", 1 );
+	producer = make_tractor( profile, "colour:blue", "noise:", "affine", NULL, frames );
+	if ( producer )
+	{
+		mlt_service service = mlt_service_producer( MLT_PRODUCER_SERVICE( producer ) );
+		while ( service && mlt_service_identify( service ) != transition_type )
+			service = mlt_service_producer( service );
+		if ( service )
+		{
+			mlt_properties_set( MLT_SERVICE_PROPERTIES( service ), "rect", "10%/10%:80%x80%" );
+			mlt_properties_set_double( MLT_SERVICE_PROPERTIES( service ), "fix_rotate_x", 5.0 );
+		}
+	}
+	return producer;
+}
+
+static mlt_producer graph_luma( mlt_profile profile, mlt_consumer consumer, int frames )
+{
+	mlt_properties_set_int( MLT_CONSUMER_PROPERTIES( consumer ), "audio_off", 1 );
+	return make_tractor( profile, "colour:blue", "noise:", "luma", NULL, frames );
+}
+
+static mlt_producer graph_mix( mlt_profile profile, mlt_consumer consumer, int frames )
+{
+	mlt_producer producer;
+	mlt_properties_set_int( MLT_CONSUMER_PROPERTIES( consumer ), "video_off", 1 );
+	producer = make_tractor( profile, "tone:", "tone:", "mix", NULL, frames );
+	if ( producer )
+	{
+		mlt_service service = mlt_service_producer( MLT_PRODUCER_SERVICE( producer ) );
+		while ( service && mlt_service_identify( service ) != transition_type )
+			service = mlt_service_producer( service );
+		if ( service )
+			mlt_properties_set_double( MLT_SERVICE_PROPERTIES( service ), "start", 0.5 );
+	}
+	return producer;
+}
+
+static const struct
+{
+	const char *name;
+	graph_builder build;
+}
+graphs[] =
+{
+	{ "colour", graph_colour },
+	{ "noise", graph_noise },
+	{ "count", graph_count },
+	{ "convert", graph_convert },
+	{ "composite", graph_composite },
+	{ "affine", graph_affine },
+	{ "luma", graph_luma },
+	{ "mix", graph_mix },
+	{ NULL, NULL }
+};
+
+static void on_frame_show( mlt_properties owner, bench_timing *timing, mlt_frame frame )
+{
+	// Ignore the paused frame that ends the render.
+	if ( timing->count >= timing->limit )
+		return;
+	if ( timing->count == timing->size )
+	{
+		timing->size = timing->size ? timing->size * 2 : 256;
+		timing->times = realloc( timing->times, timing->size * sizeof( double ) );
+	}
+	if ( timing->times )
+		timing->times[ timing->count++ ] = now( );
+}
+
+static int compare_double( const void *a, const void *b )
+{
+	double x = *( const double* )a, y = *( const double* )b;
+	return x < y ? -1 : x > y;
+}
+
+static double percentile( double *sorted, int count, double p )
+{
+	int i = ( int )( p * ( count - 1 ) + 0.5 );
+	return count ? sorted[ i ] : 0.0;
+}
+
+/** Render one graph and measure it.
+ *
+ * This runs in a child process so that each run starts from a clean pool and
+ * can use its own MLT_SLICES_COUNT.
+ */
+
+static void run( int graph, int width, int height, int threads, int frames, bench_result *result )
+{
+	mlt_profile profile;
+	mlt_consumer consumer;
+	mlt_producer producer;
+	bench_timing timing = { NULL, 0, 0, frames };
+	struct rusage before, after;
+	double start, *intervals;
+	int i;
+
+	memset( result, 0, sizeof( *result ) );
+	result->error = 1;
+	if ( !mlt_factory_init( NULL ) )
+		return;
+	mlt_log_set_level( MLT_LOG_QUIET );
+
+	profile = mlt_profile_init( NULL );
+	profile->width = width;
+	profile->height = height;
+	profile->progressive = 1;
+	profile->sample_aspect_num = profile->sample_aspect_den = 1;
+	profile->display_aspect_num = width;
+	profile->display_aspect_den = height;
+	profile->frame_rate_num = 25;
+	profile->frame_rate_den = 1;
+
+	consumer = mlt_factory_consumer( profile, "null", NULL );
+	if ( !consumer )
+		return;
+	mlt_properties_set_int( MLT_CONSUMER_PROPERTIES( consumer ), "real_time", -threads );
+	mlt_properties_set_int( MLT_CONSUMER_PROPERTIES( consumer ), "terminate_on_pause", 1 );
+	producer = graphs[ graph ].build( profile, consumer, frames );
+	if ( !producer )
+	{
+		mlt_consumer_close( consumer );
+		return;
+	}
+	mlt_consumer_connect( consumer, MLT_PRODUCER_SERVICE( producer ) );
+	mlt_events_listen( MLT_CONSUMER_PROPERTIES( consumer ), &timing, "consumer-frame-show", ( mlt_listener )on_frame_show );
+
+	getrusage( RUSAGE_SELF, &before );
+	start = now( );
+	mlt_consumer_start( consumer );
+	while ( !mlt_consumer_is_stopped( consumer ) )
+		usleep( 1000 );
+	result->seconds = now( ) - start;
+	getrusage( RUSAGE_SELF, &after );
+	mlt_consumer_stop( consumer );
+
+	result->error = 0;
+	result->frames = timing.count;
+	result->cpu_seconds = cpu_time( &after ) - cpu_time( &before );
+	result->max_rss = after.ru_maxrss;
+	mlt_pool_stat( );
+	result->pool_peak = mlt_properties_get_int64( mlt_global_properties( ), "memory.peak" );
+
+	// The interval of a frame is the time since the previous one was shown,
+	// which reflects pacing and stalls rather than the time to render it.
+	intervals = calloc( timing.count + 1, sizeof( double ) );
+	if ( intervals && timing.count )
+	{
+		intervals[ 0 ] = timing.times[ 0 ] - start;
+		for ( i = 1; i < timing.count; i++ )
+			intervals[ i ] = timing.times[ i ] - timing.times[ i - 1 ];
+		qsort( intervals, timing.count, sizeof( double ), compare_double );
+		result->p50 = 1000.0 * percentile( intervals, timing.count, 0.50 );
+		result->p90 = 1000.0 * percentile( intervals, timing.count, 0.90 );
+		result->p99 = 1000.0 * percentile( intervals, timing.count, 0.99 );
+		result->max = 1000.0 * intervals[ timing.count - 1 ];
+	}
+	free( intervals );
+	free( timing.times );
+
+	mlt_consumer_close( consumer );
+	mlt_producer_close( producer );
+	mlt_profile_close( profile );
+	mlt_factory_close( );
+}
+
+/** Run a benchmark in a child process and collect its result.
+ */
+
+static int run_child( int graph, int width, int height, int threads, int slices, int frames, bench_result *result )
+{
+	int fds[2];
+	pid_t pid;
+	int status = 0;
+
+	memset( result, 0, sizeof( *result ) );
+	result->error = 1;
+	if ( pipe( fds ) )
+		return 1;
+	pid = fork( );
+	if ( pid == 0 )
+	{
+		bench_result child;
+		char value[ 32 ];
+		close( fds[0] );
+		if ( slices > 0 )
+		{
+			snprintf( value, sizeof( value ), "%d", slices );
+			setenv( "MLT_SLICES_COUNT", value, 1 );
+		}
+		run( graph, width, height, threads, frames, &child );
+		if ( write( fds[1], &child, sizeof( child ) ) != sizeof( child ) )
+			_exit( 1 );
+		_exit( 0 );
+	}
+	close( fds[1] );
+	if ( pid > 0 )
+	{
+		if ( read( fds[0], result, sizeof( *result ) ) != sizeof( *result ) )
+			result->error = 1;
+		waitpid( pid, &status, 0 );
+	}
+	close( fds[0] );
+	return pid < 0 || result->error;
+}
+
+static int parse_list( char *list, int *values )
+{
+	int count = 0;
+	char *token = strtok( list, "," );
+	while ( token && count < MAX_VALUES )
+	{
+		values[ count++ ] = atoi( token );
+		token = strtok( NULL, "," );
+	}
+	return count;
+}
+
+static void usage( const char *name )
+{
+	fprintf( stderr, "Usage: %s [options]\n"
+		"Render generated graphs into the null consumer and report throughput.\n\n"
+		"  -graphs LIST        comma separated graphs to run (default: all)\n"
+		"  -resolutions LIST   comma separated WIDTHxHEIGHT (default: 640x360,1280x720,1920x1080)\n"
+		"  -threads LIST       comma separated numbers of rendering threads, used as\n"
+		"                      real_time=-N so that no frames are dropped (default: 1,2,4)\n"
+		"  -slices LIST        comma separated values of MLT_SLICES_COUNT, 0 for the\n"
+		"                      default (default: 0)\n"
+		"  -frames N           frames to render per run (default: 100)\n"
+		"  -json FILE          write the results as JSON to FILE, - for stdout\n\n"
+		"The p50, p90, p99 and max columns are percentiles of the interval between\n"
+		"consecutive frames being shown, in milliseconds.\n\n"
+		"Graphs:", name );
+	for ( int i = 0; graphs[i].name; i++ )
+		fprintf( stderr, " %s", graphs[i].name );
+	fprintf( stderr, "\n" );
+}
+
+int main( int argc, char **argv )
+{
+	int widths[ MAX_VALUES ] = { 640, 1280, 1920 }, heights[ MAX_VALUES ] = { 360, 720, 1080 };
+	int threads[ MAX_VALUES ] = { 1, 2, 4 }, slices[ MAX_VALUES ] = { 0 };
+	int resolution_count = 3, thread_count = 3, slice_count = 1;
+	int frames = 100;
+	char *selected = NULL;
+	const char *json_name = NULL;
+	FILE *json = NULL;
+	int first = 1, failures = 0, runs = 0;
+	int i, g, r, t, s;
+
+	for ( i = 1; i < argc; i++ )
+	{
+		if ( !strcmp( argv[i], "-graphs" ) && i + 1 < argc )
+		{
+			selected = argv[ ++i ];
+		}
+		else if ( !strcmp( argv[i], "-resolutions" ) && i + 1 < argc )
+		{
+			char *token = strtok( argv[ ++i ], "," );
+			resolution_count = 0;
+			while ( token && resolution_count < MAX_VALUES )
+			{
+				if ( sscanf( token, "%dx%d", &widths[ resolution_count ], &heights[ resolution_count ] ) == 2 )
+					resolution_count++;
+				token = strtok( NULL, "," );
+			}
+		}
+		else if ( !strcmp( argv[i], "-threads" ) && i + 1 < argc )
+		{
+			thread_count = parse_list( argv[ ++i ], threads );
+		}
+		else if ( !strcmp( argv[i], "-slices" ) && i + 1 < argc )
+		{
+			slice_count = parse_list( argv[ ++i ], slices );
+		}
+		else if ( !strcmp( argv[i], "-frames" ) && i + 1 < argc )
+		{
+			frames = atoi( argv[ ++i ] );
+		}
+		else if ( !strcmp( argv[i], "-json" ) && i + 1 < argc )
+		{
+			json_name = argv[ ++i ];
+		}
+		else
+		{
+			usage( argv[0] );
+			return !strcmp( argv[i], "-help" ) ? 0 : 1;
+		}
+	}
+	if ( frames < 1 || !resolution_count || !thread_count || !slice_count )
+	{
+		usage( argv[0] );
+		return 1;
+	}
+	if ( json_name )
+	{
+		json = strcmp( json_name, "-" ) ? fopen( json_name, "w" ) : stdout;
+		if ( !json )
+		{
+			perror( json_name );
+			return 1;
+		}
+		fprintf( json, "[\n" );
+	}
+
+	fprintf( json == stdout ? stderr : stdout, "%-10s %11s %7s %6s %8s %8s %8s %8s %8s %6s %10s %10s\n",
+		"graph", "resolution", "threads", "slices", "fps", "p50 int", "p90 int", "p99 int", "max int", "cpu %", "pool KiB", "rss KiB" );
+	for ( g = 0; graphs[g].name; g++ )
+	{
+		if ( selected )
+		{
+			const char *match = strstr( selected, graphs[g].name );
+			size_t length = strlen( graphs[g].name );
+			if ( !match || ( match != selected && match[-1] != ',' ) || ( match[ length ] && match[ length ] != ',' ) )
+				continue;
+		}
+		for ( r = 0; r < resolution_count; r++ )
+		for ( t = 0; t < thread_count; t++ )
+		for ( s = 0; s < slice_count; s++ )
+		{
+			bench_result result;
+			char resolution[ 32 ];
+			double fps, cpu;
+
+			runs++;
+			snprintf( resolution, sizeof( resolution ), "%dx%d", widths[r], heights[r] );
+			if ( run_child( g, widths[r], heights[r], threads[t], slices[s], frames, &result ) )
+			{
+				fprintf( stderr, "%-10s %11s %7d %6d failed\n", graphs[g].name, resolution, threads[t], slices[s] );
+				failures++;
+				continue;
+			}
+			fps = result.seconds > 0.0 ? result.frames / result.seconds : 0.0;
+			cpu = result.seconds > 0.0 ? 100.0 * result.cpu_seconds / result.seconds : 0.0;
+			fprintf( json == stdout ? stderr : stdout, "%-10s %11s %7d %6d %8.1f %8.2f %8.2f %8.2f %8.2f %6.0f %10"PRId64" %10ld\n",
+				graphs[g].name, resolution, threads[t], slices[s], fps,
+				result.p50, result.p90, result.p99, result.max, cpu, result.pool_peak / 1024, result.max_rss );
+			if ( json )
+			{
+				fprintf( json, "%s  {\"graph\": \"%s\", \"width\": %d, \"height\": %d, \"threads\": %d, \"slices\": %d, "
+					"\"frames\": %d, \"seconds\": %.6f, \"fps\": %.3f, "
+					"\"frame_interval_ms\": {\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}, "
+					"\"cpu_seconds\": %.6f, \"cpu_percent\": %.1f, \"pool_peak_bytes\": %"PRId64", \"max_rss_kb\": %ld}",
+					first ? "" : ",\n", graphs[g].name, widths[r], heights[r], threads[t], slices[s],
+					result.frames, result.seconds, fps, result.p50, result.p90, result.p99, result.max,
+					result.cpu_seconds, cpu, result.pool_peak, result.max_rss );
+				first = 0;
+			}
+		}
+	}
+	if ( json )
+	{
+		fprintf( json, "\n]\n" );
+		if ( json != stdout )
+			fclose( json );
+	}
+	if ( !runs )
+		fprintf( stderr, "No graph matches %s\n", selected );
+	return failures > 0 || !runs;
+}
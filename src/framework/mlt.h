@@ -38,6 +38,11 @@ extern "C"
 
 #include "mlt_animation.h"
 #include "mlt_audio.h"
+#include "mlt_audio_ring.h"
+#include "mlt_audio_summary.h"
+#include "mlt_cpu.h"
+#include "mlt_trace.h"
+#include "mlt_render_cache.h"
 #include "mlt_factory.h"
 #include "mlt_frame.h"
 #include "mlt_deque.h"
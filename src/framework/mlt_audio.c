@@ -130,6 +130,7 @@ void mlt_audio_alloc_data( mlt_audio self )
 
 	int size = mlt_audio_calculate_size( self );
 	self->data = mlt_pool_alloc( size );
+	mlt_pool_tag( self->data, mlt_memory_audio );
 	self->release_data = mlt_pool_release;
 }
 
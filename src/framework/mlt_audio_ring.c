@@ -0,0 +1,444 @@
+/**
+ * \file mlt_audio_ring.c
+ * \brief lock-free single producer, single consumer audio ring buffer
+ * \see mlt_audio_ring_s
+ *
+ * Copyright (C) 2020 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "mlt_audio_ring.h"
+#include "mlt_audio.h"
+#include "mlt_properties.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <stdatomic.h>
+
+#define CACHE_LINE 64
+
+/** \brief Audio ring class
+ *
+ * A fixed size FIFO of interleaved sample frames between exactly one writer
+ * thread (usually the consumer thread) and exactly one reader thread
+ * (usually the audio device callback). Neither side takes a lock or
+ * allocates, so the reader is safe to use from a realtime callback.
+ *
+ * The indices run freely and are masked into a power of two sized buffer.
+ * Each side only stores its own index with release semantics and loads the
+ * other with acquire semantics, which orders the sample copies against the
+ * index updates. The writer and reader fields live on separate cache lines.
+ *
+ * A flush stores the write index and then counts the request in a sequence
+ * number. The reader only acts on the flush index when the sequence number
+ * differs from the one it handled last, since the indices wrap around and a
+ * stale flush index can not be compared with them.
+ */
+
+struct mlt_audio_ring_s
+{
+	uint8_t *buffer;
+	unsigned int capacity;   /**< the usable size in samples */
+	unsigned int mask;       /**< the allocated size in samples minus one */
+	int frame_size;          /**< bytes per sample frame */
+	int frequency;
+	int silence;             /**< the byte value of silence */
+	char pad0[ CACHE_LINE ];
+
+	// Written by the writer
+	atomic_uint write_index;
+	atomic_uint flush_index;
+	atomic_uint flush_sequence;
+	atomic_llong overruns;
+	char pad1[ CACHE_LINE ];
+
+	// Written by the reader
+	atomic_uint read_index;
+	unsigned int flush_handled;  /**< the flush sequence number the reader handled last */
+	atomic_int started;
+	atomic_llong underruns;
+	atomic_llong silence_samples;
+	atomic_int min_fill;
+	atomic_int max_fill;
+	char pad2[ CACHE_LINE ];
+};
+
+/** Create an audio ring.
+ *
+ * Planar formats are only accepted with one channel; use a ring per channel
+ * for planar audio.
+ *
+ * \public \memberof mlt_audio_ring_s
+ * \param format the audio format of the samples
+ * \param channels the number of channels
+ * \param frequency the sample rate
+ * \param samples the capacity in sample frames
+ * \return a new audio ring or NULL on error
+ */
+
+mlt_audio_ring mlt_audio_ring_init( mlt_audio_format format, int channels, int frequency, int samples )
+{
+	int frame_size = mlt_audio_format_size( format, 1, channels );
+	if ( frame_size <= 0 || samples <= 0 || samples > ( 1 << 28 ) || frequency <= 0 ||
+		 ( channels > 1 && ( format == mlt_audio_s32 || format == mlt_audio_float ) ) )
+		return NULL;
+
+	mlt_audio_ring self = calloc( 1, sizeof( struct mlt_audio_ring_s ) );
+	if ( self )
+	{
+		unsigned int size = 1;
+		while ( size < samples )
+			size <<= 1;
+		self->capacity = samples;
+		self->mask = size - 1;
+		self->frame_size = frame_size;
+		self->frequency = frequency;
+		self->silence = format == mlt_audio_u8 ? 0x80 : 0;
+		self->buffer = malloc( (size_t) size * frame_size );
+		if ( !self->buffer )
+		{
+			free( self );
+			return NULL;
+		}
+		atomic_init( &self->write_index, 0 );
+		atomic_init( &self->flush_index, 0 );
+		atomic_init( &self->flush_sequence, 0 );
+		atomic_init( &self->overruns, 0 );
+		atomic_init( &self->read_index, 0 );
+		atomic_init( &self->started, 0 );
+		atomic_init( &self->underruns, 0 );
+		atomic_init( &self->silence_samples, 0 );
+		atomic_init( &self->min_fill, INT_MAX );
+		atomic_init( &self->max_fill, 0 );
+	}
+	return self;
+}
+
+/** Destroy an audio ring.
+ *
+ * Neither side may be using it any more.
+ *
+ * \public \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ */
+
+void mlt_audio_ring_close( mlt_audio_ring self )
+{
+	if ( self )
+	{
+		free( self->buffer );
+		free( self );
+	}
+}
+
+/** Get the capacity.
+ *
+ * \public \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ * \return the number of sample frames the ring can hold
+ */
+
+int mlt_audio_ring_size( mlt_audio_ring self )
+{
+	return self ? self->capacity : 0;
+}
+
+/** Get the number of samples buffered.
+ *
+ * This is exact when called by the reader and a lower bound otherwise.
+ *
+ * \public \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ * \return the number of sample frames available to read
+ */
+
+int mlt_audio_ring_readable( mlt_audio_ring self )
+{
+	unsigned int write_index = atomic_load_explicit( &self->write_index, memory_order_acquire );
+	unsigned int read_index = atomic_load_explicit( &self->read_index, memory_order_relaxed );
+	return write_index - read_index;
+}
+
+/** Get the space available.
+ *
+ * This is exact when called by the writer and a lower bound otherwise.
+ *
+ * \public \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ * \return the number of sample frames that can be written without blocking
+ */
+
+int mlt_audio_ring_writable( mlt_audio_ring self )
+{
+	unsigned int read_index = atomic_load_explicit( &self->read_index, memory_order_acquire );
+	unsigned int write_index = atomic_load_explicit( &self->write_index, memory_order_relaxed );
+	return self->capacity - ( write_index - read_index );
+}
+
+static void copy_in( mlt_audio_ring self, unsigned int index, const void *buffer, int samples )
+{
+	unsigned int offset = index & self->mask;
+	unsigned int first = self->mask + 1 - offset;
+	if ( first > samples )
+		first = samples;
+	if ( buffer )
+	{
+		memcpy( self->buffer + offset * self->frame_size, buffer, first * self->frame_size );
+		memcpy( self->buffer, (const uint8_t*) buffer + first * self->frame_size, ( samples - first ) * self->frame_size );
+	}
+	else
+	{
+		memset( self->buffer + offset * self->frame_size, self->silence, first * self->frame_size );
+		memset( self->buffer, self->silence, ( samples - first ) * self->frame_size );
+	}
+}
+
+static int ring_write( mlt_audio_ring self, const void *buffer, int samples )
+{
+	unsigned int write_index = atomic_load_explicit( &self->write_index, memory_order_relaxed );
+	unsigned int read_index = atomic_load_explicit( &self->read_index, memory_order_acquire );
+	int space = self->capacity - ( write_index - read_index );
+
+	if ( samples > space )
+	{
+		atomic_fetch_add_explicit( &self->overruns, 1, memory_order_relaxed );
+		samples = space;
+	}
+	if ( samples > 0 )
+	{
+		copy_in( self, write_index, buffer, samples );
+		atomic_store_explicit( &self->write_index, write_index + samples, memory_order_release );
+	}
+	return samples > 0 ? samples : 0;
+}
+
+/** Write samples.
+ *
+ * Only the writer thread may call this. It never blocks; samples that do not
+ * fit are dropped and counted as an overrun. Use mlt_audio_ring_wait() first
+ * to write everything.
+ *
+ * \public \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ * \param buffer the interleaved samples
+ * \param samples the number of sample frames in \p buffer
+ * \return the number of sample frames written
+ */
+
+int mlt_audio_ring_write( mlt_audio_ring self, const void *buffer, int samples )
+{
+	return ring_write( self, buffer, samples );
+}
+
+/** Write silence.
+ *
+ * Only the writer thread may call this.
+ *
+ * \public \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ * \param samples the number of sample frames of silence
+ * \return the number of sample frames written
+ */
+
+int mlt_audio_ring_write_silence( mlt_audio_ring self, int samples )
+{
+	return ring_write( self, NULL, samples );
+}
+
+/** Wait for space to write.
+ *
+ * Only the writer thread may call this. The reader is never signalled, so
+ * this sleeps in steps sized by how long the reader needs to make room.
+ *
+ * \public \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ * \param samples the number of sample frames wanted, clamped to the capacity
+ * \param timeout the maximum time to wait in milliseconds
+ * \return the number of sample frames that can be written, which is less
+ * than \p samples only on time out
+ */
+
+int mlt_audio_ring_wait( mlt_audio_ring self, int samples, int timeout )
+{
+	int64_t waited = 0;
+	int space = mlt_audio_ring_writable( self );
+
+	if ( samples > self->capacity )
+		samples = self->capacity;
+	while ( space < samples && waited < timeout * 1000LL )
+	{
+		// Sleep for half of the time it takes to drain the shortfall
+		int64_t step = 500000LL * ( samples - space ) / self->frequency;
+		struct timespec tm;
+		step = step < 500 ? 500 : step > 5000 ? 5000 : step;
+		tm.tv_sec = 0;
+		tm.tv_nsec = step * 1000;
+		nanosleep( &tm, NULL );
+		waited += step;
+		space = mlt_audio_ring_writable( self );
+	}
+	return space;
+}
+
+/** Read samples.
+ *
+ * Only the reader thread may call this. It never blocks; when fewer than
+ * \p samples are buffered the rest of \p buffer is filled with silence and,
+ * if the ring had been delivering full reads, an underrun is counted.
+ *
+ * \public \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ * \param buffer the destination for the interleaved samples
+ * \param samples the number of sample frames wanted
+ * \return the number of sample frames of audio read
+ */
+
+int mlt_audio_ring_read( mlt_audio_ring self, void *buffer, int samples )
+{
+	unsigned int read_index = atomic_load_explicit( &self->read_index, memory_order_relaxed );
+	unsigned int flush_sequence = atomic_load_explicit( &self->flush_sequence, memory_order_acquire );
+	// The flush index is loaded before the write index, so it is never ahead of it
+	unsigned int flush_index = atomic_load_explicit( &self->flush_index, memory_order_acquire );
+	unsigned int write_index = atomic_load_explicit( &self->write_index, memory_order_acquire );
+	uint8_t *dest = buffer;
+	int available, count;
+
+	// Honour a flush requested by the writer. Of several flushes since the last
+	// read this may see a later index than the sequence number, which is then
+	// found already read past at the next read.
+	if ( flush_sequence != self->flush_handled )
+	{
+		unsigned int ahead = flush_index - read_index;
+		self->flush_handled = flush_sequence;
+		if ( ahead > 0 && ahead <= self->capacity )
+		{
+			read_index = flush_index;
+			atomic_store_explicit( &self->started, 0, memory_order_relaxed );
+		}
+	}
+	available = write_index - read_index;
+
+	// Track the fill level, which is the latency through the ring
+	if ( available < atomic_load_explicit( &self->min_fill, memory_order_relaxed ) )
+		atomic_store_explicit( &self->min_fill, available, memory_order_relaxed );
+	if ( available > atomic_load_explicit( &self->max_fill, memory_order_relaxed ) )
+		atomic_store_explicit( &self->max_fill, available, memory_order_relaxed );
+
+	count = samples < available ? samples : available;
+	if ( count > 0 )
+	{
+		unsigned int offset = read_index & self->mask;
+		unsigned int first = self->mask + 1 - offset;
+		if ( first > count )
+			first = count;
+		memcpy( dest, self->buffer + offset * self->frame_size, first * self->frame_size );
+		memcpy( dest + first * self->frame_size, self->buffer, ( count - first ) * self->frame_size );
+	}
+	atomic_store_explicit( &self->read_index, read_index + count, memory_order_release );
+
+	if ( count < samples )
+	{
+		memset( dest + count * self->frame_size, self->silence, ( samples - count ) * self->frame_size );
+		atomic_fetch_add_explicit( &self->silence_samples, samples - count, memory_order_relaxed );
+		if ( atomic_exchange_explicit( &self->started, 0, memory_order_relaxed ) )
+			atomic_fetch_add_explicit( &self->underruns, 1, memory_order_relaxed );
+	}
+	else
+	{
+		atomic_store_explicit( &self->started, 1, memory_order_relaxed );
+	}
+	return count;
+}
+
+/** Discard the buffered samples.
+ *
+ * Only the writer thread may call this. The reader drops everything written
+ * so far on its next read, and running dry after that is not counted as an
+ * underrun until it has delivered a full read again.
+ *
+ * \public \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ */
+
+void mlt_audio_ring_flush( mlt_audio_ring self )
+{
+	unsigned int write_index = atomic_load_explicit( &self->write_index, memory_order_relaxed );
+	atomic_store_explicit( &self->flush_index, write_index, memory_order_release );
+	atomic_fetch_add_explicit( &self->flush_sequence, 1, memory_order_release );
+}
+
+/** Get the statistics.
+ *
+ * Any thread may call this.
+ *
+ * \public \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ * \param stats the statistics to fill in
+ * \param reset true to restart the minimum and maximum fill tracking
+ */
+
+void mlt_audio_ring_get_stats( mlt_audio_ring self, mlt_audio_ring_stats *stats, int reset )
+{
+	unsigned int read_index = atomic_load_explicit( &self->read_index, memory_order_relaxed );
+	unsigned int write_index = atomic_load_explicit( &self->write_index, memory_order_relaxed );
+
+	stats->underruns = atomic_load_explicit( &self->underruns, memory_order_relaxed );
+	stats->overruns = atomic_load_explicit( &self->overruns, memory_order_relaxed );
+	stats->silence = atomic_load_explicit( &self->silence_samples, memory_order_relaxed );
+	stats->fill = (int) ( write_index - read_index );
+	if ( stats->fill < 0 || stats->fill > self->capacity )
+		stats->fill = 0;
+	if ( reset )
+	{
+		stats->min_fill = atomic_exchange_explicit( &self->min_fill, INT_MAX, memory_order_relaxed );
+		stats->max_fill = atomic_exchange_explicit( &self->max_fill, 0, memory_order_relaxed );
+	}
+	else
+	{
+		stats->min_fill = atomic_load_explicit( &self->min_fill, memory_order_relaxed );
+		stats->max_fill = atomic_load_explicit( &self->max_fill, memory_order_relaxed );
+	}
+	if ( stats->min_fill == INT_MAX )
+		stats->min_fill = stats->fill;
+	stats->size = self->capacity;
+	stats->frequency = self->frequency;
+}
+
+/** Set the statistics as properties.
+ *
+ * This sets audio_latency, audio_latency_min and audio_latency_max in
+ * milliseconds and audio_underruns and audio_overruns as counts. Call it
+ * from the writer thread, not from an audio callback.
+ *
+ * \public \memberof mlt_audio_ring_s
+ * \param self an audio ring
+ * \param properties the properties to update, usually the consumer's
+ */
+
+void mlt_audio_ring_publish_stats( mlt_audio_ring self, mlt_properties properties )
+{
+	mlt_audio_ring_stats stats;
+	double ms = 1000.0 / self->frequency;
+
+	mlt_audio_ring_get_stats( self, &stats, 0 );
+	mlt_properties_set_double( properties, "audio_latency", stats.fill * ms );
+	mlt_properties_set_double( properties, "audio_latency_min", stats.min_fill * ms );
+	mlt_properties_set_double( properties, "audio_latency_max", stats.max_fill * ms );
+	mlt_properties_set_int64( properties, "audio_underruns", stats.underruns );
+	mlt_properties_set_int64( properties, "audio_overruns", stats.overruns );
+}
@@ -0,0 +1,59 @@
+/**
+ * \file mlt_audio_ring.h
+ * \brief lock-free single producer, single consumer audio ring buffer
+ * \see mlt_audio_ring_s
+ *
+ * Copyright (C) 2020 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef MLT_AUDIO_RING_H
+#define MLT_AUDIO_RING_H
+
+#include "mlt_types.h"
+
+/** \brief Audio ring statistics
+ *
+ * All sample counts are in sample frames (one sample for every channel).
+ */
+
+typedef struct
+{
+	int64_t underruns;  /**< the number of times the reader ran dry after playback started */
+	int64_t overruns;   /**< the number of writes that did not fit */
+	int64_t silence;    /**< the number of samples of silence the reader had to insert */
+	int fill;           /**< the number of samples currently buffered */
+	int min_fill;       /**< the lowest fill seen by the reader since the last reset */
+	int max_fill;       /**< the highest fill seen by the reader since the last reset */
+	int size;           /**< the capacity in samples */
+	int frequency;      /**< the sample rate, used to convert the above to time */
+}
+mlt_audio_ring_stats;
+
+extern mlt_audio_ring mlt_audio_ring_init( mlt_audio_format format, int channels, int frequency, int samples );
+extern void mlt_audio_ring_close( mlt_audio_ring self );
+extern int mlt_audio_ring_size( mlt_audio_ring self );
+extern int mlt_audio_ring_readable( mlt_audio_ring self );
+extern int mlt_audio_ring_writable( mlt_audio_ring self );
+extern int mlt_audio_ring_write( mlt_audio_ring self, const void *buffer, int samples );
+extern int mlt_audio_ring_write_silence( mlt_audio_ring self, int samples );
+extern int mlt_audio_ring_wait( mlt_audio_ring self, int samples, int timeout );
+extern int mlt_audio_ring_read( mlt_audio_ring self, void *buffer, int samples );
+extern void mlt_audio_ring_flush( mlt_audio_ring self );
+extern void mlt_audio_ring_get_stats( mlt_audio_ring self, mlt_audio_ring_stats *stats, int reset );
+extern void mlt_audio_ring_publish_stats( mlt_audio_ring self, mlt_properties properties );
+
+#endif
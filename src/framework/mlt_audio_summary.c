@@ -0,0 +1,693 @@
+/**
+ * \file mlt_audio_summary.c
+ * \brief multi-resolution peak and RMS summary of an audio resource
+ * \see mlt_audio_summary_s
+ *
+ * Copyright (C) 2020 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "mlt_audio_summary.h"
+#include "mlt_audio.h"
+#include "mlt_factory.h"
+#include "mlt_frame.h"
+#include "mlt_log.h"
+#include "mlt_producer.h"
+#include "mlt_properties.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define SUMMARY_MAGIC "MLTPEAK1"
+#define SUMMARY_SUFFIX ".mltpeaks"
+#define DEFAULT_FREQUENCY 16000
+#define DEFAULT_CHANNELS 2
+
+/** \brief A summary node
+ *
+ * The peaks are scaled to 16-bit and the square is the sum of the squares
+ * of all the samples the node covers.
+ */
+
+typedef struct
+{
+	int16_t min;
+	int16_t max;
+	float square;
+}
+summary_node;
+
+/** \brief Audio summary class
+ *
+ * The summary of an audio resource is a mipmap: level 0 holds the peaks and
+ * power of every MLT_AUDIO_SUMMARY_BIN samples and every level above halves
+ * the number of nodes. Any range of bins is covered by at most two nodes per
+ * level, so a query costs O(log n) regardless of its length.
+ *
+ * A summary is generated once per resource, sample rate and channel count
+ * by a background thread with its own producer, and shared by reference.
+ * The generator publishes how many samples are complete with release
+ * semantics, so queries of the finished part need no lock.
+ */
+
+struct mlt_audio_summary_s
+{
+	char *key;
+	char *sidecar;
+	int frequency;
+	int channels;
+	int64_t samples;           /**< the expected number of samples */
+	mlt_position length;       /**< the number of frames of the parent producer */
+	int levels;
+	int64_t *sizes;            /**< the number of nodes per level */
+	summary_node **nodes;      /**< per level, channels interleaved */
+	atomic_llong available;    /**< the number of samples summarised */
+	atomic_int cancel;
+	int done;
+	int ref_count;
+	mlt_producer producer;
+	pthread_t thread;
+	int has_thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+
+	// The bin being accumulated by the generator
+	float *acc_min;
+	float *acc_max;
+	double *acc_square;
+	int acc_count;
+	int64_t acc_bin;
+
+	struct mlt_audio_summary_s *next;
+};
+
+static pthread_mutex_t g_summaries_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t g_attach_lock = PTHREAD_MUTEX_INITIALIZER;
+static mlt_audio_summary g_summaries = NULL;
+
+static inline int16_t to_s16( float x )
+{
+	x = x < -1.0f ? -1.0f : x > 1.0f ? 1.0f : x;
+	return (int16_t) lrintf( x * 32767.0f );
+}
+
+static inline void merge_node( summary_node *dst, const summary_node *a, const summary_node *b )
+{
+	dst->min = b && b->min < a->min ? b->min : a->min;
+	dst->max = b && b->max > a->max ? b->max : a->max;
+	dst->square = a->square + ( b ? b->square : 0.0f );
+}
+
+/** Fill in the parents of a completed level 0 node.
+ *
+ * A parent is complete once its second child is, or its only child when
+ * that is the last node.
+ */
+
+static void propagate( mlt_audio_summary self, int64_t index, int last )
+{
+	int level, c;
+
+	for ( level = 1; level < self->levels; level++ )
+	{
+		int has_right = index & 1;
+		int64_t parent = index >> 1;
+		if ( !has_right && !last )
+			break;
+		summary_node *children = self->nodes[ level - 1 ] + 2 * parent * self->channels;
+		summary_node *dst = self->nodes[ level ] + parent * self->channels;
+		for ( c = 0; c < self->channels; c++ )
+			merge_node( &dst[c], &children[c], has_right ? &children[ self->channels + c ] : NULL );
+		index = parent;
+	}
+}
+
+static void store_bin( mlt_audio_summary self, int last )
+{
+	summary_node *dst = self->nodes[0] + self->acc_bin * self->channels;
+	int c;
+
+	for ( c = 0; c < self->channels; c++ )
+	{
+		dst[c].min = to_s16( self->acc_min[c] );
+		dst[c].max = to_s16( self->acc_max[c] );
+		dst[c].square = self->acc_square[c];
+		self->acc_min[c] = 1.0f;
+		self->acc_max[c] = -1.0f;
+		self->acc_square[c] = 0.0;
+	}
+	propagate( self, self->acc_bin, last );
+	atomic_store_explicit( &self->available, self->acc_bin * MLT_AUDIO_SUMMARY_BIN + self->acc_count, memory_order_release );
+	self->acc_bin++;
+	self->acc_count = 0;
+}
+
+/** Add planar float samples to the summary, or silence if \p pcm is NULL.
+ */
+
+static void summarise( mlt_audio_summary self, const float *pcm, int channels, int samples )
+{
+	int i = 0, c;
+
+	// Never write past the space allocated for the expected length
+	int64_t space = ( self->sizes[0] - self->acc_bin ) * MLT_AUDIO_SUMMARY_BIN - self->acc_count;
+	if ( samples > space )
+		samples = space;
+
+	while ( i < samples )
+	{
+		int n = MLT_AUDIO_SUMMARY_BIN - self->acc_count;
+		if ( n > samples - i )
+			n = samples - i;
+		for ( c = 0; c < self->channels; c++ )
+		{
+			const float *p = pcm && c < channels ? pcm + c * samples + i : NULL;
+			float lo = self->acc_min[c], hi = self->acc_max[c];
+			double square = 0.0;
+			int j;
+			if ( p )
+			{
+				for ( j = 0; j < n; j++ )
+				{
+					lo = p[j] < lo ? p[j] : lo;
+					hi = p[j] > hi ? p[j] : hi;
+					square += p[j] * p[j];
+				}
+			}
+			else
+			{
+				lo = lo > 0.0f ? 0.0f : lo;
+				hi = hi < 0.0f ? 0.0f : hi;
+			}
+			self->acc_min[c] = lo;
+			self->acc_max[c] = hi;
+			self->acc_square[c] += square;
+		}
+		self->acc_count += n;
+		i += n;
+		if ( self->acc_count == MLT_AUDIO_SUMMARY_BIN )
+			store_bin( self, self->acc_bin == self->sizes[0] - 1 );
+	}
+}
+
+static void finish( mlt_audio_summary self )
+{
+	if ( self->acc_count > 0 )
+	{
+		store_bin( self, 1 );
+	}
+	else if ( self->acc_bin > 0 && self->acc_bin < self->sizes[0] )
+	{
+		// Ended early on a bin boundary, complete the parents of the last bin
+		propagate( self, self->acc_bin - 1, 1 );
+	}
+	pthread_mutex_lock( &self->mutex );
+	self->done = 1;
+	pthread_cond_broadcast( &self->cond );
+	pthread_mutex_unlock( &self->mutex );
+}
+
+static int load_sidecar( mlt_audio_summary self )
+{
+	FILE *file = fopen( self->sidecar, "rb" );
+	char magic[8];
+	int32_t header[3];
+	int64_t samples;
+	int error = 1;
+
+	if ( !file )
+		return 1;
+	if ( fread( magic, sizeof( magic ), 1, file ) == 1 && !memcmp( magic, SUMMARY_MAGIC, sizeof( magic ) ) &&
+		 fread( header, sizeof( header ), 1, file ) == 1 && fread( &samples, sizeof( samples ), 1, file ) == 1 &&
+		 header[0] == self->frequency && header[1] == self->channels && header[2] == MLT_AUDIO_SUMMARY_BIN &&
+		 samples == self->samples &&
+		 fread( self->nodes[0], sizeof( summary_node ) * self->channels, self->sizes[0], file ) == self->sizes[0] )
+	{
+		int64_t i;
+		for ( i = 0; i < self->sizes[0]; i++ )
+			propagate( self, i, i == self->sizes[0] - 1 );
+		atomic_store_explicit( &self->available, self->samples, memory_order_release );
+		self->done = 1;
+		error = 0;
+	}
+	fclose( file );
+	return error;
+}
+
+static void *summary_thread( void *arg )
+{
+	mlt_audio_summary self = arg;
+	mlt_producer producer = self->producer;
+	double fps = mlt_producer_get_fps( producer );
+	mlt_position position;
+
+	mlt_producer_seek( producer, 0 );
+	for ( position = 0; position < self->length && !atomic_load( &self->cancel ); position++ )
+	{
+		mlt_frame frame = NULL;
+		mlt_audio_format format = mlt_audio_float;
+		int frequency = self->frequency;
+		int channels = self->channels;
+		int samples = mlt_audio_calculate_frame_samples( fps, frequency, position );
+		float *pcm = NULL;
+
+		if ( mlt_service_get_frame( MLT_PRODUCER_SERVICE( producer ), &frame, 0 ) || !frame )
+			break;
+		if ( mlt_frame_get_audio( frame, (void**) &pcm, &format, &frequency, &channels, &samples ) || format != mlt_audio_float )
+			pcm = NULL;
+		summarise( self, pcm, channels, samples );
+		mlt_frame_close( frame );
+	}
+	if ( !atomic_load( &self->cancel ) )
+	{
+		finish( self );
+		if ( self->sidecar )
+			mlt_audio_summary_save( self, self->sidecar );
+	}
+	return NULL;
+}
+
+static void summary_free( mlt_audio_summary self )
+{
+	int i;
+
+	if ( self->has_thread )
+	{
+		atomic_store( &self->cancel, 1 );
+		pthread_join( self->thread, NULL );
+	}
+	mlt_producer_close( self->producer );
+	for ( i = 0; i < self->levels; i++ )
+		free( self->nodes[i] );
+	free( self->nodes );
+	free( self->sizes );
+	free( self->acc_min );
+	free( self->acc_max );
+	free( self->acc_square );
+	free( self->key );
+	free( self->sidecar );
+	pthread_mutex_destroy( &self->mutex );
+	pthread_cond_destroy( &self->cond );
+	free( self );
+}
+
+static mlt_audio_summary summary_new( mlt_producer parent, const char *key, int frequency, int channels )
+{
+	mlt_properties properties = MLT_PRODUCER_PROPERTIES( parent );
+	const char *resource = mlt_properties_get( properties, "resource" );
+	double fps = mlt_producer_get_fps( parent );
+	mlt_position length = mlt_producer_get_length( parent );
+	mlt_audio_summary self = calloc( 1, sizeof( struct mlt_audio_summary_s ) );
+	int64_t size;
+	int i;
+
+	if ( !self || length <= 0 || fps <= 0 )
+	{
+		free( self );
+		return NULL;
+	}
+	self->key = strdup( key );
+	self->frequency = frequency;
+	self->channels = channels;
+	self->length = length;
+	self->samples = mlt_audio_calculate_samples_to_position( fps, frequency, length );
+	self->ref_count = 1;
+	pthread_mutex_init( &self->mutex, NULL );
+	pthread_cond_init( &self->cond, NULL );
+	atomic_init( &self->available, 0 );
+	atomic_init( &self->cancel, 0 );
+
+	// Allocate the levels
+	size = ( self->samples + MLT_AUDIO_SUMMARY_BIN - 1 ) / MLT_AUDIO_SUMMARY_BIN;
+	self->levels = 1;
+	while ( ( size >> ( self->levels - 1 ) ) > 1 )
+		self->levels++;
+	self->sizes = calloc( self->levels, sizeof( int64_t ) );
+	self->nodes = calloc( self->levels, sizeof( summary_node* ) );
+	for ( i = 0; i < self->levels; i++ )
+	{
+		self->sizes[i] = size;
+		self->nodes[i] = calloc( size ? size : 1, sizeof( summary_node ) * channels );
+		size = ( size + 1 ) / 2;
+	}
+	self->acc_min = malloc( channels * sizeof( float ) );
+	self->acc_max = malloc( channels * sizeof( float ) );
+	self->acc_square = calloc( channels, sizeof( double ) );
+	for ( i = 0; i < channels; i++ )
+	{
+		self->acc_min[i] = 1.0f;
+		self->acc_max[i] = -1.0f;
+	}
+
+	// Try the sidecar file first
+	if ( mlt_properties_get( properties, "audio_summary_file" ) )
+	{
+		self->sidecar = strdup( mlt_properties_get( properties, "audio_summary_file" ) );
+	}
+	else if ( getenv( "MLT_AUDIO_SUMMARY_SIDECAR" ) && atoi( getenv( "MLT_AUDIO_SUMMARY_SIDECAR" ) ) )
+	{
+		self->sidecar = malloc( strlen( resource ) + strlen( SUMMARY_SUFFIX ) + 1 );
+		sprintf( self->sidecar, "%s%s", resource, SUMMARY_SUFFIX );
+	}
+	if ( self->sidecar && !load_sidecar( self ) )
+	{
+		mlt_log_verbose( MLT_PRODUCER_SERVICE( parent ), "loaded audio summary %s\n", self->sidecar );
+		return self;
+	}
+
+	// Otherwise generate it in the background with a private producer
+	self->producer = mlt_factory_producer( mlt_service_profile( MLT_PRODUCER_SERVICE( parent ) ), NULL, key );
+	if ( self->producer )
+	{
+		mlt_properties private = MLT_PRODUCER_PROPERTIES( self->producer );
+		int count = mlt_properties_count( properties );
+		for ( i = 0; i < count; i++ )
+		{
+			const char *name = mlt_properties_get_name( properties, i );
+			const char *value = mlt_properties_get_value( properties, i );
+			if ( name && value && name[0] != '_' && strcmp( name, "mlt_service" ) && strcmp( name, "mlt_type" ) )
+				mlt_properties_set( private, name, value );
+		}
+		mlt_properties_set_int( MLT_PRODUCER_PROPERTIES( self->producer ), "video_index", -1 );
+		if ( !pthread_create( &self->thread, NULL, summary_thread, self ) )
+			self->has_thread = 1;
+	}
+	if ( !self->has_thread )
+	{
+		mlt_log_warning( MLT_PRODUCER_SERVICE( parent ), "unable to summarise audio of %s\n", resource );
+		self->ref_count = 0;
+		summary_free( self );
+		return NULL;
+	}
+	return self;
+}
+
+/** Get a summary of the audio of a producer's resource.
+ *
+ * Summaries are shared: this returns a new reference to an existing summary
+ * of the same resource, sample rate and channel count or starts generating
+ * one in a background thread. If the producer has the property
+ * "audio_summary_file" or MLT_AUDIO_SUMMARY_SIDECAR is set, the summary is
+ * loaded from that file when it matches and saved there when generated.
+ *
+ * \public \memberof mlt_audio_summary_s
+ * \param producer a producer or cut, the summary covers its whole parent
+ * \param frequency the sample rate of the summary
+ * \param channels the number of channels of the summary
+ * \return a summary to release with mlt_audio_summary_close() or NULL
+ */
+
+mlt_audio_summary mlt_audio_summary_init( mlt_producer producer, int frequency, int channels )
+{
+	mlt_producer parent = producer ? mlt_producer_cut_parent( producer ) : NULL;
+	mlt_properties properties = parent ? MLT_PRODUCER_PROPERTIES( parent ) : NULL;
+	const char *resource = properties ? mlt_properties_get( properties, "resource" ) : NULL;
+	const char *service = properties ? mlt_properties_get( properties, "mlt_service" ) : NULL;
+	mlt_audio_summary self = NULL;
+
+	if ( !resource || !service || frequency <= 0 || channels <= 0 )
+		return NULL;
+
+	char *key = malloc( strlen( service ) + strlen( resource ) + 2 );
+	sprintf( key, "%s:%s", service, resource );
+
+	pthread_mutex_lock( &g_summaries_lock );
+	for ( self = g_summaries; self; self = self->next )
+	{
+		if ( self->frequency == frequency && self->channels == channels && !strcmp( self->key, key ) )
+		{
+			self->ref_count++;
+			break;
+		}
+	}
+	if ( !self )
+	{
+		self = summary_new( parent, key, frequency, channels );
+		if ( self )
+		{
+			self->next = g_summaries;
+			g_summaries = self;
+		}
+	}
+	pthread_mutex_unlock( &g_summaries_lock );
+	free( key );
+
+	return self;
+}
+
+/** Get the default summary of a producer.
+ *
+ * This is a 16 kHz stereo summary that is created on first use and kept by
+ * the parent producer, so the caller must not close it.
+ *
+ * \public \memberof mlt_audio_summary_s
+ * \param producer a producer or cut
+ * \return the summary or NULL
+ */
+
+mlt_audio_summary mlt_audio_summary_get( mlt_producer producer )
+{
+	mlt_producer parent = producer ? mlt_producer_cut_parent( producer ) : NULL;
+	mlt_audio_summary self = NULL;
+
+	if ( parent )
+	{
+		mlt_properties properties = MLT_PRODUCER_PROPERTIES( parent );
+		pthread_mutex_lock( &g_attach_lock );
+		self = mlt_properties_get_data( properties, "_audio_summary", NULL );
+		if ( !self )
+		{
+			self = mlt_audio_summary_init( parent, DEFAULT_FREQUENCY, DEFAULT_CHANNELS );
+			if ( self )
+				mlt_properties_set_data( properties, "_audio_summary", self, 0, (mlt_destructor) mlt_audio_summary_close, NULL );
+		}
+		pthread_mutex_unlock( &g_attach_lock );
+	}
+	return self;
+}
+
+/** Release a reference to a summary.
+ *
+ * The last reference stops the generator and frees the summary.
+ *
+ * \public \memberof mlt_audio_summary_s
+ * \param self a summary
+ */
+
+void mlt_audio_summary_close( mlt_audio_summary self )
+{
+	if ( self )
+	{
+		int unused = 0;
+		pthread_mutex_lock( &g_summaries_lock );
+		if ( --self->ref_count == 0 )
+		{
+			mlt_audio_summary *p = &g_summaries;
+			while ( *p && *p != self )
+				p = &( *p )->next;
+			if ( *p )
+				*p = self->next;
+			unused = 1;
+		}
+		pthread_mutex_unlock( &g_summaries_lock );
+		if ( unused )
+			summary_free( self );
+	}
+}
+
+/** Get the sample rate of a summary.
+ *
+ * \public \memberof mlt_audio_summary_s
+ * \param self a summary
+ * \return the sample rate
+ */
+
+int mlt_audio_summary_frequency( mlt_audio_summary self )
+{
+	return self ? self->frequency : 0;
+}
+
+/** Get the number of channels of a summary.
+ *
+ * \public \memberof mlt_audio_summary_s
+ * \param self a summary
+ * \return the number of channels
+ */
+
+int mlt_audio_summary_channels( mlt_audio_summary self )
+{
+	return self ? self->channels : 0;
+}
+
+/** Get the length of a summary.
+ *
+ * \public \memberof mlt_audio_summary_s
+ * \param self a summary
+ * \return the number of samples the complete summary covers
+ */
+
+int64_t mlt_audio_summary_samples( mlt_audio_summary self )
+{
+	return self ? self->samples : 0;
+}
+
+/** Get the number of samples summarised so far.
+ *
+ * \public \memberof mlt_audio_summary_s
+ * \param self a summary
+ * \return the number of samples from the start that can be queried
+ */
+
+int64_t mlt_audio_summary_available( mlt_audio_summary self )
+{
+	return self ? atomic_load_explicit( &self->available, memory_order_acquire ) : 0;
+}
+
+/** Get the progress of the generator.
+ *
+ * \public \memberof mlt_audio_summary_s
+ * \param self a summary
+ * \return 0.0 to 1.0
+ */
+
+double mlt_audio_summary_progress( mlt_audio_summary self )
+{
+	int64_t available = mlt_audio_summary_available( self );
+	if ( !self || self->done )
+		return 1.0;
+	return self->samples > 0 ? (double) available / self->samples : 1.0;
+}
+
+/** Wait for the generator to finish.
+ *
+ * \public \memberof mlt_audio_summary_s
+ * \param self a summary
+ * \return true if there is no summary
+ */
+
+int mlt_audio_summary_wait( mlt_audio_summary self )
+{
+	if ( !self )
+		return 1;
+	pthread_mutex_lock( &self->mutex );
+	while ( !self->done )
+		pthread_cond_wait( &self->cond, &self->mutex );
+	pthread_mutex_unlock( &self->mutex );
+	return 0;
+}
+
+/** Get the peaks and power of a range of samples.
+ *
+ * The range is widened to whole bins of MLT_AUDIO_SUMMARY_BIN samples.
+ *
+ * \public \memberof mlt_audio_summary_s
+ * \param self a summary
+ * \param channel a channel index or -1 for all channels
+ * \param start the first sample
+ * \param end the sample after the last
+ * \param[out] min the lowest sample value, -1.0 to 1.0 (optional)
+ * \param[out] max the highest sample value, -1.0 to 1.0 (optional)
+ * \param[out] rms the root mean square (optional)
+ * \return true if the range is not summarised (yet)
+ */
+
+int mlt_audio_summary_query( mlt_audio_summary self, int channel, int64_t start, int64_t end, float *min, float *max, float *rms )
+{
+	int64_t available = mlt_audio_summary_available( self );
+	int c0 = channel < 0 ? 0 : channel;
+	int c1 = channel < 0 ? ( self ? self->channels : 0 ) : channel + 1;
+	int16_t lo = INT16_MAX, hi = INT16_MIN;
+	double square = 0.0;
+	int64_t b0, b1, count;
+	int level, c;
+
+	if ( !self || start < 0 || end <= start || end > available || c1 > self->channels )
+		return 1;
+
+	b0 = start / MLT_AUDIO_SUMMARY_BIN;
+	b1 = ( end + MLT_AUDIO_SUMMARY_BIN - 1 ) / MLT_AUDIO_SUMMARY_BIN;
+	count = ( b1 * MLT_AUDIO_SUMMARY_BIN < available ? b1 * MLT_AUDIO_SUMMARY_BIN : available ) - b0 * MLT_AUDIO_SUMMARY_BIN;
+
+	// Take at most one node from each end of the range per level
+	for ( level = 0; b0 < b1; level++, b0 >>= 1, b1 >>= 1 )
+	{
+		const summary_node *nodes = self->nodes[ level ];
+		if ( b0 & 1 )
+		{
+			for ( c = c0; c < c1; c++ )
+			{
+				const summary_node *n = &nodes[ b0 * self->channels + c ];
+				lo = n->min < lo ? n->min : lo;
+				hi = n->max > hi ? n->max : hi;
+				square += n->square;
+			}
+			b0++;
+		}
+		if ( b1 & 1 )
+		{
+			b1--;
+			for ( c = c0; c < c1; c++ )
+			{
+				const summary_node *n = &nodes[ b1 * self->channels + c ];
+				lo = n->min < lo ? n->min : lo;
+				hi = n->max > hi ? n->max : hi;
+				square += n->square;
+			}
+		}
+	}
+
+	if ( min )
+		*min = lo / 32767.0f;
+	if ( max )
+		*max = hi / 32767.0f;
+	if ( rms )
+		*rms = count > 0 ? sqrt( square / ( count * ( c1 - c0 ) ) ) : 0.0f;
+	return 0;
+}
+
+/** Save a complete summary to a file.
+ *
+ * The file is in the native byte order.
+ *
+ * \public \memberof mlt_audio_summary_s
+ * \param self a summary
+ * \param filename the file to write
+ * \return true on error
+ */
+
+int mlt_audio_summary_save( mlt_audio_summary self, const char *filename )
+{
+	int error = 1;
+
+	if ( self && filename && self->done && mlt_audio_summary_available( self ) == self->samples )
+	{
+		FILE *file = fopen( filename, "wb" );
+		if ( file )
+		{
+			int32_t header[3] = { self->frequency, self->channels, MLT_AUDIO_SUMMARY_BIN };
+			error = fwrite( SUMMARY_MAGIC, 8, 1, file ) != 1 ||
+				fwrite( header, sizeof( header ), 1, file ) != 1 ||
+				fwrite( &self->samples, sizeof( self->samples ), 1, file ) != 1 ||
+				fwrite( self->nodes[0], sizeof( summary_node ) * self->channels, self->sizes[0], file ) != self->sizes[0];
+			error |= fclose( file ) != 0;
+		}
+	}
+	return error;
+}
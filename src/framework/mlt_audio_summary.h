@@ -0,0 +1,48 @@
+/**
+ * \file mlt_audio_summary.h
+ * \brief multi-resolution peak and RMS summary of an audio resource
+ * \see mlt_audio_summary_s
+ *
+ * Copyright (C) 2020 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef MLT_AUDIO_SUMMARY_H
+#define MLT_AUDIO_SUMMARY_H
+
+#include "mlt_types.h"
+
+/**
+ * \envvar \em MLT_AUDIO_SUMMARY_SIDECAR Set to 1 to load and save summaries
+ * next to their resources, as the resource name with ".mltpeaks" appended.
+ */
+
+/** The number of samples summarised by the finest level of the summary. */
+#define MLT_AUDIO_SUMMARY_BIN 64
+
+extern mlt_audio_summary mlt_audio_summary_init( mlt_producer producer, int frequency, int channels );
+extern mlt_audio_summary mlt_audio_summary_get( mlt_producer producer );
+extern void mlt_audio_summary_close( mlt_audio_summary self );
+extern int mlt_audio_summary_frequency( mlt_audio_summary self );
+extern int mlt_audio_summary_channels( mlt_audio_summary self );
+extern int64_t mlt_audio_summary_samples( mlt_audio_summary self );
+extern int64_t mlt_audio_summary_available( mlt_audio_summary self );
+extern double mlt_audio_summary_progress( mlt_audio_summary self );
+extern int mlt_audio_summary_wait( mlt_audio_summary self );
+extern int mlt_audio_summary_query( mlt_audio_summary self, int channel, int64_t start, int64_t end, float *min, float *max, float *rms );
+extern int mlt_audio_summary_save( mlt_audio_summary self, const char *filename );
+
+#endif
@@ -139,6 +139,7 @@ static void cache_object_close( mlt_cache cache, void *object, void* data )
 		if ( item->destructor && --item->refcount <= 0 )
 		{
 			// Destroy the data object
+			mlt_pool_account( item->object, NULL, mlt_memory_cache, -item->size );
 			item->destructor( item->data );
 			item->data = NULL;
 			item->destructor = NULL;
@@ -158,6 +159,7 @@ static void cache_object_close( mlt_cache cache, void *object, void* data )
 				item, item->object, item->data, item->refcount );
 			if ( item->destructor && --item->refcount <= 0 )
 			{
+				mlt_pool_account( item->object, NULL, mlt_memory_cache, -item->size );
 				item->destructor( item->data );
 				item->data = NULL;
 				item->destructor = NULL;
@@ -423,6 +425,8 @@ void mlt_cache_put( mlt_cache cache, void *object, void* data, int size, mlt_des
 		item->size = size;
 		item->destructor = destructor;
 		item->refcount = 1;
+		if ( destructor )
+			mlt_pool_account( object, NULL, mlt_memory_cache, size );
 	}
 	
 	// swap the current array
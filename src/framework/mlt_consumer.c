@@ -26,18 +26,31 @@
 #include "mlt_frame.h"
 #include "mlt_profile.h"
 #include "mlt_log.h"
+#include "mlt_trace.h"
+#include "mlt_render_cache.h"
 
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 #include <stdlib.h>
 #include <sys/time.h>
 #include <stdatomic.h>
+#include <unistd.h>
 
 /** Define this if you want an automatic deinterlace (if necessary) when the
  * consumer's producer is not running at normal speed.
  */
 #undef DEINTERLACE_ON_NOT_NORMAL_SPEED
 
+/** The number of levels by which adaptive mode can lower quality. */
+#define QUALITY_LEVELS (3)
+/** The number of dropped frames that lowers quality one level. */
+#define QUALITY_MISSES (3)
+/** The maximum number of seconds to wait before raising quality. */
+#define QUALITY_HOLD_MAX (32)
+/** The default number of bytes the render cache files may take. */
+#define RENDER_CACHE_SIZE (1024LL * 1024 * 1024)
+
 /** This is not the ideal place for this, but it is needed by VDPAU as well.
  */
 pthread_mutex_t mlt_sdl_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -60,6 +73,7 @@ typedef struct
 	mlt_frame put;
 	int put_active;
 	mlt_event event_listener;
+	int frame_render_event;
 	mlt_position position;
 	pthread_mutex_t position_mutex;	
 	int is_purge;
@@ -77,6 +91,21 @@ typedef struct
 	int process_head;
 	atomic_int started;
 	pthread_t *threads; /**< used to deallocate all threads */
+	int trace;
+	int64_t queue_bytes; /**< the memory of the queued frames last accounted */
+	int throttled;       /**< whether read ahead is limited by the memory budget */
+	atomic_int quality;  /**< the level by which adaptive mode lowers processing quality */
+	int quality_misses;  /**< the number of frames dropped at the current quality */
+	int quality_hits;    /**< the number of consecutive frames rendered in time */
+	int quality_hold;    /**< the number of frames to render in time before raising quality */
+	int quality_raised;  /**< the number of frames since quality was last raised, or -1 */
+	int autoscale;       /**< whether to scale the number of worker threads to the load */
+	int max_threads;     /**< the most worker threads autoscale may activate */
+	atomic_int active_threads; /**< the number of worker threads taking frames */
+	atomic_int thread_index;   /**< used to number the worker threads */
+	atomic_int render_usec;    /**< the average time a worker takes to render a frame */
+	int autoscale_frames; /**< the number of frames since the worker threads were last scaled */
+	int autoscale_waits; /**< the number of frames since then not rendered in time */
 }
 consumer_private;
 
@@ -158,6 +187,7 @@ int mlt_consumer_init( mlt_consumer self, void *child, mlt_profile profile )
 		mlt_events_register( properties, "consumer-thread-create", ( mlt_transmitter )transmit_thread_create );
 		mlt_events_register( properties, "consumer-thread-join", ( mlt_transmitter )transmit_thread_join );
 		mlt_events_listen( properties, self, "consumer-frame-show", ( mlt_listener )on_consumer_frame_show );
+		priv->frame_render_event = mlt_events_id( "consumer-frame-render" );
 
 		// Register a property-changed listener to handle the profile property -
 		// subsequent properties can override the profile
@@ -599,10 +629,28 @@ int mlt_consumer_start( mlt_consumer self )
 	// Store the parameters for audio processing.
 	priv->aud_counter = 0;
 	priv->fps = mlt_properties_get_double( properties, "fps" );
+
+	// Start adaptive mode at full quality
+	priv->quality = 0;
+	priv->quality_misses = 0;
+	priv->quality_hits = 0;
+	priv->quality_hold = MAX( 1, lrint( priv->fps * 2 ) );
+	priv->quality_raised = -1;
+	mlt_properties_set_int( properties, "adaptive_level", 0 );
 	priv->channels = mlt_properties_get_int( properties, "channels" );
 	priv->frequency = mlt_properties_get_int( properties, "frequency" );
 	priv->preroll = 1;
 
+	// Record the time spent per service if a trace was requested, unless
+	// another consumer is already recording one
+	priv->trace = ( mlt_properties_get( properties, "trace" ) || mlt_properties_get( properties, "trace_summary" ) ||
+		getenv( "MLT_TRACE" ) || getenv( "MLT_TRACE_SUMMARY" ) ) && !mlt_trace_is_enabled();
+	if ( priv->trace )
+	{
+		mlt_trace_reset();
+		mlt_trace_enable( 1 );
+	}
+
 #ifdef _WIN32
 	if ( priv->real_time == 1 || priv->real_time == -1 )
 		consumer_read_ahead_start( self );
@@ -732,12 +780,198 @@ mlt_frame mlt_consumer_get_frame( mlt_consumer self )
 		mlt_properties_set_int( frame_properties, "consumer_tff", mlt_properties_get_int( properties, "top_field_first" ) );
 		mlt_properties_set( frame_properties, "consumer_color_trc", mlt_properties_get( properties, "color_trc" ) );
 		mlt_properties_set( frame_properties, "consumer_channel_layout", mlt_properties_get( properties, "channel_layout" ) );
+
+		// Use cheaper scaling and deinterlacing while adaptive mode lowers quality
+		consumer_private *priv = self->local;
+		if ( priv->quality > 0 )
+		{
+			const char *interp = mlt_properties_get( properties, "rescale" );
+			if ( !interp || strcmp( interp, "none" ) )
+				mlt_properties_set( frame_properties, "rescale.interp", "nearest" );
+			mlt_properties_set( frame_properties, "deinterlace_method", "onefield" );
+			if ( priv->quality >= QUALITY_LEVELS )
+				mlt_properties_set_int( frame_properties, "consumer_deinterlace", 0 );
+		}
+
+		// Reuse the image and audio rendered before for an unchanged service network
+		const char *render_cache = mlt_properties_get( properties, "render_cache" );
+		if ( render_cache && *render_cache && mlt_service_producer( service ) )
+		{
+			int64_t limit = mlt_properties_get( properties, "render_cache_size" ) ?
+				mlt_properties_get_int64( properties, "render_cache_size" ) : RENDER_CACHE_SIZE;
+			mlt_render_cache_attach( frame, render_cache, mlt_render_cache_hash( service, mlt_frame_get_position( frame ) ), limit );
+		}
 	}
 
 	// Return the frame
 	return frame;
 }
 
+/** Account the memory held by the frames in the queue.
+ *
+ * The caller must hold the queue mutex.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ */
+
+static void account_queue( mlt_consumer self )
+{
+	consumer_private *priv = self->local;
+	int64_t bytes = 0;
+	int i, size;
+
+	for ( i = 0; priv->queue && i < mlt_deque_count( priv->queue ); i++ )
+	{
+		mlt_properties frame_properties = MLT_FRAME_PROPERTIES( MLT_FRAME( mlt_deque_peek( priv->queue, i ) ) );
+		size = 0;
+		mlt_properties_get_data( frame_properties, "image", &size );
+		bytes += size;
+		size = 0;
+		mlt_properties_get_data( frame_properties, "alpha", &size );
+		bytes += size;
+		size = 0;
+		mlt_properties_get_data( frame_properties, "audio", &size );
+		bytes += size;
+	}
+	if ( bytes != priv->queue_bytes )
+	{
+		mlt_pool_account( self, mlt_properties_get( MLT_CONSUMER_PROPERTIES( self ), "mlt_service" ),
+			mlt_memory_queue, bytes - priv->queue_bytes );
+		priv->queue_bytes = bytes;
+	}
+}
+
+/** Determine if reading ahead must wait for the queue to drain.
+ *
+ * This is the case when the pool memory in use exceeds the budget set with
+ * mlt_pool_set_budget() and at least one frame is queued.
+ *
+ * The caller must hold the queue mutex.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \return true if no more frames should be queued
+ */
+
+static int is_throttled( mlt_consumer self )
+{
+	consumer_private *priv = self->local;
+	int throttled = mlt_deque_count( priv->queue ) > 0 && mlt_pool_over_budget();
+
+	if ( throttled != priv->throttled )
+	{
+		mlt_log_debug( MLT_CONSUMER_SERVICE( self ), throttled ?
+			"memory budget exceeded, reading ahead %d frames\n" : "memory budget restored with %d frames queued\n",
+			mlt_deque_count( priv->queue ) );
+		priv->throttled = throttled;
+	}
+	return throttled;
+}
+
+/** Determine if reading ahead must wait without holding the queue mutex.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \return true if no more frames should be queued
+ */
+
+static int worker_is_throttled( mlt_consumer self )
+{
+	consumer_private *priv = self->local;
+	int throttled;
+
+	pthread_mutex_lock( &priv->queue_mutex );
+	throttled = is_throttled( self );
+	pthread_mutex_unlock( &priv->queue_mutex );
+	return throttled;
+}
+
+/** Adjust the processing quality to whether frames meet their deadline.
+ *
+ * When adaptive is set, every QUALITY_MISSES dropped frames lowers quality one
+ * level and quality_hold consecutive frames rendered in time raise it one level.
+ * Dropping soon after raising quality doubles quality_hold to avoid oscillating.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \param rendered whether the frame was rendered in time
+ */
+
+static void adapt_quality( mlt_consumer self, int rendered )
+{
+	consumer_private *priv = self->local;
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( self );
+	int quality = priv->quality;
+
+	if ( !mlt_properties_get_int( properties, "adaptive" ) )
+		return;
+
+	if ( priv->quality_raised >= 0 )
+		priv->quality_raised++;
+	if ( !rendered )
+	{
+		priv->quality_hits = 0;
+		if ( ++priv->quality_misses >= QUALITY_MISSES && quality < QUALITY_LEVELS )
+		{
+			if ( priv->quality_raised >= 0 && priv->quality_raised < priv->quality_hold )
+				priv->quality_hold = MIN( priv->quality_hold * 2, lrint( priv->fps * QUALITY_HOLD_MAX ) );
+			priv->quality_misses = 0;
+			quality++;
+		}
+	}
+	else if ( ++priv->quality_hits >= priv->quality_hold && quality > 0 )
+	{
+		priv->quality_hits = 0;
+		priv->quality_misses = 0;
+		priv->quality_raised = 0;
+		quality--;
+	}
+	else if ( priv->quality_hits >= priv->fps )
+	{
+		// Forget isolated drops.
+		priv->quality_misses = 0;
+	}
+
+	if ( quality != priv->quality )
+	{
+		mlt_log_verbose( MLT_CONSUMER_SERVICE( self ), "%s quality to level %d\n",
+			quality > priv->quality ? "lowering" : "raising", quality );
+		priv->quality = quality;
+		mlt_properties_set_int( properties, "adaptive_level", quality );
+	}
+}
+
+/** Get the image size to request from the service network.
+ *
+ * This is the consumer size unless adaptive mode has lowered quality enough
+ * to render a scaled down preview.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \param[out] width the width to request
+ * \param[out] height the height to request
+ */
+
+static void get_render_size( mlt_consumer self, int *width, int *height )
+{
+	consumer_private *priv = self->local;
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( self );
+
+	*width = mlt_properties_get_int( properties, "width" );
+	*height = mlt_properties_get_int( properties, "height" );
+	if ( priv->quality >= 2 )
+	{
+		double scale = mlt_properties_get( properties, "adaptive_scale" ) ?
+			mlt_properties_get_double( properties, "adaptive_scale" ) : 0.5;
+		if ( scale > 0.0 && scale < 1.0 )
+		{
+			*width = MAX( 2, lrint( *width * scale ) & ~1 );
+			*height = MAX( 2, lrint( *height * scale ) & ~1 );
+		}
+	}
+}
+
 /** Compute the time difference between now and a time value.
  *
  * \private \memberof mlt_consumer_s
@@ -803,6 +1037,7 @@ static void *consumer_read_ahead_thread( void *arg )
 	mlt_position last_pos = 0;
 	int frame_duration = mlt_properties_get_int( properties, "frame_duration" );
 	int drop_max = mlt_properties_get_int( properties, "drop_max" );
+	int quality = priv->quality;
 
 	if ( preview_off && preview_format != 0 )
 		priv->image_format = preview_format;
@@ -828,7 +1063,7 @@ static void *consumer_read_ahead_thread( void *arg )
 		// Get the image of the first frame
 		if ( !video_off )
 		{
-			mlt_events_fire( MLT_CONSUMER_PROPERTIES( self ), "consumer-frame-render", frame, NULL );
+			mlt_events_fire_id( MLT_CONSUMER_PROPERTIES( self ), priv->frame_render_event, frame, NULL );
 			mlt_frame_get_image( frame, &image, &priv->image_format, &width, &height, 0 );
 		}
 
@@ -848,7 +1083,7 @@ static void *consumer_read_ahead_thread( void *arg )
 	
 		// Put the current frame into the queue
 		pthread_mutex_lock( &priv->queue_mutex );
-		while( priv->ahead && mlt_deque_count( priv->queue ) >= buffer )
+		while( priv->ahead && ( mlt_deque_count( priv->queue ) >= buffer || is_throttled( self ) ) )
 			pthread_cond_wait( &priv->queue_cond, &priv->queue_mutex );
 		if ( priv->is_purge )
 		{
@@ -902,11 +1137,10 @@ static void *consumer_read_ahead_thread( void *arg )
 			if ( !video_off )
 			{
 				// Reset width/height - could have been changed by previous mlt_frame_get_image
-				width = mlt_properties_get_int( properties, "width" );
-				height = mlt_properties_get_int( properties, "height" );
+				get_render_size( self, &width, &height );
 
 				// Get the image
-				mlt_events_fire( MLT_CONSUMER_PROPERTIES( self ), "consumer-frame-render", frame, NULL );
+				mlt_events_fire_id( MLT_CONSUMER_PROPERTIES( self ), priv->frame_render_event, frame, NULL );
 				mlt_log_timings_begin();
 				mlt_frame_get_image( frame, &image, &priv->image_format, &width, &height, 0 );
 				mlt_log_timings_end( NULL, "mlt_frame_get_image" );
@@ -956,8 +1190,10 @@ static void *consumer_read_ahead_thread( void *arg )
 		last_pos = pos;
 
 		// Do not skip the first 20% of buffer at start, resume, or seek
-		if ( pos - start_pos <= buffer / 5 + 1 )
+		// and measure the cost anew when adaptive mode changes quality
+		if ( pos - start_pos <= buffer / 5 + 1 || quality != priv->quality )
 		{
+			quality = priv->quality;
 			// Reset cost tracker
 			time_process = 0;
 			count = 1;
@@ -985,6 +1221,7 @@ static void *consumer_read_ahead_thread( void *arg )
 	pthread_mutex_lock( &priv->queue_mutex );
 	while ( mlt_deque_count( priv->queue ) )
 		mlt_frame_close( mlt_deque_pop_back( priv->queue ) );
+	account_queue( self );
 
 	// Close the queue
 	mlt_deque_close( priv->queue );
@@ -1050,6 +1287,11 @@ static void *consumer_worker_thread( void *arg )
 	mlt_frame frame = NULL;
 	uint8_t *image = NULL;
 
+	// The number of this thread and the time it took to render the last frame
+	int id = priv->thread_index++;
+	struct timeval ante;
+	int time_render = 0;
+
 	if ( preview_off && preview_format != 0 )
 		format = preview_format;
 
@@ -1060,8 +1302,14 @@ static void *consumer_worker_thread( void *arg )
 	{
 		// Get the next unprocessed frame from the work queue
 		pthread_mutex_lock( &priv->queue_mutex );
+		if ( time_render )
+		{
+			// Keep a moving average of the render time
+			priv->render_usec = priv->render_usec ? ( priv->render_usec * 7 + time_render ) / 8 : time_render;
+			time_render = 0;
+		}
 		int index = first_unprocessed_frame( self );
-		while ( priv->ahead && index >= mlt_deque_count( priv->queue ) )
+		while ( priv->ahead && ( index >= mlt_deque_count( priv->queue ) || id >= priv->active_threads ) )
 		{
 			mlt_log_debug( MLT_CONSUMER_SERVICE(self), "waiting in worker index = %d queue count = %d\n",
 				index, mlt_deque_count( priv->queue ) );
@@ -1097,10 +1345,12 @@ static void *consumer_worker_thread( void *arg )
 		if ( !video_off )
 		{
 			// Fetch width/height again
-			width = mlt_properties_get_int( properties, "width" );
-			height = mlt_properties_get_int( properties, "height" );
-			mlt_events_fire( MLT_CONSUMER_PROPERTIES( self ), "consumer-frame-render", frame, NULL );
+			get_render_size( self, &width, &height );
+			mlt_events_fire_id( MLT_CONSUMER_PROPERTIES( self ), priv->frame_render_event, frame, NULL );
+			gettimeofday( &ante, NULL );
 			mlt_frame_get_image( frame, &image, &format, &width, &height, 0 );
+			time_render = time_difference( &ante );
+			time_render = MAX( 1, time_render );
 		}
 		mlt_properties_set_int( MLT_FRAME_PROPERTIES( frame ), "rendered", 1 );
 		mlt_frame_close( frame );
@@ -1164,6 +1414,21 @@ static void consumer_work_start( mlt_consumer self )
 	// We're running now
 	priv->ahead = 1;
 	priv->threads = thread;
+
+	// With autoscale start with half of the threads and measure the load
+	priv->autoscale = mlt_properties_get_int( MLT_CONSUMER_PROPERTIES( self ), "autoscale" );
+	priv->active_threads = priv->autoscale ? MAX( 1, n / 2 ) : n;
+	priv->max_threads = n;
+#ifndef _WIN32
+	int cpus = sysconf( _SC_NPROCESSORS_ONLN );
+	if ( cpus > 0 )
+		priv->max_threads = MIN( n, cpus );
+#endif
+	priv->thread_index = 0;
+	priv->render_usec = 0;
+	priv->autoscale_frames = 0;
+	priv->autoscale_waits = 0;
+	mlt_properties_set_int( MLT_CONSUMER_PROPERTIES( self ), "active_threads", priv->active_threads );
 	
 	// These keep track of the acceleration of frame dropping or recovery.
 	priv->consecutive_dropped = 0;
@@ -1316,6 +1581,7 @@ static void consumer_work_stop( mlt_consumer self )
 		// Wipe the queues
 		while ( mlt_deque_count( priv->queue ) )
 			mlt_frame_close( mlt_deque_pop_back( priv->queue ) );
+		account_queue( self );
 
 		// Close the queues
 		mlt_deque_close( priv->queue );
@@ -1353,6 +1619,8 @@ void mlt_consumer_purge( mlt_consumer self )
 
 		while ( priv->started && mlt_deque_count( priv->queue ) )
 			mlt_frame_close( mlt_deque_pop_back( priv->queue ) );
+		if ( priv->started )
+			account_queue( self );
 
 		if ( priv->started && priv->real_time )
 		{
@@ -1377,6 +1645,87 @@ void mlt_consumer_purge( mlt_consumer self )
 	}
 }
 
+/** Scale the number of active worker threads to the load.
+ *
+ * This runs twice per second of frames. In real time, it activates enough threads
+ * to render a frame per frame duration at the measured render time, one more
+ * while frames are dropped, and one fewer at a time when there are more than
+ * enough. Otherwise, it activates one more thread when the consumer
+ * waited for frames to render and one fewer when rendered frames kept piling up.
+ * The number of active threads is limited to the number of processors.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \param waited whether the last frame was not rendered in time
+ */
+
+static void autoscale_workers( mlt_consumer self, int waited )
+{
+	consumer_private *priv = self->local;
+	mlt_properties properties = MLT_CONSUMER_PROPERTIES( self );
+	int frame_duration = mlt_properties_get_int( properties, "frame_duration" );
+	int threads = priv->active_threads;
+
+	priv->autoscale_waits += waited;
+	if ( ++priv->autoscale_frames < MAX( 1, priv->fps / 2 ) )
+		return;
+
+	pthread_mutex_lock( &priv->queue_mutex );
+	if ( priv->real_time > 0 && frame_duration > 0 && priv->render_usec > 0 )
+	{
+		threads = ( priv->render_usec + frame_duration - 1 ) / frame_duration;
+		if ( priv->autoscale_waits )
+			threads = MAX( threads, priv->active_threads + 1 );
+		else if ( threads < priv->active_threads )
+			threads = priv->active_threads - 1;
+	}
+	else if ( priv->real_time < 0 )
+	{
+		if ( priv->autoscale_waits > priv->autoscale_frames / 4 )
+			threads++;
+		else if ( !priv->autoscale_waits && first_unprocessed_frame( self ) > threads )
+			threads--;
+	}
+	threads = CLAMP( threads, 1, priv->max_threads );
+	priv->autoscale_frames = 0;
+	priv->autoscale_waits = 0;
+
+	if ( threads != priv->active_threads )
+	{
+		mlt_log_verbose( MLT_CONSUMER_SERVICE( self ), "%s worker threads to %d (render %d usec)\n",
+			threads > priv->active_threads ? "increasing" : "decreasing", threads, (int) priv->render_usec );
+		priv->active_threads = threads;
+		priv->process_head = MIN( priv->process_head, threads );
+		pthread_cond_broadcast( &priv->queue_cond );
+	}
+	pthread_mutex_unlock( &priv->queue_mutex );
+	mlt_properties_set_int( properties, "active_threads", threads );
+}
+
+/** Get the number of frames to read ahead when scaling the worker threads.
+ *
+ * In real time, workers take frames after the process head, so this leaves room
+ * beyond it for one frame per active thread and the number of frames played in
+ * the time it takes to render one, but not more than buffer.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \param buffer the maximum number of frames to read ahead
+ * \return the number of frames to read ahead
+ */
+
+static int autoscale_buffer( mlt_consumer self, int buffer )
+{
+	consumer_private *priv = self->local;
+	int frame_duration = mlt_properties_get_int( MLT_CONSUMER_PROPERTIES( self ), "frame_duration" );
+	int latency = 0;
+
+	if ( priv->real_time > 0 && frame_duration > 0 )
+		latency = ( priv->render_usec + frame_duration - 1 ) / frame_duration;
+	return MIN( MAX( buffer, priv->active_threads + 1 ),
+		MAX( priv->process_head, priv->active_threads ) + priv->active_threads + latency + 1 );
+}
+
 /** Use multiple worker threads and a work queue.
  */
 
@@ -1385,15 +1734,16 @@ static mlt_frame worker_get_frame( mlt_consumer self, mlt_properties properties
 	// Frame to return
 	mlt_frame frame = NULL;
 	consumer_private *priv = self->local;
-	int threads = abs( priv->real_time );
+	int threads = priv->started ? priv->active_threads : abs( priv->real_time );
 	int audio_off = mlt_properties_get_int( properties, "audio_off" );
 	int samples = 0;
 	void *audio = NULL;
+	int waited = 0;
 	int buffer = mlt_properties_get_int( properties, "_buffer" );
 	buffer = buffer > 0 ? buffer : mlt_properties_get_int( properties, "buffer" );
 	// This is a heuristic to determine a suitable minimum buffer size for the number of threads.
 	int headroom = (priv->real_time < 0) ? threads : (2 + threads * threads);
-	buffer = MAX(buffer, headroom);
+	buffer = priv->started && priv->autoscale ? autoscale_buffer( self, buffer ) : MAX(buffer, headroom);
 
 	// Start worker threads if not already started.
 	if ( ! priv->ahead )
@@ -1404,10 +1754,13 @@ static mlt_frame worker_get_frame( mlt_consumer self, mlt_properties properties
 		set_audio_format( self );
 		set_image_format( self );
 		consumer_work_start( self );
+		threads = priv->active_threads;
+		if ( priv->autoscale )
+			buffer = autoscale_buffer( self, buffer );
 
 		// Fill the work queue.
 		int i = buffer;
-		while ( priv->ahead && i-- )
+		while ( priv->ahead && i-- && !worker_is_throttled( self ) )
 		{
 			frame = mlt_consumer_get_frame( self );
 			if ( frame )
@@ -1420,7 +1773,7 @@ static mlt_frame worker_get_frame( mlt_consumer self, mlt_properties properties
 				}
 				pthread_mutex_lock( &priv->queue_mutex );
 				mlt_deque_push_back( priv->queue, frame );
-				pthread_cond_signal( &priv->queue_cond );
+				pthread_cond_broadcast( &priv->queue_cond );
 				pthread_mutex_unlock( &priv->queue_mutex );
 				priv->speed = mlt_properties_get_int( MLT_FRAME_PROPERTIES( frame ), "_speed" );
 				buffer = (priv->speed == 0) ? 1 : buffer;
@@ -1428,6 +1781,7 @@ static mlt_frame worker_get_frame( mlt_consumer self, mlt_properties properties
 		}
 
 		// Wait for prefill
+		prefill = MIN( prefill, mlt_deque_count( priv->queue ) );
 		while ( priv->ahead && first_unprocessed_frame( self ) < prefill )
 		{
 			pthread_mutex_lock( &priv->done_mutex );
@@ -1441,7 +1795,7 @@ static mlt_frame worker_get_frame( mlt_consumer self, mlt_properties properties
 //		threads, first_unprocessed_frame( self ), mlt_deque_count( priv->queue ), priv->process_head );
 
 	// Feed the work queue
-	while ( priv->ahead && mlt_deque_count( priv->queue ) < buffer )
+	while ( priv->ahead && mlt_deque_count( priv->queue ) < buffer && !worker_is_throttled( self ) )
 	{
 		frame = mlt_consumer_get_frame( self );
 		if ( frame )
@@ -1454,7 +1808,7 @@ static mlt_frame worker_get_frame( mlt_consumer self, mlt_properties properties
 			}
 			pthread_mutex_lock( &priv->queue_mutex );
 			mlt_deque_push_back( priv->queue, frame );
-			pthread_cond_signal( &priv->queue_cond );
+			pthread_cond_broadcast( &priv->queue_cond );
 			pthread_mutex_unlock( &priv->queue_mutex );
 			priv->speed = mlt_properties_get_int( MLT_FRAME_PROPERTIES( frame ), "_speed" );
 			buffer = (priv->speed == 0) ? 1 : buffer;
@@ -1468,10 +1822,12 @@ static mlt_frame worker_get_frame( mlt_consumer self, mlt_properties properties
 		pthread_mutex_lock( &priv->done_mutex );
 		pthread_cond_wait( &priv->done_cond, &priv->done_mutex );
 		pthread_mutex_unlock( &priv->done_mutex );
+		waited = 1;
 	}
 
 	// Get the frame from the queue.
 	pthread_mutex_lock( &priv->queue_mutex );
+	account_queue( self );
 	frame = mlt_deque_pop_front( priv->queue );
 	pthread_mutex_unlock( &priv->queue_mutex );
 	if ( ! frame ) {
@@ -1482,7 +1838,8 @@ static mlt_frame worker_get_frame( mlt_consumer self, mlt_properties properties
 	// Adapt the worker process head to the runtime conditions.
 	if ( priv->real_time > 0 )
 	{
-		if ( mlt_properties_get_int( MLT_FRAME_PROPERTIES( frame ), "rendered" ) )
+		int rendered = mlt_properties_get_int( MLT_FRAME_PROPERTIES( frame ), "rendered" );
+		if ( rendered )
 		{
 			priv->consecutive_dropped = 0;
 			if ( priv->process_head > threads && priv->consecutive_rendered >= priv->process_head )
@@ -1530,7 +1887,11 @@ static mlt_frame worker_get_frame( mlt_consumer self, mlt_properties properties
 			mlt_properties_set_int( properties, "drop_count", ++dropped );
 			mlt_log_verbose( MLT_CONSUMER_SERVICE(self), "dropped video frame %d\n", dropped );
 		}
+		adapt_quality( self, rendered );
+		waited = !rendered;
 	}
+	if ( priv->autoscale )
+		autoscale_workers( self, waited );
 	if ( priv->is_purge ) {
 		priv->is_purge = 0;
 		mlt_frame_close( frame );
@@ -1584,8 +1945,9 @@ mlt_frame mlt_consumer_rt_frame( mlt_consumer self )
 		// Get frame from queue
 		pthread_mutex_lock( &priv->queue_mutex );
 		mlt_log_timings_begin();
-		while( priv->ahead && mlt_deque_count( priv->queue ) < size )
+		while( priv->ahead && mlt_deque_count( priv->queue ) < size && !is_throttled( self ) )
 			pthread_cond_wait( &priv->queue_cond, &priv->queue_mutex );
+		account_queue( self );
 		frame = mlt_deque_pop_front( priv->queue );
 		mlt_log_timings_end( NULL, "wait_for_frame_queue" );
 		pthread_cond_broadcast( &priv->queue_cond );
@@ -1597,6 +1959,8 @@ mlt_frame mlt_consumer_rt_frame( mlt_consumer self )
 			mlt_properties_set_int( properties, "drop_count", ++dropped );
 			mlt_log_verbose( MLT_CONSUMER_SERVICE(self), "dropped video frame %d\n", dropped );
 		}
+		if ( priv->real_time == 1 && frame )
+			adapt_quality( self, mlt_properties_get_int( MLT_FRAME_PROPERTIES(frame), "rendered" ) );
 	}
 	else // real_time == 0
 	{
@@ -1684,6 +2048,22 @@ int mlt_consumer_stop( mlt_consumer self )
 	// Kill the test card
 	mlt_properties_set_data( properties, "test_card_producer", NULL, 0, NULL, NULL );
 
+	// Write the trace
+	if ( priv->trace )
+	{
+		const char *trace = mlt_properties_get( properties, "trace" ) ?
+			mlt_properties_get( properties, "trace" ) : getenv( "MLT_TRACE" );
+		const char *summary = mlt_properties_get( properties, "trace_summary" ) ?
+			mlt_properties_get( properties, "trace_summary" ) : getenv( "MLT_TRACE_SUMMARY" );
+
+		mlt_trace_enable( 0 );
+		priv->trace = 0;
+		if ( trace && mlt_trace_write_json( trace ) )
+			mlt_log_error( MLT_CONSUMER_SERVICE( self ), "failed to write the trace to %s\n", trace );
+		if ( summary && mlt_trace_write_summary( summary ) )
+			mlt_log_error( MLT_CONSUMER_SERVICE( self ), "failed to write the trace summary to %s\n", summary );
+	}
+
 	// Check and run a post command
 	if ( mlt_properties_get( properties, "post" ) )
 		if (system( mlt_properties_get( properties, "post" ) ) == -1 )
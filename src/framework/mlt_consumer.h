@@ -82,6 +82,27 @@
  * \properties \em audio_off set non-zero to disable audio processing
  * \properties \em video_off set non-zero to disable video processing
  * \properties \em drop_count the number of video frames not rendered since starting consumer
+ * \properties \em trace the name of a file to which to write a Chrome trace of the render when stopped,
+ * defaults to the MLT_TRACE environment variable
+ * \properties \em trace_summary the name of a file, or "-" for stderr, to which to write the time spent
+ * per service when stopped, defaults to the MLT_TRACE_SUMMARY environment variable
+ * \properties \em adaptive set non-zero to lower the processing quality when real_time is not 0
+ * and frames are dropped, and to restore it once frames are rendered in time again
+ * \properties \em adaptive_scale the fraction of the size at which to render frames at
+ * adaptive_level 2 and above, defaults to 0.5
+ * \properties \em adaptive_level the level by which adaptive mode has lowered quality (read only):
+ * 1 uses nearest neighbour scaling and one field deinterlacing, 2 also renders at adaptive_scale,
+ * and 3 also skips deinterlacing
+ * \properties \em autoscale set non-zero to vary the number of worker threads between 1 and
+ * the absolute value of real_time, and the number of frames to read ahead, with the measured
+ * render time and the number of processors
+ * \properties \em active_threads the number of worker threads rendering frames (read only)
+ * \properties \em render_cache the name of an existing directory in which to store rendered
+ * images and audio, and from which to reuse them where the service network is unchanged,
+ * see mlt_render_cache_hash(). The files are uncompressed: a 1920x1080 frame in yuv422 takes
+ * about 4 MB, or 100 MB for each second at 25 fps, plus its audio.
+ * \properties \em render_cache_size the most bytes the files in the render_cache directory may
+ * take before the least recently used ones are removed, 0 for no limit, defaults to 1 GiB
  */
 
 struct mlt_consumer_s
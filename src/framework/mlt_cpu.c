@@ -0,0 +1,53 @@
+/**
+ * \file mlt_cpu.c
+ * \brief detection of optional CPU instruction sets
+ * \see mlt_cpu.h
+ *
+ * Copyright (C) 2020 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "mlt_cpu.h"
+
+#include <pthread.h>
+
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+static int g_features = 0;
+
+static void detect_features( void )
+{
+#if ( defined(__x86_64__) || defined(__i386__) ) && defined(__GNUC__)
+	__builtin_cpu_init();
+	if ( __builtin_cpu_supports( "avx2" ) )
+		g_features |= mlt_cpu_avx2;
+	if ( __builtin_cpu_supports( "fma" ) )
+		g_features |= mlt_cpu_fma;
+#endif
+}
+
+/** Determine if the CPU supports instruction sets.
+ *
+ * The CPU is only examined once, and this may be called from any thread.
+ *
+ * \param features a combination of mlt_cpu_feature flags
+ * \return true if all of \p features are supported
+ */
+
+int mlt_cpu_has( int features )
+{
+	pthread_once( &g_once, detect_features );
+	return ( g_features & features ) == features;
+}
@@ -0,0 +1,37 @@
+/**
+ * \file mlt_cpu.h
+ * \brief detection of optional CPU instruction sets
+ * \see mlt_cpu.c
+ *
+ * Copyright (C) 2020 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef MLT_CPU_H
+#define MLT_CPU_H
+
+/** The optional instruction sets that services check for at run time */
+
+typedef enum
+{
+	mlt_cpu_avx2 = 1 << 0, /**< AVX2 */
+	mlt_cpu_fma  = 1 << 1  /**< FMA3 */
+}
+mlt_cpu_feature;
+
+extern int mlt_cpu_has( int features );
+
+#endif
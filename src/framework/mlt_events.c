@@ -24,6 +24,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
 #include "mlt_properties.h"
 #include "mlt_events.h"
@@ -37,6 +38,54 @@ static int events_created = 0;
 static int events_destroyed = 0;
 #endif
 
+/** The maximum number of distinct event names in a process */
+
+#define MAX_EVENT_IDS (256)
+
+/** The names of the events, where the index of a name is the id of the event */
+
+static char *event_names[ MAX_EVENT_IDS ];
+static atomic_int event_count = 0;
+static pthread_mutex_t event_names_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** \brief Listener list class
+ *
+ * An immutable snapshot of the listeners of an event. Changes replace the
+ * snapshot, so firing reads it without a lock.
+ */
+
+typedef struct
+{
+	int count;
+	mlt_event events[];
+}
+*listener_list;
+
+/** \brief Event slot class
+ *
+ * The registration of an event on a properties list.
+ */
+
+typedef struct
+{
+	const char *name;
+	mlt_transmitter transmitter;
+	_Atomic( listener_list ) listeners;
+}
+*event_slot;
+
+/** \brief Slot table class
+ *
+ * The registered events of a properties list indexed by the id of the event.
+ */
+
+typedef struct
+{
+	int size;
+	event_slot slots[];
+}
+*slot_table;
+
 /** \brief Events class
  *
  * Events provide messages and notifications between services and the application.
@@ -48,7 +97,16 @@ static int events_destroyed = 0;
 struct mlt_events_struct
 {
 	mlt_properties owner;
-	mlt_properties list;
+	_Atomic( slot_table ) table;
+	atomic_int listening;       /**< the number of listeners of all events */
+	atomic_int firing;          /**< the number of fires in progress */
+	pthread_mutex_t mutex;      /**< serialises changes to the table and listeners */
+	void **garbage;             /**< snapshots replaced while firing */
+	int garbage_count;
+	int garbage_size;
+	mlt_event *retired;         /**< events disconnected while firing */
+	int retired_count;
+	int retired_size;
 };
 
 typedef struct mlt_events_struct *mlt_events;
@@ -59,9 +117,9 @@ typedef struct mlt_events_struct *mlt_events;
 
 struct mlt_event_struct
 {
-	mlt_events owner;
-	int ref_count;
-	int block_count;
+	_Atomic( mlt_events ) owner;
+	atomic_int ref_count;
+	atomic_int block_count;
 	mlt_listener listener;
 	void *service;
 };
@@ -102,7 +160,13 @@ void mlt_event_unblock( mlt_event self )
 		self->block_count --;
 }
 
+static void mlt_events_prune( mlt_events events );
+
 /** Close self event.
+ *
+ * When only the listeners of its properties list still refer to the event, it
+ * is disconnected and dropped from them, so that the event no longer counts as
+ * a listener.
  *
  * \public \memberof mlt_event_struct
  * \param self an event
@@ -113,7 +177,16 @@ void mlt_event_close( mlt_event self )
 	if ( self != NULL )
 	{
 		if ( -- self->ref_count == 1 )
-			self->owner = NULL;
+		{
+			mlt_events events = atomic_exchange( &self->owner, NULL );
+
+			// Pruning releases the last reference, so self may be gone after it
+			if ( events != NULL )
+			{
+				mlt_events_prune( events );
+				return;
+			}
+		}
 		if ( self->ref_count <= 0 )
 		{
 #ifdef _MLT_EVENT_CHECKS_
@@ -130,6 +203,9 @@ void mlt_event_close( mlt_event self )
 static mlt_events mlt_events_fetch( mlt_properties );
 static void mlt_events_close( mlt_events );
 
+extern void *mlt_properties_get_events( mlt_properties self );
+extern void mlt_properties_set_events( mlt_properties self, void *events );
+
 /** Initialise the events structure.
  *
  * \public \memberof mlt_events_struct
@@ -142,11 +218,218 @@ void mlt_events_init( mlt_properties self )
 	if (!events && self) {
 		events = calloc( 1, sizeof( struct mlt_events_struct ) );
 		if (events) {
-			events->list = mlt_properties_new( );
 			events->owner = self;
+			pthread_mutex_init( &events->mutex, NULL );
 			mlt_properties_set_data( self, "_events", events, 0, ( mlt_destructor )mlt_events_close, NULL );
+			mlt_properties_set_events( self, events );
+		}
+	}
+}
+
+/** Get the numeric id of an event.
+ *
+ * The id of a name is the same for every properties list and for the life of
+ * the process. Use it with mlt_events_fire_id() to avoid looking up the name
+ * each time an event is fired.
+ *
+ * \public \memberof mlt_events_struct
+ * \param name the name of an event
+ * \return the id, or -1 if there are too many distinct events
+ */
+
+int mlt_events_id( const char *name )
+{
+	int count = atomic_load( &event_count );
+	int i;
+
+	for ( i = 0; i < count; i ++ )
+		if ( !strcmp( event_names[ i ], name ) )
+			return i;
+
+	pthread_mutex_lock( &event_names_mutex );
+	count = atomic_load( &event_count );
+	for ( ; i < count; i ++ )
+		if ( !strcmp( event_names[ i ], name ) )
+			break;
+	if ( i == count )
+	{
+		if ( count < MAX_EVENT_IDS )
+		{
+			event_names[ count ] = strdup( name );
+			atomic_store( &event_count, count + 1 );
+		}
+		else
+		{
+			i = -1;
+		}
+	}
+	pthread_mutex_unlock( &event_names_mutex );
+	return i;
+}
+
+/** Keep memory that a fire in progress may still be reading.
+ *
+ * \private \memberof mlt_events_struct
+ * \param events an events object
+ * \param ptr the memory to free once no fire is in progress
+ */
+
+static void mlt_events_discard( mlt_events events, void *ptr )
+{
+	if ( ptr == NULL )
+		return;
+	if ( events->garbage_count == events->garbage_size )
+	{
+		events->garbage_size = events->garbage_size ? events->garbage_size * 2 : 8;
+		events->garbage = realloc( events->garbage, events->garbage_size * sizeof( void* ) );
+	}
+	events->garbage[ events->garbage_count ++ ] = ptr;
+}
+
+/** Release an event that a fire in progress may still be calling.
+ *
+ * \private \memberof mlt_events_struct
+ * \param events an events object
+ * \param event the event to close once no fire is in progress
+ */
+
+static void mlt_events_retire( mlt_events events, mlt_event event )
+{
+	if ( events->retired_count == events->retired_size )
+	{
+		events->retired_size = events->retired_size ? events->retired_size * 2 : 8;
+		events->retired = realloc( events->retired, events->retired_size * sizeof( mlt_event ) );
+	}
+	events->retired[ events->retired_count ++ ] = event;
+}
+
+/** Free the discarded snapshots and retired events unless a fire is in progress.
+ *
+ * A fire increments the firing count before it loads a snapshot, and a change
+ * publishes its snapshot before it checks the count, so a fire that starts
+ * after this check can only see the new snapshots.
+ *
+ * \private \memberof mlt_events_struct
+ * \param events an events object
+ */
+
+static void mlt_events_reclaim( mlt_events events )
+{
+	int i;
+
+	if ( atomic_load( &events->firing ) > 0 )
+		return;
+	for ( i = 0; i < events->garbage_count; i ++ )
+		free( events->garbage[ i ] );
+	events->garbage_count = 0;
+	for ( i = 0; i < events->retired_count; i ++ )
+		mlt_event_close( events->retired[ i ] );
+	events->retired_count = 0;
+}
+
+/** Find the slot of an event by name.
+ *
+ * \private \memberof mlt_events_struct
+ * \param table a slot table
+ * \param id the name of an event
+ * \return the slot or NULL if the event is not registered
+ */
+
+static event_slot mlt_events_find( slot_table table, const char *id )
+{
+	int i;
+	for ( i = 0; table != NULL && i < table->size; i ++ )
+		if ( table->slots[ i ] && !strcmp( table->slots[ i ]->name, id ) )
+			return table->slots[ i ];
+	return NULL;
+}
+
+/** Replace the listeners of an event.
+ *
+ * The caller holds the mutex of the events object.
+ *
+ * \private \memberof mlt_events_struct
+ * \param events an events object
+ * \param slot the event
+ * \param listeners the new snapshot or NULL when nobody listens
+ */
+
+static void mlt_events_publish( mlt_events events, event_slot slot, listener_list listeners )
+{
+	listener_list old = atomic_load( &slot->listeners );
+	atomic_fetch_add( &events->listening, ( listeners ? listeners->count : 0 ) - ( old ? old->count : 0 ) );
+	atomic_store( &slot->listeners, listeners );
+	mlt_events_discard( events, old );
+}
+
+/** Remove the listeners of an event that match a condition.
+ *
+ * The caller holds the mutex of the events object. An event matches when its
+ * owner was cleared, or when it equals \p event, or when it belongs to
+ * \p service.
+ *
+ * \private \memberof mlt_events_struct
+ * \param events an events object
+ * \param slot the event
+ * \param event an event to remove or NULL
+ * \param service the service whose events to remove or NULL
+ */
+
+static void mlt_events_remove( mlt_events events, event_slot slot, mlt_event event, void *service )
+{
+	listener_list old = atomic_load( &slot->listeners );
+	listener_list listeners = NULL;
+	int i, count = 0;
+
+	if ( old == NULL )
+		return;
+	for ( i = 0; i < old->count; i ++ )
+	{
+		mlt_event entry = old->events[ i ];
+		if ( entry->owner != NULL && entry != event && ( service == NULL || entry->service != service ) )
+			count ++;
+	}
+	if ( count == old->count )
+		return;
+	if ( count > 0 )
+	{
+		listeners = malloc( sizeof( *listeners ) + count * sizeof( mlt_event ) );
+		listeners->count = 0;
+	}
+	for ( i = 0; i < old->count; i ++ )
+	{
+		mlt_event entry = old->events[ i ];
+		if ( entry->owner != NULL && entry != event && ( service == NULL || entry->service != service ) )
+		{
+			listeners->events[ listeners->count ++ ] = entry;
+		}
+		else
+		{
+			atomic_store( &entry->owner, NULL );
+			mlt_events_retire( events, entry );
 		}
 	}
+	mlt_events_publish( events, slot, listeners );
+}
+
+/** Remove the closed listeners of all events.
+ *
+ * \private \memberof mlt_events_struct
+ * \param events an events object
+ */
+
+static void mlt_events_prune( mlt_events events )
+{
+	slot_table table;
+	int j = 0;
+
+	pthread_mutex_lock( &events->mutex );
+	table = atomic_load( &events->table );
+	for ( j = 0; table != NULL && j < table->size; j ++ )
+		if ( table->slots[ j ] )
+			mlt_events_remove( events, table->slots[ j ], NULL, NULL );
+	mlt_events_reclaim( events );
+	pthread_mutex_unlock( &events->mutex );
 }
 
 /** Register an event and transmitter.
@@ -162,21 +445,76 @@ int mlt_events_register( mlt_properties self, const char *id, mlt_transmitter tr
 {
 	int error = 1;
 	mlt_events events = mlt_events_fetch( self );
-	if ( events != NULL )
+	int index = id ? mlt_events_id( id ) : -1;
+	if ( events != NULL && index >= 0 )
 	{
-		mlt_properties list = events->list;
-		char temp[ 128 ];
-		error = mlt_properties_set_data( list, id, transmitter, 0, NULL, NULL );
-		sprintf( temp, "list:%s", id );
-		if ( mlt_properties_get_data( list, temp, NULL ) == NULL )
-			mlt_properties_set_data( list, temp, mlt_properties_new( ), 0, ( mlt_destructor )mlt_properties_close, NULL );
+		slot_table table;
+
+		pthread_mutex_lock( &events->mutex );
+		table = atomic_load( &events->table );
+
+		// Grow the table to hold the id
+		if ( table == NULL || index >= table->size )
+		{
+			int size = index + 1;
+			slot_table grown = calloc( 1, sizeof( *grown ) + size * sizeof( event_slot ) );
+			grown->size = size;
+			if ( table != NULL )
+				memcpy( grown->slots, table->slots, table->size * sizeof( event_slot ) );
+			atomic_store( &events->table, grown );
+			mlt_events_discard( events, table );
+			table = grown;
+		}
+		if ( table->slots[ index ] == NULL )
+		{
+			event_slot slot = calloc( 1, sizeof( *slot ) );
+			slot->name = event_names[ index ];
+			table->slots[ index ] = slot;
+		}
+		table->slots[ index ]->transmitter = transmitter;
+
+		mlt_events_reclaim( events );
+		pthread_mutex_unlock( &events->mutex );
+		error = 0;
 	}
 	return error;
 }
 
+/** Call the listeners of an event.
+ *
+ * \private \memberof mlt_events_struct
+ * \param events an events object
+ * \param slot the event
+ * \param args the arguments for the transmitter
+ * \return the number of listeners
+ */
+
+static int mlt_events_dispatch( mlt_events events, event_slot slot, void **args )
+{
+	int result = 0;
+	listener_list listeners = slot ? atomic_load( &slot->listeners ) : NULL;
+	int i;
+
+	for ( i = 0; listeners != NULL && i < listeners->count; i ++ )
+	{
+		mlt_event event = listeners->events[ i ];
+		mlt_events owner = event->owner;
+		if ( owner != NULL && event->block_count == 0 )
+		{
+			if ( slot->transmitter != NULL )
+				slot->transmitter( event->listener, owner->owner, event->service, args );
+			else
+				event->listener( owner->owner, event->service );
+			++result;
+		}
+	}
+	return result;
+}
+
 /** Fire an event.
  *
  * This takes a variable number of arguments to supply to the listener.
+ * It returns right away when nobody listens to any event of the properties list.
 
  * \public \memberof mlt_events_struct
  * \param self a properties list
@@ -188,17 +526,11 @@ int mlt_events_fire( mlt_properties self, const char *id, ... )
 {
 	int result = 0;
 	mlt_events events = mlt_events_fetch( self );
-	if ( events != NULL )
+	if ( events != NULL && atomic_load_explicit( &events->listening, memory_order_relaxed ) > 0 )
 	{
 		int i = 0;
 		va_list alist;
 		void *args[ 10 ];
-		mlt_properties list = events->list;
-		mlt_properties listeners = NULL;
-		char temp[ 128 ];
-		mlt_transmitter transmitter = mlt_properties_get_data( list, id, NULL );
-		sprintf( temp, "list:%s", id );
-		listeners = mlt_properties_get_data( list, temp, NULL );
 
 		va_start( alist, id );
 		do
@@ -206,21 +538,76 @@ int mlt_events_fire( mlt_properties self, const char *id, ... )
 		while( args[ i ++ ] != NULL );
 		va_end( alist );
 
-		if ( listeners != NULL )
+		atomic_fetch_add( &events->firing, 1 );
+		result = mlt_events_dispatch( events, mlt_events_find( atomic_load( &events->table ), id ), args );
+		atomic_fetch_sub( &events->firing, 1 );
+	}
+	return result;
+}
+
+/** Fire an event by its id.
+ *
+ * This is the same as mlt_events_fire() without the lookup of the name.
+ *
+ * \public \memberof mlt_events_struct
+ * \param self a properties list
+ * \param id the id of an event from mlt_events_id()
+ * \return the number of listeners
+ */
+
+int mlt_events_fire_id( mlt_properties self, int id, ... )
+{
+	int result = 0;
+	mlt_events events = mlt_events_fetch( self );
+	if ( events != NULL && atomic_load_explicit( &events->listening, memory_order_relaxed ) > 0 )
+	{
+		int i = 0;
+		va_list alist;
+		void *args[ 10 ];
+		slot_table table;
+
+		va_start( alist, id );
+		do
+			args[ i ] = va_arg( alist, void * );
+		while( args[ i ++ ] != NULL );
+		va_end( alist );
+
+		atomic_fetch_add( &events->firing, 1 );
+		table = atomic_load( &events->table );
+		if ( table != NULL && id >= 0 && id < table->size )
+			result = mlt_events_dispatch( events, table->slots[ id ], args );
+		atomic_fetch_sub( &events->firing, 1 );
+	}
+	return result;
+}
+
+/** Determine if an event has listeners.
+ *
+ * This lets a caller skip preparing the arguments of an event nobody listens to.
+ *
+ * \private \memberof mlt_events_struct
+ * \param self a properties list
+ * \param id the id of an event from mlt_events_id()
+ * \return true if the event has listeners
+ */
+
+int mlt_events_listening( mlt_properties self, int id )
+{
+	int result = 0;
+	mlt_events events = mlt_events_fetch( self );
+	if ( events != NULL && atomic_load_explicit( &events->listening, memory_order_relaxed ) > 0 )
+	{
+		slot_table table;
+		listener_list listeners;
+
+		atomic_fetch_add( &events->firing, 1 );
+		table = atomic_load( &events->table );
+		if ( table != NULL && id >= 0 && id < table->size && table->slots[ id ] )
 		{
-			for ( i = 0; i < mlt_properties_count( listeners ); i ++ )
-			{
-				mlt_event event = mlt_properties_get_data_at( listeners, i, NULL );
-				if ( event != NULL && event->owner != NULL && event->block_count == 0 )
-				{
-					if ( transmitter != NULL )
-						transmitter( event->listener, event->owner->owner, event->service, args );
-					else
-						event->listener( event->owner->owner, event->service );
-					++result;
-				}
-			}
+			listeners = atomic_load( &table->slots[ id ]->listeners );
+			result = listeners != NULL && listeners->count > 0;
 		}
+		atomic_fetch_sub( &events->firing, 1 );
 	}
 	return result;
 }
@@ -241,27 +628,20 @@ mlt_event mlt_events_listen( mlt_properties self, void *service, const char *id,
 	mlt_events events = mlt_events_fetch( self );
 	if ( events != NULL )
 	{
-		mlt_properties list = events->list;
-		mlt_properties listeners = NULL;
-		char temp[ 128 ];
-		sprintf( temp, "list:%s", id );
-		listeners = mlt_properties_get_data( list, temp, NULL );
-		if ( listeners != NULL )
+		event_slot slot;
+
+		pthread_mutex_lock( &events->mutex );
+		slot = mlt_events_find( atomic_load( &events->table ), id );
+		if ( slot != NULL )
 		{
-			int first_null = -1;
+			listener_list old = atomic_load( &slot->listeners );
 			int i = 0;
-			for ( i = 0; event == NULL && i < mlt_properties_count( listeners ); i ++ )
+
+			for ( i = 0; old != NULL && event == NULL && i < old->count; i ++ )
 			{
-				mlt_event entry = mlt_properties_get_data_at( listeners, i, NULL );
-				if ( entry != NULL && entry->owner != NULL )
-				{
-					if ( entry->service == service && entry->listener == listener )
-						event = entry;
-				}
-				else if ( ( entry == NULL || entry->owner == NULL ) && first_null == -1 )
-				{
-					first_null = i;
-				}
+				mlt_event entry = old->events[ i ];
+				if ( entry->owner != NULL && entry->service == service && entry->listener == listener )
+					event = entry;
 			}
 
 			if ( event == NULL )
@@ -272,53 +652,80 @@ mlt_event mlt_events_listen( mlt_properties self, void *service, const char *id,
 #ifdef _MLT_EVENT_CHECKS_
 					events_created ++;
 #endif
-					sprintf( temp, "%d", first_null == -1 ? mlt_properties_count( listeners ) : first_null );
 					event->owner = events;
 					event->ref_count = 0;
 					event->block_count = 0;
 					event->listener = listener;
 					event->service = service;
-					mlt_properties_set_data( listeners, temp, event, 0, ( mlt_destructor )mlt_event_close, NULL );
 					mlt_event_inc_ref( event );
+
+					// Drop the listeners that were closed, and append the new one
+					mlt_events_remove( events, slot, NULL, NULL );
+					old = atomic_load( &slot->listeners );
+					listener_list listeners = malloc( sizeof( *listeners ) + ( ( old ? old->count : 0 ) + 1 ) * sizeof( mlt_event ) );
+					listeners->count = old ? old->count : 0;
+					if ( old != NULL )
+						memcpy( listeners->events, old->events, old->count * sizeof( mlt_event ) );
+					listeners->events[ listeners->count ++ ] = event;
+					mlt_events_publish( events, slot, listeners );
 				}
 			}
-
 		}
+		mlt_events_reclaim( events );
+		pthread_mutex_unlock( &events->mutex );
 	}
 	return event;
 }
 
-/** Block all events for a given service.
+/** Block or unblock all events for a given service.
  *
- * \public \memberof mlt_events_struct
+ * \private \memberof mlt_events_struct
  * \param self a properties list
  * \param service an opaque pointer
+ * \param block true to block, false to unblock
  */
 
-void mlt_events_block( mlt_properties self, void *service )
+static void mlt_events_set_blocked( mlt_properties self, void *service, int block )
 {
 	mlt_events events = mlt_events_fetch( self );
 	if ( events != NULL )
 	{
+		slot_table table;
 		int i = 0, j = 0;
-		mlt_properties list = events->list;
-		for ( j = 0; j < mlt_properties_count( list ); j ++ )
+
+		pthread_mutex_lock( &events->mutex );
+		table = atomic_load( &events->table );
+		for ( j = 0; table != NULL && j < table->size; j ++ )
 		{
-			char *temp = mlt_properties_get_name( list, j );
-			if ( !strncmp( temp, "list:", 5 ) )
+			listener_list listeners = table->slots[ j ] ? atomic_load( &table->slots[ j ]->listeners ) : NULL;
+			for ( i = 0; listeners != NULL && i < listeners->count; i ++ )
 			{
-				mlt_properties listeners = mlt_properties_get_data( list, temp, NULL );
-				for ( i = 0; i < mlt_properties_count( listeners ); i ++ )
+				mlt_event entry = listeners->events[ i ];
+				if ( entry->service == service )
 				{
-					mlt_event entry = mlt_properties_get_data_at( listeners, i, NULL );
-					if ( entry != NULL && entry->service == service )
+					if ( block )
 						mlt_event_block( entry );
+					else
+						mlt_event_unblock( entry );
 				}
 			}
 		}
+		pthread_mutex_unlock( &events->mutex );
 	}
 }
 
+/** Block all events for a given service.
+ *
+ * \public \memberof mlt_events_struct
+ * \param self a properties list
+ * \param service an opaque pointer
+ */
+
+void mlt_events_block( mlt_properties self, void *service )
+{
+	mlt_events_set_blocked( self, service, 1 );
+}
+
 /** Unblock all events for a given service.
  *
  * \public \memberof mlt_events_struct
@@ -328,26 +735,7 @@ void mlt_events_block( mlt_properties self, void *service )
 
 void mlt_events_unblock( mlt_properties self, void *service )
 {
-	mlt_events events = mlt_events_fetch( self );
-	if ( events != NULL )
-	{
-		int i = 0, j = 0;
-		mlt_properties list = events->list;
-		for ( j = 0; j < mlt_properties_count( list ); j ++ )
-		{
-			char *temp = mlt_properties_get_name( list, j );
-			if ( !strncmp( temp, "list:", 5 ) )
-			{
-				mlt_properties listeners = mlt_properties_get_data( list, temp, NULL );
-				for ( i = 0; i < mlt_properties_count( listeners ); i ++ )
-				{
-					mlt_event entry = mlt_properties_get_data_at( listeners, i, NULL );
-					if ( entry != NULL && entry->service == service )
-						mlt_event_unblock( entry );
-				}
-			}
-		}
-	}
+	mlt_events_set_blocked( self, service, 0 );
 }
 
 /** Disconnect all events for a given service.
@@ -360,25 +748,18 @@ void mlt_events_unblock( mlt_properties self, void *service )
 void mlt_events_disconnect( mlt_properties self, void *service )
 {
 	mlt_events events = mlt_events_fetch( self );
-	if ( events != NULL )
+	if ( events != NULL && service != NULL )
 	{
-		int i = 0, j = 0;
-		mlt_properties list = events->list;
-		for ( j = 0; j < mlt_properties_count( list ); j ++ )
-		{
-			char *temp = mlt_properties_get_name( list, j );
-			if ( !strncmp( temp, "list:", 5 ) )
-			{
-				mlt_properties listeners = mlt_properties_get_data( list, temp, NULL );
-				for ( i = 0; i < mlt_properties_count( listeners ); i ++ )
-				{
-					mlt_event entry = mlt_properties_get_data_at( listeners, i, NULL );
-					char *name = mlt_properties_get_name( listeners, i );
-					if ( entry != NULL && entry->service == service )
-						mlt_properties_set_data( listeners, name, NULL, 0, NULL, NULL );
-				}
-			}
-		}
+		slot_table table;
+		int j = 0;
+
+		pthread_mutex_lock( &events->mutex );
+		table = atomic_load( &events->table );
+		for ( j = 0; table != NULL && j < table->size; j ++ )
+			if ( table->slots[ j ] )
+				mlt_events_remove( events, table->slots[ j ], NULL, service );
+		mlt_events_reclaim( events );
+		pthread_mutex_unlock( &events->mutex );
 	}
 }
 
@@ -450,11 +831,16 @@ void mlt_events_close_wait_for( mlt_properties self, mlt_event event )
 	if ( event != NULL )
 	{
 		condition_pair *pair = event->service;
+		mlt_events events = event->owner;
 		event->owner = NULL;
 		pthread_mutex_unlock( &pair->mutex );
 		pthread_mutex_destroy( &pair->mutex );
 		pthread_cond_destroy( &pair->cond );
 		free( pair );
+
+		// Drop the closed listener from the snapshots
+		if ( events != NULL )
+			mlt_events_prune( events );
 	}
 }
 
@@ -467,10 +853,7 @@ void mlt_events_close_wait_for( mlt_properties self, mlt_event event )
 
 static mlt_events mlt_events_fetch( mlt_properties self )
 {
-	mlt_events events = NULL;
-	if ( self != NULL )
-		events = mlt_properties_get_data( self, "_events", NULL );
-	return events;
+	return self != NULL ? mlt_properties_get_events( self ) : NULL;
 }
 
 /** Close the events object.
@@ -483,7 +866,29 @@ static void mlt_events_close( mlt_events events )
 {
 	if ( events != NULL )
 	{
-		mlt_properties_close( events->list );
+		slot_table table = atomic_load( &events->table );
+		int i, j;
+
+		if ( mlt_properties_get_events( events->owner ) == events )
+			mlt_properties_set_events( events->owner, NULL );
+		for ( j = 0; table != NULL && j < table->size; j ++ )
+		{
+			event_slot slot = table->slots[ j ];
+			listener_list listeners = slot ? atomic_load( &slot->listeners ) : NULL;
+			for ( i = 0; listeners != NULL && i < listeners->count; i ++ )
+			{
+				atomic_store( &listeners->events[ i ]->owner, NULL );
+				mlt_event_close( listeners->events[ i ] );
+			}
+			free( listeners );
+			free( slot );
+		}
+		free( table );
+		atomic_store( &events->firing, 0 );
+		mlt_events_reclaim( events );
+		free( events->garbage );
+		free( events->retired );
+		pthread_mutex_destroy( &events->mutex );
 		free( events );
 	}
 }
@@ -44,6 +44,8 @@ typedef void ( *mlt_listener )( );
 extern void mlt_events_init( mlt_properties self );
 extern int mlt_events_register( mlt_properties self, const char *id, mlt_transmitter transmitter );
 extern int mlt_events_fire( mlt_properties self, const char *id, ... );
+extern int mlt_events_id( const char *name );
+extern int mlt_events_fire_id( mlt_properties self, int id, ... );
 extern mlt_event mlt_events_listen( mlt_properties self, void *service, const char *id, mlt_listener listener );
 extern void mlt_events_block( mlt_properties self, void *service );
 extern void mlt_events_unblock( mlt_properties self, void *service );
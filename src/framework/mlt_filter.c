@@ -23,6 +23,7 @@
 #include "mlt_filter.h"
 #include "mlt_frame.h"
 #include "mlt_producer.h"
+#include "mlt_trace.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -322,6 +323,14 @@ mlt_frame mlt_filter_process( mlt_filter self, mlt_frame frame )
 		mlt_properties_set_data( MLT_FRAME_PROPERTIES(frame), name, self, 0,
 			(mlt_destructor) mlt_filter_close, NULL );
 
+		if ( mlt_trace_is_enabled() )
+		{
+			int image_count = mlt_deque_count( MLT_FRAME_IMAGE_STACK( frame ) );
+			int audio_count = mlt_deque_count( MLT_FRAME_AUDIO_STACK( frame ) );
+			frame = self->process( self, frame );
+			mlt_trace_frame( frame, MLT_FILTER_SERVICE( self ), image_count, audio_count );
+			return frame;
+		}
 		return self->process( self, frame );
 	}
 }
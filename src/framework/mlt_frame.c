@@ -25,6 +25,7 @@
 #include "mlt_factory.h"
 #include "mlt_profile.h"
 #include "mlt_log.h"
+#include "mlt_audio_summary.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -333,6 +334,8 @@ mlt_deque mlt_frame_service_stack( mlt_frame self )
 
 int mlt_frame_set_image( mlt_frame self, uint8_t *image, int size, mlt_destructor destroy )
 {
+	if ( destroy == mlt_pool_release )
+		mlt_pool_tag( image, mlt_memory_image );
 	return mlt_properties_set_data( MLT_FRAME_PROPERTIES( self ), "image", image, size, destroy, NULL );
 }
 
@@ -349,6 +352,8 @@ int mlt_frame_set_image( mlt_frame self, uint8_t *image, int size, mlt_destructo
 int mlt_frame_set_alpha( mlt_frame self, uint8_t *alpha, int size, mlt_destructor destroy )
 {
 	self->get_alpha_mask = NULL;
+	if ( destroy == mlt_pool_release )
+		mlt_pool_tag( alpha, mlt_memory_image );
 	return mlt_properties_set_data( MLT_FRAME_PROPERTIES( self ), "alpha", alpha, size, destroy, NULL );
 }
 
@@ -411,6 +416,7 @@ const char * mlt_image_format_name( mlt_image_format format )
 		case mlt_image_glsl:    return "glsl";
 		case mlt_image_glsl_texture: return "glsl_texture";
 		case mlt_image_yuv422p16: return "yuv422p16";
+		case mlt_image_rgba64:  return "rgba64";
 		case mlt_image_invalid: return "invalid";
 	}
 	return "invalid";
@@ -471,6 +477,9 @@ int mlt_image_format_size( mlt_image_format format, int width, int height, int *
 		case mlt_image_yuv422p16:
 			if ( bpp ) *bpp = 0;
 			return 4 * height * width ;
+		case mlt_image_rgba64:
+			if ( bpp ) *bpp = 8;
+			return width * height * 8;
 		default:
 			if ( bpp ) *bpp = 0;
 			return 0;
@@ -539,6 +548,12 @@ static int generate_test_image( mlt_properties properties, uint8_t **buffer,  ml
 				if ( *buffer )
 					memset( *buffer, 255, size );
 				break;
+			case mlt_image_rgba64:
+				size = mlt_image_format_size( *format, *width, *height, NULL );
+				*buffer = mlt_pool_alloc( size );
+				if ( *buffer )
+					memset( *buffer, 255, size );
+				break;
 			case mlt_image_none:
 			case mlt_image_glsl:
 			case mlt_image_glsl_texture:
@@ -579,6 +594,7 @@ static int generate_test_image( mlt_properties properties, uint8_t **buffer,  ml
 				size = 0;
 				break;
 		}
+		mlt_pool_tag( *buffer, mlt_memory_image );
 		mlt_properties_set_data( properties, "image", *buffer, size, ( mlt_destructor )mlt_pool_release, NULL );
 		mlt_properties_set_int( properties, "test_image", 1 );
 		error = 0;
@@ -676,6 +692,7 @@ uint8_t *mlt_frame_get_alpha_mask( mlt_frame self )
 			int size = mlt_properties_get_int( &self->parent, "width" ) * mlt_properties_get_int( &self->parent, "height" );
 			alpha = mlt_pool_alloc( size );
 			memset( alpha, 255, size );
+			mlt_pool_tag( alpha, mlt_memory_image );
 			mlt_properties_set_data( &self->parent, "alpha", alpha, size, mlt_pool_release, NULL );
 		}
 	}
@@ -771,6 +788,7 @@ int mlt_frame_get_audio( mlt_frame self, void **buffer, mlt_audio_format *format
 			*buffer = NULL;
 		if ( *buffer )
 			memset( *buffer, 0, size );
+		mlt_pool_tag( *buffer, mlt_memory_audio );
 		mlt_properties_set_data( properties, "audio", *buffer, size, ( mlt_destructor )mlt_pool_release, NULL );
 		mlt_properties_set_int( properties, "test_audio", 1 );
 	}
@@ -815,15 +833,56 @@ int mlt_frame_get_audio( mlt_frame self, void **buffer, mlt_audio_format *format
 int mlt_frame_set_audio( mlt_frame self, void *buffer, mlt_audio_format format, int size, mlt_destructor destructor )
 {
 	mlt_properties_set_int( MLT_FRAME_PROPERTIES( self ), "audio_format", format );
+	if ( destructor == mlt_pool_release )
+		mlt_pool_tag( buffer, mlt_memory_audio );
 	return mlt_properties_set_data( MLT_FRAME_PROPERTIES( self ), "audio", buffer, size, destructor, NULL );
 }
 
+static unsigned char *get_waveform_from_summary( mlt_frame self, mlt_audio_summary summary, int64_t start, int64_t count, int w, int h )
+{
+	int channels = mlt_audio_summary_channels( summary );
+	int size = w * h;
+	unsigned char *bitmap = ( unsigned char* )mlt_pool_alloc( size );
+	int x, j, y;
+
+	if ( bitmap == NULL )
+		return NULL;
+	memset( bitmap, 0, size );
+	mlt_properties_set_data( MLT_FRAME_PROPERTIES( self ), "waveform", bitmap, size, ( mlt_destructor )mlt_pool_release, NULL );
+
+	// Draw a vertical line from the lowest to the highest peak of each column per channel
+	for ( x = 0; x < w; x++ )
+	{
+		int64_t from = start + count * x / w;
+		int64_t to = MAX( start + count * ( x + 1 ) / w, from + 1 );
+		for ( j = 0; j < channels; j++ )
+		{
+			float min, max;
+			if ( mlt_audio_summary_query( summary, j, from, to, &min, &max, NULL ) )
+				continue;
+			int centre = h * ( j * 2 + 1 ) / channels / 2;
+			int top = centre - (int) ( h * max / channels / 2 );
+			int bottom = centre - (int) ( h * min / channels / 2 );
+			top = top < 0 ? 0 : top;
+			bottom = bottom >= h ? h - 1 : bottom;
+			for ( y = top; y <= bottom; y++ )
+				bitmap[ y * w + x ] = 0xFF;
+		}
+	}
+
+	return bitmap;
+}
+
 /** Get audio on a frame as a waveform image.
  *
  * This generates an 8-bit grayscale image representation of the audio in a
  * frame. Currently, this only really works for 2 channels.
  * This allocates the bitmap using mlt_pool so you should release the return
  * value with \p mlt_pool_release.
+ * If the producer has an audio summary (see mlt_audio_summary_get()) that
+ * covers the frame and no filter has added audio processing to the frame,
+ * the peaks are drawn from it without decoding the audio. Columns narrower
+ * than MLT_AUDIO_SUMMARY_BIN samples then show the peaks of their bin.
  *
  * \public \memberof mlt_frame_s
  * \param self a frame
@@ -842,6 +901,21 @@ unsigned char *mlt_frame_get_waveform( mlt_frame self, int w, int h )
 	mlt_producer producer = mlt_frame_get_original_producer( self );
 	double fps = mlt_producer_get_fps( mlt_producer_cut_parent( producer ) );
 	int samples = mlt_audio_calculate_frame_samples( fps, frequency, mlt_frame_get_position( self ) );
+	mlt_audio_summary summary = producer ? mlt_properties_get_data( MLT_PRODUCER_PROPERTIES( mlt_producer_cut_parent( producer ) ), "_audio_summary", NULL ) : NULL;
+
+	// Draw from the audio summary of the producer when it has one that covers this frame,
+	// unless filters such as volume have been added to the audio of the producer
+	if ( summary && w > 0 && h > 0 &&
+	     mlt_properties_get( properties, "_producer_audio_stack" ) &&
+	     mlt_deque_count( MLT_FRAME_AUDIO_STACK( self ) ) == mlt_properties_get_int( properties, "_producer_audio_stack" ) )
+	{
+		// The summary covers the whole resource; the original position is relative to the in point of the producer
+		mlt_position position = mlt_frame_original_position( self ) + mlt_producer_get_in( producer );
+		int64_t start = mlt_audio_calculate_samples_to_position( fps, mlt_audio_summary_frequency( summary ), position );
+		int64_t count = mlt_audio_calculate_frame_samples( fps, mlt_audio_summary_frequency( summary ), position );
+		if ( count > 0 && start + count <= mlt_audio_summary_available( summary ) )
+			return get_waveform_from_summary( self, summary, start, count, w, h );
+	}
 
 	// Increase audio resolution proportional to requested image size
 	while ( samples < w )
@@ -1051,6 +1125,7 @@ mlt_frame mlt_frame_clone( mlt_frame self, int is_deep )
 					mlt_properties_get_int( properties, "audio_channels" ) );
 			copy = mlt_pool_alloc( size );
 			memcpy( copy, data, size );
+			mlt_pool_tag( copy, mlt_memory_audio );
 			mlt_properties_set_data( new_props, "audio", copy, size, mlt_pool_release, NULL );
 		}
 		data = mlt_properties_get_data( properties, "image", &size );
@@ -1064,6 +1139,7 @@ mlt_frame mlt_frame_clone( mlt_frame self, int is_deep )
 					width, height, NULL );
 			copy = mlt_pool_alloc( size );
 			memcpy( copy, data, size );
+			mlt_pool_tag( copy, mlt_memory_image );
 			mlt_properties_set_data( new_props, "image", copy, size, mlt_pool_release, NULL );
 
 			data = mlt_properties_get_data( properties, "alpha", &size );
@@ -1073,6 +1149,7 @@ mlt_frame mlt_frame_clone( mlt_frame self, int is_deep )
 					size = width * height;
 				copy = mlt_pool_alloc( size );
 				memcpy( copy, data, size );
+				mlt_pool_tag( copy, mlt_memory_image );
 				mlt_properties_set_data( new_props, "alpha", copy, size, mlt_pool_release, NULL );
 			};
 		}
@@ -3,7 +3,7 @@
  * \brief memory pooling functionality
  * \see mlt_pool_s
  *
- * Copyright (C) 2003-2018 Meltytech, LLC
+ * Copyright (C) 2003-2020 Meltytech, LLC
  *
  * This library is free software; you can redistribute it and/or
  * modify it under the terms of the GNU Lesser General Public
@@ -20,13 +20,17 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include "mlt_pool.h"
 #include "mlt_properties.h"
 #include "mlt_deque.h"
+#include "mlt_factory.h"
 #include "mlt_log.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <inttypes.h>
 
 // Not nice - memalign is defined here apparently?
 #ifdef linux
@@ -48,6 +52,297 @@
 #  define mlt_realloc realloc
 #endif
 
+/** \brief Memory held by one owner, for example a service
+ */
+
+typedef struct memory_owner_s
+{
+	const void *owner;
+	char name[ 64 ];
+	int64_t used[ mlt_memory_categories ];
+	int64_t peak[ mlt_memory_categories ];
+	struct memory_owner_s *next;
+}
+memory_owner;
+
+static const char *category_names[ mlt_memory_categories ] = { "other", "image", "audio", "cache", "queue" };
+
+static atomic_int_fast64_t used_bytes[ mlt_memory_categories ];
+static atomic_int_fast64_t peak_bytes[ mlt_memory_categories ];
+static atomic_int_fast64_t pool_used = 0;      ///< the bytes of pool blocks in use
+static atomic_int_fast64_t pool_peak = 0;      ///< the highest value of pool_used
+static atomic_int_fast64_t pool_allocated = 0; ///< the bytes of pool blocks in use or pooled
+static atomic_int_fast64_t budget = 0;
+static memory_owner *owners = NULL;    ///< the owners that hold memory, guarded by owners_lock
+static pthread_mutex_t owners_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void update_peak( atomic_int_fast64_t *peak, int64_t value )
+{
+	int64_t current = atomic_load( peak );
+	while ( value > current && !atomic_compare_exchange_weak( peak, &current, value ) );
+}
+
+static void account( mlt_memory_category category, int64_t bytes )
+{
+	update_peak( &peak_bytes[ category ], atomic_fetch_add( &used_bytes[ category ], bytes ) + bytes );
+}
+
+/** Account pool memory of a category.
+ *
+ * Every byte of a pool block in use is in exactly one of the categories that
+ * are tagged on the blocks, so these add up to the pool usage.
+ */
+
+static void account_pool( mlt_memory_category category, int64_t bytes )
+{
+	account( category, bytes );
+	update_peak( &pool_peak, atomic_fetch_add( &pool_used, bytes ) + bytes );
+}
+
+/** Find the entry of an owner.
+ *
+ * The caller must hold owners_lock.
+ *
+ * \return the address of the link to the entry, which points to NULL if not found
+ */
+
+static memory_owner **find_owner( const void *owner )
+{
+	memory_owner **link = &owners;
+	while ( *link && ( *link )->owner != owner )
+		link = &( *link )->next;
+	return link;
+}
+
+/** Forget all owners.
+ */
+
+static void close_owners( )
+{
+	pthread_mutex_lock( &owners_lock );
+	while ( owners )
+	{
+		memory_owner *entry = owners;
+		owners = entry->next;
+		free( entry );
+	}
+	pthread_mutex_unlock( &owners_lock );
+}
+
+/** Parse a number of bytes with an optional K, M or G suffix.
+ */
+
+static int64_t parse_bytes( const char *value )
+{
+	char *end = NULL;
+	int64_t result = value ? strtoll( value, &end, 10 ) : 0;
+	if ( end && end != value )
+	{
+		switch ( *end )
+		{
+		case 'g': case 'G': result *= 1024;
+		case 'm': case 'M': result *= 1024;
+		case 'k': case 'K': result *= 1024;
+		default: break;
+		}
+	}
+	return result;
+}
+
+/** Account memory held by an owner.
+ *
+ * This is used for memory that belongs to an object rather than to a frame,
+ * like the data in a service cache or the frames in a consumer queue. Such
+ * memory may also be counted in the pool categories under which it was
+ * allocated.
+ *
+ * \public \memberof mlt_pool_s
+ * \param owner the address of the object that holds the memory
+ * \param name a name for the owner to use in statistics (optional)
+ * \param category the kind of memory
+ * \param bytes the number of bytes added or, when negative, released
+ */
+
+void mlt_pool_account( const void *owner, const char *name, mlt_memory_category category, int64_t bytes )
+{
+	memory_owner **link, *entry;
+	int i, empty = 1;
+
+	if ( !owner || category < 0 || category >= mlt_memory_categories )
+		return;
+	account( category, bytes );
+
+	pthread_mutex_lock( &owners_lock );
+	link = find_owner( owner );
+	entry = *link;
+	if ( !entry && bytes > 0 )
+	{
+		entry = calloc( 1, sizeof( memory_owner ) );
+		if ( entry )
+		{
+			entry->owner = owner;
+			*link = entry;
+		}
+	}
+	if ( entry )
+	{
+		if ( name && !entry->name[0] )
+			strncpy( entry->name, name, sizeof( entry->name ) - 1 );
+		entry->used[ category ] += bytes;
+		if ( entry->used[ category ] > entry->peak[ category ] )
+			entry->peak[ category ] = entry->used[ category ];
+		for ( i = 0; i < mlt_memory_categories; i++ )
+			empty = empty && entry->used[ i ] <= 0;
+		// Forget an owner once it holds nothing; its address might be reused.
+		if ( empty )
+		{
+			*link = entry->next;
+			free( entry );
+		}
+	}
+	pthread_mutex_unlock( &owners_lock );
+}
+
+/** Get the memory held by an owner.
+ *
+ * \public \memberof mlt_pool_s
+ * \param owner the address of the object that holds the memory
+ * \param category the kind of memory
+ * \return the number of bytes
+ */
+
+int64_t mlt_pool_owner_used( const void *owner, mlt_memory_category category )
+{
+	memory_owner *entry;
+	int64_t result = 0;
+
+	if ( !owner || category < 0 || category >= mlt_memory_categories )
+		return 0;
+	pthread_mutex_lock( &owners_lock );
+	entry = *find_owner( owner );
+	if ( entry )
+		result = entry->used[ category ];
+	pthread_mutex_unlock( &owners_lock );
+	return result;
+}
+
+/** Get the memory currently used in a category.
+ *
+ * \public \memberof mlt_pool_s
+ * \param category the kind of memory
+ * \return the number of bytes
+ */
+
+int64_t mlt_pool_used( mlt_memory_category category )
+{
+	return category >= 0 && category < mlt_memory_categories ? atomic_load( &used_bytes[ category ] ) : 0;
+}
+
+/** Get the most memory that was used in a category at any time.
+ *
+ * \public \memberof mlt_pool_s
+ * \param category the kind of memory
+ * \return the number of bytes
+ */
+
+int64_t mlt_pool_peak( mlt_memory_category category )
+{
+	return category >= 0 && category < mlt_memory_categories ? atomic_load( &peak_bytes[ category ] ) : 0;
+}
+
+/** Set a limit on the pool memory in use.
+ *
+ * Consumers stop reading ahead while the limit is exceeded. The default is
+ * taken from the environment variable MLT_MEMORY_BUDGET, which accepts a
+ * K, M or G suffix.
+ *
+ * \public \memberof mlt_pool_s
+ * \param bytes the number of bytes or 0 for no limit
+ */
+
+void mlt_pool_set_budget( int64_t bytes )
+{
+	atomic_store( &budget, bytes > 0 ? bytes : 0 );
+}
+
+/** Get the limit on the pool memory in use.
+ *
+ * \public \memberof mlt_pool_s
+ * \return the number of bytes or 0 if there is no limit
+ */
+
+int64_t mlt_pool_get_budget( )
+{
+	return atomic_load( &budget );
+}
+
+/** Determine if the pool memory in use exceeds the budget.
+ *
+ * This releases the unused pool blocks before giving up.
+ *
+ * \public \memberof mlt_pool_s
+ * \return true if the budget is exceeded
+ */
+
+int mlt_pool_over_budget( )
+{
+	int64_t limit = atomic_load( &budget );
+
+	if ( limit <= 0 )
+		return 0;
+	if ( atomic_load( &pool_allocated ) > limit && atomic_load( &pool_allocated ) > atomic_load( &pool_used ) )
+		mlt_pool_purge( );
+	return atomic_load( &pool_used ) > limit;
+}
+
+/** Publish the memory statistics as properties of mlt_global_properties().
+ *
+ * \private \memberof mlt_pool_s
+ */
+
+static void publish_stat( )
+{
+	mlt_properties properties = mlt_global_properties( );
+	char name[ 32 ];
+	int i;
+
+	if ( !properties )
+		return;
+	for ( i = 0; i < mlt_memory_categories; i++ )
+	{
+		snprintf( name, sizeof( name ), "memory.%s", category_names[ i ] );
+		mlt_properties_set_int64( properties, name, mlt_pool_used( i ) );
+		snprintf( name, sizeof( name ), "memory.%s.peak", category_names[ i ] );
+		mlt_properties_set_int64( properties, name, mlt_pool_peak( i ) );
+	}
+	mlt_properties_set_int64( properties, "memory.used", atomic_load( &pool_used ) );
+	mlt_properties_set_int64( properties, "memory.peak", atomic_load( &pool_peak ) );
+	mlt_properties_set_int64( properties, "memory.allocated", atomic_load( &pool_allocated ) );
+	mlt_properties_set_int64( properties, "memory.budget", atomic_load( &budget ) );
+}
+
+/** Log the memory held by each owner.
+ *
+ * \private \memberof mlt_pool_s
+ */
+
+static void log_owners( )
+{
+	memory_owner *entry;
+	int j;
+
+	pthread_mutex_lock( &owners_lock );
+	for ( entry = owners; entry; entry = entry->next )
+	{
+		for ( j = 0; j < mlt_memory_categories; j++ )
+			if ( entry->peak[ j ] )
+				mlt_log_verbose( NULL, "mlt_pool_stat: %p %s %s used %"PRId64" peak %"PRId64" bytes\n",
+					entry->owner, entry->name, category_names[ j ],
+					entry->used[ j ], entry->peak[ j ] );
+	}
+	pthread_mutex_unlock( &owners_lock );
+}
+
 // We now require a compile-time define to use mlt_pool.
 #ifndef USE_MLT_POOL
 #define USE_MLT_POOL 1
@@ -55,13 +350,14 @@
 
 #if !USE_MLT_POOL
 
-void mlt_pool_init() {}
+void mlt_pool_init() { mlt_pool_set_budget( parse_bytes( getenv( "MLT_MEMORY_BUDGET" ) ) ); }
 void *mlt_pool_alloc( int size ) { return mlt_alloc( size ); }
 void *mlt_pool_realloc( void *ptr, int size ) { return mlt_realloc( ptr, size ); }
 void mlt_pool_release( void *release ) { return mlt_free( release ); }
+void mlt_pool_tag( void *ptr, mlt_memory_category category ) {}
 void mlt_pool_purge() {}
-void mlt_pool_close() {}
-void mlt_pool_stat() {}
+void mlt_pool_close() { close_owners(); }
+void mlt_pool_stat() { publish_stat(); log_owners(); }
 
 #else
 
@@ -91,6 +387,7 @@ typedef struct __attribute__ ((aligned (16))) mlt_release_s
 {
 	mlt_pool pool;
 	int references;
+	int category; ///< the mlt_memory_category of the block
 }
 *mlt_release;
 
@@ -148,7 +445,9 @@ static void *pool_fetch( mlt_pool self )
 			ptr = mlt_deque_pop_back( self->stack );
 
 			// Assign the reference
-			( ( mlt_release )ptr )->references = 1;
+			mlt_release release = ( void * )( ( char * )ptr - sizeof( struct mlt_release_s ) );
+			release->references = 1;
+			release->category = mlt_memory_other;
 		}
 		else
 		{
@@ -174,6 +473,8 @@ static void *pool_fetch( mlt_pool self )
 
 				// Assign the reference
 				release->references = 1;
+				release->category = mlt_memory_other;
+				atomic_fetch_add( &pool_allocated, self->size );
 
 				// Determine the ptr
 				ptr = ( char * )release + sizeof( struct mlt_release_s );
@@ -182,6 +483,9 @@ static void *pool_fetch( mlt_pool self )
 
 		// Unlock the pool
 		pthread_mutex_unlock( &self->lock );
+
+		if ( ptr )
+			account_pool( mlt_memory_other, self->size );
 	}
 
 	// Return the generated release object
@@ -207,6 +511,8 @@ static void pool_return( void *ptr )
 
 		if ( self != NULL )
 		{
+			account_pool( that->category, -self->size );
+
 			// Lock the pool
 			pthread_mutex_lock( &self->lock );
 
@@ -242,6 +548,7 @@ static void pool_close( mlt_pool self )
 		{
 			// We'll free this item now
 			mlt_free( ( char * )release - sizeof( struct mlt_release_s ) );
+			atomic_fetch_sub( &pool_allocated, self->size );
 		}
 
 		// We can now close the stack
@@ -283,6 +590,8 @@ void mlt_pool_init( )
 		// Register with properties
 		mlt_properties_set_data( pools, name, pool, 0, ( mlt_destructor )pool_close, NULL );
 	}
+
+	mlt_pool_set_budget( parse_bytes( getenv( "MLT_MEMORY_BUDGET" ) ) );
 }
 
 /** Allocate size bytes from the pool.
@@ -337,6 +646,7 @@ void *mlt_pool_realloc( void *ptr, int size )
 
 			// Copy
 			memcpy( result, ptr, that->pool->size - sizeof( struct mlt_release_s ) );
+			mlt_pool_tag( result, that->category );
 
 			// Release
 			mlt_pool_release( ptr );
@@ -356,6 +666,27 @@ void *mlt_pool_realloc( void *ptr, int size )
 	return result;
 }
 
+/** Set the category under which a block from the pool is accounted.
+ *
+ * \public \memberof mlt_pool_s
+ * \param ptr an opaque pointer of a block in the pool
+ * \param category the kind of memory
+ */
+
+void mlt_pool_tag( void *ptr, mlt_memory_category category )
+{
+	if ( ptr != NULL && category >= 0 && category < mlt_memory_categories )
+	{
+		mlt_release that = ( void * )(( char * )ptr - sizeof( struct mlt_release_s ));
+		if ( that->pool != NULL && that->category != category )
+		{
+			account_pool( that->category, -that->pool->size );
+			account_pool( category, that->pool->size );
+			that->category = category;
+		}
+	}
+}
+
 /** Purge unused items in the pool.
  *
  * A form of garbage collection.
@@ -382,6 +713,7 @@ void mlt_pool_purge( )
 		while ( ( release = mlt_deque_pop_back( self->stack ) ) != NULL )
 		{
 			mlt_free( ( char * )release - sizeof( struct mlt_release_s ) );
+			atomic_fetch_sub( &pool_allocated, self->size );
 			self->count--;
 		}
 
@@ -415,8 +747,18 @@ void mlt_pool_close( )
 
 	// Close the properties
 	mlt_properties_close( pools );
+	close_owners( );
 }
 
+/** Log the pool usage and update the memory statistics.
+ *
+ * This sets the properties memory.used, memory.peak, memory.allocated,
+ * memory.budget, and memory.<category> and memory.<category>.peak for each
+ * category, on mlt_global_properties(). The values are in bytes.
+ *
+ * \public \memberof mlt_pool_s
+ */
+
 void mlt_pool_stat( )
 {
 	// Stats dump
@@ -438,6 +780,9 @@ void mlt_pool_stat( )
 
 	mlt_log_verbose( NULL, "%s: allocated %"PRIu64" bytes, used %"PRIu64" bytes \n",
 		__FUNCTION__, allocated, used );
+
+	publish_stat( );
+	log_owners( );
 }
 
 #endif // NO_MLT_POOL
@@ -23,6 +23,13 @@
 #ifndef MLT_POOL_H
 #define MLT_POOL_H
 
+#include "mlt_types.h"
+
+/**
+ * \envvar \em MLT_MEMORY_BUDGET the most pool memory in bytes, with an optional
+ * K, M or G suffix, that may be in use before consumers stop reading ahead
+ */
+
 extern void mlt_pool_init( );
 extern void *mlt_pool_alloc( int size );
 extern void *mlt_pool_realloc( void *ptr, int size );
@@ -30,5 +37,13 @@ extern void mlt_pool_release( void *release );
 extern void mlt_pool_purge( );
 extern void mlt_pool_close( );
 extern void mlt_pool_stat( );
+extern void mlt_pool_tag( void *ptr, mlt_memory_category category );
+extern void mlt_pool_account( const void *owner, const char *name, mlt_memory_category category, int64_t bytes );
+extern int64_t mlt_pool_owner_used( const void *owner, mlt_memory_category category );
+extern int64_t mlt_pool_used( mlt_memory_category category );
+extern int64_t mlt_pool_peak( mlt_memory_category category );
+extern void mlt_pool_set_budget( int64_t bytes );
+extern int64_t mlt_pool_get_budget( );
+extern int mlt_pool_over_budget( );
 
 #endif
@@ -653,7 +653,12 @@ static int producer_get_frame( mlt_service service, mlt_frame_ptr frame, int ind
 		mlt_properties_set_int( properties, "test_audio", mlt_frame_is_test_audio( *frame ) );
 		mlt_properties_set_int( properties, "test_image", mlt_frame_is_test_card( *frame ) );
 		if ( mlt_properties_get_data( properties, "_producer", NULL ) == NULL )
+		{
 			mlt_properties_set_data( properties, "_producer", service, 0, NULL, NULL );
+
+			// Remember the audio operations of the producer itself, before any filters
+			mlt_properties_set_int( properties, "_producer_audio_stack", mlt_deque_count( MLT_FRAME_AUDIO_STACK( *frame ) ) );
+		}
 	}
 	else if ( self != NULL )
 	{
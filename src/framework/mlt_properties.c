@@ -37,6 +37,7 @@
 #include <ctype.h>
 #include <stdarg.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <sys/types.h>
 #include <dirent.h>
 #include <sys/stat.h>
@@ -57,6 +58,9 @@ typedef struct
 	int ref_count;
 	pthread_mutex_t mutex;
 	locale_t locale;
+	void *events;
+	atomic_int batch;
+	mlt_properties changed;
 }
 property_list;
 
@@ -104,6 +108,174 @@ int mlt_properties_init( mlt_properties self, void *child )
 	return self != NULL && self->local == NULL;
 }
 
+/** The ids of the property-changed and properties-changed events, resolved on first use */
+
+static atomic_int property_changed_id = -1;
+static atomic_int properties_changed_id = -1;
+
+extern int mlt_events_listening( mlt_properties self, int id );
+
+/** Protects the batch depth and the changed names of every properties list */
+
+static pthread_mutex_t batch_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Record a change made during a batch.
+ *
+ * \private \memberof mlt_properties_s
+ * \param self a properties list
+ * \param name the name of the property that changed
+ * \return true if the change was recorded, false if the batch has ended
+ */
+
+static int batch_record( mlt_properties self, const char *name )
+{
+	property_list *list = self->local;
+	int recorded = 0;
+
+	pthread_mutex_lock( &batch_mutex );
+	if ( atomic_load( &list->batch ) > 0 )
+	{
+		if ( list->changed == NULL )
+			list->changed = mlt_properties_new( );
+		if ( list->changed != NULL )
+			recorded = !mlt_properties_set_int( list->changed, name, 1 );
+	}
+	pthread_mutex_unlock( &batch_mutex );
+
+	return recorded;
+}
+
+static int event_id( atomic_int *id, const char *name )
+{
+	int result = atomic_load_explicit( id, memory_order_relaxed );
+	if ( result < 0 )
+	{
+		result = mlt_events_id( name );
+		atomic_store_explicit( id, result, memory_order_relaxed );
+	}
+	return result;
+}
+
+/** Fire the property-changed and properties-changed events.
+ *
+ * During a batch, the name is recorded for the properties-changed event at
+ * the end of the batch instead. The list of names is only made when somebody
+ * listens to properties-changed. Private names, which start with an
+ * underscore, only fire property-changed; they are set very often on frames
+ * and services, and properties-changed reports user-visible changes.
+ *
+ * \private \memberof mlt_properties_s
+ * \param self a properties list
+ * \param name the name of the property that changed
+ */
+
+static inline void fire_property_changed( mlt_properties self, const char *name )
+{
+	property_list *list = self->local;
+	int id;
+
+	mlt_events_fire_id( self, event_id( &property_changed_id, "property-changed" ), name, NULL );
+
+	if ( name[0] == '_' )
+		return;
+	if ( atomic_load_explicit( &list->batch, memory_order_relaxed ) > 0 && batch_record( self, name ) )
+		return;
+	id = event_id( &properties_changed_id, "properties-changed" );
+	if ( mlt_events_listening( self, id ) )
+	{
+		mlt_properties changed = mlt_properties_new( );
+		if ( changed )
+		{
+			mlt_properties_set_int( changed, name, 1 );
+			mlt_events_fire_id( self, id, changed, NULL );
+			mlt_properties_close( changed );
+		}
+	}
+}
+
+/** Get the events object of a properties list.
+ *
+ * The events object is also held as the "_events" property; this avoids
+ * looking it up each time an event is fired.
+ *
+ * \private \memberof mlt_properties_s
+ * \param self a properties list
+ * \return the events object or NULL
+ */
+
+void *mlt_properties_get_events( mlt_properties self )
+{
+	return ( ( property_list * )self->local )->events;
+}
+
+/** Set the events object of a properties list.
+ *
+ * \private \memberof mlt_properties_s
+ * \param self a properties list
+ * \param events the events object or NULL
+ */
+
+void mlt_properties_set_events( mlt_properties self, void *events )
+{
+	( ( property_list * )self->local )->events = events;
+}
+
+/** Begin a batch of changes to a properties list.
+ *
+ * Every change fires "property-changed" right away, batch or not, so listeners
+ * of it see the changes in the order they are made. Outside of a batch, every
+ * change also fires "properties-changed" with a list holding its name, except
+ * for private names that start with an underscore. Until the matching
+ * mlt_properties_end_batch(), the names of the changed properties are collected
+ * instead and reported in one "properties-changed" event when the batch ends. Batches may be nested; only the end of the outermost batch fires
+ * the event.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ */
+
+void mlt_properties_begin_batch( mlt_properties self )
+{
+	if ( !self ) return;
+	property_list *list = self->local;
+	pthread_mutex_lock( &batch_mutex );
+	atomic_fetch_add( &list->batch, 1 );
+	pthread_mutex_unlock( &batch_mutex );
+}
+
+/** End a batch of changes to a properties list.
+ *
+ * When the outermost batch ends, this fires a single "properties-changed" event
+ * whose argument is a properties list holding the names of the properties that
+ * changed, in the order they were first changed. A listener of it runs after
+ * all of the batch's values have been set, so it sees the final values, and
+ * work that depends on several properties is done once.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ */
+
+void mlt_properties_end_batch( mlt_properties self )
+{
+	if ( !self ) return;
+	property_list *list = self->local;
+	mlt_properties changed = NULL;
+
+	pthread_mutex_lock( &batch_mutex );
+	if ( atomic_load( &list->batch ) > 0 && atomic_fetch_sub( &list->batch, 1 ) == 1 )
+	{
+		changed = list->changed;
+		list->changed = NULL;
+	}
+	pthread_mutex_unlock( &batch_mutex );
+
+	if ( changed )
+	{
+		mlt_events_fire_id( self, event_id( &properties_changed_id, "properties-changed" ), changed, NULL );
+		mlt_properties_close( changed );
+	}
+}
+
 /** Create a properties object.
  *
  * This allocates the properties structure and calls mlt_properties_init() on it.
@@ -450,6 +622,7 @@ int mlt_properties_inherit( mlt_properties self, mlt_properties that )
 	if (value)
 		mlt_properties_set_string(self, "properties", value);
 
+	mlt_properties_begin_batch( self );
 	mlt_properties_lock( that );
 
 	int count = mlt_properties_count( that );
@@ -466,6 +639,7 @@ int mlt_properties_inherit( mlt_properties self, mlt_properties that )
 	}
 
 	mlt_properties_unlock( that );
+	mlt_properties_end_batch( self );
 
 	return 0;
 }
@@ -488,6 +662,7 @@ int mlt_properties_pass( mlt_properties self, mlt_properties that, const char *p
 	int count = mlt_properties_count( that );
 	int length = strlen( prefix );
 	int i = 0;
+	mlt_properties_begin_batch( self );
 	for ( i = 0; i < count; i ++ )
 	{
 		char *name = mlt_properties_get_name( that, i );
@@ -498,6 +673,7 @@ int mlt_properties_pass( mlt_properties self, mlt_properties that, const char *p
 				mlt_properties_set_string( self, name + length, value );
 		}
 	}
+	mlt_properties_end_batch( self );
 	return 0;
 }
 
@@ -614,7 +790,7 @@ void mlt_properties_pass_property( mlt_properties self, mlt_properties that, con
 		return;
 
 	mlt_property_pass( mlt_properties_fetch( self, name ), that_prop );
-	mlt_events_fire( self, "property-changed", name, NULL );
+	fire_property_changed( self, name );
 }
 
 /** Copy all properties specified in a comma-separated list to another properties list.
@@ -786,7 +962,7 @@ int mlt_properties_set( mlt_properties self, const char *name, const char *value
 			mlt_properties_preset( self, value );
 	}
 
-	mlt_events_fire( self, "property-changed", name, NULL );
+	fire_property_changed( self, name );
 
 	return error;
 }
@@ -848,7 +1024,7 @@ int mlt_properties_set_string( mlt_properties self, const char *name, const char
 			mlt_properties_preset( self, value );
 	}
 
-	mlt_events_fire( self, "property-changed", name, NULL );
+	fire_property_changed( self, name );
 
 	return error;
 }
@@ -1051,7 +1227,7 @@ int mlt_properties_set_int( mlt_properties self, const char *name, int value )
 		mlt_properties_do_mirror( self, name );
 	}
 
-	mlt_events_fire( self, "property-changed", name, NULL );
+	fire_property_changed( self, name );
 
 	return error;
 }
@@ -1095,7 +1271,7 @@ int mlt_properties_set_int64( mlt_properties self, const char *name, int64_t val
 		mlt_properties_do_mirror( self, name );
 	}
 
-	mlt_events_fire( self, "property-changed", name, NULL );
+	fire_property_changed( self, name );
 
 	return error;
 }
@@ -1147,7 +1323,7 @@ int mlt_properties_set_double( mlt_properties self, const char *name, double val
 		mlt_properties_do_mirror( self, name );
 	}
 
-	mlt_events_fire( self, "property-changed", name, NULL );
+	fire_property_changed( self, name );
 
 	return error;
 }
@@ -1199,7 +1375,7 @@ int mlt_properties_set_position( mlt_properties self, const char *name, mlt_posi
 		mlt_properties_do_mirror( self, name );
 	}
 
-	mlt_events_fire( self, "property-changed", name, NULL );
+	fire_property_changed( self, name );
 
 	return error;
 }
@@ -1245,7 +1421,7 @@ int mlt_properties_set_data( mlt_properties self, const char *name, void *value,
 	if ( property != NULL )
 		error = mlt_property_set_data( property, value, length, destroy, serialise );
 
-	mlt_events_fire( self, "property-changed", name, NULL );
+	fire_property_changed( self, name );
 
 	return error;
 }
@@ -1509,6 +1685,9 @@ void mlt_properties_close( mlt_properties self )
 			free( list->locale );
 #endif
 
+			// Discard the changes of an unfinished batch
+			mlt_properties_close( list->changed );
+
 			// Clear up the list
 			pthread_mutex_destroy( &list->mutex );
 			free( list->name );
@@ -2244,7 +2423,7 @@ void mlt_properties_clear( mlt_properties self, const char *name )
 	if ( property )
 		mlt_property_clear( property );
 
-	mlt_events_fire( self, "property-changed", name, NULL );
+	fire_property_changed( self, name );
 }
 
 /** Check if a property exists.
@@ -2405,7 +2584,7 @@ int mlt_properties_set_color( mlt_properties self, const char *name, mlt_color c
 		mlt_properties_do_mirror( self, name );
 	}
 
-	mlt_events_fire( self, "property-changed", name, NULL );
+	fire_property_changed( self, name );
 
 	return error;
 }
@@ -2467,7 +2646,7 @@ int mlt_properties_anim_set( mlt_properties self, const char *name, const char *
 		mlt_properties_do_mirror( self, name );
 	}
 
-	mlt_events_fire( self, "property-changed", name, NULL );
+	fire_property_changed( self, name );
 
 	return error;
 }
@@ -2525,7 +2704,7 @@ int mlt_properties_anim_set_int( mlt_properties self, const char *name, int valu
 		mlt_properties_do_mirror( self, name );
 	}
 
-	mlt_events_fire( self, "property-changed", name, NULL );
+	fire_property_changed( self, name );
 
 	return error;
 }
@@ -2583,7 +2762,7 @@ int mlt_properties_anim_set_double( mlt_properties self, const char *name, doubl
 		mlt_properties_do_mirror( self, name );
 	}
 
-	mlt_events_fire( self, "property-changed", name, NULL );
+	fire_property_changed( self, name );
 
 	return error;
 }
@@ -2627,7 +2806,7 @@ extern int mlt_properties_set_rect( mlt_properties self, const char *name, mlt_r
 		mlt_properties_do_mirror( self, name );
 	}
 
-	mlt_events_fire( self, "property-changed", name, NULL );
+	fire_property_changed( self, name );
 
 	return error;
 }
@@ -2681,7 +2860,7 @@ extern int mlt_properties_anim_set_rect( mlt_properties self, const char *name,
 		mlt_properties_do_mirror( self, name );
 	}
 
-	mlt_events_fire( self, "property-changed", name, NULL );
+	fire_property_changed( self, name );
 
 	return error;
 }
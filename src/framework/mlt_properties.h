@@ -53,6 +53,8 @@ extern int mlt_properties_inc_ref( mlt_properties self );
 extern int mlt_properties_dec_ref( mlt_properties self );
 extern int mlt_properties_ref_count( mlt_properties self );
 extern void mlt_properties_mirror( mlt_properties self, mlt_properties that );
+extern void mlt_properties_begin_batch( mlt_properties self );
+extern void mlt_properties_end_batch( mlt_properties self );
 extern int mlt_properties_inherit( mlt_properties self, mlt_properties that );
 extern int mlt_properties_pass( mlt_properties self, mlt_properties that, const char *prefix );
 extern void mlt_properties_pass_property( mlt_properties self, mlt_properties that, const char *name );
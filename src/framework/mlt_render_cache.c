@@ -0,0 +1,570 @@
+/**
+ * \file mlt_render_cache.c
+ * \brief disk cache of rendered frames keyed by a hash of the service network
+ * \see mlt_render_cache.h
+ *
+ * Copyright (C) 2020 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "mlt_render_cache.h"
+#include "mlt_frame.h"
+#include "mlt_audio.h"
+#include "mlt_service.h"
+#include "mlt_filter.h"
+#include "mlt_producer.h"
+#include "mlt_playlist.h"
+#include "mlt_multitrack.h"
+#include "mlt_tractor.h"
+#include "mlt_properties.h"
+#include "mlt_log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <utime.h>
+#include <sys/stat.h>
+
+/** The first bytes of a file in the render cache. */
+#define CACHE_MAGIC "MLTC"
+/** The version of the file format, which is part of the header. */
+#define CACHE_VERSION (1)
+/** The deepest nesting of services that is hashed. */
+#define HASH_DEPTH (64)
+/** The length of the name of a file in the render cache, the hash and a suffix. */
+#define CACHE_NAME_LENGTH (16 + 6)
+
+/** \brief The header of an image or audio file in the render cache
+ *
+ * The header is followed by size bytes of image or audio and, for an image,
+ * alpha_size bytes of alpha channel.
+ */
+
+typedef struct
+{
+	char magic[4];
+	int32_t version;
+	int32_t format;    /**< the mlt_image_format or mlt_audio_format */
+	int32_t width;     /**< the image width or audio frequency */
+	int32_t height;    /**< the image height or number of audio channels */
+	int32_t samples;   /**< the number of audio samples */
+	int32_t size;
+	int32_t alpha_size;
+}
+cache_header;
+
+/** \brief The size of a render cache directory
+ */
+
+typedef struct cache_directory_s
+{
+	char *name;
+	int64_t size;   /**< the bytes of the files written, or -1 before the directory is scanned */
+	struct cache_directory_s *next;
+}
+cache_directory;
+
+/** \brief A file in a render cache directory
+ */
+
+typedef struct
+{
+	char name[ CACHE_NAME_LENGTH + 1 ];
+	double time;
+	int64_t size;
+}
+cache_file;
+
+static cache_directory *directories = NULL;
+static pthread_mutex_t directories_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t hash_bytes( uint64_t hash, const void *data, size_t size )
+{
+	const uint8_t *p = data;
+	while ( size-- )
+	{
+		hash ^= *p++;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static uint64_t hash_int( uint64_t hash, int64_t value )
+{
+	return hash_bytes( hash, &value, sizeof( value ) );
+}
+
+static uint64_t hash_string( uint64_t hash, const char *value )
+{
+	return value ? hash_bytes( hash, value, strlen( value ) + 1 ) : hash_int( hash, 0 );
+}
+
+/** Mix the bits of a hash so that sums of hashes do not cancel out.
+ */
+
+static uint64_t hash_mix( uint64_t hash )
+{
+	hash ^= hash >> 30;
+	hash *= 0xbf58476d1ce4e5b9ULL;
+	hash ^= hash >> 27;
+	hash *= 0x94d049bb133111ebULL;
+	return hash ^ ( hash >> 31 );
+}
+
+/** Hash the public properties of a service.
+ *
+ * The order in which properties were set does not change the hash. Properties
+ * whose name starts with an underscore are private state and not hashed.
+ * A container does not hash its in, out and length, so that appending to a
+ * playlist or tractor does not change the hash of the frames already in it.
+ */
+
+static uint64_t hash_properties( uint64_t hash, mlt_properties properties, int container )
+{
+	uint64_t sum = 0;
+	int i;
+
+	for ( i = 0; i < mlt_properties_count( properties ); i++ )
+	{
+		const char *name = mlt_properties_get_name( properties, i );
+		const char *value = mlt_properties_get_value( properties, i );
+		if ( !name || !value || name[0] == '_' )
+			continue;
+		if ( container && ( !strcmp( name, "in" ) || !strcmp( name, "out" ) || !strcmp( name, "length" ) ) )
+			continue;
+		sum += hash_mix( hash_string( hash_string( 14695981039346656037ULL, name ), value ) );
+	}
+	return hash_int( hash, sum );
+}
+
+/** Hash the modification time and size of the file named by the resource property.
+ */
+
+static uint64_t hash_resource( uint64_t hash, mlt_properties properties )
+{
+	const char *resource = mlt_properties_get( properties, "resource" );
+	struct stat info;
+
+	if ( resource && !stat( resource, &info ) )
+	{
+		hash = hash_int( hash, info.st_mtime );
+		hash = hash_int( hash, info.st_size );
+	}
+	return hash;
+}
+
+static uint64_t hash_service( uint64_t hash, mlt_service service, mlt_position position, int depth )
+{
+	mlt_service_type type;
+	int container, i;
+
+	if ( !service || depth > HASH_DEPTH )
+		return hash_int( hash, -1 );
+
+	type = mlt_service_identify( service );
+	// The xml producer replaces the resource of the container it returns with the file name
+	if ( type == producer_type && mlt_properties_get_int( MLT_SERVICE_PROPERTIES( service ), "_original_type" ) )
+		type = mlt_properties_get_int( MLT_SERVICE_PROPERTIES( service ), "_original_type" );
+	container = type == playlist_type || type == tractor_type || type == multitrack_type;
+
+	hash = hash_int( hash, type );
+	if ( type != consumer_type )
+		hash = hash_properties( hash, MLT_SERVICE_PROPERTIES( service ), container );
+
+	// A container passes the position on, so that moving it only changes the hash of containers,
+	// and the normalizing filters of the loader do not depend on the position
+	if ( !container && type != consumer_type && !mlt_properties_get_int( MLT_SERVICE_PROPERTIES( service ), "_loader" ) )
+		hash = hash_int( hash, position );
+
+	for ( i = 0; i < mlt_service_filter_count( service ); i++ )
+		hash = hash_service( hash, MLT_FILTER_SERVICE( mlt_service_filter( service, i ) ), position, depth + 1 );
+
+	switch ( type )
+	{
+		case producer_type:
+			if ( mlt_producer_is_cut( MLT_PRODUCER( service ) ) )
+				hash = hash_service( hash, MLT_PRODUCER_SERVICE( mlt_producer_cut_parent( MLT_PRODUCER( service ) ) ), position, depth + 1 );
+			else
+				hash = hash_resource( hash, MLT_SERVICE_PROPERTIES( service ) );
+			break;
+		case playlist_type:
+		{
+			mlt_playlist playlist = MLT_PLAYLIST( service );
+			mlt_playlist_clip_info info;
+			int clip = mlt_playlist_get_clip_index_at( playlist, position );
+
+			if ( !mlt_playlist_is_blank( playlist, clip ) && !mlt_playlist_get_clip_info( playlist, &info, clip ) && info.cut )
+				hash = hash_service( hash, MLT_PRODUCER_SERVICE( info.cut ), info.frame_in + position - info.start, depth + 1 );
+			else
+				hash = hash_int( hash, -1 );
+			break;
+		}
+		case multitrack_type:
+			for ( i = 0; i < mlt_multitrack_count( MLT_MULTITRACK( service ) ); i++ )
+				hash = hash_service( hash, MLT_PRODUCER_SERVICE( mlt_multitrack_track( MLT_MULTITRACK( service ), i ) ), position, depth + 1 );
+			break;
+		case tractor_type:
+		case filter_type:
+		case transition_type:
+		case consumer_type:
+			// Follow the connected producer, which is how the services planted in a field are chained
+			hash = hash_service( hash, mlt_service_producer( service ), position, depth + 1 );
+			break;
+		default:
+			break;
+	}
+	return hash;
+}
+
+/** Compute the hash of a service network at a position.
+ *
+ * The hash covers the public properties of every service that feeds a frame at
+ * the position, including the filters attached to them, the file modification
+ * times of their resources, and their position. Animated properties are covered
+ * by their keyframes together with the position. Clips that only moved within a
+ * playlist or tractor keep their hash. The properties of a consumer are not
+ * hashed but its filters and producer are.
+ *
+ * \param service the service from which frames are obtained, usually a consumer
+ * \param position the position of the frame
+ * \return the hash
+ */
+
+uint64_t mlt_render_cache_hash( mlt_service service, mlt_position position )
+{
+	return hash_service( 14695981039346656037ULL, service, position, 0 );
+}
+
+/** Get the modification time of a file with the precision the platform has.
+ */
+
+static double modification_time( struct stat *info )
+{
+#if defined(__APPLE__)
+	return info->st_mtimespec.tv_sec + info->st_mtimespec.tv_nsec / 1000000000.0;
+#elif defined(_WIN32)
+	return info->st_mtime;
+#else
+	return info->st_mtim.tv_sec + info->st_mtim.tv_nsec / 1000000000.0;
+#endif
+}
+
+static int compare_cache_file( const void *a, const void *b )
+{
+	double x = ( ( const cache_file* ) a )->time, y = ( ( const cache_file* ) b )->time;
+	return x < y ? -1 : x > y;
+}
+
+/** Remove the least recently used files of a directory in excess of a limit.
+ *
+ * Once the files exceed the limit, they are removed in the order of their
+ * modification time, which a read from the cache updates, until they take
+ * three quarters of the limit, so that the directory is not scanned on every
+ * write.
+ *
+ * \param directory the name of a render cache directory
+ * \param limit the most bytes the files may take
+ * \return the bytes the remaining files take
+ */
+
+static int64_t cache_evict( const char *directory, int64_t limit )
+{
+	DIR *dir = opendir( directory );
+	cache_file *files = NULL;
+	int count = 0, size = 0, i;
+	int64_t total = 0;
+	char path[ PATH_MAX ];
+	struct dirent *entry;
+	struct stat info;
+
+	if ( !dir )
+		return 0;
+	while ( ( entry = readdir( dir ) ) )
+	{
+		size_t length = strlen( entry->d_name );
+		if ( length != CACHE_NAME_LENGTH ||
+			 ( strcmp( entry->d_name + 16, ".image" ) && strcmp( entry->d_name + 16, ".audio" ) ) )
+			continue;
+		snprintf( path, sizeof( path ), "%s/%s", directory, entry->d_name );
+		if ( stat( path, &info ) )
+			continue;
+		if ( count == size )
+		{
+			cache_file *grown = realloc( files, ( size ? size * 2 : 256 ) * sizeof( cache_file ) );
+			if ( !grown )
+				break;
+			files = grown;
+			size = size ? size * 2 : 256;
+		}
+		strcpy( files[ count ].name, entry->d_name );
+		files[ count ].time = modification_time( &info );
+		files[ count ].size = info.st_size;
+		total += info.st_size;
+		count++;
+	}
+	closedir( dir );
+
+	if ( total > limit )
+	{
+		qsort( files, count, sizeof( cache_file ), compare_cache_file );
+		for ( i = 0; i < count && total > limit / 4 * 3; i++ )
+		{
+			snprintf( path, sizeof( path ), "%s/%s", directory, files[ i ].name );
+			if ( !remove( path ) )
+				total -= files[ i ].size;
+		}
+		mlt_log_debug( NULL, "[render_cache] removed %d files from %s, %" PRId64 " bytes remain\n", i, directory, total );
+	}
+	free( files );
+	return total;
+}
+
+/** Account a file written to a directory and keep the directory within a limit.
+ *
+ * \param directory the name of a render cache directory
+ * \param limit the most bytes the files may take, or 0 for no limit
+ * \param bytes the size of the file written
+ */
+
+static void cache_account( const char *directory, int64_t limit, int64_t bytes )
+{
+	cache_directory *entry;
+
+	if ( limit <= 0 )
+		return;
+	pthread_mutex_lock( &directories_lock );
+	for ( entry = directories; entry && strcmp( entry->name, directory ); entry = entry->next );
+	if ( !entry )
+	{
+		entry = calloc( 1, sizeof( cache_directory ) );
+		if ( entry )
+		{
+			entry->name = strdup( directory );
+			entry->size = -1;
+			entry->next = directories;
+			directories = entry;
+		}
+	}
+	// Other processes may share the directory, so it is scanned again once the estimate is over the limit
+	if ( entry && entry->size >= 0 )
+		entry->size += bytes;
+	if ( entry && ( entry->size < 0 || entry->size > limit ) )
+		entry->size = cache_evict( directory, limit );
+	pthread_mutex_unlock( &directories_lock );
+}
+
+static int cache_read( const char *path, cache_header *header, void **data, void **alpha )
+{
+	FILE *file = mlt_fopen( path, "rb" );
+	int error = 1;
+
+	*data = NULL;
+	*alpha = NULL;
+	if ( !file )
+		return error;
+	if ( fread( header, sizeof( *header ), 1, file ) == 1 &&
+		 !memcmp( header->magic, CACHE_MAGIC, 4 ) && header->version == CACHE_VERSION &&
+		 header->size > 0 && header->alpha_size >= 0 )
+	{
+		*data = mlt_pool_alloc( header->size );
+		*alpha = header->alpha_size ? mlt_pool_alloc( header->alpha_size ) : NULL;
+		if ( *data && fread( *data, header->size, 1, file ) == 1 &&
+			 ( !header->alpha_size || ( *alpha && fread( *alpha, header->alpha_size, 1, file ) == 1 ) ) )
+			error = 0;
+	}
+	fclose( file );
+	// Mark the file as recently used for the eviction
+	if ( !error )
+		utime( path, NULL );
+	if ( error )
+	{
+		mlt_pool_release( *data );
+		mlt_pool_release( *alpha );
+		*data = NULL;
+		*alpha = NULL;
+	}
+	return error;
+}
+
+/** Write a file to the cache.
+ *
+ * The file is written under a temporary name and renamed so that a concurrent
+ * reader never sees a partial file.
+ */
+
+static void cache_write( mlt_properties properties, const char *path, cache_header *header, const void *data, const void *alpha )
+{
+	char temp[ PATH_MAX ];
+	FILE *file;
+	int ok;
+
+	snprintf( temp, sizeof( temp ), "%s.%d.%p.tmp", path, (int) getpid(), data );
+	file = mlt_fopen( temp, "wb" );
+	if ( !file )
+	{
+		mlt_log_debug( NULL, "[render_cache] failed to write %s\n", temp );
+		return;
+	}
+	memcpy( header->magic, CACHE_MAGIC, 4 );
+	header->version = CACHE_VERSION;
+	ok = fwrite( header, sizeof( *header ), 1, file ) == 1 &&
+		 fwrite( data, header->size, 1, file ) == 1 &&
+		 ( !header->alpha_size || fwrite( alpha, header->alpha_size, 1, file ) == 1 );
+	if ( fclose( file ) )
+		ok = 0;
+	if ( ok )
+	{
+#ifdef _WIN32
+		remove( path );
+#endif
+		if ( !rename( temp, path ) )
+		{
+			cache_account( mlt_properties_get( properties, "_render_cache_directory" ),
+				mlt_properties_get_int64( properties, "_render_cache_limit" ),
+				sizeof( *header ) + header->size + header->alpha_size );
+			return;
+		}
+	}
+	remove( temp );
+}
+
+static int cache_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( frame );
+	char path[ PATH_MAX ];
+	cache_header header;
+	void *data, *alpha;
+	int error;
+
+	snprintf( path, sizeof( path ), "%s.image", mlt_properties_get( properties, "_render_cache" ) );
+	if ( !cache_read( path, &header, &data, &alpha ) )
+	{
+		if ( header.width == *width && header.height == *height &&
+			 header.size == mlt_image_format_size( header.format, header.width, header.height, NULL ) &&
+			 ( !header.alpha_size || header.alpha_size == header.width * header.height ) )
+		{
+			mlt_pool_tag( data, mlt_memory_image );
+			mlt_frame_set_image( frame, data, header.size, mlt_pool_release );
+			if ( alpha )
+			{
+				mlt_pool_tag( alpha, mlt_memory_image );
+				mlt_frame_set_alpha( frame, alpha, header.alpha_size, mlt_pool_release );
+			}
+			mlt_properties_set_int( properties, "render_cache.hit", 1 );
+			*image = data;
+			*format = header.format;
+			return 0;
+		}
+		mlt_pool_release( data );
+		mlt_pool_release( alpha );
+	}
+
+	error = mlt_frame_get_image( frame, image, format, width, height, writable );
+	if ( !error && *image && !mlt_properties_get_int( properties, "test_image" ) )
+	{
+		int size = 0;
+		uint8_t *alpha = mlt_frame_get_alpha( frame );
+		mlt_properties_get_data( properties, "alpha", &size );
+		memset( &header, 0, sizeof( header ) );
+		header.format = *format;
+		header.width = *width;
+		header.height = *height;
+		header.size = mlt_image_format_size( *format, *width, *height, NULL );
+		header.alpha_size = alpha && size >= *width * *height ? *width * *height : 0;
+		if ( *format != mlt_image_glsl && *format != mlt_image_glsl_texture && *format != mlt_image_opengl && header.size > 0 )
+			cache_write( properties, path, &header, *image, alpha );
+	}
+	return error;
+}
+
+static int cache_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *format, int *frequency, int *channels, int *samples )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( frame );
+	char path[ PATH_MAX ];
+	cache_header header;
+	void *data, *alpha;
+	int error;
+
+	snprintf( path, sizeof( path ), "%s.audio", mlt_properties_get( properties, "_render_cache" ) );
+	if ( !cache_read( path, &header, &data, &alpha ) )
+	{
+		if ( header.width == *frequency && header.height == *channels && header.samples == *samples &&
+			 header.size == mlt_audio_format_size( header.format, header.samples, header.height ) )
+		{
+			mlt_pool_tag( data, mlt_memory_audio );
+			mlt_frame_set_audio( frame, data, header.format, header.size, mlt_pool_release );
+			*buffer = data;
+			*format = header.format;
+			return 0;
+		}
+		mlt_pool_release( data );
+		mlt_pool_release( alpha );
+	}
+
+	error = mlt_frame_get_audio( frame, buffer, format, frequency, channels, samples );
+	if ( !error && *buffer && !mlt_properties_get_int( properties, "test_audio" ) )
+	{
+		memset( &header, 0, sizeof( header ) );
+		header.format = *format;
+		header.width = *frequency;
+		header.height = *channels;
+		header.samples = *samples;
+		header.size = mlt_audio_format_size( *format, *samples, *channels );
+		if ( header.size > 0 )
+			cache_write( properties, path, &header, *buffer, NULL );
+	}
+	return error;
+}
+
+/** Obtain the image and audio of a frame from the render cache.
+ *
+ * This uses the image and audio stored for the hash when their size matches the
+ * request and otherwise renders them and stores them in the directory. The hash
+ * is usually from mlt_render_cache_hash() and is combined with the interpolation,
+ * deinterlacing and color options a consumer sets on the frame. The frame has the
+ * property render_cache.hit when its image came from the cache.
+ *
+ * The files are uncompressed. Once they take more than \p limit bytes, the
+ * least recently used ones are removed.
+ *
+ * \param frame a frame
+ * \param directory the name of an existing directory to hold the cache
+ * \param hash the hash of the service network at the position of the frame
+ * \param limit the most bytes the files in the directory may take, or 0 for no limit
+ */
+
+void mlt_render_cache_attach( mlt_frame frame, const char *directory, uint64_t hash, int64_t limit )
+{
+	mlt_properties properties = MLT_FRAME_PROPERTIES( frame );
+	char path[ PATH_MAX ];
+
+	hash = hash_string( hash, mlt_properties_get( properties, "rescale.interp" ) );
+	hash = hash_int( hash, mlt_properties_get_int( properties, "consumer_deinterlace" ) );
+	hash = hash_string( hash, mlt_properties_get( properties, "deinterlace_method" ) );
+	hash = hash_int( hash, mlt_properties_get_int( properties, "consumer_tff" ) );
+	hash = hash_string( hash, mlt_properties_get( properties, "consumer_color_trc" ) );
+	hash = hash_string( hash, mlt_properties_get( properties, "consumer_channel_layout" ) );
+	snprintf( path, sizeof( path ), "%s/%016" PRIx64, directory, hash );
+	mlt_properties_set( properties, "_render_cache", path );
+	mlt_properties_set( properties, "_render_cache_directory", directory );
+	mlt_properties_set_int64( properties, "_render_cache_limit", limit );
+	mlt_frame_push_get_image( frame, cache_get_image );
+	mlt_frame_push_audio( frame, cache_get_audio );
+}
@@ -0,0 +1,31 @@
+/**
+ * \file mlt_render_cache.h
+ * \brief disk cache of rendered frames keyed by a hash of the service network
+ * \see mlt_render_cache.c
+ *
+ * Copyright (C) 2020 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef MLT_RENDER_CACHE_H
+#define MLT_RENDER_CACHE_H
+
+#include "mlt_types.h"
+
+extern uint64_t mlt_render_cache_hash( mlt_service service, mlt_position position );
+extern void mlt_render_cache_attach( mlt_frame frame, const char *directory, uint64_t hash, int64_t limit );
+
+#endif
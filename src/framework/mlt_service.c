@@ -27,11 +27,13 @@
 #include "mlt_factory.h"
 #include "mlt_log.h"
 #include "mlt_producer.h"
+#include "mlt_trace.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
 
 /*  IMPORTANT NOTES
@@ -44,6 +46,13 @@
 	CONTROL THIS IN EXTENDING CLASSES.
 */
 
+/** The number of unfiltered frames a producer keeps for filters that need the
+ *  previous and next frames.
+ */
+
+#define NEIGHBOUR_WINDOW (4)
+#define DISTANCE( a, b ) ( ( a ) > ( b ) ? ( a ) - ( b ) : ( b ) - ( a ) )
+
 /** \brief private service definition */
 
 typedef struct
@@ -56,6 +65,10 @@ typedef struct
 	int filter_size;
 	mlt_filter *filters;
 	pthread_mutex_t mutex;
+	mlt_frame neighbours[ NEIGHBOUR_WINDOW ];
+	mlt_position neighbour_positions[ NEIGHBOUR_WINDOW ];
+	int neighbours_listening;
+	atomic_int neighbours_stale;
 }
 mlt_service_base;
 
@@ -66,6 +79,7 @@ static void mlt_service_disconnect( mlt_service self );
 static void mlt_service_connect( mlt_service self, mlt_service that );
 static int service_get_frame( mlt_service self, mlt_frame_ptr frame, int index );
 static void mlt_service_property_changed( mlt_listener, mlt_properties owner, mlt_service self, void **args );
+static void mlt_service_properties_changed( mlt_listener, mlt_properties owner, mlt_service self, void **args );
 
 /** Initialize a service.
  *
@@ -101,6 +115,7 @@ int mlt_service_init( mlt_service self, void *child )
 		mlt_events_init( &self->parent );
 		mlt_events_register( &self->parent, "service-changed", NULL );
 		mlt_events_register( &self->parent, "property-changed", ( mlt_transmitter )mlt_service_property_changed );
+		mlt_events_register( &self->parent, "properties-changed", ( mlt_transmitter )mlt_service_properties_changed );
 		pthread_mutex_init( &( ( mlt_service_base * )self->local )->mutex, NULL );
 	}
 
@@ -124,6 +139,23 @@ static void mlt_service_property_changed( mlt_listener listener, mlt_properties
 		listener( owner, self, ( char * )args[ 0 ] );
 }
 
+/** The transmitter for the end of a batch of property changes.
+ *
+ * Invokes the listener.
+ *
+ * \private \memberof mlt_service_s
+ * \param listener a function pointer that will be invoked
+ * \param owner a properties list that will be passed to \p listener
+ * \param self a service that will be passed to \p listener
+ * \param args an array of pointers - the first entry is passed as the properties list of changed names to \p listener
+ */
+
+static void mlt_service_properties_changed( mlt_listener listener, mlt_properties owner, mlt_service self, void **args )
+{
+	if ( listener != NULL )
+		listener( owner, self, ( mlt_properties )args[ 0 ] );
+}
+
 /** Acquire a mutual exclusion lock on this service.
  *
  * \public \memberof mlt_service_s
@@ -555,16 +587,233 @@ void mlt_service_apply_filters( mlt_service self, mlt_frame frame, int index )
 				int disable = mlt_properties_get_int( MLT_FILTER_PROPERTIES( base->filters[ i ] ), "disable" );
 				if ( !disable && ( ( in == 0 && out == 0 ) || ( position >= in && ( position <= out || out == 0 ) ) ) )
 				{
+					// The audio operations of normalisers count as those of the producer
+					int normaliser = mlt_properties_get_int( MLT_FILTER_PROPERTIES( base->filters[ i ] ), "_loader" ) &&
+						mlt_properties_get( frame_properties, "_producer_audio_stack" ) &&
+						mlt_deque_count( MLT_FRAME_AUDIO_STACK( frame ) ) == mlt_properties_get_int( frame_properties, "_producer_audio_stack" );
 					mlt_properties_set_position( frame_properties, "in", in == 0 ? self_in : in );
 					mlt_properties_set_position( frame_properties, "out", out == 0 ? self_out : out );
 					mlt_filter_process( base->filters[ i ], frame );
 					mlt_service_apply_filters( MLT_FILTER_SERVICE( base->filters[ i ] ), frame, index + 1 );
+					if ( normaliser )
+						mlt_properties_set_int( frame_properties, "_producer_audio_stack", mlt_deque_count( MLT_FRAME_AUDIO_STACK( frame ) ) );
 				}
 			}
 		}
 	}
 }
 
+/** Get an unfiltered neighbour image while holding the lock of the shared frame.
+ *
+ * \private \memberof mlt_service_s
+ */
+
+static int neighbour_get_image( mlt_frame self, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
+{
+	mlt_frame source = mlt_frame_pop_service( self );
+	mlt_properties properties = MLT_FRAME_PROPERTIES( source );
+	pthread_mutex_t *mutex = mlt_properties_get_data( properties, "_neighbour_mutex", NULL );
+	int error;
+
+	pthread_mutex_lock( mutex );
+
+	// Another wrapper may point to the image of the shared frame, so once it is
+	// rendered it is never converted; mlt_frame_get_image() converts the copy of
+	// this wrapper to the requested format instead
+	if ( mlt_properties_get_data( properties, "image", NULL ) )
+		*format = mlt_properties_get_int( properties, "format" );
+	error = mlt_frame_get_image( source, image, format, width, height, 0 );
+	if ( !error && *image )
+	{
+		int size = mlt_image_format_size( *format, *width, *height, NULL );
+		int alpha_size = 0;
+		uint8_t *alpha = mlt_properties_get_data( properties, "alpha", &alpha_size );
+
+		// The image is shared with the other users of the neighbour
+		if ( writable )
+		{
+			uint8_t *copy = mlt_pool_alloc( size );
+			memcpy( copy, *image, size );
+			*image = copy;
+			mlt_frame_set_image( self, copy, size, mlt_pool_release );
+		}
+		else
+		{
+			mlt_frame_set_image( self, *image, size, NULL );
+		}
+		if ( alpha )
+			mlt_frame_set_alpha( self, alpha, alpha_size, NULL );
+		mlt_properties_pass_list( MLT_FRAME_PROPERTIES( self ), properties, "progressive top_field_first colorspace full_luma" );
+	}
+	pthread_mutex_unlock( mutex );
+
+	return error;
+}
+
+/** Get unfiltered neighbour audio while holding the lock of the shared frame.
+ *
+ * \private \memberof mlt_service_s
+ */
+
+static int neighbour_get_audio( mlt_frame self, void **buffer, mlt_audio_format *format, int *frequency, int *channels, int *samples )
+{
+	mlt_frame source = mlt_frame_pop_audio( self );
+	mlt_properties properties = MLT_FRAME_PROPERTIES( source );
+	pthread_mutex_t *mutex = mlt_properties_get_data( properties, "_neighbour_mutex", NULL );
+	int error;
+
+	pthread_mutex_lock( mutex );
+
+	// As for the image, the shared audio is never converted once it is fetched
+	if ( mlt_properties_get_data( properties, "audio", NULL ) )
+		*format = mlt_properties_get_int( properties, "audio_format" );
+	error = mlt_frame_get_audio( source, buffer, format, frequency, channels, samples );
+	if ( !error && *buffer )
+		mlt_frame_set_audio( self, *buffer, *format, 0, NULL );
+	pthread_mutex_unlock( mutex );
+
+	return error;
+}
+
+static void neighbour_mutex_close( pthread_mutex_t *mutex )
+{
+	pthread_mutex_destroy( mutex );
+	free( mutex );
+}
+
+/** Release the unfiltered frames kept for the previous and next frames.
+ *
+ * \private \memberof mlt_service_s
+ * \param self a service
+ */
+
+static void clear_neighbours( mlt_service self )
+{
+	mlt_service_base *base = self->local;
+	int i;
+
+	base->neighbours_stale = 0;
+	for ( i = 0; i < NEIGHBOUR_WINDOW; i++ )
+	{
+		if ( base->neighbours[ i ] )
+		{
+			mlt_frame_close( base->neighbours[ i ] );
+			base->neighbours[ i ] = NULL;
+		}
+	}
+}
+
+/** Mark the neighbours stale when a public property of the producer changes.
+ *
+ * The neighbours are not released here, because the producer may be in the
+ * middle of getting a frame.
+ *
+ * \private \memberof mlt_service_s
+ */
+
+static void neighbours_property_changed( mlt_properties owner, mlt_service self, char *name )
+{
+	if ( name && name[ 0 ] != '_' )
+		( ( mlt_service_base * )self->local )->neighbours_stale = 1;
+}
+
+static void neighbours_service_changed( mlt_properties owner, mlt_service self )
+{
+	( ( mlt_service_base * )self->local )->neighbours_stale = 1;
+}
+
+/** Get an unfiltered frame at a position for a producer whose filters need the
+ * previous and next frames.
+ *
+ * The producer keeps a small window of the unfiltered frames it produced, so
+ * that during sequential playback a frame that is the next frame of one
+ * output frame is reused as the following output frame and as the previous
+ * frame of the one after, and each is only fetched and rendered once. Because
+ * a frame may be shared by output frames that are rendered in parallel, it is
+ * returned wrapped in a new frame that serializes access to it. The filters
+ * of the producer are applied to the wrapper.
+ *
+ * \private \memberof mlt_service_s
+ * \param self a producer
+ * \param[out] frame a new frame
+ * \param position the position of the frame
+ * \param index as determined by the producer
+ * \return true if there was an error
+ */
+
+static int get_neighbour( mlt_service self, mlt_frame_ptr frame, mlt_position position, int index )
+{
+	mlt_service_base *base = self->local;
+	mlt_frame source = NULL;
+	int slot = 0;
+	int i;
+
+	// Frames produced before the producer changed are no longer valid
+	if ( !base->neighbours_listening )
+	{
+		mlt_events_listen( MLT_SERVICE_PROPERTIES( self ), self, "property-changed", ( mlt_listener )neighbours_property_changed );
+		mlt_events_listen( MLT_SERVICE_PROPERTIES( self ), self, "service-changed", ( mlt_listener )neighbours_service_changed );
+		base->neighbours_listening = 1;
+	}
+	if ( base->neighbours_stale )
+		clear_neighbours( self );
+
+	// Look for the position or else the slot farthest from it
+	for ( i = 0; i < NEIGHBOUR_WINDOW && !source; i++ )
+	{
+		if ( !base->neighbours[ i ] )
+		{
+			if ( base->neighbours[ slot ] )
+				slot = i;
+		}
+		else if ( base->neighbour_positions[ i ] == position )
+		{
+			source = base->neighbours[ i ];
+		}
+		else if ( base->neighbours[ slot ] &&
+			  DISTANCE( base->neighbour_positions[ i ], position ) > DISTANCE( base->neighbour_positions[ slot ], position ) )
+		{
+			slot = i;
+		}
+	}
+
+	if ( !source )
+	{
+		int error;
+		pthread_mutex_t *mutex = malloc( sizeof( pthread_mutex_t ) );
+
+		mlt_producer_seek( MLT_PRODUCER( self ), position );
+		error = self->get_frame( self, &source, index );
+		if ( error || !mutex )
+		{
+			free( mutex );
+			return error ? error : 1;
+		}
+		pthread_mutex_init( mutex, NULL );
+		mlt_properties_set_data( MLT_FRAME_PROPERTIES( source ), "_neighbour_mutex", mutex, 0, ( mlt_destructor ) neighbour_mutex_close, NULL );
+		if ( base->neighbours[ slot ] )
+			mlt_frame_close( base->neighbours[ slot ] );
+		base->neighbours[ slot ] = source;
+		base->neighbour_positions[ slot ] = position;
+	}
+
+	// Wrap the shared frame
+	*frame = mlt_frame_init( self );
+	mlt_properties_inherit( MLT_FRAME_PROPERTIES( *frame ), MLT_FRAME_PROPERTIES( source ) );
+	mlt_properties_set_data( MLT_FRAME_PROPERTIES( *frame ), "_producer",
+		mlt_frame_get_original_producer( source ), 0, NULL, NULL );
+	mlt_properties_inc_ref( MLT_FRAME_PROPERTIES( source ) );
+	mlt_properties_set_data( MLT_FRAME_PROPERTIES( *frame ), "_neighbour", source, 0, ( mlt_destructor ) mlt_frame_close, NULL );
+	( *frame )->convert_image = source->convert_image;
+	( *frame )->convert_audio = source->convert_audio;
+	mlt_frame_push_service( *frame, source );
+	mlt_frame_push_get_image( *frame, neighbour_get_image );
+	mlt_frame_push_audio( *frame, source );
+	mlt_frame_push_audio( *frame, neighbour_get_audio );
+
+	return 0;
+}
+
 /** Obtain a frame.
  *
  * \public \memberof mlt_service_s
@@ -577,6 +826,7 @@ void mlt_service_apply_filters( mlt_service self, mlt_frame frame, int index )
 int mlt_service_get_frame( mlt_service self, mlt_frame_ptr frame, int index )
 {
 	int result = 0;
+	int64_t trace_start = mlt_trace_begin();
 
 	// Lock the service
 	mlt_service_lock( self );
@@ -591,8 +841,27 @@ int mlt_service_get_frame( mlt_service self, mlt_frame_ptr frame, int index )
 		mlt_position in = mlt_properties_get_position( properties, "in" );
 		mlt_position out = mlt_properties_get_position( properties, "out" );
 		mlt_position position = mlt_service_identify( self ) == producer_type ? mlt_producer_position( MLT_PRODUCER( self ) ) : -1;
+		int need_previous_next = mlt_service_identify( self ) == producer_type &&
+			mlt_properties_get_int( properties, "_need_previous_next" );
 
-		result = self->get_frame( self, frame, index );
+		if ( need_previous_next )
+		{
+			// The frame itself also comes from the window, so that it is only
+			// rendered once as the next, current and previous frame
+			result = get_neighbour( self, frame, position, index );
+			if ( result == 0 )
+			{
+				// Advance as getting the frame from the producer does
+				mlt_producer_seek( MLT_PRODUCER( self ), position );
+				mlt_producer_prepare_next( MLT_PRODUCER( self ) );
+				mlt_properties_set_int( MLT_FRAME_PROPERTIES( *frame ), "_producer_audio_stack",
+					mlt_deque_count( MLT_FRAME_AUDIO_STACK( *frame ) ) );
+			}
+		}
+		else
+		{
+			result = self->get_frame( self, frame, index );
+		}
 
 		if ( result == 0 )
 		{
@@ -604,36 +873,36 @@ int mlt_service_get_frame( mlt_service self, mlt_frame_ptr frame, int index )
 				mlt_properties_set_position( properties, "in", in );
 				mlt_properties_set_position( properties, "out", out );
 			}
+			if ( mlt_service_identify( self ) == producer_type && !mlt_producer_is_cut( MLT_PRODUCER( self ) ) )
+				mlt_trace_frame( *frame, self, 0, 0 );
 			mlt_service_apply_filters( self, *frame, 1 );
 			mlt_deque_push_back( MLT_FRAME_SERVICE_STACK( *frame ), self );
 			
-			if ( mlt_service_identify( self ) == producer_type &&
-			     mlt_properties_get_int( MLT_SERVICE_PROPERTIES( self ), "_need_previous_next" ) )
+			if ( need_previous_next )
 			{
 				// Save the new position from self->get_frame
 				mlt_position new_position = mlt_producer_position( MLT_PRODUCER( self ) );
-				
+				mlt_frame neighbour;
+
 				// Get the preceding frame, unfiltered
-				mlt_frame previous_frame;
-				mlt_producer_seek( MLT_PRODUCER(self), position - 1 );
-				result = self->get_frame( self, &previous_frame, index );
+				result = get_neighbour( self, &neighbour, position - 1, index );
 				if ( !result )
 					mlt_properties_set_data( properties, "previous frame",
-						previous_frame, 0, ( mlt_destructor ) mlt_frame_close, NULL );
+						neighbour, 0, ( mlt_destructor ) mlt_frame_close, NULL );
 
 				// Get the following frame, unfiltered
-				mlt_frame next_frame;
-				mlt_producer_seek( MLT_PRODUCER(self), position + 1 );
-				result = self->get_frame( self, &next_frame, index );
+				result = get_neighbour( self, &neighbour, position + 1, index );
 				if ( !result )
-				{
 					mlt_properties_set_data( properties, "next frame",
-						next_frame, 0, ( mlt_destructor ) mlt_frame_close, NULL );
-				}
-				
+						neighbour, 0, ( mlt_destructor ) mlt_frame_close, NULL );
+
 				// Restore the new position
 				mlt_producer_seek( MLT_PRODUCER(self), new_position );
 			}
+			else if ( mlt_service_identify( self ) == producer_type )
+			{
+				clear_neighbours( self );
+			}
 		}
 	}
 
@@ -644,6 +913,8 @@ int mlt_service_get_frame( mlt_service self, mlt_frame_ptr frame, int index )
 	// Unlock the service
 	mlt_service_unlock( self );
 
+	mlt_trace_end_service( trace_start, "get_frame", self );
+
 	return result;
 }
 
@@ -890,6 +1161,7 @@ void mlt_service_close( mlt_service self )
 					mlt_service_close( base->in[ i ] );
 			self->parent.close = NULL;
 			free( base->in );
+			clear_neighbours( self );
 			pthread_mutex_destroy( &base->mutex );
 			free( base );
 			mlt_properties_close( &self->parent );
@@ -965,7 +1237,11 @@ void mlt_service_cache_put( mlt_service self, const char *name, void* data, int
 	mlt_cache cache = get_cache( self, name );
 
 	if ( cache )
+	{
 		mlt_cache_put( cache, self, data, size, destructor );
+		// Name the owner of the cached memory in the statistics.
+		mlt_pool_account( self, mlt_properties_get( MLT_SERVICE_PROPERTIES( self ), "mlt_service" ), mlt_memory_cache, 0 );
+	}
 }
 
 /** Get an object from a service's cache.
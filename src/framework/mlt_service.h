@@ -40,6 +40,9 @@
  *
  * \event \em service-changed a filter was attached or detached or a transition was connected or disconnected
  * \event \em property-changed
+ * \event \em properties-changed properties changed outside of a batch or a batch of changes ended,
+ *   the argument is a properties list holding the changed names, not including names that start
+ *   with an underscore (see mlt_properties_begin_batch)
  * \properties \em mlt_type identifies the subclass
  * \properties \em _mlt_service_hidden a flag that indicates whether to hide the mlt_service
  * \properties \em mlt_service is the name of the implementation of the service
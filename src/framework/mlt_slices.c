@@ -24,6 +24,7 @@
 #include "mlt_properties.h"
 #include "mlt_log.h"
 #include "mlt_factory.h"
+#include "mlt_trace.h"
 
 #include <stdlib.h>
 #include <unistd.h>
@@ -114,7 +115,9 @@ static void* mlt_slices_worker( void* p )
 		pthread_mutex_unlock( &ctx->cond_mutex );
 		mlt_log_debug( NULL, "%s:%d: running job: id=%d, idx=%d/%d, pool=[%s]\n", __FUNCTION__, __LINE__,
 			id, idx, r->jobs, ctx->name );
+		int64_t trace_start = mlt_trace_begin();
 		r->proc( id, idx, r->jobs, r->cookie );
+		mlt_trace_end( trace_start, "slice", ctx->name ? ctx->name : "slices", ctx );
 		pthread_mutex_lock( &ctx->cond_mutex );
 
 		/* increase done jobs counter */
@@ -274,6 +277,7 @@ void mlt_slices_close( mlt_slices ctx )
 void mlt_slices_run( mlt_slices ctx, int jobs, mlt_slices_proc proc, void* cookie )
 {
 	struct mlt_slices_runtime_s runtime, *r = &runtime;
+	int64_t trace_start = mlt_trace_begin();
 
 	/* lock */
 	pthread_mutex_lock( &ctx->cond_mutex);
@@ -314,6 +318,8 @@ void mlt_slices_run( mlt_slices ctx, int jobs, mlt_slices_proc proc, void* cooki
 	}
 
 	pthread_mutex_unlock( &ctx->cond_mutex);
+
+	mlt_trace_end( trace_start, "slices", ctx->name ? ctx->name : "slices", ctx );
 }
 
 /** Get a global shared sliced threading context.
@@ -411,3 +417,27 @@ void mlt_slices_run_fifo(int jobs, mlt_slices_proc proc, void *cookie)
 	return mlt_slices_run( mlt_slices_get_global( mlt_policy_fifo ),
 	   jobs, proc, cookie );
 }
+
+/** Compute the size of one slice of a job.
+ *
+ * This is a helper for slice procs that divide an image into bands of rows.
+ * The input is split into \p jobs nearly equal parts and the part for
+ * \p index is returned. Trailing slices may be smaller or empty.
+ *
+ * \public \memberof mlt_slices_s
+ * \param jobs the number of slices
+ * \param index the index of the slice
+ * \param input_size the total size to divide, for example the image height
+ * \param[out] start optional; the offset of the first element of the slice
+ * \return the number of elements in the slice
+ */
+
+int mlt_slices_size_slice( int jobs, int index, int input_size, int* start )
+{
+	int size = ( input_size + jobs - 1 ) / jobs;
+	int my_start = index * size;
+
+	if ( start )
+		*start = my_start;
+	return CLAMP( input_size - my_start, 0, size );
+}
@@ -52,4 +52,6 @@ extern void mlt_slices_run_rr( int jobs, mlt_slices_proc proc, void* cookie );
 
 extern void mlt_slices_run_fifo( int jobs, mlt_slices_proc proc, void* cookie );
 
+extern int mlt_slices_size_slice( int jobs, int index, int input_size, int* start );
+
 #endif
@@ -0,0 +1,469 @@
+/**
+ * \file mlt_trace.c
+ * \brief render profiler that records time spent per service and thread
+ * \see mlt_trace.h
+ *
+ * Copyright (C) 2020 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "mlt_trace.h"
+#include "mlt_frame.h"
+#include "mlt_service.h"
+#include "mlt_properties.h"
+#include "mlt_deque.h"
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+/** The number of events kept per thread, the oldest are overwritten. */
+#define TRACE_EVENTS (16384)
+/** The deepest nesting of spans that is accounted for. */
+#define TRACE_DEPTH (64)
+#define TRACE_NAME_SIZE (40)
+
+/* Recording works on per-thread ring buffers, so the only shared state
+ * touched per event is the enabled flag. A buffer is claimed by a thread on
+ * its first event and released for reuse when the thread exits, so threads
+ * that come and go with every consumer start do not accumulate buffers.
+ */
+
+typedef struct
+{
+	int64_t start;       /**< nanoseconds */
+	int64_t duration;    /**< nanoseconds, including nested spans */
+	int64_t self;        /**< nanoseconds, excluding nested spans */
+	const void *id;
+	const char *category;
+	int thread;
+	char name[ TRACE_NAME_SIZE ];
+}
+trace_event;
+
+typedef struct trace_buffer_s
+{
+	trace_event *events;
+	atomic_llong count;        /**< the number of events ever written */
+	int thread;
+	int in_use;
+	int depth;
+	int64_t children[ TRACE_DEPTH ];
+	struct trace_buffer_s *next;
+}
+trace_buffer;
+
+typedef struct
+{
+	const void *id;
+	const char *category;
+	const char *name;
+	int64_t calls;
+	int64_t self;
+	int64_t total;
+	int64_t max;
+}
+trace_total;
+
+static atomic_int g_enabled = 0;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static trace_buffer *g_buffers = NULL;
+static int g_threads = 0;
+static pthread_key_t g_key;
+static pthread_once_t g_key_once = PTHREAD_ONCE_INIT;
+static __thread trace_buffer *t_buffer = NULL;
+
+static int64_t now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void release_buffer( void *arg )
+{
+	trace_buffer *buffer = arg;
+	pthread_mutex_lock( &g_lock );
+	buffer->in_use = 0;
+	pthread_mutex_unlock( &g_lock );
+}
+
+static void create_key( void )
+{
+	pthread_key_create( &g_key, release_buffer );
+}
+
+static trace_buffer *get_buffer( void )
+{
+	trace_buffer *buffer = t_buffer;
+
+	if ( !buffer )
+	{
+		pthread_once( &g_key_once, create_key );
+		pthread_mutex_lock( &g_lock );
+		for ( buffer = g_buffers; buffer && buffer->in_use; buffer = buffer->next );
+		if ( !buffer )
+		{
+			buffer = calloc( 1, sizeof( trace_buffer ) );
+			if ( buffer )
+				buffer->events = calloc( TRACE_EVENTS, sizeof( trace_event ) );
+			if ( buffer && buffer->events )
+			{
+				buffer->next = g_buffers;
+				g_buffers = buffer;
+			}
+			else
+			{
+				if ( buffer )
+					free( buffer->events );
+				free( buffer );
+				buffer = NULL;
+			}
+		}
+		if ( buffer )
+		{
+			buffer->in_use = 1;
+			buffer->thread = ++g_threads;
+			buffer->depth = 0;
+			t_buffer = buffer;
+			pthread_setspecific( g_key, buffer );
+		}
+		pthread_mutex_unlock( &g_lock );
+	}
+	return buffer;
+}
+
+/** Start or stop recording.
+ *
+ * \param enable true to record spans
+ */
+
+void mlt_trace_enable( int enable )
+{
+	atomic_store( &g_enabled, enable != 0 );
+}
+
+/** Determine if spans are recorded.
+ *
+ * \return true if enabled
+ */
+
+int mlt_trace_is_enabled( void )
+{
+	return atomic_load_explicit( &g_enabled, memory_order_relaxed );
+}
+
+/** Discard all of the recorded spans.
+ *
+ * This should not be called while services are rendering.
+ */
+
+void mlt_trace_reset( void )
+{
+	trace_buffer *buffer;
+
+	pthread_mutex_lock( &g_lock );
+	for ( buffer = g_buffers; buffer; buffer = buffer->next )
+		atomic_store( &buffer->count, 0 );
+	pthread_mutex_unlock( &g_lock );
+}
+
+/** Begin a span.
+ *
+ * Every call that returns a time must be matched with mlt_trace_end() on the
+ * same thread.
+ *
+ * \return the start time to pass to mlt_trace_end() or 0 if disabled
+ */
+
+int64_t mlt_trace_begin( void )
+{
+	trace_buffer *buffer;
+
+	if ( !mlt_trace_is_enabled() || !( buffer = get_buffer() ) )
+		return 0;
+	if ( ++buffer->depth < TRACE_DEPTH )
+		buffer->children[ buffer->depth ] = 0;
+	return now();
+}
+
+/** End a span.
+ *
+ * \param start the value returned by mlt_trace_begin()
+ * \param category the kind of work, a string that must outlive the trace
+ * \param name the name of the span
+ * \param id identifies the object for aggregation (optional)
+ */
+
+void mlt_trace_end( int64_t start, const char *category, const char *name, const void *id )
+{
+	trace_buffer *buffer = t_buffer;
+
+	if ( !start || !buffer )
+		return;
+
+	int64_t duration = now() - start;
+	int64_t children = buffer->depth < TRACE_DEPTH ? buffer->children[ buffer->depth ] : 0;
+	int64_t count = atomic_load_explicit( &buffer->count, memory_order_relaxed );
+	trace_event *event = &buffer->events[ count % TRACE_EVENTS ];
+
+	if ( --buffer->depth > 0 && buffer->depth < TRACE_DEPTH )
+		buffer->children[ buffer->depth ] += duration;
+
+	event->start = start;
+	event->duration = duration;
+	event->self = duration - children;
+	event->id = id;
+	event->category = category;
+	event->thread = buffer->thread;
+	strncpy( event->name, name ? name : "", TRACE_NAME_SIZE - 1 );
+	event->name[ TRACE_NAME_SIZE - 1 ] = '\0';
+	atomic_store_explicit( &buffer->count, count + 1, memory_order_release );
+}
+
+/** End a span of a service.
+ *
+ * \param start the value returned by mlt_trace_begin()
+ * \param category the kind of work, a string that must outlive the trace
+ * \param service the service that did the work
+ */
+
+void mlt_trace_end_service( int64_t start, const char *category, mlt_service service )
+{
+	if ( start )
+	{
+		const char *name = service ? mlt_properties_get( MLT_SERVICE_PROPERTIES( service ), "mlt_service" ) : NULL;
+		if ( !name )
+		{
+			switch ( mlt_service_identify( service ) )
+			{
+			case playlist_type: name = "playlist"; break;
+			case tractor_type: name = "tractor"; break;
+			case multitrack_type: name = "multitrack"; break;
+			case field_type: name = "field"; break;
+			case producer_type: name = "producer"; break;
+			case filter_type: name = "filter"; break;
+			case transition_type: name = "transition"; break;
+			case consumer_type: name = "consumer"; break;
+			default: name = "unknown"; break;
+			}
+		}
+		mlt_trace_end( start, category, name, service );
+	}
+}
+
+static int trace_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
+{
+	mlt_service service = mlt_frame_pop_service( frame );
+	int64_t start = mlt_trace_begin();
+	int error = mlt_frame_get_image( frame, image, format, width, height, writable );
+	mlt_trace_end_service( start, "get_image", service );
+	return error;
+}
+
+static int trace_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *format, int *frequency, int *channels, int *samples )
+{
+	mlt_service service = mlt_frame_pop_audio( frame );
+	int64_t start = mlt_trace_begin();
+	int error = mlt_frame_get_audio( frame, buffer, format, frequency, channels, samples );
+	mlt_trace_end_service( start, "get_audio", service );
+	return error;
+}
+
+/** Attribute the image and audio work a service added to a frame.
+ *
+ * This wraps the callbacks that \p service pushed since the stacks had the
+ * given sizes in a span, so nothing is added to a frame on which it did not
+ * push anything.
+ *
+ * \param frame a frame
+ * \param service the service that processed the frame
+ * \param image_count the size of the image stack before processing
+ * \param audio_count the size of the audio stack before processing
+ */
+
+void mlt_trace_frame( mlt_frame frame, mlt_service service, int image_count, int audio_count )
+{
+	if ( !frame || !mlt_trace_is_enabled() )
+		return;
+	if ( mlt_deque_count( MLT_FRAME_IMAGE_STACK( frame ) ) > image_count )
+	{
+		mlt_frame_push_service( frame, service );
+		mlt_frame_push_get_image( frame, trace_get_image );
+	}
+	if ( mlt_deque_count( MLT_FRAME_AUDIO_STACK( frame ) ) > audio_count )
+	{
+		mlt_frame_push_audio( frame, service );
+		mlt_frame_push_audio( frame, trace_get_audio );
+	}
+}
+
+/** Get a copy of all recorded events.
+ */
+
+static trace_event *collect( int64_t *count )
+{
+	trace_buffer *buffer;
+	trace_event *events = NULL;
+	int64_t total = 0, n = 0;
+
+	pthread_mutex_lock( &g_lock );
+	for ( buffer = g_buffers; buffer; buffer = buffer->next )
+	{
+		int64_t written = atomic_load_explicit( &buffer->count, memory_order_acquire );
+		total += written < TRACE_EVENTS ? written : TRACE_EVENTS;
+	}
+	events = malloc( ( total ? total : 1 ) * sizeof( trace_event ) );
+	for ( buffer = g_buffers; events && buffer; buffer = buffer->next )
+	{
+		int64_t written = atomic_load_explicit( &buffer->count, memory_order_acquire );
+		int64_t i = written > TRACE_EVENTS ? written - TRACE_EVENTS : 0;
+		for ( ; i < written && n < total; i++ )
+			events[ n++ ] = buffer->events[ i % TRACE_EVENTS ];
+	}
+	pthread_mutex_unlock( &g_lock );
+	*count = n;
+	return events;
+}
+
+static void write_json_string( FILE *file, const char *s )
+{
+	fputc( '"', file );
+	for ( ; *s; s++ )
+	{
+		if ( *s == '"' || *s == '\\' )
+			fputc( '\\', file );
+		if ( (unsigned char) *s >= 0x20 )
+			fputc( *s, file );
+	}
+	fputc( '"', file );
+}
+
+/** Write the recorded spans in the Chrome trace event format.
+ *
+ * The file can be loaded in chrome://tracing or Perfetto.
+ *
+ * \param filename the file to write
+ * \return true on error
+ */
+
+int mlt_trace_write_json( const char *filename )
+{
+	int64_t count = 0, i;
+	trace_event *events = collect( &count );
+	FILE *file = events ? fopen( filename, "w" ) : NULL;
+	int64_t epoch = INT64_MAX;
+	int error;
+
+	if ( !file )
+	{
+		free( events );
+		return 1;
+	}
+	for ( i = 0; i < count; i++ )
+		if ( events[i].start < epoch )
+			epoch = events[i].start;
+
+	fprintf( file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" );
+	for ( i = 0; i < count; i++ )
+	{
+		trace_event *e = &events[i];
+		fprintf( file, "%s\n{\"name\":", i ? "," : "" );
+		write_json_string( file, e->name );
+		fprintf( file, ",\"cat\":" );
+		write_json_string( file, e->category );
+		fprintf( file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"id\":\"%p\",\"self_us\":%.3f}}",
+			e->thread, ( e->start - epoch ) / 1000.0, e->duration / 1000.0, e->id, e->self / 1000.0 );
+	}
+	fprintf( file, "\n]}\n" );
+	error = fclose( file ) != 0;
+	free( events );
+	return error;
+}
+
+static int compare_event( const void *a, const void *b )
+{
+	const trace_event *x = a, *y = b;
+	if ( x->id != y->id )
+		return x->id < y->id ? -1 : 1;
+	return strcmp( x->category, y->category );
+}
+
+static int compare_total( const void *a, const void *b )
+{
+	const trace_total *x = a, *y = b;
+	return x->self < y->self ? 1 : x->self > y->self ? -1 : 0;
+}
+
+/** Write the time spent per service and kind of work.
+ *
+ * Self time excludes the time of the spans nested inside, for example the
+ * producer's work below a filter's get_image.
+ *
+ * \param filename the file to write or "-" for stderr
+ * \return true on error
+ */
+
+int mlt_trace_write_summary( const char *filename )
+{
+	int64_t count = 0, i, n = 0;
+	trace_event *events = collect( &count );
+	trace_total *totals = events ? calloc( count ? count : 1, sizeof( trace_total ) ) : NULL;
+	FILE *file = NULL;
+	int error = 1;
+
+	if ( totals )
+		file = strcmp( filename, "-" ) ? fopen( filename, "w" ) : stderr;
+	if ( file )
+	{
+		qsort( events, count, sizeof( trace_event ), compare_event );
+		for ( i = 0; i < count; i++ )
+		{
+			if ( !n || compare_event( &events[i], &events[ i - 1 ] ) )
+			{
+				totals[ n ].id = events[i].id;
+				totals[ n ].category = events[i].category;
+				totals[ n ].name = events[i].name;
+				n++;
+			}
+			trace_total *t = &totals[ n - 1 ];
+			t->calls++;
+			t->self += events[i].self;
+			t->total += events[i].duration;
+			if ( events[i].duration > t->max )
+				t->max = events[i].duration;
+		}
+		qsort( totals, n, sizeof( trace_total ), compare_total );
+
+		fprintf( file, "%-24s %-10s %8s %12s %12s %10s %10s\n",
+			"service", "work", "calls", "self ms", "total ms", "avg ms", "max ms" );
+		for ( i = 0; i < n; i++ )
+		{
+			trace_total *t = &totals[i];
+			fprintf( file, "%-24s %-10s %8" PRId64 " %12.3f %12.3f %10.3f %10.3f\n",
+				t->name, t->category, t->calls, t->self / 1e6, t->total / 1e6,
+				t->total / 1e6 / t->calls, t->max / 1e6 );
+		}
+		error = file == stderr ? fflush( file ) != 0 : fclose( file ) != 0;
+	}
+	free( totals );
+	free( events );
+	return error;
+}
@@ -0,0 +1,45 @@
+/**
+ * \file mlt_trace.h
+ * \brief render profiler that records time spent per service and thread
+ * \see mlt_trace.c
+ *
+ * Copyright (C) 2020 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef MLT_TRACE_H
+#define MLT_TRACE_H
+
+#include "mlt_types.h"
+
+/**
+ * \envvar \em MLT_TRACE the name of a file to which a consumer writes a trace
+ * of the render in the Chrome trace event format when it stops
+ * \envvar \em MLT_TRACE_SUMMARY the name of a file, or "-" for stderr, to which
+ * a consumer writes the time spent per service when it stops
+ */
+
+extern void mlt_trace_enable( int enable );
+extern int mlt_trace_is_enabled( void );
+extern void mlt_trace_reset( void );
+extern int64_t mlt_trace_begin( void );
+extern void mlt_trace_end( int64_t start, const char *category, const char *name, const void *id );
+extern void mlt_trace_end_service( int64_t start, const char *category, mlt_service service );
+extern void mlt_trace_frame( mlt_frame frame, mlt_service service, int image_count, int audio_count );
+extern int mlt_trace_write_json( const char *filename );
+extern int mlt_trace_write_summary( const char *filename );
+
+#endif
@@ -24,6 +24,7 @@
 #include "mlt_frame.h"
 #include "mlt_log.h"
 #include "mlt_producer.h"
+#include "mlt_trace.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -319,9 +320,21 @@ double mlt_transition_get_progress_delta( mlt_transition self, mlt_frame frame )
 mlt_frame mlt_transition_process( mlt_transition self, mlt_frame a_frame, mlt_frame b_frame )
 {
 	if ( self->process == NULL )
+	{
 		return a_frame;
+	}
+	else if ( mlt_trace_is_enabled() )
+	{
+		int image_count = mlt_deque_count( MLT_FRAME_IMAGE_STACK( a_frame ) );
+		int audio_count = mlt_deque_count( MLT_FRAME_AUDIO_STACK( a_frame ) );
+		mlt_frame frame = self->process( self, a_frame, b_frame );
+		mlt_trace_frame( frame, MLT_TRANSITION_SERVICE( self ), image_count, audio_count );
+		return frame;
+	}
 	else
+	{
 		return self->process( self, a_frame, b_frame );
+	}
 }
 
 static int get_image_a( mlt_frame a_frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
@@ -34,7 +34,6 @@ extern "C"
 #include <inttypes.h>
 #include <limits.h>
 #include <stdio.h>
-#include "mlt_pool.h"
 
 #ifndef PATH_MAX
 #define PATH_MAX 4096
@@ -53,6 +52,7 @@ typedef enum
 	mlt_image_glsl,    /**< for opengl module internal use only */
 	mlt_image_glsl_texture, /**< an OpenGL texture name */
 	mlt_image_yuv422p16, /**< planar YUV 4:2:2, 32bpp, (1 Cr & Cb sample per 2x1 Y samples), little-endian */
+	mlt_image_rgba64,  /**< 16-bit RGB with alpha channel, 64bpp, native-endian */
 	mlt_image_invalid
 }
 mlt_image_format;
@@ -152,6 +152,21 @@ typedef enum
 }
 mlt_service_type;
 
+/** The kinds of memory accounted by mlt_pool */
+
+typedef enum
+{
+	mlt_memory_other = 0,       /**< pool memory that has not been tagged */
+	mlt_memory_image,           /**< images and alpha channels of frames */
+	mlt_memory_audio,           /**< audio of frames */
+	mlt_memory_cache,           /**< data held by a service cache */
+	mlt_memory_queue,           /**< frames held in a consumer's read ahead queue */
+	mlt_memory_categories       /**< the number of categories */
+}
+mlt_memory_category;
+
+#include "mlt_pool.h"
+
 /* I don't want to break anyone's applications without warning. -Zach */
 #ifdef DOUBLE_MLT_POSITION
 #define MLT_POSITION_FMT "%f"
@@ -208,6 +223,8 @@ typedef struct mlt_cache_s *mlt_cache;                  /**< pointer to Cache ob
 typedef struct mlt_cache_item_s *mlt_cache_item;        /**< pointer to CacheItem object */
 typedef struct mlt_animation_s *mlt_animation;          /**< pointer to Property Animation object */
 typedef struct mlt_slices_s *mlt_slices;                /**< pointer to Sliced processing context object */
+typedef struct mlt_audio_ring_s *mlt_audio_ring;        /**< pointer to Audio Ring object */
+typedef struct mlt_audio_summary_s *mlt_audio_summary;  /**< pointer to Audio Summary object */
 
 typedef void ( *mlt_destructor )( void * );             /**< pointer to destructor function */
 typedef char *( *mlt_serialiser )( void *, int length );/**< pointer to serialization function */
@@ -589,6 +589,8 @@ static enum AVPixelFormat pick_pix_fmt( mlt_image_format img_fmt )
 		return AV_PIX_FMT_YUV420P;
 	case mlt_image_yuv422p16:
 		return AV_PIX_FMT_YUV422P16LE;
+	case mlt_image_rgba64:
+		return AV_PIX_FMT_RGBA64;
 	default:
 		return AV_PIX_FMT_YUYV422;
 	}
@@ -1978,7 +1980,8 @@ static void *consumer_thread( void *arg )
 
 						// Apply the alpha if applicable
 						if ( !mlt_properties_get( properties, "mlt_image_format" ) ||
-						     strcmp( mlt_properties_get( properties, "mlt_image_format" ), "rgb24a" ) )
+						     ( strcmp( mlt_properties_get( properties, "mlt_image_format" ), "rgb24a" ) &&
+						       strcmp( mlt_properties_get( properties, "mlt_image_format" ), "rgba64" ) ) )
 						if ( c->pix_fmt == AV_PIX_FMT_RGBA ||
 						     c->pix_fmt == AV_PIX_FMT_ARGB ||
 						     c->pix_fmt == AV_PIX_FMT_BGRA )
@@ -67,6 +67,9 @@ static int convert_mlt_to_av_cs( mlt_image_format format )
 		case mlt_image_yuv422p16:
 			value = AV_PIX_FMT_YUV422P16LE;
 			break;
+		case mlt_image_rgba64:
+			value = AV_PIX_FMT_RGBA64;
+			break;
 		default:
 			mlt_log_error( NULL, "[filter avcolor_space] Invalid format %s\n",
 				mlt_image_format_name( format ) );
@@ -101,7 +104,7 @@ static int av_convert_image( uint8_t *out, uint8_t *in, int out_fmt, int in_fmt,
 	if ( context )
 	{
 		// libswscale wants the RGB colorspace to be SWS_CS_DEFAULT, which is = SWS_CS_ITU601.
-		if ( out_fmt == AV_PIX_FMT_RGB24 || out_fmt == AV_PIX_FMT_RGBA )
+		if ( out_fmt == AV_PIX_FMT_RGB24 || out_fmt == AV_PIX_FMT_RGBA || out_fmt == AV_PIX_FMT_RGBA64 )
 			dst_colorspace = 601;
 		error = mlt_set_luma_transfer( context, src_colorspace, dst_colorspace, use_full_range, use_full_range );
 		sws_scale(context, (const uint8_t* const*) in_data, in_stride, 0, in_height,
@@ -178,6 +181,21 @@ static int convert_image( mlt_frame frame, uint8_t **image, mlt_image_format *fo
 					mlt_frame_set_alpha( frame, alpha, len, mlt_pool_release );
 				}
 			}
+			else if ( *format == mlt_image_rgba64 )
+			{
+				int len = width * height;
+				uint8_t *alpha = mlt_pool_alloc( len );
+
+				if ( alpha )
+				{
+					// Extract the most significant byte of the 16-bit alpha
+					uint16_t *s = (uint16_t*) *image + 3;
+					int i;
+					for ( i = 0; i < len; i++, s += 4 )
+						alpha[i] = *s >> 8;
+					mlt_frame_set_alpha( frame, alpha, len, mlt_pool_release );
+				}
+			}
 		} else {
 			// Scaling
 			mlt_properties_clear(properties, "alpha");
@@ -231,6 +249,21 @@ static int convert_image( mlt_frame frame, uint8_t **image, mlt_image_format *fo
 				}
 			}
 		}
+		else if ( output_format == mlt_image_rgba64 )
+		{
+			int len = width * height;
+			int alpha_size = 0;
+			uint8_t *alpha = mlt_frame_get_alpha( frame );
+			mlt_properties_get_data( properties, "alpha", &alpha_size );
+
+			if ( alpha && alpha_size >= len )
+			{
+				uint16_t *d = (uint16_t*) *image + 3;
+				int i;
+				for ( i = 0; i < len; i++, d += 4 )
+					*d = alpha[i] * 257;
+			}
+		}
 	}
 	return error;
 }
@@ -54,12 +54,15 @@ typedef struct
 	int reset;
 } private_data;
 
-static void property_changed( mlt_service owner, mlt_filter filter, char *name )
+static void properties_changed( mlt_service owner, mlt_filter filter, mlt_properties names )
 {
-	if( strncmp( PARAM_PREFIX, name, PARAM_PREFIX_LEN ) == 0 ) {
-		private_data* pdata = (private_data*)filter->child;
-		if( pdata->avfilter )
-		{
+	private_data* pdata = (private_data*)filter->child;
+	int i;
+
+	for( i = 0; pdata->avfilter && !pdata->reset && i < mlt_properties_count( names ); i++ )
+	{
+		const char *name = mlt_properties_get_name( names, i );
+		if( strncmp( PARAM_PREFIX, name, PARAM_PREFIX_LEN ) == 0 ) {
 			const AVOption *opt = NULL;
 			while( ( opt = av_opt_next( &pdata->avfilter->priv_class, opt ) ) )
 			{
@@ -900,7 +903,7 @@ mlt_filter filter_avfilter_init( mlt_profile profile, mlt_service_type type, con
 		filter->process = filter_process;
 		filter->child = pdata;
 
-		mlt_events_listen( MLT_FILTER_PROPERTIES(filter), filter, "property-changed", (mlt_listener)property_changed );
+		mlt_events_listen( MLT_FILTER_PROPERTIES(filter), filter, "properties-changed", (mlt_listener)properties_changed );
 
 		mlt_properties param_name_map = mlt_properties_get_data(mlt_global_properties(), "avfilter.resolution_scale", NULL);
 		if (param_name_map) {
@@ -52,6 +52,9 @@ static inline int convert_mlt_to_av_cs( mlt_image_format format )
 		case mlt_image_yuv420p:
 			value = AV_PIX_FMT_YUV420P;
 			break;
+		case mlt_image_rgba64:
+			value = AV_PIX_FMT_RGBA64;
+			break;
 		default:
 			fprintf( stderr, "Invalid format...\n" );
 			break;
@@ -101,9 +104,15 @@ static int filter_scale( mlt_frame frame, uint8_t **image, mlt_image_format *for
 		case mlt_image_rgb24:
 		case mlt_image_rgb24a:
 		case mlt_image_opengl:
+		case mlt_image_rgba64:
+			break;
+		case mlt_image_yuv420p:
+			// The planes must be laid out as mlt_image_format_planes() does
+			if ( iwidth % 2 || iheight % 2 || owidth % 2 || oheight % 2 )
+				return 1;
 			break;
 		default:
-			// XXX: we only know how to rescale packed formats
+			// XXX: we only know how to rescale packed and 4:2:0 formats
 			return 1;
 	}
 
@@ -67,6 +67,23 @@
 #define MAX_AUDIO_FRAME_SIZE (192000) // 1 second of 48khz 32bit audio
 #define IMAGE_ALIGN (1)
 #define VFR_THRESHOLD (3) // The minimum number of video frames with differing durations to be considered VFR.
+#define AUDIO_CACHE_SIZE (50) // The default number of frames of decoded audio to keep.
+
+/** Decoded samples of one frame, keyed by the stream and the position of the first sample.
+*/
+
+typedef struct
+{
+	int index;
+	int64_t sample;
+	int samples;
+	int channels;
+	int frequency;
+	mlt_audio_format format;
+	mlt_channel_layout layout;
+	void *data;
+	int size;
+} audio_cache_entry;
 
 struct producer_avformat_s
 {
@@ -102,6 +119,12 @@ struct producer_avformat_s
 	unsigned int invalid_pts_counter;
 	unsigned int invalid_dts_counter;
 	mlt_cache image_cache;
+	audio_cache_entry *audio_cache;
+	int audio_cache_size;
+	int audio_cache_next;
+	int64_t audio_cache_hits;
+	int64_t audio_cache_misses;
+	int audio_cache_served; /// audio_expected was advanced by a cache hit, not by decoding
 	int yuv_colorspace, color_primaries, color_trc;
 	int full_luma;
 	pthread_mutex_t video_mutex;
@@ -1369,7 +1392,7 @@ static int convert_image( producer_avformat self, AVFrame *frame, uint8_t *buffe
 			|| pix_fmt == AV_PIX_FMT_YUVA444P
 #endif
 			) &&
-		*format != mlt_image_rgb24a && *format != mlt_image_opengl &&
+		*format != mlt_image_rgb24a && *format != mlt_image_opengl && *format != mlt_image_rgba64 &&
 		frame->data[3] && frame->linesize[3] )
 	{
 		int i;
@@ -1443,6 +1466,21 @@ static int convert_image( producer_avformat self, AVFrame *frame, uint8_t *buffe
 			out_data, out_stride);
 		sws_freeContext( context );
 	}
+	else if ( *format == mlt_image_rgba64 )
+	{
+		// Keep the full precision of high bit depth sources.
+		int flags = mlt_get_sws_flags(width, height, src_pix_fmt, width, height, AV_PIX_FMT_RGBA64);
+		struct SwsContext *context = sws_getContext( width, height, src_pix_fmt,
+			width, height, AV_PIX_FMT_RGBA64, flags, NULL, NULL, NULL);
+		uint8_t *out_data[4];
+		int out_stride[4];
+		av_image_fill_arrays(out_data, out_stride, buffer, AV_PIX_FMT_RGBA64, width, height, IMAGE_ALIGN);
+		// libswscale wants the RGB colorspace to be SWS_CS_DEFAULT, which is = SWS_CS_ITU601.
+		mlt_set_luma_transfer( context, self->yuv_colorspace, 601, self->full_luma, 0 );
+		sws_scale( context, (const uint8_t* const*) frame->data, frame->linesize, 0, height,
+			out_data, out_stride);
+		sws_freeContext( context );
+	}
 	else
 #if defined(FFUDIV) && (LIBSWSCALE_VERSION_INT >= ((3<<16)+(1<<8)+101))
 	{
@@ -1684,12 +1722,12 @@ static int producer_get_image( mlt_frame frame, uint8_t **buffer, mlt_image_form
 			*format = mlt_image_rgb24;
 	}
 #endif
-	else if ( codec_context->pix_fmt == AV_PIX_FMT_YUVA444P10LE
+	else if ( ( codec_context->pix_fmt == AV_PIX_FMT_YUVA444P10LE
 #if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(56,0,0)
 			|| codec_context->pix_fmt == AV_PIX_FMT_GBRAP10LE
 			|| codec_context->pix_fmt == AV_PIX_FMT_GBRAP12LE
 #endif
-			)
+			) && *format != mlt_image_rgba64 )
 		*format = mlt_image_rgb24a;
 
 	// Duplicate the last image if necessary
@@ -2386,7 +2424,7 @@ static int seek_audio( producer_avformat self, mlt_position position, double tim
 	pthread_mutex_lock( &self->packets_mutex );
 
 	// Seek if necessary
-	if ( self->seekable && ( position != self->audio_expected || self->last_position < 0 ) )
+	if ( self->seekable && ( position != self->audio_expected || self->last_position < 0 || self->audio_cache_served ) )
 	{
 		if ( self->last_position == POSITION_INITIAL )
 		{
@@ -2403,7 +2441,7 @@ static int seek_audio( producer_avformat self, mlt_position position, double tim
 			// We're paused - silence required
 			paused = 1;
 		}
-		else if ( position < self->audio_expected || position - self->audio_expected >= 12 )
+		else if ( self->audio_cache_served || position < self->audio_expected || position - self->audio_expected >= 12 )
 		{
 			AVFormatContext *context = self->audio_format;
 			int64_t timestamp = llrint( timecode * AV_TIME_BASE );
@@ -2420,6 +2458,9 @@ static int seek_audio( producer_avformat self, mlt_position position, double tim
 			int i = MAX_AUDIO_STREAMS + 1;
 			while ( --i )
 				self->audio_used[i - 1] = 0;
+
+			// The decoder is positioned again
+			self->audio_cache_served = 0;
 		}
 	}
 	pthread_mutex_unlock( &self->packets_mutex );
@@ -2572,6 +2613,141 @@ static int decode_audio( producer_avformat self, int *ignore, AVPacket pkt, int
 	return ret;
 }
 
+/** Release the decoded audio cache.
+*/
+
+static void audio_cache_close( producer_avformat self )
+{
+	int i;
+	for ( i = 0; i < self->audio_cache_size; i++ )
+		mlt_pool_release( self->audio_cache[i].data );
+	free( self->audio_cache );
+	self->audio_cache = NULL;
+	self->audio_cache_size = 0;
+	self->audio_cache_next = 0;
+}
+
+/** Get the frequency of the samples delivered for the selected stream(s).
+ *
+ * Returns 0 when the samples can not be cached.
+ */
+
+static int audio_cache_frequency( producer_avformat self )
+{
+	if ( !self->seekable || self->audio_index < 0 )
+		return 0;
+	if ( self->audio_index == INT_MAX )
+		return self->max_frequency;
+	if ( self->audio_index < MAX_AUDIO_STREAMS && self->audio_codec[ self->audio_index ] )
+		return self->audio_codec[ self->audio_index ]->sample_rate;
+	return 0;
+}
+
+/** Size the decoded audio cache from the audio_cache property.
+ *
+ * The size is a number of frames. It may be supplied for all instances by the
+ * environment variable MLT_AVFORMAT_AUDIO_CACHE, and 0 disables the cache.
+ */
+
+static int audio_cache_init( producer_avformat self )
+{
+	mlt_properties properties = MLT_PRODUCER_PROPERTIES( self->parent );
+	int size = AUDIO_CACHE_SIZE;
+
+	if ( mlt_properties_get( properties, "audio_cache" ) )
+		size = mlt_properties_get_int( properties, "audio_cache" );
+	else if ( getenv( "MLT_AVFORMAT_AUDIO_CACHE" ) )
+		size = atoi( getenv( "MLT_AVFORMAT_AUDIO_CACHE" ) );
+	size = MAX( size, 0 );
+	if ( size != self->audio_cache_size )
+	{
+		audio_cache_close( self );
+		if ( size > 0 )
+			self->audio_cache = calloc( size, sizeof( audio_cache_entry ) );
+		self->audio_cache_size = self->audio_cache ? size : 0;
+	}
+	return self->audio_cache_size;
+}
+
+static void audio_cache_update_stats( producer_avformat self )
+{
+	mlt_properties properties = MLT_PRODUCER_PROPERTIES( self->parent );
+	int64_t total = self->audio_cache_hits + self->audio_cache_misses;
+
+	mlt_properties_set_int64( properties, "_audio_cache_hits", self->audio_cache_hits );
+	mlt_properties_set_int64( properties, "_audio_cache_misses", self->audio_cache_misses );
+	mlt_properties_set_double( properties, "_audio_cache_hit_rate", total ? (double) self->audio_cache_hits / total : 0.0 );
+}
+
+/** Deliver the samples of a frame from the decoded audio cache.
+ *
+ * Returns true if the frame was found.
+ */
+
+static int audio_cache_get( producer_avformat self, mlt_frame frame, mlt_position position, double fps,
+	void **buffer, mlt_audio_format *format, int *frequency, int *channels, int *samples )
+{
+	int sample_rate = audio_cache_frequency( self );
+	int i;
+
+	if ( !sample_rate || !audio_cache_init( self ) )
+		return 0;
+
+	int64_t sample = mlt_audio_calculate_samples_to_position( fps, sample_rate, position );
+	int count = mlt_audio_calculate_frame_samples( fps, sample_rate, position );
+	for ( i = 0; i < self->audio_cache_size; i++ )
+	{
+		audio_cache_entry *entry = &self->audio_cache[i];
+		if ( entry->data && entry->index == self->audio_index && entry->sample == sample &&
+			 entry->samples == count && entry->frequency == sample_rate )
+		{
+			*buffer = mlt_pool_alloc( entry->size );
+			memcpy( *buffer, entry->data, entry->size );
+			mlt_frame_set_audio( frame, *buffer, entry->format, entry->size, mlt_pool_release );
+			mlt_properties_set( MLT_FRAME_PROPERTIES(frame), "channel_layout", mlt_audio_channel_layout_name( entry->layout ) );
+			*format = entry->format;
+			*frequency = entry->frequency;
+			*channels = entry->channels;
+			*samples = entry->samples;
+			self->audio_cache_hits++;
+			audio_cache_update_stats( self );
+			return 1;
+		}
+	}
+	self->audio_cache_misses++;
+	audio_cache_update_stats( self );
+	return 0;
+}
+
+/** Keep a copy of the samples decoded for a frame, replacing the oldest.
+*/
+
+static void audio_cache_put( producer_avformat self, mlt_position position, double fps, void *buffer,
+	mlt_audio_format format, int frequency, int channels, int samples, mlt_channel_layout layout )
+{
+	if ( !audio_cache_init( self ) || frequency != audio_cache_frequency( self ) )
+		return;
+
+	audio_cache_entry *entry = &self->audio_cache[ self->audio_cache_next ];
+	int size = mlt_audio_format_size( format, samples, channels );
+
+	if ( !entry->data || entry->size != size )
+	{
+		mlt_pool_release( entry->data );
+		entry->data = mlt_pool_alloc( size );
+	}
+	memcpy( entry->data, buffer, size );
+	entry->index = self->audio_index;
+	entry->sample = mlt_audio_calculate_samples_to_position( fps, frequency, position );
+	entry->samples = samples;
+	entry->channels = channels;
+	entry->frequency = frequency;
+	entry->format = format;
+	entry->layout = layout;
+	entry->size = size;
+	self->audio_cache_next = ( self->audio_cache_next + 1 ) % self->audio_cache_size;
+}
+
 /** Get the audio from a frame.
 */
 static int producer_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *format, int *frequency, int *channels, int *samples )
@@ -2592,6 +2768,19 @@ static int producer_get_audio( mlt_frame frame, void **buffer, mlt_audio_format
 	if ( mlt_properties_get( MLT_FRAME_PROPERTIES(frame), "producer_consumer_fps" ) )
 		fps = mlt_properties_get_double( MLT_FRAME_PROPERTIES(frame), "producer_consumer_fps" );
 
+	// Serve a frame that was delivered recently without seeking and decoding
+	// again, but keep decoding when the decoder is already at this position.
+	if ( ( position != self->audio_expected || self->audio_cache_served ) &&
+		 !( position + 1 == self->audio_expected && mlt_properties_get_int( MLT_PRODUCER_PROPERTIES( self->parent ), "mute_on_pause" ) ) &&
+		 audio_cache_get( self, frame, position, fps, buffer, format, frequency, channels, samples ) )
+	{
+		// Expect the next frame as after decoding, but seek before decoding it
+		self->audio_expected = position + 1;
+		self->audio_cache_served = 1;
+		pthread_mutex_unlock( &self->audio_mutex );
+		return 0;
+	}
+
 	// Number of frames to ignore (for ffwd)
 	int ignore[ MAX_AUDIO_STREAMS ] = { 0 };
 
@@ -2819,6 +3008,8 @@ static int producer_get_audio( mlt_frame frame, void **buffer, mlt_audio_format
 				memset( *buffer, silence, *samples * *channels * sizeof_sample );
 			}
 		}
+		if ( got_audio )
+			audio_cache_put( self, position, fps, *buffer, *format, *frequency, *channels, *samples, layout );
 	}
 	else
 	{
@@ -3065,6 +3256,7 @@ static void producer_avformat_close( producer_avformat self )
 
 	// Cleanup caches.
 	mlt_cache_close( self->image_cache );
+	audio_cache_close( self );
 	if ( self->last_good_frame )
 		mlt_frame_close( self->last_good_frame );
 
@@ -0,0 +1,102 @@
+/*
+ * composite_line_yuv_avx2.c
+ * Copyright (C) 2020 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <inttypes.h>
+
+#if defined(USE_SSE) && defined(ARCH_X86_64)
+
+#include <immintrin.h>
+
+/* Sixteen pixels per iteration of the same arithmetic as
+ * composite_line_yuv_sse2_simple(), so that the results are bit exact:
+ *
+ *   alpha  = src_a ? (weight == 256 ? src_a : src_a * weight >> 8) : weight
+ *   dest_a = dest_a + div255( alpha * (255 - dest_a) )
+ *   dest   = div255( src * alpha + dest * (255 - alpha) )
+ *
+ * where div255(x) = ((x >> 8) + x + 128) >> 8.
+ */
+
+__attribute__((target("avx2")))
+static inline __m256i div255_epu16( __m256i x )
+{
+	x = _mm256_add_epi16( _mm256_add_epi16( _mm256_srli_epi16( x, 8 ), x ), _mm256_set1_epi16( 128 ) );
+	return _mm256_srli_epi16( x, 8 );
+}
+
+__attribute__((target("avx2")))
+static inline __m256i blend_epu16( __m256i src, __m256i dest, __m256i alpha )
+{
+	__m256i x = _mm256_mullo_epi16( _mm256_sub_epi16( src, dest ), alpha );
+	return div255_epu16( _mm256_add_epi16( x, _mm256_mullo_epi16( dest, _mm256_set1_epi16( 0xFF ) ) ) );
+}
+
+/** Blend width & ~15 pixels, weight is in the range 0-256.
+ */
+
+__attribute__((target("avx2")))
+void composite_line_yuv_avx2( uint8_t *dest, uint8_t *src, int width, uint8_t *src_a, uint8_t *dest_a, int weight )
+{
+	const __m256i w = _mm256_set1_epi16( weight );
+	const __m256i ff = _mm256_set1_epi16( 0xFF );
+	int j;
+
+	for ( j = 0; j + 16 <= width; j += 16 )
+	{
+		__m256i alpha;
+
+		if ( src_a )
+		{
+			alpha = _mm256_cvtepu8_epi16( _mm_loadu_si128( (const __m128i*) ( src_a + j ) ) );
+			if ( weight != 256 )
+				alpha = _mm256_srli_epi16( _mm256_mullo_epi16( alpha, w ), 8 );
+		}
+		else
+		{
+			alpha = w;
+		}
+
+		if ( dest_a )
+		{
+			__m256i a = _mm256_cvtepu8_epi16( _mm_loadu_si128( (const __m128i*) ( dest_a + j ) ) );
+			a = _mm256_add_epi16( a, div255_epu16( _mm256_mullo_epi16( _mm256_sub_epi16( ff, a ), alpha ) ) );
+			_mm_storeu_si128( (__m128i*) ( dest_a + j ),
+				_mm_packus_epi16( _mm256_castsi256_si128( a ), _mm256_extracti128_si256( a, 1 ) ) );
+		}
+
+		// Each pixel is a luma and a chroma byte sharing the same alpha
+		__m128i alpha_lo = _mm256_castsi256_si128( alpha );
+		__m128i alpha_hi = _mm256_extracti128_si256( alpha, 1 );
+		__m256i alpha0 = _mm256_inserti128_si256( _mm256_castsi128_si256(
+			_mm_unpacklo_epi16( alpha_lo, alpha_lo ) ), _mm_unpackhi_epi16( alpha_lo, alpha_lo ), 1 );
+		__m256i alpha1 = _mm256_inserti128_si256( _mm256_castsi128_si256(
+			_mm_unpacklo_epi16( alpha_hi, alpha_hi ) ), _mm_unpackhi_epi16( alpha_hi, alpha_hi ), 1 );
+
+		__m256i s = _mm256_loadu_si256( (const __m256i*) ( src + j * 2 ) );
+		__m256i d = _mm256_loadu_si256( (const __m256i*) ( dest + j * 2 ) );
+		__m256i r0 = blend_epu16( _mm256_cvtepu8_epi16( _mm256_castsi256_si128( s ) ),
+			_mm256_cvtepu8_epi16( _mm256_castsi256_si128( d ) ), alpha0 );
+		__m256i r1 = blend_epu16( _mm256_cvtepu8_epi16( _mm256_extracti128_si256( s, 1 ) ),
+			_mm256_cvtepu8_epi16( _mm256_extracti128_si256( d, 1 ) ), alpha1 );
+		_mm256_storeu_si256( (__m256i*) ( dest + j * 2 ),
+			_mm256_permute4x64_epi64( _mm256_packus_epi16( r0, r1 ), 0xD8 ) );
+	}
+}
+
+#endif
@@ -20,6 +20,7 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
+#include <framework/mlt_cpu.h>
 
 const static unsigned char const1[] =
 {
@@ -237,10 +238,10 @@ static void blend_case6(uint8_t *dest, uint8_t *src, int width, uint8_t *src_a,
 };
 
 
-void composite_line_yuv_sse2_simple(uint8_t *dest, uint8_t *src, int width, uint8_t *src_a, uint8_t *dest_a, int weight)
-{
-    weight >>= 8;
+void composite_line_yuv_avx2(uint8_t *dest, uint8_t *src, int width, uint8_t *src_a, uint8_t *dest_a, int weight);
 
+static void blend_span(uint8_t *dest, uint8_t *src, int width, uint8_t *src_a, uint8_t *dest_a, int weight)
+{
     /*
         | 0   | dest_a == NULL | src_a == NULL | weight == 256 | blit
         | 1   | dest_a == NULL | src_a == NULL | weight != 256 | blend: with given alpha
@@ -254,6 +255,19 @@ void composite_line_yuv_sse2_simple(uint8_t *dest, uint8_t *src, int width, uint
 
     int cond = ((dest_a != NULL)?4:0) + ((src_a != NULL)?2:0) + ((weight != 256)?1:0);
 
+    if ( cond != 0 && cond != 4 && width >= 16 && mlt_cpu_has(mlt_cpu_avx2) )
+    {
+        int j = width & ~15;
+        composite_line_yuv_avx2(dest, src, j, src_a, dest_a, weight);
+        if (width - j < 8)
+            return;
+        dest += j * 2;
+        src += j * 2;
+        width -= j;
+        if (src_a) src_a += j;
+        if (dest_a) dest_a += j;
+    }
+
     switch(cond)
     {
         case 0:
@@ -270,4 +284,71 @@ void composite_line_yuv_sse2_simple(uint8_t *dest, uint8_t *src, int width, uint
         case 6: blend_case6(dest, src, width, src_a, dest_a); break;
         case 7: blend_case7(dest, src, width, src_a, dest_a, weight); break;
     };
+}
+
+#define ALPHA_RUN 32
+
+// 0: fully transparent, 1: fully opaque, 2: mixed
+static inline int alpha_run_class(const uint8_t *a, int n)
+{
+    uint64_t all = ~(uint64_t) 0, any = 0, v;
+    int i;
+
+    // n is a multiple of 8
+    for (i = 0; i < n; i += 8)
+    {
+        memcpy(&v, a + i, sizeof(v));
+        all &= v;
+        any |= v;
+    }
+    return any == 0 ? 0 : all == ~(uint64_t) 0 ? 1 : 2;
+}
+
+/* Blends width & ~7 pixels, leaving the remainder to the caller.
+ *
+ * Overlays such as titles and logos are mostly fully transparent or fully
+ * opaque, so the source alpha is classified in runs: transparent runs leave
+ * the destination untouched, opaque runs at full weight are copied, and only
+ * the rest is blended.
+ */
+void composite_line_yuv_sse2_simple(uint8_t *dest, uint8_t *src, int width, uint8_t *src_a, uint8_t *dest_a, int weight)
+{
+    int j = 0;
+
+    weight >>= 8;
+
+    if (!src_a)
+    {
+        blend_span(dest, src, width, src_a, dest_a, weight);
+        return;
+    }
+
+    width &= ~7;
+
+    while (j < width)
+    {
+        int n = width - j < ALPHA_RUN ? width - j : ALPHA_RUN;
+        int cls = alpha_run_class(src_a + j, n);
+        int k = j + n;
+
+        while (k < width)
+        {
+            n = width - k < ALPHA_RUN ? width - k : ALPHA_RUN;
+            if (alpha_run_class(src_a + k, n) != cls)
+                break;
+            k += n;
+        }
+
+        if (cls == 1 && weight == 256)
+        {
+            memcpy(dest + j * 2, src + j * 2, 2 * (k - j));
+            if (dest_a)
+                memset(dest_a + j, 0xFF, k - j);
+        }
+        else if (cls != 0)
+        {
+            blend_span(dest + j * 2, src + j * 2, k - j, src_a + j, dest_a ? dest_a + j : NULL, weight);
+        }
+        j = k;
+    }
 };
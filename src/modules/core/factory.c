@@ -26,6 +26,7 @@ extern mlt_consumer consumer_null_init( mlt_profile profile, mlt_service_type ty
 extern mlt_filter filter_audiochannels_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_filter filter_audioconvert_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_filter filter_audiomap_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
+extern mlt_filter filter_audioresample_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_filter filter_audiowave_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_filter filter_brightness_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_filter filter_channelcopy_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
@@ -44,6 +45,7 @@ extern mlt_filter filter_mirror_init( mlt_profile profile, mlt_service_type type
 extern mlt_filter filter_mono_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_filter filter_obscure_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_filter filter_panner_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
+extern mlt_filter filter_proxy_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_filter filter_region_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_filter filter_rescale_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_filter filter_resize_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
@@ -61,6 +63,7 @@ extern mlt_producer producer_tone_init( mlt_profile profile, mlt_service_type ty
 #include "transition_composite.h"
 extern mlt_transition transition_luma_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_transition transition_mix_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
+extern mlt_transition transition_mixer_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 extern mlt_transition transition_matte_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg );
 #include "transition_region.h"
 
@@ -78,6 +81,7 @@ MLT_REPOSITORY
 	MLT_REGISTER( filter_type, "audiochannels", filter_audiochannels_init );
 	MLT_REGISTER( filter_type, "audioconvert", filter_audioconvert_init );
 	MLT_REGISTER( filter_type, "audiomap", filter_audiomap_init );
+	MLT_REGISTER( filter_type, "audioresample", filter_audioresample_init );
 	MLT_REGISTER( filter_type, "audiowave", filter_audiowave_init );
 	MLT_REGISTER( filter_type, "brightness", filter_brightness_init );
 	MLT_REGISTER( filter_type, "channelcopy", filter_channelcopy_init );
@@ -98,6 +102,7 @@ MLT_REPOSITORY
 	MLT_REGISTER( filter_type, "mono", filter_mono_init );
 	MLT_REGISTER( filter_type, "obscure", filter_obscure_init );
 	MLT_REGISTER( filter_type, "panner", filter_panner_init );
+	MLT_REGISTER( filter_type, "proxy", filter_proxy_init );
 	MLT_REGISTER( filter_type, "region", filter_region_init );
 	MLT_REGISTER( filter_type, "rescale", filter_rescale_init );
 	MLT_REGISTER( filter_type, "resize", filter_resize_init );
@@ -117,11 +122,13 @@ MLT_REPOSITORY
 	MLT_REGISTER( transition_type, "composite", transition_composite_init );
 	MLT_REGISTER( transition_type, "luma", transition_luma_init );
 	MLT_REGISTER( transition_type, "mix", transition_mix_init );
+	MLT_REGISTER( transition_type, "mixer", transition_mixer_init );
 	MLT_REGISTER( transition_type, "matte", transition_matte_init );
 	MLT_REGISTER( transition_type, "region", transition_region_init );
 
 	MLT_REGISTER_METADATA( consumer_type, "multi", metadata, "consumer_multi.yml" );
 	MLT_REGISTER_METADATA( filter_type, "audiomap", metadata, "filter_audiomap.yml" );
+	MLT_REGISTER_METADATA( filter_type, "audioresample", metadata, "filter_audioresample.yml" );
 	MLT_REGISTER_METADATA( filter_type, "audiowave", metadata, "filter_audiowave.yml" );
 	MLT_REGISTER_METADATA( filter_type, "brightness", metadata, "filter_brightness.yml" );
 	MLT_REGISTER_METADATA( filter_type, "channelcopy", metadata, "filter_channelcopy.yml" );
@@ -140,6 +147,7 @@ MLT_REPOSITORY
 	MLT_REGISTER_METADATA( filter_type, "mono", metadata, "filter_mono.yml" );
 	MLT_REGISTER_METADATA( filter_type, "obscure", metadata, "filter_obscure.yml" );
 	MLT_REGISTER_METADATA( filter_type, "panner", metadata, "filter_panner.yml" );
+	MLT_REGISTER_METADATA( filter_type, "proxy", metadata, "filter_proxy.yml" );
 	MLT_REGISTER_METADATA( filter_type, "region", metadata, "filter_region.yml" );
 	MLT_REGISTER_METADATA( filter_type, "rescale", metadata, "filter_rescale.yml" );
 	MLT_REGISTER_METADATA( filter_type, "resize", metadata, "filter_resize.yml" );
@@ -158,6 +166,7 @@ MLT_REPOSITORY
 	MLT_REGISTER_METADATA( transition_type, "composite", metadata, "transition_composite.yml" );
 	MLT_REGISTER_METADATA( transition_type, "luma", metadata, "transition_luma.yml" );
 	MLT_REGISTER_METADATA( transition_type, "mix", metadata, "transition_mix.yml" );
+	MLT_REGISTER_METADATA( transition_type, "mixer", metadata, "transition_mixer.yml" );
 	MLT_REGISTER_METADATA( transition_type, "matte", metadata, "transition_matte.yml" );
 	MLT_REGISTER_METADATA( transition_type, "region", metadata, "transition_region.yml" );
 }
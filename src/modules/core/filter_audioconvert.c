@@ -20,9 +20,415 @@
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
 #include <framework/mlt_log.h>
+#include <framework/mlt_pool.h>
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#if defined(USE_SSE2)
+#include <emmintrin.h>
+#endif
+
+/* Every audio format is one of four sample types in either an interleaved or
+ * a planar layout. A conversion runs a kernel that converts the sample type
+ * over contiguous samples, interleaving or deinterleaving in cache sized
+ * blocks when the layouts differ.
+ */
+
+typedef enum
+{
+	sample_s16,
+	sample_s32,
+	sample_float,
+	sample_u8,
+	sample_type_count
+} sample_type;
+
+typedef void ( *sample_converter )( const void *in, void *out, int count );
+
+static const struct
+{
+	sample_type type;
+	int planar;
+}
+audio_layouts[] =
+{
+	[mlt_audio_s16]   = { sample_s16, 0 },
+	[mlt_audio_s32]   = { sample_s32, 1 },
+	[mlt_audio_float] = { sample_float, 1 },
+	[mlt_audio_s32le] = { sample_s32, 0 },
+	[mlt_audio_f32le] = { sample_float, 0 },
+	[mlt_audio_u8]    = { sample_u8, 0 },
+};
+
+static const int sample_size[ sample_type_count ] = { 2, 4, 4, 1 };
+
+// The number of samples converted before they are interleaved or deinterleaved
+#define BLOCK_SAMPLES (4096)
+
+static void copy_s16( const void *in, void *out, int count )
+{
+	memcpy( out, in, count * 2 );
+}
+
+static void copy_32( const void *in, void *out, int count )
+{
+	memcpy( out, in, count * 4 );
+}
+
+static void copy_u8( const void *in, void *out, int count )
+{
+	memcpy( out, in, count );
+}
+
+static void s16_to_s32( const void *in, void *out, int count )
+{
+	const int16_t *p = in;
+	int32_t *q = out;
+	int i = 0;
+#if defined(USE_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		__m128i x = _mm_loadu_si128( (const __m128i*) ( p + i ) );
+		_mm_storeu_si128( (__m128i*) ( q + i ), _mm_unpacklo_epi16( zero, x ) );
+		_mm_storeu_si128( (__m128i*) ( q + i + 4 ), _mm_unpackhi_epi16( zero, x ) );
+	}
+#endif
+	for ( ; i < count; i++ )
+		q[i] = (int32_t) p[i] << 16;
+}
+
+static void s16_to_float( const void *in, void *out, int count )
+{
+	const int16_t *p = in;
+	float *q = out;
+	int i = 0;
+#if defined(USE_SSE2)
+	const __m128 scale = _mm_set1_ps( 1.0f / 32768.0f );
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		__m128i x = _mm_loadu_si128( (const __m128i*) ( p + i ) );
+		__m128i lo = _mm_srai_epi32( _mm_unpacklo_epi16( x, x ), 16 );
+		__m128i hi = _mm_srai_epi32( _mm_unpackhi_epi16( x, x ), 16 );
+		_mm_storeu_ps( q + i, _mm_mul_ps( _mm_cvtepi32_ps( lo ), scale ) );
+		_mm_storeu_ps( q + i + 4, _mm_mul_ps( _mm_cvtepi32_ps( hi ), scale ) );
+	}
+#endif
+	for ( ; i < count; i++ )
+		q[i] = (float) p[i] / 32768.0f;
+}
+
+static void s16_to_u8( const void *in, void *out, int count )
+{
+	const int16_t *p = in;
+	uint8_t *q = out;
+	int i = 0;
+#if defined(USE_SSE2)
+	const __m128i bias = _mm_set1_epi8( (char) 0x80 );
+	for ( ; i + 16 <= count; i += 16 )
+	{
+		__m128i x = _mm_srai_epi16( _mm_loadu_si128( (const __m128i*) ( p + i ) ), 8 );
+		__m128i y = _mm_srai_epi16( _mm_loadu_si128( (const __m128i*) ( p + i + 8 ) ), 8 );
+		_mm_storeu_si128( (__m128i*) ( q + i ), _mm_xor_si128( _mm_packs_epi16( x, y ), bias ) );
+	}
+#endif
+	for ( ; i < count; i++ )
+		q[i] = ( p[i] >> 8 ) + 128;
+}
+
+static void s32_to_s16( const void *in, void *out, int count )
+{
+	const int32_t *p = in;
+	int16_t *q = out;
+	int i = 0;
+#if defined(USE_SSE2)
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		__m128i x = _mm_srai_epi32( _mm_loadu_si128( (const __m128i*) ( p + i ) ), 16 );
+		__m128i y = _mm_srai_epi32( _mm_loadu_si128( (const __m128i*) ( p + i + 4 ) ), 16 );
+		_mm_storeu_si128( (__m128i*) ( q + i ), _mm_packs_epi32( x, y ) );
+	}
+#endif
+	for ( ; i < count; i++ )
+		q[i] = p[i] >> 16;
+}
+
+static void s32_to_float( const void *in, void *out, int count )
+{
+	const int32_t *p = in;
+	float *q = out;
+	int i = 0;
+#if defined(USE_SSE2)
+	const __m128 scale = _mm_set1_ps( 1.0f / 2147483648.0f );
+	for ( ; i + 4 <= count; i += 4 )
+		_mm_storeu_ps( q + i, _mm_mul_ps( _mm_cvtepi32_ps( _mm_loadu_si128( (const __m128i*) ( p + i ) ) ), scale ) );
+#endif
+	for ( ; i < count; i++ )
+		q[i] = (float) p[i] / 2147483648.0f;
+}
+
+static void s32_to_u8( const void *in, void *out, int count )
+{
+	const int32_t *p = in;
+	uint8_t *q = out;
+	int i = 0;
+#if defined(USE_SSE2)
+	const __m128i bias = _mm_set1_epi8( (char) 0x80 );
+	for ( ; i + 16 <= count; i += 16 )
+	{
+		__m128i a = _mm_srai_epi32( _mm_loadu_si128( (const __m128i*) ( p + i ) ), 24 );
+		__m128i b = _mm_srai_epi32( _mm_loadu_si128( (const __m128i*) ( p + i + 4 ) ), 24 );
+		__m128i c = _mm_srai_epi32( _mm_loadu_si128( (const __m128i*) ( p + i + 8 ) ), 24 );
+		__m128i d = _mm_srai_epi32( _mm_loadu_si128( (const __m128i*) ( p + i + 12 ) ), 24 );
+		__m128i x = _mm_packs_epi16( _mm_packs_epi32( a, b ), _mm_packs_epi32( c, d ) );
+		_mm_storeu_si128( (__m128i*) ( q + i ), _mm_xor_si128( x, bias ) );
+	}
+#endif
+	for ( ; i < count; i++ )
+		q[i] = ( p[i] >> 24 ) + 128;
+}
+
+static void float_to_s16( const void *in, void *out, int count )
+{
+	const float *p = in;
+	int16_t *q = out;
+	int i = 0;
+#if defined(USE_SSE2)
+	const __m128 min = _mm_set1_ps( -1.0f ), max = _mm_set1_ps( 1.0f ), scale = _mm_set1_ps( 32767.0f );
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		__m128 x = _mm_min_ps( _mm_max_ps( _mm_loadu_ps( p + i ), min ), max );
+		__m128 y = _mm_min_ps( _mm_max_ps( _mm_loadu_ps( p + i + 4 ), min ), max );
+		__m128i a = _mm_cvttps_epi32( _mm_mul_ps( x, scale ) );
+		__m128i b = _mm_cvttps_epi32( _mm_mul_ps( y, scale ) );
+		_mm_storeu_si128( (__m128i*) ( q + i ), _mm_packs_epi32( a, b ) );
+	}
+#endif
+	for ( ; i < count; i++ )
+	{
+		float f = CLAMP( p[i], -1.0f, 1.0f );
+		q[i] = 32767 * f;
+	}
+}
+
+static void float_to_s32( const void *in, void *out, int count )
+{
+	const float *p = in;
+	int32_t *q = out;
+	int i = 0;
+#if defined(USE_SSE2)
+	const __m128 min = _mm_set1_ps( -1.0f ), max = _mm_set1_ps( 1.0f ), scale = _mm_set1_ps( 2147483648.0f );
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		__m128 x = _mm_mul_ps( _mm_min_ps( _mm_max_ps( _mm_loadu_ps( p + i ), min ), max ), scale );
+		// Only +1.0 overflows, which the conversion returns as INT32_MIN; flip it to INT32_MAX.
+		__m128i overflow = _mm_castps_si128( _mm_cmpge_ps( x, scale ) );
+		_mm_storeu_si128( (__m128i*) ( q + i ), _mm_xor_si128( _mm_cvttps_epi32( x ), overflow ) );
+	}
+#endif
+	for ( ; i < count; i++ )
+	{
+		float f = CLAMP( p[i], -1.0f, 1.0f );
+		int64_t pcm = ( f > 0.0f ? 2147483647LL : 2147483648LL ) * f;
+		q[i] = CLAMP( pcm, -2147483648LL, 2147483647LL );
+	}
+}
+
+static void float_to_u8( const void *in, void *out, int count )
+{
+	const float *p = in;
+	uint8_t *q = out;
+	int i = 0;
+#if defined(USE_SSE2)
+	const __m128 min = _mm_set1_ps( -1.0f ), max = _mm_set1_ps( 1.0f );
+	const __m128 scale = _mm_set1_ps( 127.0f ), bias = _mm_set1_ps( 128.0f );
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		__m128 x = _mm_min_ps( _mm_max_ps( _mm_loadu_ps( p + i ), min ), max );
+		__m128 y = _mm_min_ps( _mm_max_ps( _mm_loadu_ps( p + i + 4 ), min ), max );
+		__m128i a = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( x, scale ), bias ) );
+		__m128i b = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( y, scale ), bias ) );
+		__m128i c = _mm_packs_epi32( a, b );
+		_mm_storel_epi64( (__m128i*) ( q + i ), _mm_packus_epi16( c, c ) );
+	}
+#endif
+	for ( ; i < count; i++ )
+	{
+		float f = CLAMP( p[i], -1.0f, 1.0f );
+		q[i] = ( 127 * f ) + 128;
+	}
+}
+
+static void u8_to_s16( const void *in, void *out, int count )
+{
+	const uint8_t *p = in;
+	int16_t *q = out;
+	int i = 0;
+#if defined(USE_SSE2)
+	const __m128i zero = _mm_setzero_si128(), bias = _mm_set1_epi16( (short) 0x8000 );
+	for ( ; i + 16 <= count; i += 16 )
+	{
+		__m128i x = _mm_loadu_si128( (const __m128i*) ( p + i ) );
+		_mm_storeu_si128( (__m128i*) ( q + i ), _mm_xor_si128( _mm_unpacklo_epi8( zero, x ), bias ) );
+		_mm_storeu_si128( (__m128i*) ( q + i + 8 ), _mm_xor_si128( _mm_unpackhi_epi8( zero, x ), bias ) );
+	}
+#endif
+	for ( ; i < count; i++ )
+		q[i] = ( (int16_t) p[i] - 128 ) << 8;
+}
+
+static void u8_to_s32( const void *in, void *out, int count )
+{
+	const uint8_t *p = in;
+	int32_t *q = out;
+	int i = 0;
+#if defined(USE_SSE2)
+	const __m128i zero = _mm_setzero_si128(), bias = _mm_set1_epi32( (int) 0x80000000 );
+	for ( ; i + 16 <= count; i += 16 )
+	{
+		__m128i x = _mm_loadu_si128( (const __m128i*) ( p + i ) );
+		__m128i lo = _mm_unpacklo_epi8( zero, x ), hi = _mm_unpackhi_epi8( zero, x );
+		_mm_storeu_si128( (__m128i*) ( q + i ), _mm_xor_si128( _mm_unpacklo_epi16( zero, lo ), bias ) );
+		_mm_storeu_si128( (__m128i*) ( q + i + 4 ), _mm_xor_si128( _mm_unpackhi_epi16( zero, lo ), bias ) );
+		_mm_storeu_si128( (__m128i*) ( q + i + 8 ), _mm_xor_si128( _mm_unpacklo_epi16( zero, hi ), bias ) );
+		_mm_storeu_si128( (__m128i*) ( q + i + 12 ), _mm_xor_si128( _mm_unpackhi_epi16( zero, hi ), bias ) );
+	}
+#endif
+	for ( ; i < count; i++ )
+		q[i] = ( (int32_t) p[i] - 128 ) << 24;
+}
+
+static void u8_to_float( const void *in, void *out, int count )
+{
+	const uint8_t *p = in;
+	float *q = out;
+	int i = 0;
+#if defined(USE_SSE2)
+	const __m128i zero = _mm_setzero_si128(), bias = _mm_set1_epi32( 128 );
+	const __m128 scale = _mm_set1_ps( 1.0f / 256.0f );
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		__m128i x = _mm_unpacklo_epi8( _mm_loadl_epi64( (const __m128i*) ( p + i ) ), zero );
+		__m128i lo = _mm_sub_epi32( _mm_unpacklo_epi16( x, zero ), bias );
+		__m128i hi = _mm_sub_epi32( _mm_unpackhi_epi16( x, zero ), bias );
+		_mm_storeu_ps( q + i, _mm_mul_ps( _mm_cvtepi32_ps( lo ), scale ) );
+		_mm_storeu_ps( q + i + 4, _mm_mul_ps( _mm_cvtepi32_ps( hi ), scale ) );
+	}
+#endif
+	for ( ; i < count; i++ )
+		q[i] = ( (float) p[i] - 128 ) / 256.0f;
+}
+
+static const sample_converter converters[ sample_type_count ][ sample_type_count ] =
+{
+	//                 to s16        to s32        to float      to u8
+	[sample_s16]   = { copy_s16,     s16_to_s32,   s16_to_float, s16_to_u8 },
+	[sample_s32]   = { s32_to_s16,   copy_32,      s32_to_float, s32_to_u8 },
+	[sample_float] = { float_to_s16, float_to_s32, copy_32,      float_to_u8 },
+	[sample_u8]    = { u8_to_s16,    u8_to_s32,    u8_to_float,  copy_u8 },
+};
+
+/* Interleaving writes each output frame in order while it gathers from the
+ * planes, and deinterleaving works a tile of TRANSPOSE_SAMPLES at a time so
+ * both sides of the transpose stay in cache.
+ */
+#define TRANSPOSE_SAMPLES (64)
+
+#define INTERLEAVE( type, in, stride, out, channels, count ) \
+	{ \
+		const type *p = in; \
+		type *q = out; \
+		int c, i; \
+		for ( i = 0; i < count; i++ ) \
+			for ( c = 0; c < channels; c++ ) \
+				*q++ = p[ c * stride + i ]; \
+	}
+
+#define DEINTERLEAVE( type, in, out, stride, channels, count ) \
+	{ \
+		const type *p = in; \
+		type *q = out; \
+		int s, c, i; \
+		for ( s = 0; s < count; s += TRANSPOSE_SAMPLES ) \
+		{ \
+			int n = MIN( TRANSPOSE_SAMPLES, count - s ); \
+			for ( c = 0; c < channels; c++ ) \
+				for ( i = s; i < s + n; i++ ) \
+					q[ c * stride + i ] = p[ i * channels + c ]; \
+		} \
+	}
+
+/** Interleave count samples per channel of planes that are stride samples apart.
+*/
+
+static void interleave( const void *in, int stride, void *out, int channels, int count, int size )
+{
+	switch ( size )
+	{
+	case 1: INTERLEAVE( uint8_t, in, stride, out, channels, count ); break;
+	case 2: INTERLEAVE( int16_t, in, stride, out, channels, count ); break;
+	case 4: INTERLEAVE( int32_t, in, stride, out, channels, count ); break;
+	}
+}
+
+/** Deinterleave count samples per channel into planes that are stride samples apart.
+*/
+
+static void deinterleave( const void *in, void *out, int stride, int channels, int count, int size )
+{
+	switch ( size )
+	{
+	case 1: DEINTERLEAVE( uint8_t, in, out, stride, channels, count ); break;
+	case 2: DEINTERLEAVE( int16_t, in, out, stride, channels, count ); break;
+	case 4: DEINTERLEAVE( int32_t, in, out, stride, channels, count ); break;
+	}
+}
+
+static int convert_layout( const void *in, int in_planar, sample_type in_type, void *out, sample_type out_type,
+	int channels, int samples )
+{
+	sample_converter convert = converters[ in_type ][ out_type ];
+	int in_size = sample_size[ in_type ];
+	int out_size = sample_size[ out_type ];
+	const uint8_t *p = in;
+	uint8_t *q = out;
+
+	if ( in_type == out_type )
+	{
+		if ( in_planar )
+			interleave( in, samples, out, channels, samples, out_size );
+		else
+			deinterleave( in, out, samples, channels, samples, out_size );
+	}
+	else
+	{
+		int block = MAX( 1, BLOCK_SAMPLES / channels );
+		uint8_t *tmp = mlt_pool_alloc( block * channels * out_size );
+		int s, c;
+
+		if ( !tmp )
+			return 1;
+		for ( s = 0; s < samples; s += block )
+		{
+			int n = MIN( block, samples - s );
+			if ( in_planar )
+			{
+				for ( c = 0; c < channels; c++ )
+					convert( p + ( c * samples + s ) * in_size, tmp + c * n * out_size, n );
+				interleave( tmp, n, q + s * channels * out_size, channels, n, out_size );
+			}
+			else
+			{
+				convert( p + s * channels * in_size, tmp, n * channels );
+				deinterleave( tmp, q + s * out_size, samples, channels, n, out_size );
+			}
+		}
+		mlt_pool_release( tmp );
+	}
+	return 0;
+}
 
 static int convert_audio( mlt_frame frame, void **audio, mlt_audio_format *format, mlt_audio_format requested_format )
 {
@@ -32,531 +438,45 @@ static int convert_audio( mlt_frame frame, void **audio, mlt_audio_format *forma
 	int samples = mlt_properties_get_int( properties, "audio_samples" );
 	int size = mlt_audio_format_size( requested_format, samples, channels );
 
-	if ( *format != requested_format )
+	if ( *format != requested_format &&
+	     *format > mlt_audio_none && *format <= mlt_audio_u8 &&
+	     requested_format > mlt_audio_none && requested_format <= mlt_audio_u8 )
 	{
+		sample_type in_type = audio_layouts[ *format ].type;
+		sample_type out_type = audio_layouts[ requested_format ].type;
+		int in_planar = audio_layouts[ *format ].planar;
+		int same_layout = in_planar == audio_layouts[ requested_format ].planar || channels == 1;
+
+		void *buffer = mlt_pool_alloc( size );
+
 		mlt_log_debug( NULL, "[filter audioconvert] %s -> %s %d channels %d samples\n",
 			mlt_audio_format_name( *format ), mlt_audio_format_name( requested_format ),
 			channels, samples );
-		switch ( *format )
+
+		if ( buffer )
 		{
-		case mlt_audio_s16:
-			switch ( requested_format )
+			if ( same_layout )
 			{
-			case mlt_audio_s32:
-			{
-				int32_t *buffer = mlt_pool_alloc( size );
-				int32_t *p = buffer;
-				int c;
-				for ( c = 0; c < channels; c++ )
-				{
-					int16_t *q = (int16_t*) *audio + c;
-					int i = samples + 1;
-					while ( --i )
-					{
-						*p++ = (int32_t) *q << 16;
-						q += channels;
-					}
-				}
-				*audio = buffer;
+				converters[ in_type ][ out_type ]( *audio, buffer, samples * channels );
 				error = 0;
-				break;
 			}
-			case mlt_audio_float:
+			else
 			{
-				float *buffer = mlt_pool_alloc( size );
-				float *p = buffer;
-				int c;
-				for ( c = 0; c < channels; c++ )
-				{
-					int16_t *q = (int16_t*) *audio + c;
-					int i = samples + 1;
-					while ( --i )
-					{
-						*p++ = (float)( *q ) / 32768.0;
-						q += channels;
-					}
-				}
-				*audio = buffer;
-				error = 0;
-				break;
+				error = convert_layout( *audio, in_planar, in_type, buffer, out_type, channels, samples );
 			}
-			case mlt_audio_s32le:
-			{
-				int32_t *buffer = mlt_pool_alloc( size );
-				int32_t *p = buffer;
-				int16_t *q = (int16_t*) *audio;
-				int i = samples * channels + 1;
-				while ( --i )
-					*p++ = (int32_t) *q++ << 16;
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_f32le:
-			{
-				float *buffer = mlt_pool_alloc( size );
-				float *p = buffer;
-				int16_t *q = (int16_t*) *audio;
-				int i = samples * channels + 1;
-				while ( --i )
-				{
-					float f = (float)( *q++ ) / 32768.0;
-					*p++ = CLAMP( f, -1.0f, 1.0f );
-				}
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_u8:
-			{
-				uint8_t *buffer = mlt_pool_alloc( size );
-				uint8_t *p = buffer;
-				int16_t *q = (int16_t*) *audio;
-				int i = samples * channels + 1;
-				while ( --i )
-					*p++ = ( *q++ >> 8 ) + 128;
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			default:
-				break;
-			}
-			break;
-		case mlt_audio_s32:
-			switch ( requested_format )
-			{
-			case mlt_audio_s16:
-			{
-				int16_t *buffer = mlt_pool_alloc( size );
-				int16_t *p = buffer;
-				int32_t *q = (int32_t*) *audio;
-				int s, c;
-				for ( s = 0; s < samples; s++ )
-					for ( c = 0; c < channels; c++ )
-						*p++ = *( q + c * samples + s ) >> 16;
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_float:
-			{
-				float *buffer = mlt_pool_alloc( size );
-				float *p = buffer;
-				int32_t *q = (int32_t*) *audio;
-				int i = samples * channels + 1;
-				while ( --i )
-					*p++ = (float)( *q++ ) / 2147483648.0;
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_s32le:
-			{
-				int32_t *buffer = mlt_pool_alloc( size );
-				int32_t *p = buffer;
-				int32_t *q = (int32_t*) *audio;
-				int s, c;
-				for ( s = 0; s < samples; s++ )
-					for ( c = 0; c < channels; c++ )
-						*p++ = *( q + c * samples + s );
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_f32le:
-			{
-				float *buffer = mlt_pool_alloc( size );
-				float *p = buffer;
-				int32_t *q = (int32_t*) *audio;
-				int s, c;
-				for ( s = 0; s < samples; s++ )
-					for ( c = 0; c < channels; c++ )
-					{
-						float f = (float)( *( q + c * samples + s ) ) / 2147483648.0;
-						*p++ = CLAMP( f, -1.0f, 1.0f );
-					}
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_u8:
-			{
-				uint8_t *buffer = mlt_pool_alloc( size );
-				uint8_t *p = buffer;
-				int32_t *q = (int32_t*) *audio;
-				int s, c;
-				for ( s = 0; s < samples; s++ )
-					for ( c = 0; c < channels; c++ )
-						*p++ = ( q[c * samples + s] >> 24 ) + 128;
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			default:
-				break;
-			}
-			break;
-		case mlt_audio_float:
-			switch ( requested_format )
-			{
-			case mlt_audio_s16:
-			{
-				int16_t *buffer = mlt_pool_alloc( size );
-				int16_t *p = buffer;
-				float *q = (float*) *audio;
-				int s, c;
-				for ( s = 0; s < samples; s++ )
-					for ( c = 0; c < channels; c++ )
-					{
-						float f = *( q + c * samples + s );
-						f = CLAMP( f, -1.0f, 1.0f );
-						*p++ = 32767 * f;
-					}
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_s32:
-			{
-				int32_t *buffer = mlt_pool_alloc( size );
-				int32_t *p = buffer;
-				float *q = (float*) *audio;
-				int i = samples * channels + 1;
-				while ( --i )
-				{
-					float f = *q++;
-					f = CLAMP( f, -1.0f, 1.0f );
-					int64_t pcm = ( f > 0.0f ? 2147483647LL : 2147483648LL ) * f;
-					*p++ = CLAMP( pcm, -2147483648LL, 2147483647LL );
-				}
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_s32le:
-			{
-				int32_t *buffer = mlt_pool_alloc( size );
-				int32_t *p = buffer;
-				float *q = (float*) *audio;
-				int s, c;
-				for ( s = 0; s < samples; s++ )
-					for ( c = 0; c < channels; c++ )
-					{
-						float f = *( q + c * samples + s );
-						f = CLAMP( f, -1.0f, 1.0f );
-						int64_t pcm = ( f > 0.0f ? 2147483647LL : 2147483648LL ) * f;
-						*p++ = CLAMP( pcm, -2147483648LL, 2147483647LL );
-					}
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_f32le:
-			{
-				float *buffer = mlt_pool_alloc( size );
-				float *p = buffer;
-				float *q = (float*) *audio;
-				int s, c;
-				for ( s = 0; s < samples; s++ )
-					for ( c = 0; c < channels; c++ )
-						*p++ = *( q + c * samples + s );
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_u8:
-			{
-				uint8_t *buffer = mlt_pool_alloc( size );
-				uint8_t *p = buffer;
-				float *q = (float*) *audio;
-				int s, c;
-				for ( s = 0; s < samples; s++ )
-					for ( c = 0; c < channels; c++ )
-					{
-						float f = *( q + c * samples + s );
-						f = CLAMP( f, -1.0f, 1.0f );
-						*p++ = ( 127 * f ) + 128;
-					}
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			default:
-				break;
-			}
-			break;
-		case mlt_audio_s32le:
-			switch ( requested_format )
-			{
-			case mlt_audio_s16:
-			{
-				int16_t *buffer = mlt_pool_alloc( size );
-				int16_t *p = buffer;
-				int32_t *q = (int32_t*) *audio;
-				int i = samples * channels + 1;
-				while ( --i )
-					*p++ = *q++ >> 16;
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_s32:
-			{
-				int32_t *buffer = mlt_pool_alloc( size );
-				int32_t *p = buffer;
-				int c;
-				for ( c = 0; c < channels; c++ )
-				{
-					int32_t *q = (int32_t*) *audio + c;
-					int i = samples + 1;
-					while ( --i )
-					{
-						*p++ = *q;
-						q += channels;
-					}
-				}
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_float:
-			{
-				float *buffer = mlt_pool_alloc( size );
-				float *p = buffer;
-				int c;
-				for ( c = 0; c < channels; c++ )
-				{
-					int32_t *q = (int32_t*) *audio + c;
-					int i = samples + 1;
-					while ( --i )
-					{
-						*p++ = (float)( *q ) / 2147483648.0;
-						q += channels;
-					}
-				}
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_f32le:
-			{
-				float *buffer = mlt_pool_alloc( size );
-				float *p = buffer;
-				int32_t *q = (int32_t*) *audio;
-				int i = samples * channels + 1;
-				while ( --i )
-					*p++ = (float)( *q++ ) / 2147483648.0;
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_u8:
-			{
-				uint8_t *buffer = mlt_pool_alloc( size );
-				uint8_t *p = buffer;
-				int32_t *q = (int32_t*) *audio;
-				int i = samples * channels + 1;
-				while ( --i )
-					*p++ = ( *q++ >> 24 ) + 128;
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			default:
-				break;
-			}
-			break;
-		case mlt_audio_f32le:
-			switch ( requested_format )
-			{
-			case mlt_audio_s16:
-			{
-				int16_t *buffer = mlt_pool_alloc( size );
-				int16_t *p = buffer;
-				float *q = (float*) *audio;
-				int i = samples * channels + 1;
-				while ( --i )
-				{
-					float f = *q++;
-					f = CLAMP( f, -1.0f , 1.0f );
-					*p++ = 32767 * f;
-				}
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_float:
-			{
-				float *buffer = mlt_pool_alloc( size );
-				float *p = buffer;
-				int c;
-				for ( c = 0; c < channels; c++ )
-				{
-					float *q = (float*) *audio + c;
-					int i = samples + 1;
-					while ( --i )
-					{
-						*p++ = *q;
-						q += channels;
-					}
-				}
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_s32:
-			{
-				int32_t *buffer = mlt_pool_alloc( size );
-				int32_t *p = buffer;
-				int c;
-				for ( c = 0; c < channels; c++ )
-				{
-					float *q = (float*) *audio + c;
-					int i = samples + 1;
-					while ( --i )
-					{
-						float f = *q;
-						f = CLAMP( f, -1.0f , 1.0f );
-						int64_t pcm = ( f > 0.0f ? 2147483647LL : 2147483648LL ) * f;
-						*p++ = CLAMP( pcm, -2147483648LL, 2147483647LL );
-						q += channels;
-					}
-				}
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_s32le:
-			{
-				int32_t *buffer = mlt_pool_alloc( size );
-				int32_t *p = buffer;
-				float *q = (float*) *audio;
-				int i = samples * channels + 1;
-				while ( --i )
-				{
-					float f = *q++;
-					f = CLAMP( f, -1.0f , 1.0f );
-					int64_t pcm = ( f > 0.0f ? 2147483647LL : 2147483648LL ) * f;
-					*p++ = CLAMP( pcm, -2147483648LL, 2147483647LL );
-				}
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_u8:
-			{
-				uint8_t *buffer = mlt_pool_alloc( size );
-				uint8_t *p = buffer;
-				float *q = (float*) *audio;
-				int i = samples * channels + 1;
-				while ( --i )
-				{
-					float f = *q++;
-					f = CLAMP( f, -1.0f , 1.0f );
-					*p++ = ( 127 * f ) + 128;
-				}
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			default:
-				break;
-			}
-			break;
-		case mlt_audio_u8:
-			switch ( requested_format )
-			{
-			case mlt_audio_s32:
-			{
-				int32_t *buffer = mlt_pool_alloc( size );
-				int32_t *p = buffer;
-				int c;
-				for ( c = 0; c < channels; c++ )
-				{
-					uint8_t *q = (uint8_t*) *audio + c;
-					int i = samples + 1;
-					while ( --i )
-					{
-						*p++ = ( (int32_t) *q - 128 ) << 24;
-						q += channels;
-					}
-				}
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_float:
-			{
-				float *buffer = mlt_pool_alloc( size );
-				float *p = buffer;
-				int c;
-				for ( c = 0; c < channels; c++ )
-				{
-					uint8_t *q = (uint8_t*) *audio + c;
-					int i = samples + 1;
-					while ( --i )
-					{
-						*p++ = ( (float) *q - 128 ) / 256.0f;
-						q += channels;
-					}
-				}
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_s16:
-			{
-				int16_t *buffer = mlt_pool_alloc( size );
-				int16_t *p = buffer;
-				uint8_t *q = (uint8_t*) *audio;
-				int i = samples * channels + 1;
-				while ( --i )
-					*p++ = ( (int16_t) *q++ - 128 ) << 8;
-				*audio = buffer;
-				error = 0;
-				break;
-			}
-			case mlt_audio_s32le:
+
+			if ( error )
 			{
-				int32_t *buffer = mlt_pool_alloc( size );
-				int32_t *p = buffer;
-				uint8_t *q = (uint8_t*) *audio;
-				int i = samples * channels + 1;
-				while ( --i )
-					*p++ = ( (int32_t) *q++ - 128 ) << 24;
-				*audio = buffer;
-				error = 0;
-				break;
+				mlt_pool_release( buffer );
 			}
-			case mlt_audio_f32le:
+			else
 			{
-				float *buffer = mlt_pool_alloc( size );
-				float *p = buffer;
-				uint8_t *q = (uint8_t*) *audio;
-				int i = samples * channels + 1;
-				while ( --i )
-				{
-					float f = ( (float) *q++ - 128 ) / 256.0f;
-					*p++ = CLAMP( f, -1.0f, 1.0f );
-				}
+				mlt_frame_set_audio( frame, buffer, requested_format, size, mlt_pool_release );
 				*audio = buffer;
-				error = 0;
-				break;
-			}
-			default:
-				break;
+				*format = requested_format;
 			}
-			break;
-		default:
-			break;
 		}
 	}
-	if ( !error )
-	{
-		mlt_frame_set_audio( frame, *audio, requested_format, size, mlt_pool_release );
-		*format = requested_format;
-	}
 	return error;
 }
 
@@ -0,0 +1,519 @@
+/*
+ * filter_audioresample.c -- polyphase sample rate conversion of planar float
+ * Copyright (C) 2020 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <framework/mlt_filter.h>
+#include <framework/mlt_frame.h>
+#include <framework/mlt_log.h>
+#include <framework/mlt_pool.h>
+#include <framework/mlt_cpu.h>
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(USE_SSE) && defined(ARCH_X86_64)
+#include <immintrin.h>
+#endif
+
+// Sample rate pairs that need more phases than this are approximated
+#define MAX_PHASES (1024)
+
+// The most output samples kept between frames before the oldest are dropped
+#define MAX_LATENCY(rate) ((rate) / 10)
+
+// The output samples held back beyond the filter delay to absorb frames that
+// complete fewer samples than they ask for
+#define CUSHION (16)
+
+/** The quality presets: the filter length at unity ratio, the passband and
+ * the Kaiser window shape.
+ */
+
+static const struct
+{
+	const char *name;
+	int taps;
+	double rolloff;
+	double beta;
+} presets[] =
+{
+	{ "fast",   16, 0.85, 5.0 },
+	{ "medium", 32, 0.91, 7.0 },
+	{ "best",   64, 0.95, 9.0 }
+};
+
+/** The streaming state of one filter instance.
+ *
+ * Input samples wait in the history until the whole filter window is
+ * available, and output samples wait in the fifo until a frame asks for them.
+ * Both hold each channel in its own slot of capacity samples.
+ */
+
+typedef struct
+{
+	pthread_mutex_t mutex;
+	int in_rate;
+	int out_rate;
+	int channels;
+	int preset;
+	int phases;
+	int step;
+	int taps;
+	float *coeffs;
+	float *history;
+	int history_count;
+	int history_capacity;
+	int phase;
+	float *fifo;
+	int fifo_count;
+	int fifo_capacity;
+	int *offsets;
+	int *phase_list;
+	int list_capacity;
+	mlt_position expected;
+} private_data;
+
+static double bessel_i0( double x )
+{
+	double sum = 1.0, term = 1.0;
+	int k;
+
+	for ( k = 1; k < 50 && term > 1e-12 * sum; k++ )
+	{
+		term *= ( x / ( 2 * k ) ) * ( x / ( 2 * k ) );
+		sum += term;
+	}
+	return sum;
+}
+
+static int gcd( int a, int b )
+{
+	while ( b )
+	{
+		int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/** Grow a planar buffer, keeping count samples of every channel.
+*/
+
+static int reserve( float **buffer, int *capacity, int channels, int count, int needed )
+{
+	if ( needed <= *capacity )
+		return 0;
+	int capacity_new = MAX( needed, *capacity * 3 / 2 );
+	float *buffer_new = malloc( (size_t) capacity_new * channels * sizeof(float) );
+	int c;
+
+	if ( !buffer_new )
+		return 1;
+	for ( c = 0; *buffer && c < channels; c++ )
+		memcpy( buffer_new + c * capacity_new, *buffer + c * *capacity, count * sizeof(float) );
+	free( *buffer );
+	*buffer = buffer_new;
+	*capacity = capacity_new;
+	return 0;
+}
+
+/** Build the polyphase filter bank for the current rates and preset.
+ *
+ * Output sample k is taken at input time k * step / phases. Each phase holds
+ * the windowed sinc taps for one fractional offset, normalised to unity gain.
+ */
+
+static int configure( private_data *pdata )
+{
+	int g = gcd( pdata->in_rate, pdata->out_rate );
+	double ratio = (double) pdata->out_rate / pdata->in_rate;
+	double scale = MIN( 1.0, ratio ) * presets[ pdata->preset ].rolloff;
+	double beta = presets[ pdata->preset ].beta;
+	int p, t;
+
+	pdata->phases = pdata->out_rate / g;
+	pdata->step = pdata->in_rate / g;
+	if ( pdata->phases > MAX_PHASES )
+	{
+		pdata->phases = MAX_PHASES;
+		pdata->step = lrint( (double) MAX_PHASES * pdata->in_rate / pdata->out_rate );
+	}
+
+	// Widen the window when decimating so that the transition band keeps its shape
+	pdata->taps = presets[ pdata->preset ].taps;
+	if ( ratio < 1.0 )
+		pdata->taps = ( (int) ceil( pdata->taps / ratio ) + 7 ) & ~7;
+
+	free( pdata->coeffs );
+	pdata->coeffs = malloc( (size_t) pdata->phases * pdata->taps * sizeof(float) );
+	if ( !pdata->coeffs )
+		return 1;
+	for ( p = 0; p < pdata->phases; p++ )
+	{
+		float *row = pdata->coeffs + p * pdata->taps;
+		double half = pdata->taps / 2;
+		double sum = 0.0;
+		for ( t = 0; t < pdata->taps; t++ )
+		{
+			double d = (double) p / pdata->phases + half - 1 - t;
+			double x = d / half;
+			double w = fabs( x ) < 1.0 ? bessel_i0( beta * sqrt( 1.0 - x * x ) ) / bessel_i0( beta ) : 0.0;
+			double s = d == 0.0 ? 1.0 : sin( M_PI * scale * d ) / ( M_PI * scale * d );
+			row[t] = s * w;
+			sum += row[t];
+		}
+		for ( t = 0; t < pdata->taps; t++ )
+			row[t] /= sum;
+	}
+	return 0;
+}
+
+/** Forget the stream and start over with silence in the filter window.
+ *
+ * The fifo is primed with the delay of the filter plus a cushion, so that a
+ * frame is always served from samples that are already filtered.
+*/
+
+static void reset( private_data *pdata )
+{
+	int c;
+
+	free( pdata->history );
+	free( pdata->fifo );
+	pdata->history = pdata->fifo = NULL;
+	pdata->history_capacity = pdata->fifo_capacity = 0;
+	pdata->history_count = pdata->taps / 2 - 1;
+	pdata->phase = 0;
+	pdata->fifo_count = 0;
+	reserve( &pdata->history, &pdata->history_capacity, pdata->channels, 0, pdata->taps );
+	for ( c = 0; pdata->history && c < pdata->channels; c++ )
+		memset( pdata->history + c * pdata->history_capacity, 0, pdata->history_count * sizeof(float) );
+	int preroll = (int) ( ( (int64_t) ( pdata->taps / 2 ) * pdata->phases + pdata->step - 1 ) / pdata->step ) + CUSHION;
+	if ( !reserve( &pdata->fifo, &pdata->fifo_capacity, pdata->channels, 0, preroll ) )
+	{
+		for ( c = 0; c < pdata->channels; c++ )
+			memset( pdata->fifo + c * pdata->fifo_capacity, 0, preroll * sizeof(float) );
+		pdata->fifo_count = preroll;
+	}
+}
+
+/** Filter one channel at the listed window offsets and phases.
+*/
+
+static void resample_channel_c( float *out, const float *in, const float *coeffs, int taps,
+	const int *offsets, const int *phases, int count )
+{
+	int k, t;
+
+	for ( k = 0; k < count; k++ )
+	{
+		const float *x = in + offsets[k];
+		const float *h = coeffs + phases[k] * taps;
+		float sum = 0.0f;
+		for ( t = 0; t < taps; t++ )
+			sum += x[t] * h[t];
+		out[k] = sum;
+	}
+}
+
+#if defined(USE_SSE) && defined(ARCH_X86_64)
+__attribute__((target("avx2,fma")))
+static void resample_channel_fma( float *out, const float *in, const float *coeffs, int taps,
+	const int *offsets, const int *phases, int count )
+{
+	int k, t;
+
+	for ( k = 0; k < count; k++ )
+	{
+		const float *x = in + offsets[k];
+		const float *h = coeffs + phases[k] * taps;
+		__m256 sum0 = _mm256_setzero_ps();
+		__m256 sum1 = _mm256_setzero_ps();
+		for ( t = 0; t + 16 <= taps; t += 16 )
+		{
+			sum0 = _mm256_fmadd_ps( _mm256_loadu_ps( x + t ), _mm256_loadu_ps( h + t ), sum0 );
+			sum1 = _mm256_fmadd_ps( _mm256_loadu_ps( x + t + 8 ), _mm256_loadu_ps( h + t + 8 ), sum1 );
+		}
+		if ( t < taps )
+			sum0 = _mm256_fmadd_ps( _mm256_loadu_ps( x + t ), _mm256_loadu_ps( h + t ), sum0 );
+		sum0 = _mm256_add_ps( sum0, sum1 );
+		__m128 s = _mm_add_ps( _mm256_castps256_ps128( sum0 ), _mm256_extractf128_ps( sum0, 1 ) );
+		s = _mm_add_ps( s, _mm_movehl_ps( s, s ) );
+		s = _mm_add_ss( s, _mm_shuffle_ps( s, s, 1 ) );
+		out[k] = _mm_cvtss_f32( s );
+	}
+	// Leave the AVX state clean before any SSE code runs
+	_mm256_zeroupper();
+}
+#endif
+
+static void resample_channel( float *out, const float *in, const float *coeffs, int taps,
+	const int *offsets, const int *phases, int count )
+{
+#if defined(USE_SSE) && defined(ARCH_X86_64)
+	// The taps are always a multiple of 8
+	if ( mlt_cpu_has( mlt_cpu_avx2 | mlt_cpu_fma ) )
+	{
+		resample_channel_fma( out, in, coeffs, taps, offsets, phases, count );
+		return;
+	}
+#endif
+	resample_channel_c( out, in, coeffs, taps, offsets, phases, count );
+}
+
+/** Append a frame of planar input and filter every output sample it completes.
+*/
+
+static int process( private_data *pdata, const float *in, int samples )
+{
+	int channels = pdata->channels;
+	int c, k;
+
+	if ( reserve( &pdata->history, &pdata->history_capacity, channels, pdata->history_count, pdata->history_count + samples ) )
+		return 1;
+	for ( c = 0; c < channels; c++ )
+		memcpy( pdata->history + c * pdata->history_capacity + pdata->history_count, in + c * samples, samples * sizeof(float) );
+	pdata->history_count += samples;
+
+	// List the window offset and phase of each output sample
+	int available = pdata->history_count - pdata->taps;
+	int count = available < 0 ? 0 : (int) ( ( (int64_t) ( available + 1 ) * pdata->phases - pdata->phase + pdata->step - 1 ) / pdata->step );
+	if ( count > pdata->list_capacity )
+	{
+		free( pdata->offsets );
+		free( pdata->phase_list );
+		pdata->offsets = malloc( count * sizeof(int) );
+		pdata->phase_list = malloc( count * sizeof(int) );
+		pdata->list_capacity = pdata->offsets && pdata->phase_list ? count : 0;
+		if ( !pdata->list_capacity )
+			return 1;
+	}
+	int offset = 0, phase = pdata->phase;
+	for ( k = 0; k < count; k++ )
+	{
+		pdata->offsets[k] = offset;
+		pdata->phase_list[k] = phase;
+		phase += pdata->step;
+		offset += phase / pdata->phases;
+		phase %= pdata->phases;
+	}
+
+	if ( reserve( &pdata->fifo, &pdata->fifo_capacity, channels, pdata->fifo_count, pdata->fifo_count + count ) )
+		return 1;
+	for ( c = 0; c < channels; c++ )
+		resample_channel( pdata->fifo + c * pdata->fifo_capacity + pdata->fifo_count,
+			pdata->history + c * pdata->history_capacity, pdata->coeffs, pdata->taps,
+			pdata->offsets, pdata->phase_list, count );
+	pdata->fifo_count += count;
+
+	// Keep the input that later output samples still need
+	pdata->phase = phase;
+	pdata->history_count -= offset;
+	for ( c = 0; c < channels && offset > 0; c++ )
+	{
+		float *h = pdata->history + c * pdata->history_capacity;
+		memmove( h, h + offset, pdata->history_count * sizeof(float) );
+	}
+	return 0;
+}
+
+/** Take exactly samples from the fifo into a new planar buffer.
+ *
+ * The pre-roll of the fifo covers the usual shortfall. Should the fifo still
+ * run dry, the missing samples are left silent at the end of the frame so that
+ * the start of the frame stays continuous with the previous one.
+ */
+
+static float *deliver( mlt_filter filter, private_data *pdata, int samples )
+{
+	int channels = pdata->channels;
+	float *output = mlt_pool_alloc( mlt_audio_format_size( mlt_audio_float, samples, channels ) );
+	int take = MIN( samples, pdata->fifo_count );
+	int c;
+
+	if ( take < samples )
+		mlt_log_debug( MLT_FILTER_SERVICE(filter), "underrun of %d samples\n", samples - take );
+	for ( c = 0; c < channels; c++ )
+	{
+		float *fifo = pdata->fifo + c * pdata->fifo_capacity;
+		memcpy( output + c * samples, fifo, take * sizeof(float) );
+		memset( output + c * samples + take, 0, ( samples - take ) * sizeof(float) );
+		memmove( fifo, fifo + take, ( pdata->fifo_count - take ) * sizeof(float) );
+	}
+	pdata->fifo_count -= take;
+
+	// Do not let latency build up when the producer delivers more than asked:
+	// drop only the oldest samples beyond the limit
+	int excess = pdata->fifo_count - MAX_LATENCY( pdata->out_rate );
+	if ( excess > 0 )
+	{
+		pdata->fifo_count -= excess;
+		for ( c = 0; c < channels; c++ )
+		{
+			float *fifo = pdata->fifo + c * pdata->fifo_capacity;
+			memmove( fifo, fifo + excess, pdata->fifo_count * sizeof(float) );
+		}
+	}
+	return output;
+}
+
+static int find_preset( const char *name )
+{
+	int i;
+
+	for ( i = 0; name && i < sizeof( presets ) / sizeof( presets[0] ); i++ )
+		if ( !strcmp( name, presets[i].name ) )
+			return i;
+	return 1;
+}
+
+/** Get the audio.
+*/
+
+static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *format, int *frequency, int *channels, int *samples )
+{
+	mlt_filter filter = mlt_frame_pop_audio( frame );
+	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
+	private_data *pdata = filter->child;
+	int requested_samples = *samples;
+	int output_rate = mlt_properties_get_int( properties, "frequency" );
+
+	// If no resample frequency is specified, default to requested value
+	if ( output_rate <= 0 )
+		output_rate = *frequency;
+
+	int error = mlt_frame_get_audio( frame, buffer, format, frequency, channels, samples );
+	if ( error || output_rate == *frequency || *frequency <= 0 || *channels <= 0 || *samples <= 0 )
+		return error;
+
+	mlt_log_debug( MLT_FILTER_SERVICE(filter), "channels %d samples %d frequency %d -> %d\n",
+		*channels, *samples, *frequency, output_rate );
+
+	if ( *format != mlt_audio_float && frame->convert_audio )
+		frame->convert_audio( frame, buffer, format, mlt_audio_float );
+	if ( *format != mlt_audio_float )
+	{
+		mlt_log_error( MLT_FILTER_SERVICE(filter), "unable to convert %s to float\n", mlt_audio_format_name( *format ) );
+		return 0;
+	}
+
+	pthread_mutex_lock( &pdata->mutex );
+
+	int preset = find_preset( mlt_properties_get( properties, "quality" ) );
+	mlt_position position = mlt_frame_get_position( frame );
+	if ( pdata->in_rate != *frequency || pdata->out_rate != output_rate || pdata->preset != preset || !pdata->coeffs )
+	{
+		pdata->in_rate = *frequency;
+		pdata->out_rate = output_rate;
+		pdata->preset = preset;
+		pdata->channels = *channels;
+		error = configure( pdata );
+		reset( pdata );
+	}
+	else if ( pdata->channels != *channels || position != pdata->expected )
+	{
+		pdata->channels = *channels;
+		reset( pdata );
+	}
+	pdata->expected = position + 1;
+
+	if ( !error )
+		error = process( pdata, *buffer, *samples );
+	if ( !error )
+	{
+		*buffer = deliver( filter, pdata, requested_samples );
+		*samples = requested_samples;
+		*frequency = output_rate;
+		mlt_frame_set_audio( frame, *buffer, mlt_audio_float, mlt_audio_format_size( mlt_audio_float, *samples, *channels ), mlt_pool_release );
+	}
+	else
+	{
+		mlt_log_error( MLT_FILTER_SERVICE(filter), "out of memory %d,%d,%d\n", *frequency, *samples, output_rate );
+		// Start over on the next frame
+		pdata->in_rate = 0;
+	}
+
+	pthread_mutex_unlock( &pdata->mutex );
+
+	return error;
+}
+
+/** Filter processing.
+*/
+
+static mlt_frame filter_process( mlt_filter filter, mlt_frame frame )
+{
+	if ( mlt_frame_is_test_audio( frame ) == 0 )
+	{
+		mlt_frame_push_audio( frame, filter );
+		mlt_frame_push_audio( frame, filter_get_audio );
+	}
+	return frame;
+}
+
+static void filter_close( mlt_filter filter )
+{
+	private_data *pdata = filter->child;
+
+	if ( pdata )
+	{
+		pthread_mutex_destroy( &pdata->mutex );
+		free( pdata->coeffs );
+		free( pdata->history );
+		free( pdata->fifo );
+		free( pdata->offsets );
+		free( pdata->phase_list );
+		free( pdata );
+	}
+	filter->child = NULL;
+	filter->close = NULL;
+	filter->parent.close = NULL;
+	mlt_service_close( &filter->parent );
+}
+
+/** Constructor for the filter.
+*/
+
+mlt_filter filter_audioresample_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg )
+{
+	mlt_filter filter = mlt_filter_new();
+	private_data *pdata = calloc( 1, sizeof( private_data ) );
+
+	if ( filter && pdata )
+	{
+		pthread_mutex_init( &pdata->mutex, NULL );
+		pdata->expected = -1;
+		filter->child = pdata;
+		filter->close = filter_close;
+		filter->process = filter_process;
+		if ( arg )
+			mlt_properties_set_int( MLT_FILTER_PROPERTIES( filter ), "frequency", atoi( arg ) );
+		mlt_properties_set( MLT_FILTER_PROPERTIES( filter ), "quality", "medium" );
+	}
+	else
+	{
+		if ( filter )
+			mlt_filter_close( filter );
+		free( pdata );
+		filter = NULL;
+	}
+	return filter;
+}
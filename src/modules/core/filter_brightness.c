@@ -19,11 +19,66 @@
 
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
+#include <framework/mlt_slices.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 
+struct sliced_desc
+{
+	uint8_t *image;
+	uint8_t *alpha;
+	mlt_image_format format;
+	int width;
+	int height;
+	double level;
+	double alpha_level;
+};
+
+static int sliced_proc( int id, int index, int jobs, void* cookie )
+{
+	(void) id; // unused
+	struct sliced_desc* ctx = ( (struct sliced_desc*) cookie );
+	int slice_line_start, slice_height = mlt_slices_size_slice( jobs, index, ctx->height, &slice_line_start );
+	int slice_pixels = ctx->width * slice_height;
+
+	// Only process if level is something other than 1
+	if ( ctx->level != 1.0 && ctx->format == mlt_image_yuv422 )
+	{
+		int i = slice_pixels + 1;
+		uint8_t *p = ctx->image + slice_line_start * ctx->width * 2;
+		int32_t m = ctx->level * ( 1 << 16 );
+		int32_t n = 128 * ( ( 1 << 16 ) - m );
+
+		while ( --i )
+		{
+			p[0] = CLAMP( (p[0] * m) >> 16, 16, 235 );
+			p[1] = CLAMP( (p[1] * m + n) >> 16, 16, 240 );
+			p += 2;
+		}
+	}
+
+	// Process the alpha channel if requested.
+	if ( ctx->alpha_level != 1.0 )
+	{
+		int32_t m = ctx->alpha_level * ( 1 << 16 );
+		int i = slice_pixels + 1;
+
+		if ( ctx->format == mlt_image_rgb24a ) {
+			uint8_t *p = ctx->image + slice_line_start * ctx->width * 4 + 3;
+			for ( ; --i; p += 4 )
+				p[0] = ( p[0] * m ) >> 16;
+		} else if ( ctx->alpha ) {
+			uint8_t *p = ctx->alpha + slice_line_start * ctx->width;
+			for ( ; --i; ++p )
+				p[0] = ( p[0] * m ) >> 16;
+		}
+	}
+
+	return 0;
+}
+
 /** Do it :-).
 */
 
@@ -66,43 +121,28 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	// Only process if we have no error.
 	if ( error == 0 )
 	{
-		// Only process if level is something other than 1
-		if ( level != 1.0 && *format == mlt_image_yuv422 )
+		struct sliced_desc desc =
 		{
-			int i = *width * *height + 1;
-			uint8_t *p = *image;
-			int32_t m = level * ( 1 << 16 );
-			int32_t n = 128 * ( ( 1 << 16 ) - m );
-
-			while ( --i )
-			{
-				p[0] = CLAMP( (p[0] * m) >> 16, 16, 235 );
-				p[1] = CLAMP( (p[1] * m + n) >> 16, 16, 240 );
-				p += 2;
-			}
-		}
+			.image = *image,
+			.alpha = NULL,
+			.format = *format,
+			.width = *width,
+			.height = *height,
+			.level = level,
+			.alpha_level = 1.0
+		};
 
 		// Process the alpha channel if requested.
 		if ( mlt_properties_get( properties, "alpha" ) )
 		{
 			double alpha = mlt_properties_anim_get_double( properties, "alpha", position, length );
-			alpha = alpha >= 0.0 ? alpha : level;
-			if ( alpha != 1.0 )
-			{
-				int32_t m = alpha * ( 1 << 16 );
-				int i = *width * *height + 1;
-
-				if ( *format == mlt_image_rgb24a ) {
-					uint8_t *p = *image + 3;
-					for ( ; --i; p += 4 )
-						p[0] = ( p[0] * m ) >> 16;
-				} else {
-					uint8_t *p = mlt_frame_get_alpha_mask( frame );
-					for ( ; --i; ++p )
-						p[0] = ( p[0] * m ) >> 16;
-				}
-			}
+			desc.alpha_level = alpha >= 0.0 ? alpha : level;
+			if ( desc.alpha_level != 1.0 && *format != mlt_image_rgb24a )
+				desc.alpha = mlt_frame_get_alpha_mask( frame );
 		}
+
+		if ( ( level != 1.0 && *format == mlt_image_yuv422 ) || desc.alpha_level != 1.0 )
+			mlt_slices_run_normal( 0, sliced_proc, &desc );
 	}
 
 	return error;
@@ -85,6 +85,13 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	{
 		int bpp;
 
+		// Planar 4:2:0 can only be cropped in whole chroma samples.
+		if (*format == mlt_image_yuv420p && frame->convert_image &&
+			(left & 1 || right & 1 || top & 1 || bottom & 1 || *width & 1 || *height & 1))
+		{
+			frame->convert_image( frame, image, format, mlt_image_yuv422 );
+		}
+
 		// Subsampled YUV is messy and less precise.
 		if (*format == mlt_image_yuv422 && frame->convert_image && (left & 1 || right & 1))
 		{
@@ -103,8 +110,26 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 		uint8_t *output = mlt_pool_alloc( size );
 		if ( output )
 		{
-			// Call the generic resize
-			crop( *image, output, bpp, *width, *height, left, right, top, bottom );
+			if ( *format == mlt_image_yuv420p )
+			{
+				uint8_t *in_planes[4], *out_planes[4];
+				int in_strides[4], out_strides[4];
+				int p;
+
+				mlt_image_format_planes( *format, *width, *height, *image, in_planes, in_strides );
+				mlt_image_format_planes( *format, owidth, oheight, output, out_planes, out_strides );
+				for ( p = 0; p < 3; p++ )
+				{
+					int shift = p > 0;
+					crop( in_planes[p], out_planes[p], 1, *width >> shift, *height >> shift,
+						left >> shift, right >> shift, top >> shift, bottom >> shift );
+				}
+			}
+			else
+			{
+				// Call the generic resize
+				crop( *image, output, bpp, *width, *height, left, right, top, bottom );
+			}
 
 			// Now update the frame
 			mlt_frame_set_image( frame, output, size, mlt_pool_release );
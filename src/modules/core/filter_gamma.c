@@ -19,11 +19,36 @@
 
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
+#include <framework/mlt_slices.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 
+struct sliced_desc
+{
+	uint8_t *image;
+	int width;
+	int height;
+	const uint8_t *lookup;
+};
+
+static int sliced_proc( int id, int index, int jobs, void* cookie )
+{
+	(void) id; // unused
+	struct sliced_desc* ctx = ( (struct sliced_desc*) cookie );
+	int slice_line_start, slice_height = mlt_slices_size_slice( jobs, index, ctx->height, &slice_line_start );
+	uint8_t *p = ctx->image + slice_line_start * ctx->width * 2;
+	uint8_t *q = p + slice_height * ctx->width * 2;
+
+	while ( p != q )
+	{
+		*p = ctx->lookup[ *p ];
+		p += 2;
+	}
+	return 0;
+}
+
 /** Do it :-).
 */
 
@@ -44,9 +69,6 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 
 		if ( gamma != 1.0 )
 		{
-			uint8_t *p = *image;
-			uint8_t *q = *image + *width * *height * 2;
-
 			// Calculate the look up table
 			double exp = 1 / gamma;
 			uint8_t lookup[ 256 ];
@@ -55,11 +77,14 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 			for( i = 0; i < 256; i ++ )
 				lookup[ i ] = ( uint8_t )( pow( ( double )i / 255.0, exp ) * 255 );
 
-			while ( p != q )
+			struct sliced_desc desc =
 			{
-				*p = lookup[ *p ];
-				p += 2;
-			}
+				.image = *image,
+				.width = *width,
+				.height = *height,
+				.lookup = lookup
+			};
+			mlt_slices_run_normal( 0, sliced_proc, &desc );
 		}
 	}
 
@@ -19,10 +19,31 @@
 
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
+#include <framework/mlt_slices.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 
+struct sliced_desc
+{
+	uint8_t *image;
+	int width;
+	int height;
+};
+
+static int sliced_proc( int id, int index, int jobs, void* cookie )
+{
+	(void) id; // unused
+	struct sliced_desc* ctx = ( (struct sliced_desc*) cookie );
+	int slice_line_start, slice_height = mlt_slices_size_slice( jobs, index, ctx->height, &slice_line_start );
+	uint8_t *p = ctx->image + slice_line_start * ctx->width * 2;
+	uint8_t *q = p + slice_height * ctx->width * 2;
+
+	while ( p ++ != q )
+		*p ++ = 128;
+	return 0;
+}
+
 /** Do it :-).
 */
 
@@ -32,10 +53,13 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	int error = mlt_frame_get_image( frame, image, format, width, height, 1 );
 	if ( error == 0 )
 	{
-		uint8_t *p = *image;
-		uint8_t *q = *image + *width * *height * 2;
-		while ( p ++ != q )
-			*p ++ = 128;
+		struct sliced_desc desc =
+		{
+			.image = *image,
+			.width = *width,
+			.height = *height
+		};
+		mlt_slices_run_normal( 0, sliced_proc, &desc );
 	}
 	return error;
 }
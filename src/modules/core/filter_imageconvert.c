@@ -257,6 +257,138 @@ static int convert_yuv420p_to_yuv422( uint8_t *yuv420p, uint8_t *yuv, uint8_t *a
 	return ret;
 }
 
+static int convert_yuv422_to_yuv420p( uint8_t *yuv, uint8_t *yuv420p, uint8_t *alpha, int width, int height )
+{
+	int i, j;
+	int half = width >> 1;
+	int stride = width * 2;
+	uint8_t *Y = yuv420p;
+	uint8_t *U = Y + width * height;
+	uint8_t *V = U + width * height / 4;
+
+	for ( i = 0; i < height; i++ )
+	{
+		uint8_t *s = yuv + i * stride;
+		for ( j = 0; j < width; j++ )
+			*Y++ = s[ j << 1 ];
+	}
+	for ( i = 0; i < height / 2; i++ )
+	{
+		// Average the chroma of each pair of lines
+		uint8_t *s0 = yuv + 2 * i * stride;
+		uint8_t *s1 = s0 + stride;
+		for ( j = 0; j < half; j++ )
+		{
+			*U++ = ( s0[ 4 * j + 1 ] + s1[ 4 * j + 1 ] + 1 ) >> 1;
+			*V++ = ( s0[ 4 * j + 3 ] + s1[ 4 * j + 3 ] + 1 ) >> 1;
+		}
+	}
+	return 0;
+}
+
+/** Convert packed RGB with bpp 3 or 4 to planar 4:2:0, optionally extracting alpha.
+*/
+
+static inline void rgb_to_yuv420p( uint8_t *rgb, int bpp, uint8_t *yuv420p, uint8_t *alpha, int width, int height )
+{
+	int i, j;
+	int half = width >> 1;
+	int stride = width * bpp;
+	int y0, u0, v0;
+	int r, g, b;
+	uint8_t *Y = yuv420p;
+	uint8_t *U = Y + width * height;
+	uint8_t *V = U + width * height / 4;
+
+	for ( i = 0; i < height; i++ )
+	{
+		uint8_t *s = rgb + i * stride;
+		for ( j = 0; j < width; j++, s += bpp )
+		{
+			r = s[0];
+			g = s[1];
+			b = s[2];
+			RGB2YUV_601( r, g, b, y0, u0, v0 );
+			*Y++ = y0;
+			if ( alpha )
+				*alpha++ = s[3];
+		}
+	}
+	for ( i = 0; i < height / 2; i++ )
+	{
+		uint8_t *s0 = rgb + 2 * i * stride;
+		uint8_t *s1 = s0 + stride;
+		for ( j = 0; j < half; j++, s0 += 2 * bpp, s1 += 2 * bpp )
+		{
+			// Convert the average of each 2x2 block
+			r = ( s0[0] + s0[bpp] + s1[0] + s1[bpp] + 2 ) >> 2;
+			g = ( s0[1] + s0[bpp + 1] + s1[1] + s1[bpp + 1] + 2 ) >> 2;
+			b = ( s0[2] + s0[bpp + 2] + s1[2] + s1[bpp + 2] + 2 ) >> 2;
+			RGB2UV_601_SCALED( r, g, b, u0, v0 );
+			*U++ = u0;
+			*V++ = v0;
+		}
+	}
+}
+
+static int convert_rgb24_to_yuv420p( uint8_t *rgb, uint8_t *yuv420p, uint8_t *alpha, int width, int height )
+{
+	rgb_to_yuv420p( rgb, 3, yuv420p, NULL, width, height );
+	return 0;
+}
+
+static int convert_rgb24a_to_yuv420p( uint8_t *rgba, uint8_t *yuv420p, uint8_t *alpha, int width, int height )
+{
+	rgb_to_yuv420p( rgba, 4, yuv420p, alpha, width, height );
+	return 0;
+}
+
+/** Convert planar 4:2:0 to packed RGB with bpp 3 or 4, optionally inserting alpha.
+*/
+
+static inline void yuv420p_to_rgb( uint8_t *yuv420p, uint8_t *rgb, int bpp, uint8_t *alpha, int width, int height )
+{
+	int i, j;
+	int half = width >> 1;
+	int yy, uu, vv;
+	int r, g, b;
+	uint8_t *Y = yuv420p;
+	uint8_t *U = Y + width * height;
+	uint8_t *V = U + width * height / 4;
+
+	for ( i = 0; i < height; i++ )
+	{
+		uint8_t *u = U + ( i / 2 ) * half;
+		uint8_t *v = V + ( i / 2 ) * half;
+		uint8_t *d = rgb + i * width * bpp;
+
+		for ( j = 0; j < width; j++, d += bpp )
+		{
+			yy = *Y++;
+			uu = u[ j >> 1 ];
+			vv = v[ j >> 1 ];
+			YUV2RGB_601( yy, uu, vv, r, g, b );
+			d[0] = r;
+			d[1] = g;
+			d[2] = b;
+			if ( bpp == 4 )
+				d[3] = alpha ? *alpha++ : 0xff;
+		}
+	}
+}
+
+static int convert_yuv420p_to_rgb24( uint8_t *yuv420p, uint8_t *rgb, uint8_t *alpha, int width, int height )
+{
+	yuv420p_to_rgb( yuv420p, rgb, 3, NULL, width, height );
+	return 0;
+}
+
+static int convert_yuv420p_to_rgb24a( uint8_t *yuv420p, uint8_t *rgba, uint8_t *alpha, int width, int height )
+{
+	yuv420p_to_rgb( yuv420p, rgba, 4, alpha, width, height );
+	return 0;
+}
+
 static int convert_rgb24_to_rgb24a( uint8_t *rgb, uint8_t *rgba, uint8_t *alpha, int width, int height )
 {
 	uint8_t *s = rgb;
@@ -291,18 +423,346 @@ static int convert_rgb24a_to_rgb24( uint8_t *rgba, uint8_t *rgb, uint8_t *alpha,
 	return 0;
 }
 
+/** These macros are the 16-bit equivalents of the 8-bit 601 scaled macros in mlt_frame.h. */
+#define RGB2YUV_601_SCALED_16(r, g, b, y, u, v)\
+  y = ((263*r + 516*g + 100*b) >> 10) + 4096;\
+  u = ((-152*r - 300*g + 450*b) >> 10) + 32768;\
+  v = ((450*r - 377*g - 73*b) >> 10) + 32768;
+
+#define YUV2RGB_601_SCALED_16( y, u, v, r, g, b ) \
+  r = ((1192 * ( y - 4096 ) + 1634 * ( v - 32768 ) ) >> 10 ); \
+  g = ((1192 * ( y - 4096 ) - 832 * ( v - 32768 ) - 401 * ( u - 32768 ) ) >> 10 ); \
+  b = ((1192 * ( y - 4096 ) + 2066 * ( u - 32768 ) ) >> 10 ); \
+  r = r < 0 ? 0 : r > 65535 ? 65535 : r; \
+  g = g < 0 ? 0 : g > 65535 ? 65535 : g; \
+  b = b < 0 ? 0 : b > 65535 ? 65535 : b;
+
+static int convert_rgb24_to_rgba64( uint8_t *rgb, uint8_t *rgba64, uint8_t *alpha, int width, int height )
+{
+	uint8_t *s = rgb;
+	uint16_t *d = (uint16_t*) rgba64;
+	int total = width * height + 1;
+
+	while ( --total )
+	{
+		*d++ = s[0] * 257;
+		*d++ = s[1] * 257;
+		*d++ = s[2] * 257;
+		*d++ = alpha ? *alpha++ * 257 : 0xffff;
+		s += 3;
+	}
+	return 0;
+}
+
+static int convert_rgb24a_to_rgba64( uint8_t *rgba, uint8_t *rgba64, uint8_t *alpha, int width, int height )
+{
+	uint8_t *s = rgba;
+	uint16_t *d = (uint16_t*) rgba64;
+	int total = width * height * 4 + 1;
+
+	while ( --total )
+		*d++ = *s++ * 257;
+	return 0;
+}
+
+static int convert_yuv422_to_rgba64( uint8_t *yuv, uint8_t *rgba64, uint8_t *alpha, int width, int height )
+{
+	int yy, uu, vv;
+	int r, g, b;
+	uint16_t *d = (uint16_t*) rgba64;
+	int total = width * height / 2 + 1;
+
+	while ( --total )
+	{
+		yy = yuv[0];
+		uu = yuv[1];
+		vv = yuv[3];
+		YUV2RGB_601( yy, uu, vv, r, g, b );
+		d[0] = r * 257;
+		d[1] = g * 257;
+		d[2] = b * 257;
+		d[3] = *alpha++ * 257;
+		yy = yuv[2];
+		YUV2RGB_601( yy, uu, vv, r, g, b );
+		d[4] = r * 257;
+		d[5] = g * 257;
+		d[6] = b * 257;
+		d[7] = *alpha++ * 257;
+		yuv += 4;
+		d += 8;
+	}
+	return 0;
+}
+
+static int convert_rgba64_to_rgb24( uint8_t *rgba64, uint8_t *rgb, uint8_t *alpha, int width, int height )
+{
+	uint16_t *s = (uint16_t*) rgba64;
+	uint8_t *d = rgb;
+	int total = width * height + 1;
+
+	while ( --total )
+	{
+		*d++ = s[0] >> 8;
+		*d++ = s[1] >> 8;
+		*d++ = s[2] >> 8;
+		*alpha++ = s[3] >> 8;
+		s += 4;
+	}
+	return 0;
+}
+
+static int convert_rgba64_to_rgb24a( uint8_t *rgba64, uint8_t *rgba, uint8_t *alpha, int width, int height )
+{
+	uint16_t *s = (uint16_t*) rgba64;
+	uint8_t *d = rgba;
+	int total = width * height * 4 + 1;
+
+	while ( --total )
+		*d++ = *s++ >> 8;
+	return 0;
+}
+
+static int convert_rgba64_to_yuv422( uint8_t *rgba64, uint8_t *yuv, uint8_t *alpha, int width, int height )
+{
+	int y0, y1, u0, u1, v0, v1;
+	int r, g, b;
+	uint16_t *s = (uint16_t*) rgba64;
+	uint8_t *d = yuv;
+	int i, j, n = width / 2 + 1;
+
+	for ( i = 0; i < height; i++ )
+	{
+		j = n;
+		while ( --j )
+		{
+			r = s[0] >> 8;
+			g = s[1] >> 8;
+			b = s[2] >> 8;
+			*alpha++ = s[3] >> 8;
+			RGB2YUV_601( r, g, b, y0, u0 , v0 );
+			r = s[4] >> 8;
+			g = s[5] >> 8;
+			b = s[6] >> 8;
+			*alpha++ = s[7] >> 8;
+			RGB2YUV_601( r, g, b, y1, u1 , v1 );
+			*d++ = y0;
+			*d++ = (u0+u1) >> 1;
+			*d++ = y1;
+			*d++ = (v0+v1) >> 1;
+			s += 8;
+		}
+		if ( width % 2 )
+		{
+			r = s[0] >> 8;
+			g = s[1] >> 8;
+			b = s[2] >> 8;
+			*alpha++ = s[3] >> 8;
+			RGB2YUV_601( r, g, b, y0, u0 , v0 );
+			*d++ = y0;
+			*d++ = u0;
+			s += 4;
+		}
+	}
+	return 0;
+}
+
+/** Convert 16-bit RGBA to 16-bit planar 4:2:2 without going through 8 bits.
+*/
+
+static int convert_rgba64_to_yuv422p16( uint8_t *rgba64, uint8_t *yuv, uint8_t *alpha, int width, int height )
+{
+	int y0, y1, u0, u1, v0, v1;
+	int r, g, b;
+	uint16_t *s = (uint16_t*) rgba64;
+	uint8_t *planes[4];
+	int strides[4];
+	int i, j;
+
+	mlt_image_format_planes( mlt_image_yuv422p16, width, height, yuv, planes, strides );
+	for ( i = 0; i < height; i++ )
+	{
+		uint16_t *Y = (uint16_t*) ( planes[0] + i * strides[0] );
+		uint16_t *U = (uint16_t*) ( planes[1] + i * strides[1] );
+		uint16_t *V = (uint16_t*) ( planes[2] + i * strides[2] );
+
+		for ( j = 0; j < width / 2; j++ )
+		{
+			r = s[0];
+			g = s[1];
+			b = s[2];
+			*alpha++ = s[3] >> 8;
+			RGB2YUV_601_SCALED_16( r, g, b, y0, u0, v0 );
+			r = s[4];
+			g = s[5];
+			b = s[6];
+			*alpha++ = s[7] >> 8;
+			RGB2YUV_601_SCALED_16( r, g, b, y1, u1, v1 );
+			*Y++ = y0;
+			*Y++ = y1;
+			*U++ = ( u0 + u1 ) >> 1;
+			*V++ = ( v0 + v1 ) >> 1;
+			s += 8;
+		}
+		if ( width % 2 )
+		{
+			// The chroma planes have no sample for the last column
+			r = s[0];
+			g = s[1];
+			b = s[2];
+			*alpha++ = s[3] >> 8;
+			RGB2YUV_601_SCALED_16( r, g, b, y0, u0, v0 );
+			*Y++ = y0;
+			s += 4;
+		}
+	}
+	return 0;
+}
+
+static int convert_yuv422p16_to_rgba64( uint8_t *yuv, uint8_t *rgba64, uint8_t *alpha, int width, int height )
+{
+	int yy, uu, vv;
+	int r, g, b;
+	uint16_t *d = (uint16_t*) rgba64;
+	uint8_t *planes[4];
+	int strides[4];
+	int i, j;
+
+	mlt_image_format_planes( mlt_image_yuv422p16, width, height, yuv, planes, strides );
+	for ( i = 0; i < height; i++ )
+	{
+		uint16_t *Y = (uint16_t*) ( planes[0] + i * strides[0] );
+		uint16_t *U = (uint16_t*) ( planes[1] + i * strides[1] );
+		uint16_t *V = (uint16_t*) ( planes[2] + i * strides[2] );
+
+		for ( j = 0; j < width / 2; j++ )
+		{
+			uu = *U++;
+			vv = *V++;
+			yy = *Y++;
+			YUV2RGB_601_SCALED_16( yy, uu, vv, r, g, b );
+			d[0] = r;
+			d[1] = g;
+			d[2] = b;
+			d[3] = *alpha++ * 257;
+			yy = *Y++;
+			YUV2RGB_601_SCALED_16( yy, uu, vv, r, g, b );
+			d[4] = r;
+			d[5] = g;
+			d[6] = b;
+			d[7] = *alpha++ * 257;
+			d += 8;
+		}
+		if ( width % 2 )
+		{
+			// Reuse the chroma of the previous pair for the last column
+			uu = j ? U[-1] : 32768;
+			vv = j ? V[-1] : 32768;
+			yy = *Y++;
+			YUV2RGB_601_SCALED_16( yy, uu, vv, r, g, b );
+			d[0] = r;
+			d[1] = g;
+			d[2] = b;
+			d[3] = *alpha++ * 257;
+			d += 4;
+		}
+	}
+	return 0;
+}
+
+/** Convert planar 4:2:0 to 16-bit RGBA.
+*/
+
+static int convert_yuv420p_to_rgba64( uint8_t *yuv420p, uint8_t *rgba64, uint8_t *alpha, int width, int height )
+{
+	int i, j;
+	int half = width >> 1;
+	int yy, uu, vv;
+	int r, g, b;
+	uint8_t *Y = yuv420p;
+	uint8_t *U = Y + width * height;
+	uint8_t *V = U + width * height / 4;
+	uint16_t *d = (uint16_t*) rgba64;
+
+	for ( i = 0; i < height; i++ )
+	{
+		uint8_t *u = U + ( i / 2 ) * half;
+		uint8_t *v = V + ( i / 2 ) * half;
+
+		for ( j = 0; j < width; j++, d += 4 )
+		{
+			yy = *Y++;
+			uu = u[ j >> 1 ];
+			vv = v[ j >> 1 ];
+			YUV2RGB_601( yy, uu, vv, r, g, b );
+			d[0] = r * 257;
+			d[1] = g * 257;
+			d[2] = b * 257;
+			d[3] = alpha ? *alpha++ * 257 : 0xffff;
+		}
+	}
+	return 0;
+}
+
+/** Convert 16-bit RGBA to planar 4:2:0, extracting alpha.
+*/
+
+static int convert_rgba64_to_yuv420p( uint8_t *rgba64, uint8_t *yuv420p, uint8_t *alpha, int width, int height )
+{
+	int i, j;
+	int half = width >> 1;
+	int stride = width * 4;
+	int y0, u0, v0;
+	int r, g, b;
+	uint16_t *s = (uint16_t*) rgba64;
+	uint8_t *Y = yuv420p;
+	uint8_t *U = Y + width * height;
+	uint8_t *V = U + width * height / 4;
+
+	for ( i = 0; i < width * height; i++, s += 4 )
+	{
+		r = s[0] >> 8;
+		g = s[1] >> 8;
+		b = s[2] >> 8;
+		RGB2YUV_601( r, g, b, y0, u0, v0 );
+		*Y++ = y0;
+		*alpha++ = s[3] >> 8;
+	}
+	for ( i = 0; i < height / 2; i++ )
+	{
+		uint16_t *s0 = (uint16_t*) rgba64 + 2 * i * stride;
+		uint16_t *s1 = s0 + stride;
+		for ( j = 0; j < half; j++, s0 += 8, s1 += 8 )
+		{
+			// Convert the average of each 2x2 block
+			r = ( s0[0] + s0[4] + s1[0] + s1[4] + 512 ) >> 10;
+			g = ( s0[1] + s0[5] + s1[1] + s1[5] + 512 ) >> 10;
+			b = ( s0[2] + s0[6] + s1[2] + s1[6] + 512 ) >> 10;
+			RGB2UV_601_SCALED( r, g, b, u0, v0 );
+			*U++ = u0;
+			*V++ = v0;
+		}
+	}
+	return 0;
+}
+
 typedef int ( *conversion_function )( uint8_t *yuv, uint8_t *rgba, uint8_t *alpha, int width, int height );
 
 static conversion_function conversion_matrix[ mlt_image_invalid - 1 ][ mlt_image_invalid - 1 ] = {
-	{ NULL, convert_rgb24_to_rgb24a, convert_rgb24_to_yuv422, NULL, convert_rgb24_to_rgb24a, NULL },
-	{ convert_rgb24a_to_rgb24, NULL, convert_rgb24a_to_yuv422, NULL, NULL, NULL },
-	{ convert_yuv422_to_rgb24, convert_yuv422_to_rgb24a, NULL, NULL, convert_yuv422_to_rgb24a, NULL },
-	{ NULL, NULL, convert_yuv420p_to_yuv422, NULL, NULL, NULL },
-	{ convert_rgb24a_to_rgb24, NULL, convert_rgb24a_to_yuv422, NULL, NULL, NULL },
-	{ NULL, NULL, NULL, NULL, NULL, NULL },
+	{ NULL, convert_rgb24_to_rgb24a, convert_rgb24_to_yuv422, convert_rgb24_to_yuv420p, convert_rgb24_to_rgb24a, NULL, NULL, NULL, convert_rgb24_to_rgba64 },
+	{ convert_rgb24a_to_rgb24, NULL, convert_rgb24a_to_yuv422, convert_rgb24a_to_yuv420p, NULL, NULL, NULL, NULL, convert_rgb24a_to_rgba64 },
+	{ convert_yuv422_to_rgb24, convert_yuv422_to_rgb24a, NULL, convert_yuv422_to_yuv420p, convert_yuv422_to_rgb24a, NULL, NULL, NULL, convert_yuv422_to_rgba64 },
+	{ convert_yuv420p_to_rgb24, convert_yuv420p_to_rgb24a, convert_yuv420p_to_yuv422, NULL, convert_yuv420p_to_rgb24a, NULL, NULL, NULL, convert_yuv420p_to_rgba64 },
+	{ convert_rgb24a_to_rgb24, NULL, convert_rgb24a_to_yuv422, convert_rgb24a_to_yuv420p, NULL, NULL, NULL, NULL, convert_rgb24a_to_rgba64 },
+	{ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL },
+	{ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL },
+	{ NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, convert_yuv422p16_to_rgba64 },
+	{ convert_rgba64_to_rgb24, convert_rgba64_to_rgb24a, convert_rgba64_to_yuv422, convert_rgba64_to_yuv420p, convert_rgba64_to_rgb24a, NULL, NULL, convert_rgba64_to_yuv422p16, NULL },
 };
 
-static uint8_t bpp_table[4] = { 3, 4, 2, 0 };
+static int has_alpha( mlt_image_format format )
+{
+	return format == mlt_image_rgb24a || format == mlt_image_opengl || format == mlt_image_rgba64;
+}
 
 static int convert_image( mlt_frame frame, uint8_t **buffer, mlt_image_format *format, mlt_image_format requested_format )
 {
@@ -320,24 +780,30 @@ static int convert_image( mlt_frame frame, uint8_t **buffer, mlt_image_format *f
 			width, height );
 		if ( converter )
 		{
-			int size = width * height * bpp_table[ requested_format - 1 ];
+			int size = mlt_image_format_size( requested_format, width, height, NULL );
 			int alpha_size = width * height;
 			uint8_t *image = mlt_pool_alloc( size );
-			uint8_t *alpha = ( *format == mlt_image_rgb24a ||
-			                   *format == mlt_image_opengl )
-			                 ? mlt_pool_alloc( width * height ) : NULL;
-			if ( requested_format == mlt_image_rgb24a || requested_format == mlt_image_opengl )
+			uint8_t *alpha = NULL;
+
+			// The alpha channel moves between the image and the frame's alpha mask
+			// only when exactly one of the formats carries it inline.
+			if ( has_alpha( requested_format ) )
 			{
-				if ( alpha )
-					mlt_pool_release( alpha );
-				alpha = mlt_frame_get_alpha_mask( frame );
-				mlt_properties_get_data( properties, "alpha", &alpha_size );
+				if ( !has_alpha( *format ) )
+				{
+					alpha = mlt_frame_get_alpha_mask( frame );
+					mlt_properties_get_data( properties, "alpha", &alpha_size );
+				}
+			}
+			else if ( has_alpha( *format ) )
+			{
+				alpha = mlt_pool_alloc( width * height );
 			}
 
 			if ( !( error = converter( *buffer, image, alpha, width, height ) ) )
 			{
 				mlt_frame_set_image( frame, image, size, mlt_pool_release );
-				if ( alpha && ( *format == mlt_image_rgb24a || *format == mlt_image_opengl ) )
+				if ( alpha && has_alpha( *format ) && !has_alpha( requested_format ) )
 					mlt_frame_set_alpha( frame, alpha, alpha_size, mlt_pool_release );
 				*buffer = image;
 				*format = requested_format;
@@ -345,7 +811,7 @@ static int convert_image( mlt_frame frame, uint8_t **buffer, mlt_image_format *f
 			else
 			{
 				mlt_pool_release( image );
-				if ( alpha )
+				if ( alpha && has_alpha( *format ) && !has_alpha( requested_format ) )
 					mlt_pool_release( alpha );
 			}
 		}
@@ -20,6 +20,7 @@
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
 #include <framework/mlt_profile.h>
+#include <framework/mlt_slices.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -177,35 +178,66 @@ static inline void obscure_average( uint8_t *start, int width, int height, int s
 }
 
 
-/** The obscurer rendering function...
+/** The obscurer slice context...
 */
 
-static void obscure_render( uint8_t *image, int width, int height, struct geometry_s result )
+struct sliced_desc
 {
-	int area_x = result.x;
-	int area_y = result.y;
-	int area_w = result.w;
-	int area_h = result.h;
+	uint8_t *image;
+	int width;
+	struct geometry_s *result;
+};
+
+/** Render one horizontal band of mask blocks...
+*/
 
-	int mw = result.mask_w;
-	int mh = result.mask_h;
+static int obscure_sliced_proc( int id, int index, int jobs, void* cookie )
+{
+	(void) id; // unused
+	struct sliced_desc* ctx = ( (struct sliced_desc*) cookie );
+	int area_x = ctx->result->x;
+	int area_y = ctx->result->y;
+	int area_w = ctx->result->w;
+	int area_h = ctx->result->h;
+
+	int mw = ctx->result->mask_w;
+	int mh = ctx->result->mask_h;
+	int rows = ( area_h + mh - 1 ) / mh;
+	int row_start, row_count = mlt_slices_size_slice( jobs, index, rows, &row_start );
 	int w;
 	int h;
 	int aw;
 	int ah;
 
-	uint8_t *p = image + area_y * width * 2 + area_x * 2;
+	uint8_t *p = ctx->image + area_y * ctx->width * 2 + area_x * 2;
 
-	for ( w = 0; w < area_w; w += mw )
+	for ( h = row_start * mh; h < ( row_start + row_count ) * mh && h < area_h; h += mh )
 	{
-		for ( h = 0; h < area_h; h += mh )
+		for ( w = 0; w < area_w; w += mw )
 		{
 			aw = w + mw > area_w ? mw - ( w + mw - area_w ) : mw;
 			ah = h + mh > area_h ? mh - ( h + mh - area_h ) : mh;
 			if ( aw > 1 && ah > 1 )
-				obscure_average( p + h * ( width << 1 ) + ( w << 1 ), aw, ah, width << 1 );
+				obscure_average( p + h * ( ctx->width << 1 ) + ( w << 1 ), aw, ah, ctx->width << 1 );
 		}
 	}
+	return 0;
+}
+
+/** The obscurer rendering function...
+*/
+
+static void obscure_render( uint8_t *image, int width, int height, struct geometry_s result )
+{
+	struct sliced_desc desc =
+	{
+		.image = image,
+		.width = width,
+		.result = &result
+	};
+
+	if ( (int) result.w > 0 && (int) result.h > 0 )
+		mlt_slices_run_normal( 0, obscure_sliced_proc, &desc );
 }
 
 /** Do it :-).
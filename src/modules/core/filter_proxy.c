@@ -0,0 +1,344 @@
+/*
+ * filter_proxy.c -- substitute a low resolution proxy for a large source
+ * Copyright (C) 2020 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <framework/mlt.h>
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct
+{
+	pthread_t thread;
+	mlt_profile profile;
+	char *source;
+	char *target;
+	int cancel;
+} *proxy_job;
+
+// The proxy jobs of the session keyed by the file they create
+static mlt_properties jobs = NULL;
+static pthread_mutex_t jobs_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t hash_bytes( uint64_t hash, const void *data, size_t size )
+{
+	const uint8_t *p = data;
+	while ( size-- )
+		hash = ( hash ^ *p++ ) * 1099511628211ULL;
+	return hash;
+}
+
+/** Transcode the source into the proxy file.
+ *
+ * The proxy is written to a temporary file that is only renamed when the
+ * whole source was transcoded, so an interrupted job never leaves a short
+ * proxy behind.
+ */
+
+static void *job_run( void *arg )
+{
+	proxy_job job = arg;
+	char *temp = malloc( strlen( job->target ) + 6 );
+	mlt_producer producer = mlt_factory_producer( job->profile, NULL, job->source );
+	mlt_consumer consumer = NULL;
+	int done = 0;
+
+	sprintf( temp, "%s.part", job->target );
+	if ( producer )
+		consumer = mlt_factory_consumer( job->profile, "avformat", temp );
+	if ( consumer )
+	{
+		mlt_properties properties = MLT_CONSUMER_PROPERTIES( consumer );
+
+		// Every frame of an intra-frame codec is a key frame, which keeps seeking cheap
+		mlt_properties_set( properties, "f", "avi" );
+		mlt_properties_set( properties, "vcodec", "mjpeg" );
+		mlt_properties_set_int( properties, "qscale", 3 );
+		mlt_properties_set_int( properties, "an", 1 );
+		mlt_properties_set_int( properties, "real_time", -1 );
+		mlt_properties_set_int( properties, "terminate_on_pause", 1 );
+
+		// Prevent the proxy filter of the source from using or creating a proxy
+		mlt_properties_set_int( MLT_PRODUCER_PROPERTIES( producer ), "_proxy_job", 1 );
+
+		mlt_consumer_connect( consumer, MLT_PRODUCER_SERVICE( producer ) );
+		mlt_producer_set_speed( producer, 1.0 );
+		mlt_consumer_start( consumer );
+		while ( !job->cancel && !mlt_consumer_is_stopped( consumer ) )
+			usleep( 100000 );
+		mlt_consumer_stop( consumer );
+		done = !job->cancel && mlt_producer_position( producer ) >= mlt_producer_get_out( producer );
+	}
+	else
+	{
+		mlt_log_warning( NULL, "[filter proxy] unable to transcode %s\n", job->source );
+	}
+	mlt_consumer_close( consumer );
+	mlt_producer_close( producer );
+
+	if ( done && !rename( temp, job->target ) )
+		mlt_log_info( NULL, "[filter proxy] created %s for %s\n", job->target, job->source );
+	else
+		remove( temp );
+	free( temp );
+	return NULL;
+}
+
+static void job_close( proxy_job job )
+{
+	job->cancel = 1;
+	pthread_join( job->thread, NULL );
+	mlt_profile_close( job->profile );
+	free( job->source );
+	free( job->target );
+	free( job );
+}
+
+/** Start a background job that creates a proxy unless one already ran in this session.
+ */
+
+static void job_start( mlt_filter filter, const char *source, const char *target, int width, int height )
+{
+	pthread_mutex_lock( &jobs_mutex );
+	if ( !jobs )
+	{
+		jobs = mlt_properties_new();
+		mlt_factory_register_for_clean_up( jobs, ( mlt_destructor )mlt_properties_close );
+	}
+	if ( !mlt_properties_get_data( jobs, target, NULL ) )
+	{
+		proxy_job job = calloc( 1, sizeof( *job ) );
+		job->profile = mlt_profile_clone( mlt_service_profile( MLT_FILTER_SERVICE( filter ) ) );
+		job->source = strdup( source );
+		job->target = strdup( target );
+
+		// The proxy keeps the display aspect of the source with square pixels
+		job->profile->width = width;
+		job->profile->height = height;
+		job->profile->sample_aspect_num = 1;
+		job->profile->sample_aspect_den = 1;
+		job->profile->display_aspect_num = width;
+		job->profile->display_aspect_den = height;
+		job->profile->progressive = 1;
+
+		if ( !pthread_create( &job->thread, NULL, job_run, job ) )
+		{
+			mlt_properties_set_data( jobs, target, job, 0, ( mlt_destructor )job_close, NULL );
+		}
+		else
+		{
+			mlt_profile_close( job->profile );
+			free( job->source );
+			free( job->target );
+			free( job );
+		}
+	}
+	pthread_mutex_unlock( &jobs_mutex );
+}
+
+/** Determine the proxy file and size for the source of a frame.
+ */
+
+static void setup( mlt_filter filter, mlt_frame frame )
+{
+	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
+	mlt_producer source = mlt_frame_get_original_producer( frame );
+	mlt_properties source_properties = source ? MLT_PRODUCER_PROPERTIES( source ) : NULL;
+	mlt_profile profile = mlt_service_profile( MLT_FILTER_SERVICE( filter ) );
+	const char *resource = mlt_properties_get( source_properties, "resource" );
+	const char *directory = mlt_properties_get( properties, "directory" );
+	int width = mlt_properties_get_int( source_properties, "width" );
+	int height = mlt_properties_get_int( source_properties, "height" );
+	double aspect = mlt_properties_get_double( source_properties, "aspect_ratio" );
+	int proxy_height = mlt_properties_get_int( properties, "height" );
+	struct stat info;
+
+	mlt_properties_set_int( properties, "_setup", 1 );
+	if ( !source || mlt_properties_get_int( source_properties, "_proxy_job" ) )
+	{
+		mlt_properties_set_int( properties, "_disabled", 1 );
+		return;
+	}
+	if ( !width || !height )
+	{
+		width = mlt_properties_get_int( source_properties, "meta.media.width" );
+		height = mlt_properties_get_int( source_properties, "meta.media.height" );
+	}
+	if ( aspect <= 0.0 )
+		aspect = 1.0;
+
+	if ( height > proxy_height && proxy_height > 0 )
+	{
+		mlt_properties_set_int( properties, "_width", lrint( proxy_height * width * aspect / height / 2.0 ) * 2 );
+		mlt_properties_set_int( properties, "_height", proxy_height );
+	}
+	if ( mlt_properties_get( properties, "resource" ) )
+		return;
+
+	// Name the proxy after the source file, its modification time and the proxy format
+	if ( resource && directory && mlt_properties_get_int( properties, "_height" ) && !stat( resource, &info ) )
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		char *path = malloc( strlen( directory ) + 22 );
+
+		hash = hash_bytes( hash, resource, strlen( resource ) );
+		hash = hash_bytes( hash, &info.st_mtime, sizeof( info.st_mtime ) );
+		hash = hash_bytes( hash, &info.st_size, sizeof( info.st_size ) );
+		hash = hash_bytes( hash, &proxy_height, sizeof( proxy_height ) );
+		hash = hash_bytes( hash, &profile->frame_rate_num, sizeof( profile->frame_rate_num ) );
+		hash = hash_bytes( hash, &profile->frame_rate_den, sizeof( profile->frame_rate_den ) );
+		sprintf( path, "%s/%016" PRIx64 ".avi", directory, hash );
+		mlt_properties_set( properties, "resource", path );
+		mlt_properties_set( properties, "_source", resource );
+		free( path );
+	}
+	else
+	{
+		mlt_properties_set_int( properties, "_disabled", 1 );
+	}
+}
+
+/** Get the proxy producer, opening it once the proxy file exists.
+ */
+
+static mlt_producer get_proxy( mlt_filter filter )
+{
+	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
+	mlt_producer proxy = mlt_properties_get_data( properties, "_producer", NULL );
+	const char *resource = mlt_properties_get( properties, "resource" );
+
+	if ( proxy || !resource )
+		return proxy;
+
+	if ( !access( resource, R_OK ) )
+	{
+		// The proxy is used as it is, the filters after this one normalise it
+		proxy = mlt_factory_producer( mlt_service_profile( MLT_FILTER_SERVICE( filter ) ), "abnormal", resource );
+		if ( proxy )
+		{
+			mlt_properties proxy_properties = MLT_PRODUCER_PROPERTIES( proxy );
+			mlt_properties_set_data( properties, "_producer", proxy, 0, ( mlt_destructor )mlt_producer_close, NULL );
+			if ( mlt_properties_get_int( proxy_properties, "width" ) > 0 )
+			{
+				mlt_properties_set_int( properties, "_width", mlt_properties_get_int( proxy_properties, "width" ) );
+				mlt_properties_set_int( properties, "_height", mlt_properties_get_int( proxy_properties, "height" ) );
+			}
+		}
+		if ( !proxy || !mlt_properties_get_int( properties, "_height" ) )
+			mlt_properties_set_int( properties, "_disabled", 1 );
+	}
+	else if ( mlt_properties_get_int( properties, "generate" ) && mlt_properties_get( properties, "_source" ) &&
+	          !mlt_properties_get_int( properties, "_started" ) )
+	{
+		mlt_properties_set_int( properties, "_started", 1 );
+		job_start( filter, mlt_properties_get( properties, "_source" ), resource,
+			mlt_properties_get_int( properties, "_width" ), mlt_properties_get_int( properties, "_height" ) );
+	}
+	return proxy;
+}
+
+static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
+{
+	mlt_filter filter = mlt_frame_pop_service( frame );
+	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
+	mlt_properties frame_properties = MLT_FRAME_PROPERTIES( frame );
+	int request_width = mlt_properties_get_int( frame_properties, "rescale_width" );
+	int request_height = mlt_properties_get_int( frame_properties, "rescale_height" );
+	mlt_frame proxy_frame = NULL;
+	int original_width = *width;
+	int original_height = *height;
+	int proxy_width, proxy_height;
+
+	// The rescaler tells what the consumer actually wants
+	if ( request_width <= 0 || request_height <= 0 )
+	{
+		request_width = *width;
+		request_height = *height;
+	}
+
+	mlt_service_lock( MLT_FILTER_SERVICE( filter ) );
+
+	if ( !mlt_properties_get_int( properties, "_setup" ) )
+		setup( filter, frame );
+
+	// Only a consumer that wants no more than the size of the proxy gets the proxy
+	proxy_width = mlt_properties_get_int( properties, "_width" );
+	proxy_height = mlt_properties_get_int( properties, "_height" );
+	if ( !mlt_properties_get_int( properties, "_disabled" ) && request_width > 0 && request_height > 0 &&
+	     ( !proxy_height || ( request_width <= proxy_width && request_height <= proxy_height ) ) )
+	{
+		mlt_producer proxy = get_proxy( filter );
+		proxy_width = mlt_properties_get_int( properties, "_width" );
+		proxy_height = mlt_properties_get_int( properties, "_height" );
+		if ( proxy && request_width <= proxy_width && request_height <= proxy_height )
+		{
+			mlt_producer_seek( proxy, mlt_frame_original_position( frame ) );
+			mlt_service_get_frame( MLT_PRODUCER_SERVICE( proxy ), &proxy_frame, 0 );
+		}
+	}
+
+	mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
+
+	if ( proxy_frame )
+	{
+		*width = proxy_width;
+		*height = proxy_height;
+		if ( !mlt_frame_get_image( proxy_frame, image, format, width, height, writable ) && *image )
+		{
+			// The image belongs to the proxy frame, which lives as long as this frame
+			mlt_properties_set_data( frame_properties, "_proxy_frame", proxy_frame, 0, ( mlt_destructor )mlt_frame_close, NULL );
+			mlt_frame_set_image( frame, *image, 0, NULL );
+			mlt_properties_set_double( frame_properties, "aspect_ratio", mlt_frame_get_aspect_ratio( proxy_frame ) );
+			mlt_properties_set_int( frame_properties, "progressive", 1 );
+			mlt_properties_set_int( frame_properties, "proxy", 1 );
+			return 0;
+		}
+		mlt_frame_close( proxy_frame );
+		*width = original_width;
+		*height = original_height;
+	}
+
+	return mlt_frame_get_image( frame, image, format, width, height, writable );
+}
+
+static mlt_frame filter_process( mlt_filter filter, mlt_frame frame )
+{
+	mlt_frame_push_service( frame, filter );
+	mlt_frame_push_get_image( frame, filter_get_image );
+	return frame;
+}
+
+mlt_filter filter_proxy_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg )
+{
+	mlt_filter filter = mlt_filter_new();
+	if ( filter )
+	{
+		mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
+		const char *directory = arg ? arg : getenv( "MLT_PROXY_DIR" );
+		mlt_properties_set( properties, "directory", directory );
+		mlt_properties_set_int( properties, "height", 540 );
+		mlt_properties_set_int( properties, "generate", 1 );
+		filter->process = filter_process;
+	}
+	return filter;
+}
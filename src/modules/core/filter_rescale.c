@@ -35,6 +35,9 @@
  * rgb24a -> rgb24a
  * rgb24 -> yuv422
  * rgb24a -> yuv422
+ *
+ * and optionally rgba64 -> rgba64 and yuv420p -> yuv420p (even sizes only);
+ * the local fallback scaler is yuv422 only.
  */
 
 typedef int ( *image_scaler )( mlt_frame frame, uint8_t **image, mlt_image_format *format, int iwidth, int iheight, int owidth, int oheight );
@@ -228,9 +231,15 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 			mlt_log_debug( MLT_FILTER_SERVICE( filter ), "%dx%d -> %dx%d (%s) %s\n",
 				iwidth, iheight, owidth, oheight, mlt_image_format_name( *format ), interps );
 
+			// Planar 4:2:0 can only be scaled in whole chroma samples
+			if ( *format == mlt_image_yuv420p && frame->convert_image &&
+			     ( iwidth % 2 || iheight % 2 || owidth % 2 || oheight % 2 ) )
+				frame->convert_image( frame, image, format, mlt_image_yuv422 );
+
 			// If valid colorspace
 			if ( *format == mlt_image_yuv422 || *format == mlt_image_rgb24 ||
-			     *format == mlt_image_rgb24a || *format == mlt_image_opengl )
+			     *format == mlt_image_rgb24a || *format == mlt_image_opengl ||
+			     *format == mlt_image_rgba64 || *format == mlt_image_yuv420p )
 			{
 				// Call the virtual function
 				scaler_method( frame, image, format, iwidth, iheight, owidth, oheight );
@@ -95,6 +95,17 @@ static void resize_image( uint8_t *output, int owidth, int oheight, uint8_t *inp
 			}
 		}
 	}
+	else if ( format == mlt_image_rgba64 )
+	{
+		uint16_t *q = (uint16_t*) p;
+		memset(p, 0, size * bpp);
+		if (alpha_value != 0) {
+			while (size--) {
+				q[3] = alpha_value * 257;
+				q += 4;
+			}
+		}
+	}
 	else if ( bpp == 2 )
 	{
 		memset(p, 16, size * bpp);
@@ -126,6 +137,37 @@ static void resize_image( uint8_t *output, int owidth, int oheight, uint8_t *inp
 	}
 }
 
+/** Pad a planar 4:2:0 image, keeping the offsets on chroma sample boundaries.
+*/
+
+static void resize_image_yuv420p( uint8_t *output, int owidth, int oheight, uint8_t *input, int iwidth, int iheight )
+{
+	uint8_t *out_planes[4], *in_planes[4];
+	int out_strides[4], in_strides[4];
+	int offset_x = ( owidth - iwidth ) / 4 * 2;
+	int offset_y = ( oheight - iheight ) / 4 * 2;
+	int p, i;
+
+	if ( output == NULL || input == NULL )
+		return;
+
+	mlt_image_format_planes( mlt_image_yuv420p, owidth, oheight, output, out_planes, out_strides );
+	mlt_image_format_planes( mlt_image_yuv420p, iwidth, iheight, input, in_planes, in_strides );
+	for ( p = 0; p < 3; p++ )
+	{
+		int shift = p > 0;
+		int x = offset_x >> shift, y = offset_y >> shift;
+		int width = MIN( in_strides[p], out_strides[p] );
+		int rows = MIN( iheight, oheight ) >> shift;
+		uint8_t *out_line = out_planes[p] + MAX( y, 0 ) * out_strides[p] + MAX( x, 0 );
+		uint8_t *in_line = in_planes[p] + MAX( -y, 0 ) * in_strides[p] + MAX( -x, 0 );
+
+		memset( out_planes[p], p ? 128 : 16, out_strides[p] * ( oheight >> shift ) );
+		for ( i = 0; i < rows; i++ )
+			memcpy( out_line + i * out_strides[p], in_line + i * in_strides[p], width );
+	}
+}
+
 /** A padding function for frames - this does not rescale, but simply
 	resizes.
 */
@@ -151,16 +193,20 @@ static uint8_t *frame_resize_image( mlt_frame frame, int owidth, int oheight, ml
 	{
 		uint8_t alpha_value = mlt_properties_get_int( properties, "resize_alpha" );
 		// Create the output image
-		uint8_t *output = mlt_pool_alloc( owidth * ( oheight + 1 ) * bpp );
+		int size = mlt_image_format_size( format, owidth, oheight, NULL );
+		uint8_t *output = mlt_pool_alloc( size );
 
 		// Call the generic resize
-		resize_image( output, owidth, oheight, input, iwidth, iheight, bpp, format, alpha_value );
+		if ( format == mlt_image_yuv420p )
+			resize_image_yuv420p( output, owidth, oheight, input, iwidth, iheight );
+		else
+			resize_image( output, owidth, oheight, input, iwidth, iheight, bpp, format, alpha_value );
 
 		// Now update the frame
-		mlt_frame_set_image( frame, output, owidth * ( oheight + 1 ) * bpp, mlt_pool_release );
+		mlt_frame_set_image( frame, output, size, mlt_pool_release );
 
 		// We should resize the alpha too
-		if ( format != mlt_image_rgb24a && alpha && alpha_size >= iwidth * iheight )
+		if ( format != mlt_image_rgb24a && format != mlt_image_rgba64 && alpha && alpha_size >= iwidth * iheight )
 		{
 			alpha = resize_alpha( alpha, owidth, oheight, iwidth, iheight, alpha_value );
 			if ( alpha )
@@ -264,21 +310,19 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	mlt_properties_set_int( properties, "resize_width", *width );
 	mlt_properties_set_int( properties, "resize_height", *height );
 
-	// If there will be padding, then we need packed image format.
-	if ( *format == mlt_image_yuv420p )
-	{
-		int iwidth = mlt_properties_get_int( properties, "width" );
-		int iheight = mlt_properties_get_int( properties, "height" );
-		if ( iwidth < owidth || iheight < oheight )
-			*format = mlt_image_yuv422;
-	}
+	// Padding a planar image needs whole chroma samples.
+	if ( *format == mlt_image_yuv420p && ( *width % 2 || *height % 2 ) )
+		*format = mlt_image_yuv422;
 
 	// Now get the image
-	if ( *format == mlt_image_yuv422 )
+	if ( *format == mlt_image_yuv422 || *format == mlt_image_yuv420p )
 		owidth -= owidth % 2;
+	if ( *format == mlt_image_yuv420p )
+		oheight -= oheight % 2;
 	error = mlt_frame_get_image( frame, image, format, &owidth, &oheight, writable );
 
-	if ( error == 0 && *image && *format != mlt_image_yuv420p )
+	if ( error == 0 && *image && ( *format != mlt_image_yuv420p ||
+		( owidth % 2 == 0 && oheight % 2 == 0 ) ) )
 	{
 		*image = frame_resize_image( frame, *width, *height, *format );
 	}
@@ -222,6 +222,15 @@ mlt_producer producer_loader_init( mlt_profile profile, mlt_service_type type, c
 	if ( producer != NULL )
 		properties = MLT_PRODUCER_PROPERTIES( producer );
 
+	// Substitute proxies for video files when previewing at a lower resolution.
+	// The proxy must be closest to the producer so that the normalisers scale it.
+	if ( producer && getenv( "MLT_PROXY_DIR" ) && strcmp( id, "abnormal" ) &&
+		!strncmp( mlt_properties_get( properties, "mlt_service" ), "avformat", 8 ) )
+	{
+		int created = 0;
+		create_filter( profile, producer, "proxy", &created );
+	}
+
 	// Attach filters if we have a producer and it isn't already xml'd :-)
 	if ( producer && strcmp( id, "abnormal" ) &&
 		strncmp( arg, "abnormal:", 9 ) &&
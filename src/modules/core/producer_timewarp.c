@@ -59,25 +59,31 @@ static void timewarp_property_changed( mlt_service owner, mlt_producer producer,
 	}
 }
 
-static void clip_property_changed( mlt_service owner, mlt_producer producer, char *name )
+static void clip_properties_changed( mlt_service owner, mlt_producer producer, mlt_properties names )
 {
 	private_data* pdata = (private_data*)producer->child;
-	if ( mlt_properties_get_int( pdata->clip_parameters, name ) ||
-		 !strcmp( name, "length" ) ||
-		 !strcmp( name, "in" ) ||
-		 !strcmp( name, "out" ) ||
-		 !strcmp( name, "ignore_points" ) ||
-		 !strcmp( name, "eof" ) ||
-		 !strncmp( name, "meta.", 5 ) )
+	mlt_properties producer_properties = MLT_PRODUCER_PROPERTIES( producer );
+	mlt_properties clip_properties = MLT_PRODUCER_PROPERTIES( pdata->clip_producer );
+	int i;
+
+	mlt_events_block( producer_properties, producer );
+	for ( i = 0; i < mlt_properties_count( names ); i++ )
 	{
-		// The encapsulated clip producer might change its own parameters.
-		// Pass those changes to this producer.
-		mlt_properties producer_properties = MLT_PRODUCER_PROPERTIES( producer );
-		mlt_properties clip_properties = MLT_PRODUCER_PROPERTIES( pdata->clip_producer );
-		mlt_events_block( producer_properties, producer );
-		mlt_properties_pass_property( producer_properties, clip_properties, name );
-		mlt_events_unblock( producer_properties, producer );
+		const char *name = mlt_properties_get_name( names, i );
+		if ( mlt_properties_get_int( pdata->clip_parameters, name ) ||
+			 !strcmp( name, "length" ) ||
+			 !strcmp( name, "in" ) ||
+			 !strcmp( name, "out" ) ||
+			 !strcmp( name, "ignore_points" ) ||
+			 !strcmp( name, "eof" ) ||
+			 !strncmp( name, "meta.", 5 ) )
+		{
+			// The encapsulated clip producer might change its own parameters.
+			// Pass those changes to this producer.
+			mlt_properties_pass_property( producer_properties, clip_properties, name );
+		}
 	}
+	mlt_events_unblock( producer_properties, producer );
 }
 
 static int producer_get_audio( mlt_frame frame, void** buffer, mlt_audio_format* format, int* frequency, int* channels, int* samples )
@@ -310,7 +316,7 @@ mlt_producer producer_timewarp_init( mlt_profile profile, mlt_service_type type,
 
 			// Monitor property changes from both producers so that the clip
 			// parameters can be passed back and forth.
-			mlt_events_listen( clip_properties, producer, "property-changed", ( mlt_listener )clip_property_changed );
+			mlt_events_listen( clip_properties, producer, "properties-changed", ( mlt_listener )clip_properties_changed );
 			mlt_events_listen( producer_properties, producer, "property-changed", ( mlt_listener )timewarp_property_changed );
 		}
 	}
@@ -312,6 +312,54 @@ static void composite_line_yuv_xor( uint8_t *dest, uint8_t *src, int width, uint
 	}
 }
 
+/** Composite a 16-bit RGBA source line over a destination line.
+
+    The alpha channels are inline, so alpha_b and alpha_a are not used.
+    operator is 0 = over, 1 = or, 2 = and, 3 = xor as for the yuv422 lines.
+*/
+
+static inline void composite_line_rgba64_op( uint8_t *dest8, uint8_t *src8, int width, int weight, uint16_t *luma, int soft, uint32_t step, int operator )
+{
+	uint16_t *dest = (uint16_t*) dest8;
+	uint16_t *src = (uint16_t*) src8;
+	int j;
+
+	for ( j = 0; j < width; j++, dest += 4, src += 4 )
+	{
+		uint32_t alpha = operator == 0 ? src[3] :
+		                 operator == 1 ? src[3] | dest[3] :
+		                 operator == 2 ? src[3] & dest[3] : src[3] ^ dest[3];
+		uint32_t mix = ( (uint64_t) ( luma ? smoothstep( luma[ j ], luma[ j ] + soft, step ) : weight ) * ( alpha + 1 ) ) >> 16;
+		dest[0] = ( src[0] * mix + dest[0] * ( ( 1 << 16 ) - mix ) ) >> 16;
+		dest[1] = ( src[1] * mix + dest[1] * ( ( 1 << 16 ) - mix ) ) >> 16;
+		dest[2] = ( src[2] * mix + dest[2] * ( ( 1 << 16 ) - mix ) ) >> 16;
+		if ( operator == 0 )
+			dest[3] |= mix - ( mix >> 16 );
+		else
+			dest[3] = mix - ( mix >> 16 );
+	}
+}
+
+static void composite_line_rgba64( uint8_t *dest, uint8_t *src, int width, uint8_t *alpha_b, uint8_t *alpha_a, int weight, uint16_t *luma, int soft, uint32_t step )
+{
+	composite_line_rgba64_op( dest, src, width, weight, luma, soft, step, 0 );
+}
+
+static void composite_line_rgba64_or( uint8_t *dest, uint8_t *src, int width, uint8_t *alpha_b, uint8_t *alpha_a, int weight, uint16_t *luma, int soft, uint32_t step )
+{
+	composite_line_rgba64_op( dest, src, width, weight, luma, soft, step, 1 );
+}
+
+static void composite_line_rgba64_and( uint8_t *dest, uint8_t *src, int width, uint8_t *alpha_b, uint8_t *alpha_a, int weight, uint16_t *luma, int soft, uint32_t step )
+{
+	composite_line_rgba64_op( dest, src, width, weight, luma, soft, step, 2 );
+}
+
+static void composite_line_rgba64_xor( uint8_t *dest, uint8_t *src, int width, uint8_t *alpha_b, uint8_t *alpha_a, int weight, uint16_t *luma, int soft, uint32_t step )
+{
+	composite_line_rgba64_op( dest, src, width, weight, luma, soft, step, 3 );
+}
+
 struct sliced_composite_desc
 {
 	int height_src;
@@ -360,14 +408,13 @@ static int sliced_composite_proc( int id, int idx, int jobs, void* cookie )
 /** Composite function.
 */
 
-static int composite_yuv( uint8_t *p_dest, int width_dest, int height_dest, uint8_t *p_src, int width_src, int height_src, uint8_t *alpha_b, uint8_t *alpha_a, struct geometry_s geometry, int field, uint16_t *p_luma, double softness, composite_line_fn line_fn, int sliced )
+static int composite_yuv( uint8_t *p_dest, int width_dest, int height_dest, uint8_t *p_src, int width_src, int height_src, uint8_t *alpha_b, uint8_t *alpha_a, struct geometry_s geometry, int field, uint16_t *p_luma, double softness, composite_line_fn line_fn, int sliced, int bpp )
 {
 	int ret = 0;
 	int i;
 	int x_src = -geometry.x_src, y_src = -geometry.y_src;
 	int uneven_x_src = ( x_src % 2 );
 	int step = ( field > -1 ) ? 2 : 1;
-	int bpp = 2;
 	int stride_src = geometry.sw * bpp;
 	int stride_dest = width_dest * bpp;
 	int i_softness = ( 1 << 16 ) * softness;
@@ -473,7 +520,7 @@ static int composite_yuv( uint8_t *p_dest, int width_dest, int height_dest, uint
 	int alpha_a_stride = stride_dest / bpp;
 
 	// Align chroma of source and destination
-	if ( uneven_x != uneven_x_src )
+	if ( bpp == 2 && uneven_x != uneven_x_src )
 	{
 		p_src += 2;
 		if ( alpha_b )
@@ -720,10 +767,9 @@ static uint16_t* get_luma( mlt_transition self, mlt_properties properties, int w
 /** Get the properly sized image from b_frame.
 */
 
-static int get_b_frame_image( mlt_transition self, mlt_frame b_frame, uint8_t **image, int *width, int *height, struct geometry_s *geometry )
+static int get_b_frame_image( mlt_transition self, mlt_frame b_frame, uint8_t **image, mlt_image_format format, int *width, int *height, struct geometry_s *geometry )
 {
 	int error = 0;
-	mlt_image_format format = mlt_image_yuv422;
 
 	// Get the properties objects
 	mlt_properties b_props = MLT_FRAME_PROPERTIES( b_frame );
@@ -838,13 +884,19 @@ static int get_b_frame_image( mlt_transition self, mlt_frame b_frame, uint8_t **
 
 	// Adjust to consumer scale
 	*width = rint( geometry->sw * *width / geometry->nw );
-	*width -= *width % 2; // coerce to even width for yuv422
+	if ( format == mlt_image_yuv422 )
+		*width -= *width % 2; // coerce to even width for yuv422
 	*height = rint( geometry->sh * *height / geometry->nh );
 // fprintf(stderr, "%s: scaled %dx%d norm %dx%d resize %dx%d\n", __FILE__,
 // geometry->sw, geometry->sh, geometry->nw, geometry->nh, *width, *height);
 
+	mlt_image_format requested_format = format;
 	error = mlt_frame_get_image( b_frame, image, &format, width, height, 1 );
 
+	// The compositing line functions only handle the requested format
+	if ( !error && format != requested_format )
+		error = 1;
+
 	// composite_yuv uses geometry->sw to determine source stride, which
 	// should equal the image width if not using crop property.
 	if ( !mlt_properties_get( properties, "crop" ) )
@@ -1083,6 +1135,19 @@ mlt_frame composite_copy_region( mlt_transition self, mlt_frame a_frame, mlt_pos
 /** Get the image.
 */
 
+/** Set the inline alpha channel of a 16-bit RGBA image from an 8-bit value.
+*/
+
+static void fill_alpha_rgba64( uint8_t *image, int count, int value )
+{
+	uint16_t *p = (uint16_t*) image + 3;
+	while ( count-- )
+	{
+		*p = value * 257;
+		p += 4;
+	}
+}
+
 static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
 {
 	// Get the b frame from the stack
@@ -1114,8 +1179,10 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 		b_frame = c;
 	}
 
-	// This compositer is yuv422 only
-	*format = mlt_image_yuv422;
+	// This compositer is yuv422 only, or rgba64 when requested
+	if ( *format != mlt_image_rgba64 )
+		*format = mlt_image_yuv422;
+	int bpp = *format == mlt_image_rgba64 ? 8 : 2;
 
 	if ( b_frame != NULL )
 	{
@@ -1168,14 +1235,23 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 		if ( a_frame == b_frame )
 		{
 			double aspect_ratio = mlt_frame_get_aspect_ratio( b_frame );
-			get_b_frame_image( self, b_frame, &image_b, &width_b, &height_b, &result );
-			alpha_b = mlt_frame_get_alpha( b_frame );
+			get_b_frame_image( self, b_frame, &image_b, *format, &width_b, &height_b, &result );
+			alpha_b = bpp == 2 ? mlt_frame_get_alpha( b_frame ) : NULL;
 			mlt_properties_set_double( a_props, "aspect_ratio", aspect_ratio );
 		}
 
 		// Get the image from the a frame
 		mlt_frame_get_image( a_frame, image, format, width, height, 1 );
-		alpha_a = mlt_frame_get_alpha( a_frame );
+		if ( bpp == 8 && *format != mlt_image_rgba64 )
+		{
+			// The a frame did not deliver rgba64, so fall back to yuv422
+			*format = mlt_image_yuv422;
+			bpp = 2;
+			image_b = NULL;
+			alpha_b = NULL;
+			mlt_frame_get_image( a_frame, image, format, width, height, 1 );
+		}
+		alpha_a = bpp == 2 ? mlt_frame_get_alpha( a_frame ) : NULL;
 
 		// Optimisation - no compositing required
 		if ( result.item.mix == 0 || ( result.item.w == 0 && result.item.h == 0 ) )
@@ -1205,7 +1281,7 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 		}
 
 		if ( *image != image_b && ( image_b ||
-			get_b_frame_image( self, b_frame, &image_b, &width_b, &height_b, &result ) ) )
+			get_b_frame_image( self, b_frame, &image_b, *format, &width_b, &height_b, &result ) ) )
 		{
 			int progressive = 
 					mlt_properties_get_int( a_props, "consumer_deinterlace" ) ||
@@ -1220,27 +1296,37 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 			mlt_service_unlock( MLT_TRANSITION_SERVICE( self ) );
 			char *operator = mlt_properties_get( properties, "operator" );
 
-			alpha_b = alpha_b == NULL ? mlt_frame_get_alpha( b_frame ) : alpha_b;
+			alpha_b = alpha_b == NULL && bpp == 2 ? mlt_frame_get_alpha( b_frame ) : alpha_b;
 
-			composite_line_fn line_fn = composite_line_yuv;
+			composite_line_fn line_fn = bpp == 2 ? composite_line_yuv : composite_line_rgba64;
 
 			// Replacement and override
 			if ( operator != NULL )
 			{
 				if ( !strcmp( operator, "or" ) )
-					line_fn = composite_line_yuv_or;
+					line_fn = bpp == 2 ? composite_line_yuv_or : composite_line_rgba64_or;
 				if ( !strcmp( operator, "and" ) )
-					line_fn = composite_line_yuv_and;
+					line_fn = bpp == 2 ? composite_line_yuv_and : composite_line_rgba64_and;
 				if ( !strcmp( operator, "xor" ) )
-					line_fn = composite_line_yuv_xor;
+					line_fn = bpp == 2 ? composite_line_yuv_xor : composite_line_rgba64_xor;
 			}
 
 			// Allow the user to completely obliterate the alpha channels from both frames
-			if ( mlt_properties_get( properties, "alpha_a" ) && alpha_a )
-				memset( alpha_a, mlt_properties_get_int( properties, "alpha_a" ), *width * *height );
+			if ( mlt_properties_get( properties, "alpha_a" ) )
+			{
+				if ( alpha_a )
+					memset( alpha_a, mlt_properties_get_int( properties, "alpha_a" ), *width * *height );
+				else if ( bpp == 8 )
+					fill_alpha_rgba64( *image, *width * *height, mlt_properties_get_int( properties, "alpha_a" ) );
+			}
 
-			if ( mlt_properties_get( properties, "alpha_b" ) && alpha_b )
-				memset( alpha_b, mlt_properties_get_int( properties, "alpha_b" ), width_b * height_b );
+			if ( mlt_properties_get( properties, "alpha_b" ) )
+			{
+				if ( alpha_b )
+					memset( alpha_b, mlt_properties_get_int( properties, "alpha_b" ), width_b * height_b );
+				else if ( bpp == 8 )
+					fill_alpha_rgba64( image_b, width_b * height_b, mlt_properties_get_int( properties, "alpha_b" ) );
+			}
 
 			for ( field = 0; field < ( progressive ? 1 : 2 ); field++ )
 			{
@@ -1292,7 +1378,7 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 
 				// Composite the b_frame on the a_frame
 				mlt_log_timings_begin()
-				composite_yuv( *image, *width, *height, image_b, width_b, height_b, alpha_b, alpha_a, result, field_id, luma_bitmap, luma_softness, line_fn, sliced );
+				composite_yuv( *image, *width, *height, image_b, width_b, height_b, alpha_b, alpha_a, result, field_id, luma_bitmap, luma_softness, line_fn, sliced, bpp );
 				mlt_log_timings_end( NULL, "composite_yuv" )
 			}
 		}
@@ -71,6 +71,57 @@ static void composite_line_yuv_float( uint8_t *dest, uint8_t *src, int width, ui
 	}
 }
 
+static inline int is_opaque_rgba64( uint8_t *image, int width, int height )
+{
+	uint16_t *p = (uint16_t*) image + 3;
+	int n = width * height + 1;
+	while ( --n )
+	{
+		if ( *p != 0xffff ) return 0;
+		p += 4;
+	}
+	return 1;
+}
+
+/** Mix one 16-bit RGBA pixel over another with alpha, the same as composite_line_yuv_float.
+*/
+
+static inline void sample_mix_rgba64( uint16_t *dest, const uint16_t *src, float weight )
+{
+	float mix_a = ( 1.0f - weight ) * dest[3] / 65535.f;
+	float mix_b = weight * src[3] / 65535.f;
+	float mix2 = mix_b + mix_a - mix_b * mix_a;
+	dest[3] = 65535 * mix2;
+	if ( mix2 != 0.f ) mix_b /= mix2;
+	dest[0] = src[0] * mix_b + dest[0] * ( 1.f - mix_b );
+	dest[1] = src[1] * mix_b + dest[1] * ( 1.f - mix_b );
+	dest[2] = src[2] * mix_b + dest[2] * ( 1.f - mix_b );
+}
+
+static void composite_line_rgba64( uint16_t *dest, const uint16_t *src, int width, float weight, int alpha_over )
+{
+	int j;
+
+	if ( alpha_over )
+	{
+		for ( j = 0; j < width; j++, dest += 4, src += 4 )
+			sample_mix_rgba64( dest, src, weight );
+	}
+	else
+	{
+		// Weight by the source alpha like composite_line_yuv
+		uint32_t weight_i = weight * ( 1 << 16 );
+		for ( j = 0; j < width; j++, dest += 4, src += 4 )
+		{
+			uint32_t mix = ( (uint64_t) weight_i * ( src[3] + 1 ) ) >> 16;
+			dest[0] = ( src[0] * mix + dest[0] * ( ( 1 << 16 ) - mix ) ) >> 16;
+			dest[1] = ( src[1] * mix + dest[1] * ( ( 1 << 16 ) - mix ) ) >> 16;
+			dest[2] = ( src[2] * mix + dest[2] * ( ( 1 << 16 ) - mix ) ) >> 16;
+			dest[3] |= mix - ( mix >> 16 );
+		}
+	}
+}
+
 struct dissolve_slice_context {
 	uint8_t *dst_image;
 	uint8_t *src_image;
@@ -104,6 +155,60 @@ static int dissolve_slice( int id, int index, int count, void *context )
 	return 0;
 }
 
+struct dissolve_rgba64_context {
+	uint16_t *dst_image;
+	uint16_t *src_image;
+	int dst_width;
+	int src_width;
+	int width;
+	int height;
+	float weight;
+	int alpha_over;
+};
+
+static int dissolve_rgba64_slice( int id, int index, int count, void *context )
+{
+	struct dissolve_rgba64_context *ctx = (struct dissolve_rgba64_context*) context;
+	int slice_line_start, slice_height = mlt_slices_size_slice( count, index, ctx->height, &slice_line_start );
+	int i;
+
+	for ( i = slice_line_start; i < slice_line_start + slice_height; i++ )
+		composite_line_rgba64( ctx->dst_image + i * ctx->dst_width * 4, ctx->src_image + i * ctx->src_width * 4,
+			ctx->width, ctx->weight, ctx->alpha_over );
+	return 0;
+}
+
+/** Dissolve 16-bit RGBA images, which carry their alpha channel inline.
+*/
+
+static int dissolve_rgba64( mlt_frame frame, mlt_frame that, float weight, int width, int height, int threads, int alpha_over )
+{
+	int width_src = width, height_src = height;
+	mlt_image_format format = mlt_image_rgba64;
+	uint8_t *p_src = NULL, *p_dest = NULL;
+
+	if ( mlt_properties_get( &frame->parent, "distort" ) )
+		mlt_properties_set( &that->parent, "distort", mlt_properties_get( &frame->parent, "distort" ) );
+	mlt_frame_get_image( frame, &p_dest, &format, &width, &height, 1 );
+	mlt_frame_get_image( that, &p_src, &format, &width_src, &height_src, 0 );
+	if ( !p_dest || !p_src || format != mlt_image_rgba64 )
+		return 1;
+
+	struct dissolve_rgba64_context context = {
+		.dst_image = (uint16_t*) p_dest,
+		.src_image = (uint16_t*) p_src,
+		.dst_width = width,
+		.src_width = width_src,
+		.width = MIN( width, width_src ),
+		.height = MIN( height, height_src ),
+		.weight = weight,
+		.alpha_over = alpha_over && ( !is_opaque_rgba64( p_dest, width, height ) || !is_opaque_rgba64( p_src, width_src, height_src ) )
+	};
+	mlt_slices_run_normal( threads, dissolve_rgba64_slice, &context );
+
+	return 0;
+}
+
 static inline int dissolve_yuv( mlt_frame frame, mlt_frame that, float weight, int width, int height, int threads, int alpha_over )
 {
 	int ret = 0;
@@ -156,6 +261,66 @@ static inline int dissolve_yuv( mlt_frame frame, mlt_frame that, float weight, i
 	return ret;
 }
 
+/** Dissolve planar 4:2:0 images without a round trip through 4:2:2.
+ *
+ * Chroma samples are weighted by the alpha of the top-left pixel of their
+ * block, like the even pixel of a 4:2:2 pair. Translucent alpha_over
+ * dissolves and odd dimensions are left to the 4:2:2 path, in which case
+ * this returns non-zero.
+*/
+
+static int dissolve_yuv420p( mlt_frame frame, mlt_frame that, float weight, int width, int height, int alpha_over )
+{
+	int width_src = width, height_src = height;
+	mlt_image_format format = mlt_image_yuv420p;
+	uint8_t *p_src = NULL, *p_dest = NULL;
+	uint8_t *dest_planes[4], *src_planes[4];
+	int dest_strides[4], src_strides[4];
+	int mix = weight * ( 1 << 16 );
+	int p, x, y;
+
+	if ( mlt_properties_get( &frame->parent, "distort" ) )
+		mlt_properties_set( &that->parent, "distort", mlt_properties_get( &frame->parent, "distort" ) );
+	mlt_frame_get_image( frame, &p_dest, &format, &width, &height, 1 );
+	if ( !p_dest || format != mlt_image_yuv420p )
+		return 1;
+	mlt_frame_get_image( that, &p_src, &format, &width_src, &height_src, 0 );
+	if ( !p_src || format != mlt_image_yuv420p || ( width | height | width_src | height_src ) & 1 )
+		return 1;
+
+	uint8_t *alpha_dst = mlt_frame_get_alpha( frame );
+	uint8_t *alpha_src = mlt_frame_get_alpha( that );
+	if ( alpha_over && ( ( alpha_dst && !is_opaque( alpha_dst, width, height ) )
+	                  || ( alpha_src && !is_opaque( alpha_src, width_src, height_src ) ) ) )
+		return 1;
+
+	mlt_image_format_planes( format, width, height, p_dest, dest_planes, dest_strides );
+	mlt_image_format_planes( format, width_src, height_src, p_src, src_planes, src_strides );
+	width_src = MIN( width, width_src );
+	height_src = MIN( height, height_src );
+
+	for ( p = 0; p < 3; p++ )
+	{
+		int shift = p > 0;
+		for ( y = 0; y < height_src >> shift; y++ )
+		{
+			uint8_t *d = dest_planes[p] + y * dest_strides[p];
+			uint8_t *s = src_planes[p] + y * src_strides[p];
+			uint8_t *a_src = alpha_src ? alpha_src + ( y << shift ) * src_strides[0] : NULL;
+			uint8_t *a_dst = alpha_dst && !p ? alpha_dst + y * width : NULL;
+			for ( x = 0; x < width_src >> shift; x++ )
+			{
+				int m = ( mix * ( ( a_src ? a_src[ x << shift ] : 255 ) + 1 ) ) >> 8;
+				d[x] = ( s[x] * m + d[x] * ( ( 1 << 16 ) - m ) ) >> 16;
+				if ( a_dst )
+					a_dst[x] |= m >> 8;
+			}
+		}
+	}
+
+	return 0;
+}
+
 /** A smoother, non-linear threshold determination function.
 */
 
@@ -308,6 +473,103 @@ static void luma_composite( mlt_frame a_frame, mlt_frame b_frame, int luma_width
 	}
 }
 
+/** The 16-bit RGBA version of luma_composite - the alpha channel is inline and,
+    as in luma_composite, the result alpha goes to the source image when inverted.
+*/
+static void luma_composite_rgba64( mlt_frame a_frame, mlt_frame b_frame, int luma_width, int luma_height,
+							uint16_t *luma_bitmap, float pos, float frame_delta, float softness, int field_order,
+							int *width, int *height, int invert )
+{
+	int width_src = *width, height_src = *height;
+	int width_dest = *width, height_dest = *height;
+	mlt_image_format format_src = mlt_image_rgba64, format_dest = mlt_image_rgba64;
+	uint8_t *p_src = NULL, *p_dest = NULL;
+	int i, j;
+
+	if ( mlt_properties_get( &a_frame->parent, "distort" ) )
+		mlt_properties_set( &b_frame->parent, "distort", mlt_properties_get( &a_frame->parent, "distort" ) );
+	mlt_frame_get_image( a_frame, &p_dest, &format_dest, &width_dest, &height_dest, 1 );
+	mlt_frame_get_image( b_frame, &p_src, &format_src, &width_src, &height_src, invert );
+
+	if ( *width == 0 || *height == 0 || !p_src || !p_dest ||
+	     format_src != mlt_image_rgba64 || format_dest != mlt_image_rgba64 )
+		return;
+
+	int is_translucent = !is_opaque_rgba64( p_dest, width_dest, height_dest )
+	                  || !is_opaque_rgba64( p_src, width_src, height_src );
+
+	// Pick the lesser of two evils ;-)
+	width_src = width_src > width_dest ? width_dest : width_src;
+	height_src = height_src > height_dest ? height_dest : height_src;
+
+	int stride_src = width_src * 4;
+	int stride_dest = width_dest * 4;
+
+	// Offset the position based on which field we're looking at ...
+	float field_pos[ 2 ];
+	field_pos[ 0 ] = ( pos + ( ( field_order == 0 ? 1 : 0 ) * frame_delta * 0.5f ) ) * ( 1.f + softness );
+	field_pos[ 1 ] = ( pos + ( ( field_order == 0 ? 0 : 1 ) * frame_delta * 0.5f ) ) * ( 1.f + softness );
+
+	int32_t x_diff = ( luma_width << 16 ) / *width;
+	int32_t y_diff = ( luma_height << 16 ) / *height;
+	uint32_t i_softness = softness * ( 1 << 16 );
+	int field_count = field_order < 0 ? 1 : 2;
+	int field;
+
+	for ( field = 0; field < field_count; field++ )
+	{
+		uint16_t *p_row = (uint16_t*) p_src + field * stride_src;
+		uint16_t *q_row = (uint16_t*) p_dest + field * stride_dest;
+		int32_t y_offset = field << 16;
+
+		for ( i = field; i < height_src; i += field_count )
+		{
+			uint16_t *p = p_row;
+			uint16_t *q = q_row;
+			uint16_t *l = luma_bitmap + ( y_offset >> 16 ) * ( luma_width * field_count );
+			int32_t x_offset = 0;
+
+			if ( is_translucent )
+			{
+				for ( j = 0; j < width_src; j++, p += 4, q += 4, x_offset += x_diff )
+				{
+					float weight = l[ x_offset >> 16 ] / 65535.f;
+					float value = smoothstep_float( weight, softness + weight, field_pos[ field ] );
+					if ( invert )
+					{
+						float mix_a = ( 1.0f - value ) * q[3] / 65535.f;
+						float mix_b = value * p[3] / 65535.f;
+						float mix2 = mix_b + mix_a - mix_b * mix_a;
+						p[3] = 65535 * mix2;
+						if ( mix2 != 0.f ) mix_b /= mix2;
+						q[0] = p[0] * mix_b + q[0] * ( 1.f - mix_b );
+						q[1] = p[1] * mix_b + q[1] * ( 1.f - mix_b );
+						q[2] = p[2] * mix_b + q[2] * ( 1.f - mix_b );
+					}
+					else
+					{
+						sample_mix_rgba64( q, p, value );
+					}
+				}
+			}
+			else
+			{
+				for ( j = 0; j < width_src * 4; j += 4, x_offset += x_diff )
+				{
+					uint16_t weight = l[ x_offset >> 16 ];
+					uint32_t value = smoothstep( weight, i_softness + weight, (1 << 16) * field_pos[ field ] );
+					q[j + 0] = ( p[j + 0] * value + q[j + 0] * ((1 << 16) - value) ) >> 16;
+					q[j + 1] = ( p[j + 1] * value + q[j + 1] * ((1 << 16) - value) ) >> 16;
+					q[j + 2] = ( p[j + 2] * value + q[j + 2] * ((1 << 16) - value) ) >> 16;
+				}
+			}
+			y_offset += y_diff;
+			p_row += field_count * stride_src;
+			q_row += field_count * stride_dest;
+		}
+	}
+}
+
 void yuv422_to_luma16(uint8_t *image, uint16_t **map, int width, int height, int full_range)
 {
 	// allocate the luma bitmap
@@ -344,8 +606,9 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 	// Get the properties of the b frame
 	mlt_properties b_props = MLT_FRAME_PROPERTIES( b_frame );
 
-	// This compositer is yuv422 only
-	*format = mlt_image_yuv422;
+	// This compositer is yuv422 only, or rgba64 and planar yuv420p when requested
+	if ( *format != mlt_image_rgba64 && *format != mlt_image_yuv420p )
+		*format = mlt_image_yuv422;
 
 	mlt_service_lock( MLT_TRANSITION_SERVICE( transition ) );
 
@@ -532,15 +795,26 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 		mix = reverse ? 1 - mix : mix;
 		frame_delta *= reverse ? -1.0 : 1.0;
 		// Composite the frames using a luma map
-		luma_composite( !invert ? a_frame : b_frame, !invert ? b_frame : a_frame, luma_width, luma_height, luma_bitmap, mix, frame_delta,
-			luma_softness, progressive ? -1 : top_field_first, width, height, invert );
+		if ( *format == mlt_image_yuv420p )
+			*format = mlt_image_yuv422;
+		if ( *format == mlt_image_rgba64 )
+			luma_composite_rgba64( !invert ? a_frame : b_frame, !invert ? b_frame : a_frame, luma_width, luma_height, luma_bitmap, mix, frame_delta,
+				luma_softness, progressive ? -1 : top_field_first, width, height, invert );
+		else
+			luma_composite( !invert ? a_frame : b_frame, !invert ? b_frame : a_frame, luma_width, luma_height, luma_bitmap, mix, frame_delta,
+				luma_softness, progressive ? -1 : top_field_first, width, height, invert );
 	}
 	else
 	{
 		mix = ( reverse || invert ) ? 1 - mix : mix;
 		invert = 0;
 		// Dissolve the frames using the time offset for mix value
-		dissolve_yuv( a_frame, b_frame, mix, *width, *height, threads, alpha_over );
+		if ( *format == mlt_image_yuv420p && dissolve_yuv420p( a_frame, b_frame, mix, *width, *height, alpha_over ) )
+			*format = mlt_image_yuv422;
+		if ( *format == mlt_image_rgba64 )
+			dissolve_rgba64( a_frame, b_frame, mix, *width, *height, threads, alpha_over );
+		else if ( *format == mlt_image_yuv422 )
+			dissolve_yuv( a_frame, b_frame, mix, *width, *height, threads, alpha_over );
 	}
 	if (producer) {
 		mlt_service_unlock( MLT_TRANSITION_SERVICE( transition ) );
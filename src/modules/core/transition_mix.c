@@ -20,6 +20,7 @@
 #include <framework/mlt_transition.h>
 #include <framework/mlt_frame.h>
 #include <framework/mlt_log.h>
+#include <framework/mlt_cpu.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,6 +32,10 @@
 #define SAMPLE_BYTES(samples, channels) ((samples) * (channels) * sizeof(float))
 #define MAX_BYTES    SAMPLE_BYTES( MAX_SAMPLES, MAX_CHANNELS )
 
+#if defined(USE_SSE) && defined(ARCH_X86_64)
+#include <immintrin.h>
+#endif
+
 typedef struct transition_mix_s
 {
 	mlt_transition parent;
@@ -40,6 +45,9 @@ typedef struct transition_mix_s
 	int dest_buffer_count;
 	mlt_position previous_frame_a;
 	mlt_position previous_frame_b;
+	int planar;
+	int src_channels;
+	int dest_channels;
 } *transition_mix;
 
 static void mix_audio( double weight_start, double weight_end, float *buffer_a,
@@ -113,6 +121,224 @@ static void combine_audio( double weight, float *buffer_a, float *buffer_b,
 	}
 }
 
+/** Mix or sum one channel of planar float with a linear gain ramp.
+ *
+ * The gain of sample i is start + i * step. Mixing computes a + gain * (b - a)
+ * and summing computes a + gain * b.
+ */
+
+static void ramp_channel_c( float *a, const float *b, int samples, float start, float step, int sum )
+{
+	int i;
+
+	for ( i = 0; i < samples; i++ )
+	{
+		float gain = start + i * step;
+		a[i] = sum ? a[i] + gain * b[i] : a[i] + gain * ( b[i] - a[i] );
+	}
+}
+
+#if defined(USE_SSE) && defined(ARCH_X86_64)
+__attribute__((target("avx2,fma")))
+static void ramp_channel_fma( float *a, const float *b, int samples, float start, float step, int sum )
+{
+	const __m256 steps = _mm256_set1_ps( step * 8 );
+	__m256 gain = _mm256_fmadd_ps( _mm256_setr_ps( 0, 1, 2, 3, 4, 5, 6, 7 ), _mm256_set1_ps( step ), _mm256_set1_ps( start ) );
+	int i;
+
+	for ( i = 0; i + 8 <= samples; i += 8 )
+	{
+		__m256 x = _mm256_loadu_ps( a + i );
+		__m256 y = _mm256_loadu_ps( b + i );
+		if ( !sum )
+			y = _mm256_sub_ps( y, x );
+		_mm256_storeu_ps( a + i, _mm256_fmadd_ps( gain, y, x ) );
+		gain = _mm256_add_ps( gain, steps );
+	}
+	// Leave the AVX state clean before any SSE code runs
+	_mm256_zeroupper();
+	for ( ; i < samples; i++ )
+	{
+		float g = start + i * step;
+		a[i] = sum ? a[i] + g * b[i] : a[i] + g * ( b[i] - a[i] );
+	}
+}
+#endif
+
+static void ramp_channel( float *a, const float *b, int samples, float start, float step, int sum )
+{
+#if defined(USE_SSE) && defined(ARCH_X86_64)
+	if ( mlt_cpu_has( mlt_cpu_avx2 | mlt_cpu_fma ) )
+	{
+		ramp_channel_fma( a, b, samples, start, step, sum );
+		return;
+	}
+#endif
+	ramp_channel_c( a, b, samples, start, step, sum );
+}
+
+static void combine_channel( double weight, float *a, const float *b, int samples )
+{
+	double Fc = 0.5;
+	double B = exp(-2.0 * M_PI * Fc);
+	double A = 1.0 - B;
+	double v_prev = samples > 0 ? a[0] : 0.0;
+	int i;
+
+	for ( i = 0; i < samples; i++ )
+		v_prev = a[i] = ( weight * a[i] + b[i] ) * A + v_prev * B;
+}
+
+/** Queue planar samples in a buffer that holds each channel in a fixed slot.
+ *
+ * The slots divide the same storage used for interleaved samples, so the
+ * number of channels is not limited to MAX_CHANNELS.
+ */
+
+static void planar_append( mlt_transition transition, float *buffer, int *count, int channels,
+	const float *samples_in, int samples )
+{
+	int stride = MAX_SAMPLES * MAX_CHANNELS / channels;
+	int in_stride = samples;
+	int c;
+
+	samples = MIN( samples, stride );
+	if ( *count + samples > stride )
+	{
+		int keep = stride - samples;
+		mlt_log_verbose( MLT_TRANSITION_SERVICE(transition), "buffer overflow: count %d\n", *count );
+		for ( c = 0; c < channels; c++ )
+			memmove( buffer + c * stride, buffer + c * stride + *count - keep, keep * sizeof(float) );
+		*count = keep;
+	}
+	for ( c = 0; c < channels; c++ )
+		memcpy( buffer + c * stride + *count, samples_in + c * in_stride, samples * sizeof(float) );
+	*count += samples;
+}
+
+static void planar_consume( float *buffer, int *count, int channels, int samples )
+{
+	int stride = MAX_SAMPLES * MAX_CHANNELS / channels;
+	int c;
+
+	*count -= samples;
+	if ( *count > 0 )
+		for ( c = 0; c < channels; c++ )
+			memmove( buffer + c * stride, buffer + c * stride + samples, *count * sizeof(float) );
+}
+
+static void planar_silence( float *buffer, int count, int channels )
+{
+	int stride = MAX_SAMPLES * MAX_CHANNELS / channels;
+	int c;
+
+	for ( c = 0; c < channels; c++ )
+		memset( buffer + c * stride, 0, count * sizeof(float) );
+}
+
+/** Determine the mixing method and the gain ramp for this frame.
+ *
+ * Returns 1 to sum, 2 to combine, and 0 to mix.
+ */
+
+static int get_mix_levels( mlt_transition transition, mlt_frame frame_a, mlt_frame frame_b, double *mix_start, double *mix_end )
+{
+	mlt_properties properties = MLT_TRANSITION_PROPERTIES(transition);
+	mlt_properties b_props = MLT_FRAME_PROPERTIES( frame_b );
+	int method = mlt_properties_get_int( properties, "sum" ) ? 1 : mlt_properties_get_int( properties, "combine" ) ? 2 : 0;
+
+	if ( method == 2 )
+	{
+		*mix_start = *mix_end = 1.0;
+		if ( mlt_properties_get_int( MLT_FRAME_PROPERTIES( frame_a ), "meta.mixdown" ) )
+			*mix_start = *mix_end = 1.0 - mlt_properties_get_double( MLT_FRAME_PROPERTIES( frame_a ), "meta.volume" );
+		return method;
+	}
+	*mix_start = *mix_end = method == 1 ? 1.0 : 0.5;
+	if ( mlt_properties_get( b_props, "audio.previous_mix" ) )
+		*mix_start = mlt_properties_get_double( b_props, "audio.previous_mix" );
+	if ( mlt_properties_get( b_props, "audio.mix" ) )
+		*mix_end = mlt_properties_get_double( b_props, "audio.mix" );
+	if ( mlt_properties_get_int( b_props, "audio.reverse" ) )
+	{
+		*mix_start = 1.0 - *mix_start;
+		*mix_end = 1.0 - *mix_end;
+	}
+	return method;
+}
+
+/** Mix planar float, channel by channel, with no limit on the channel count.
+*/
+
+static int get_audio_planar( mlt_transition transition, mlt_frame frame_a, mlt_frame frame_b,
+	float *buffer_a, float *buffer_b, int channels_a, int channels_b, int samples_a, int samples_b,
+	void **buffer, int *channels, int *samples, int *frequency, int frequency_a )
+{
+	transition_mix self = transition->child;
+	mlt_properties b_props = MLT_FRAME_PROPERTIES( frame_b );
+	double mix_start, mix_end;
+	int method = get_mix_levels( transition, frame_a, frame_b, &mix_start, &mix_end );
+	int c;
+
+	if ( channels_b != self->src_channels )
+		self->src_buffer_count = 0;
+	if ( channels_a != self->dest_channels )
+		self->dest_buffer_count = 0;
+	self->src_channels = channels_b;
+	self->dest_channels = channels_a;
+
+	// Silence the buffers if discontinuity, then queue the new samples
+	if ( self->src_buffer_count > 0 && mlt_frame_get_position( frame_b ) != self->previous_frame_b + 1 )
+		planar_silence( self->src_buffer, self->src_buffer_count, channels_b );
+	self->previous_frame_b = mlt_frame_get_position( frame_b );
+	planar_append( transition, self->src_buffer, &self->src_buffer_count, channels_b, buffer_b, samples_b );
+
+	if ( self->dest_buffer_count > 0 && mlt_frame_get_position( frame_a ) != self->previous_frame_a + 1 )
+		planar_silence( self->dest_buffer, self->dest_buffer_count, channels_a );
+	self->previous_frame_a = mlt_frame_get_position( frame_a );
+	planar_append( transition, self->dest_buffer, &self->dest_buffer_count, channels_a, buffer_a, samples_a );
+
+	*samples = MIN( self->src_buffer_count, self->dest_buffer_count );
+	*channels = MIN( channels_a, channels_b );
+	*frequency = frequency_a;
+
+	// Mix each channel in its slot, then copy the result into the frame
+	int stride_a = MAX_SAMPLES * MAX_CHANNELS / channels_a;
+	int stride_b = MAX_SAMPLES * MAX_CHANNELS / channels_b;
+	float *output = mlt_pool_alloc( SAMPLE_BYTES( *samples, *channels ) );
+	float step = *samples ? ( mix_end - mix_start ) / *samples : 0;
+	for ( c = 0; c < *channels; c++ )
+	{
+		float *a = self->dest_buffer + c * stride_a;
+		float *b = self->src_buffer + c * stride_b;
+		if ( method == 2 )
+			combine_channel( mix_start, a, b, *samples );
+		else
+			ramp_channel( a, b, *samples, mix_start, step, method == 1 );
+		memcpy( output + c * *samples, a, *samples * sizeof(float) );
+	}
+	*buffer = output;
+	mlt_frame_set_audio( frame_a, output, mlt_audio_float, SAMPLE_BYTES( *samples, *channels ), mlt_pool_release );
+
+	if ( mlt_properties_get_int( b_props, "_speed" ) == 0 )
+	{
+		// Flush the buffer when paused and scrubbing.
+		samples_b = self->src_buffer_count;
+		samples_a = self->dest_buffer_count;
+	}
+	else
+	{
+		// Keep at most 1ms of latency in the buffers.
+		int max_latency = CLAMP( *frequency / 1000, 0, MAX_SAMPLES );
+		samples_b = self->src_buffer_count - CLAMP( self->src_buffer_count - *samples, 0, max_latency );
+		samples_a = self->dest_buffer_count - CLAMP( self->dest_buffer_count - *samples, 0, max_latency );
+	}
+	planar_consume( self->src_buffer, &self->src_buffer_count, channels_b, samples_b );
+	planar_consume( self->dest_buffer, &self->dest_buffer_count, channels_a, samples_a );
+
+	return 0;
+}
+
 /** Get the audio.
 */
 
@@ -135,8 +361,10 @@ static int transition_get_audio( mlt_frame frame_a, void **buffer, mlt_audio_for
 	int channels_b = *channels, channels_a = *channels;
 	int samples_b = *samples, samples_a = *samples;
 
-	// We can only mix interleaved 32-bit float.
-	*format = mlt_audio_f32le;
+	// We mix 32-bit float, planar when the consumer wants planar samples and
+	// interleaved otherwise.
+	int planar = *format == mlt_audio_float || *format == mlt_audio_s32;
+	*format = planar ? mlt_audio_float : mlt_audio_f32le;
 	// Get the audio from our producers
 	mlt_frame_get_audio( frame_b, (void**) &buffer_b, format, &frequency_b, &channels_b, &samples_b );
 	mlt_frame_get_audio( frame_a, (void**) &buffer_a, format, &frequency_a, &channels_a, &samples_a );
@@ -182,6 +410,16 @@ static int transition_get_audio( mlt_frame frame_a, void **buffer, mlt_audio_for
 	return error;
 #endif
 
+	if ( planar != self->planar )
+	{
+		// The queued samples are in the other layout.
+		self->src_buffer_count = self->dest_buffer_count = 0;
+		self->planar = planar;
+	}
+	if ( planar )
+		return get_audio_planar( transition, frame_a, frame_b, buffer_a, buffer_b, channels_a, channels_b,
+			samples_a, samples_b, buffer, channels, samples, frequency, frequency_a );
+
 	// However, the simple and stupid approach drops samples. Over time, this
 	// can accumulate and cause an A/V sync drift, which addressed in b2640656
 	// by saving the unused samples in a buffer and then using them first on the
@@ -235,41 +473,14 @@ static int transition_get_audio( mlt_frame frame_a, void **buffer, mlt_audio_for
 	buffer_a = self->dest_buffer;
 
 	// Do the mixing.
-	if ( mlt_properties_get_int( MLT_TRANSITION_PROPERTIES(transition), "sum" ) )
-	{
-		double mix_start = 1.0, mix_end = 1.0;
-		if ( mlt_properties_get( b_props, "audio.previous_mix" ) )
-			mix_start = mlt_properties_get_double( b_props, "audio.previous_mix" );
-		if ( mlt_properties_get( b_props, "audio.mix" ) )
-			mix_end = mlt_properties_get_double( b_props, "audio.mix" );
-		if ( mlt_properties_get_int( b_props, "audio.reverse" ) )
-		{
-			mix_start = 1.0 - mix_start;
-			mix_end = 1.0 - mix_end;
-		}
+	double mix_start, mix_end;
+	int method = get_mix_levels( transition, frame_a, frame_b, &mix_start, &mix_end );
+	if ( method == 1 )
 		sum_audio( mix_start, mix_end, buffer_a, buffer_b, channels_a, channels_b, *channels, *samples );
-	}
-	else if ( mlt_properties_get_int( MLT_TRANSITION_PROPERTIES(transition), "combine" ) )
-	{
-		double weight = 1.0;
-		if ( mlt_properties_get_int( MLT_FRAME_PROPERTIES( frame_a ), "meta.mixdown" ) )
-			weight = 1.0 - mlt_properties_get_double( MLT_FRAME_PROPERTIES( frame_a ), "meta.volume" );
-		combine_audio( weight, buffer_a, buffer_b, channels_a, channels_b, *channels, *samples );
-	}
+	else if ( method == 2 )
+		combine_audio( mix_start, buffer_a, buffer_b, channels_a, channels_b, *channels, *samples );
 	else
-	{
-		double mix_start = 0.5, mix_end = 0.5;
-		if ( mlt_properties_get( b_props, "audio.previous_mix" ) )
-			mix_start = mlt_properties_get_double( b_props, "audio.previous_mix" );
-		if ( mlt_properties_get( b_props, "audio.mix" ) )
-			mix_end = mlt_properties_get_double( b_props, "audio.mix" );
-		if ( mlt_properties_get_int( b_props, "audio.reverse" ) )
-		{
-			mix_start = 1.0 - mix_start;
-			mix_end = 1.0 - mix_end;
-		}
 		mix_audio( mix_start, mix_end, buffer_a, buffer_b, channels_a, channels_b, *channels, *samples );
-	}
 
 	// Copy the audio from the dest buffer into the frame.
 	bytes = SAMPLE_BYTES( *samples, *channels );
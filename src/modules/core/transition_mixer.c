@@ -0,0 +1,419 @@
+/*
+ * transition_mixer.c -- mix all of the audio tracks in a range into one bus
+ * Copyright (C) 2020 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <framework/mlt_transition.h>
+#include <framework/mlt_factory.h>
+#include <framework/mlt_filter.h>
+#include <framework/mlt_frame.h>
+#include <framework/mlt_log.h>
+#include <framework/mlt_pool.h>
+#include <framework/mlt_slices.h>
+#include <framework/mlt_cpu.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#if defined(USE_SSE) && defined(ARCH_X86_64)
+#include <immintrin.h>
+#endif
+
+/** One track feeding the bus.
+*/
+
+typedef struct
+{
+	mlt_frame frame;
+	int track;
+	double gain_start[3];
+	double gain_end[3];
+	float *buffer;
+	int channels;
+	int samples;
+	int error;
+} mixer_track;
+
+/** The tracks collected for a frame by the transition.
+*/
+
+typedef struct
+{
+	mlt_transition transition;
+	int count;
+	int threads;
+	mixer_track *tracks;
+} *mixer_bus;
+
+typedef struct
+{
+	mixer_bus bus;
+	int index;
+	int frequency;
+	int channels;
+	int samples;
+} mixer_fetch;
+
+static void bus_close( mixer_bus bus )
+{
+	free( bus->tracks );
+	free( bus );
+}
+
+/** Add one channel of a track to the bus with a linear gain ramp and meter it.
+ *
+ * The gain of sample i is start + i * step. The peak and the sum of squares
+ * are taken after the gain (post-fader) and combined with the values passed in.
+ */
+
+static void accumulate_channel_c( float *bus, const float *in, int samples, float start, float step,
+	float *peak, double *square )
+{
+	float p = *peak;
+	double s = 0.0;
+	int i;
+
+	for ( i = 0; i < samples; i++ )
+	{
+		float y = ( start + i * step ) * in[i];
+		float m = fabsf( y );
+		bus[i] += y;
+		p = m > p ? m : p;
+		s += y * y;
+	}
+	*peak = p;
+	*square += s;
+}
+
+#if defined(USE_SSE) && defined(ARCH_X86_64)
+__attribute__((target("avx2,fma")))
+static void accumulate_channel_fma( float *bus, const float *in, int samples, float start, float step,
+	float *peak, double *square )
+{
+	const __m256 steps = _mm256_set1_ps( step * 8 );
+	const __m256 abs_mask = _mm256_castsi256_ps( _mm256_set1_epi32( 0x7fffffff ) );
+	__m256 gain = _mm256_fmadd_ps( _mm256_setr_ps( 0, 1, 2, 3, 4, 5, 6, 7 ), _mm256_set1_ps( step ), _mm256_set1_ps( start ) );
+	__m256 p = _mm256_set1_ps( *peak );
+	__m256d s = _mm256_setzero_pd();
+	float lanes[8];
+	double sums[4];
+	int i;
+
+	for ( i = 0; i + 8 <= samples; i += 8 )
+	{
+		__m256 y = _mm256_mul_ps( gain, _mm256_loadu_ps( in + i ) );
+		_mm256_storeu_ps( bus + i, _mm256_add_ps( _mm256_loadu_ps( bus + i ), y ) );
+		p = _mm256_max_ps( p, _mm256_and_ps( y, abs_mask ) );
+		__m256 y2 = _mm256_mul_ps( y, y );
+		s = _mm256_add_pd( s, _mm256_cvtps_pd( _mm256_castps256_ps128( y2 ) ) );
+		s = _mm256_add_pd( s, _mm256_cvtps_pd( _mm256_extractf128_ps( y2, 1 ) ) );
+		gain = _mm256_add_ps( gain, steps );
+	}
+	_mm256_storeu_ps( lanes, p );
+	_mm256_storeu_pd( sums, s );
+	// Leave the AVX state clean before any SSE code runs
+	_mm256_zeroupper();
+
+	float peak_out = lanes[0];
+	double square_out = sums[0] + sums[1] + sums[2] + sums[3];
+	for ( int j = 1; j < 8; j++ )
+		peak_out = lanes[j] > peak_out ? lanes[j] : peak_out;
+	for ( ; i < samples; i++ )
+	{
+		float y = ( start + i * step ) * in[i];
+		float m = fabsf( y );
+		bus[i] += y;
+		peak_out = m > peak_out ? m : peak_out;
+		square_out += y * y;
+	}
+	*peak = peak_out;
+	*square += square_out;
+}
+#endif
+
+static void accumulate_channel( float *bus, const float *in, int samples, float start, float step,
+	float *peak, double *square )
+{
+#if defined(USE_SSE) && defined(ARCH_X86_64)
+	if ( mlt_cpu_has( mlt_cpu_avx2 | mlt_cpu_fma ) )
+	{
+		accumulate_channel_fma( bus, in, samples, start, step, peak, square );
+		return;
+	}
+#endif
+	accumulate_channel_c( bus, in, samples, start, step, peak, square );
+}
+
+/** Get the planar float audio of the tracks assigned to one fetch thread.
+*/
+
+static void *fetch_audio( void *arg )
+{
+	mixer_fetch *fetch = arg;
+	mixer_bus bus = fetch->bus;
+	int i;
+
+	for ( i = fetch->index; i < bus->count; i += bus->threads )
+	{
+		mixer_track *track = &bus->tracks[i];
+		mlt_audio_format format = mlt_audio_float;
+		int frequency = fetch->frequency;
+
+		track->channels = fetch->channels;
+		track->samples = fetch->samples;
+		track->error = mlt_frame_get_audio( track->frame, (void**) &track->buffer, &format, &frequency,
+			&track->channels, &track->samples );
+		if ( !track->error && format != mlt_audio_float )
+		{
+			mlt_log_warning( MLT_TRANSITION_SERVICE( bus->transition ), "track %d audio is not float (%s)\n",
+				track->track, mlt_audio_format_name( format ) );
+			track->error = 1;
+		}
+		if ( !track->error && frequency != fetch->frequency )
+		{
+			mlt_log_warning( MLT_TRANSITION_SERVICE( bus->transition ), "track %d audio is %d Hz instead of %d Hz\n",
+				track->track, frequency, fetch->frequency );
+			track->error = 1;
+		}
+		if ( !track->error && mlt_properties_get_int( MLT_FRAME_PROPERTIES( track->frame ), "silent_audio" ) )
+		{
+			mlt_properties_set_int( MLT_FRAME_PROPERTIES( track->frame ), "silent_audio", 0 );
+			track->error = 1;
+		}
+	}
+	return NULL;
+}
+
+/** Get the audio.
+*/
+
+static int transition_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *format, int *frequency, int *channels, int *samples )
+{
+	mixer_bus bus = mlt_frame_pop_audio( frame );
+	mlt_properties properties = MLT_TRANSITION_PROPERTIES( bus->transition );
+	mixer_fetch fetch[ bus->threads ];
+	pthread_t threads[ bus->threads ];
+	int started[ bus->threads ];
+	int i, c;
+
+	if ( *channels <= 0 )
+		*channels = 2;
+	if ( *frequency <= 0 )
+		*frequency = 48000;
+
+	// Fetch the audio of all tracks at once, one share on this thread
+	for ( i = 0; i < bus->threads; i++ )
+	{
+		fetch[i].bus = bus;
+		fetch[i].index = i;
+		fetch[i].frequency = *frequency;
+		fetch[i].channels = *channels;
+		fetch[i].samples = *samples;
+		started[i] = i > 0 && !pthread_create( &threads[i], NULL, fetch_audio, &fetch[i] );
+	}
+	for ( i = 0; i < bus->threads; i++ )
+	{
+		if ( started[i] )
+			pthread_join( threads[i], NULL );
+		else
+			fetch_audio( &fetch[i] );
+	}
+
+	// Sum every track into the bus and meter it on the way
+	int size = mlt_audio_format_size( mlt_audio_float, *samples, *channels );
+	float *output = mlt_pool_alloc( size );
+	char name[64];
+	memset( output, 0, size );
+	mlt_properties_set_position( properties, "meter.position", mlt_frame_get_position( frame ) );
+	for ( i = 0; i < bus->count; i++ )
+	{
+		mixer_track *track = &bus->tracks[i];
+		float peak = 0.0f;
+		double square = 0.0;
+		int count = 0;
+		int metered = 0;
+
+		if ( !track->error && track->buffer && track->channels > 0 )
+		{
+			count = MIN( track->samples, *samples );
+			for ( c = 0; c < *channels; c++ )
+			{
+				// A mono track feeds every channel
+				int source = track->channels == 1 ? 0 : c;
+				// Pan applies to the left and right channels only
+				int gain = c < 2 && *channels > 1 ? c : 2;
+				if ( source >= track->channels )
+					continue;
+				double start = track->gain_start[gain];
+				double end = track->gain_end[gain];
+				float step = count ? ( end - start ) / count : 0;
+				accumulate_channel( output + c * *samples, track->buffer + source * track->samples, count,
+					start, step, &peak, &square );
+				metered++;
+			}
+		}
+		double rms = count && metered ? sqrt( square / ( count * metered ) ) : 0.0;
+		snprintf( name, sizeof(name), "meter.%d.peak", track->track );
+		mlt_properties_set_double( properties, name, peak );
+		snprintf( name, sizeof(name), "meter.%d.rms", track->track );
+		mlt_properties_set_double( properties, name, rms );
+		snprintf( name, sizeof(name), "meta.mixer.%d.peak", track->track );
+		mlt_properties_set_double( MLT_FRAME_PROPERTIES( frame ), name, peak );
+		snprintf( name, sizeof(name), "meta.mixer.%d.rms", track->track );
+		mlt_properties_set_double( MLT_FRAME_PROPERTIES( frame ), name, rms );
+	}
+
+	*buffer = output;
+	*format = mlt_audio_float;
+	mlt_frame_set_audio( frame, output, mlt_audio_float, size, mlt_pool_release );
+
+	return 0;
+}
+
+/** Compute the left, right and unpanned gain of a track at a position.
+ *
+ * The pan is a balance control: 0 is the centre, where both sides keep the
+ * full gain, and -1 or 1 silence the opposite side. Channels beyond stereo
+ * and a mono bus use the unpanned gain.
+ */
+
+static void get_track_gain( mlt_properties properties, int track, int position, int length, double gain[3] )
+{
+	char name[32];
+	double level = 1.0, pan = 0.0;
+
+	snprintf( name, sizeof(name), "gain.%d", track );
+	if ( mlt_properties_get( properties, name ) )
+		level = mlt_properties_anim_get_double( properties, name, position, length );
+	snprintf( name, sizeof(name), "pan.%d", track );
+	if ( mlt_properties_get( properties, name ) )
+		pan = CLAMP( mlt_properties_anim_get_double( properties, name, position, length ), -1.0, 1.0 );
+	gain[0] = level * ( pan > 0.0 ? 1.0 - pan : 1.0 );
+	gain[1] = level * ( pan < 0.0 ? 1.0 + pan : 1.0 );
+	gain[2] = level;
+}
+
+/** Get the resampler that keeps the stream of a track at the bus rate.
+*/
+
+static mlt_filter get_track_resampler( mlt_transition transition, int track )
+{
+	mlt_properties properties = MLT_TRANSITION_PROPERTIES( transition );
+	char name[32];
+
+	snprintf( name, sizeof(name), "_resample.%d", track );
+	mlt_filter filter = mlt_properties_get_data( properties, name, NULL );
+	if ( !filter )
+	{
+		filter = mlt_factory_filter( mlt_service_profile( MLT_TRANSITION_SERVICE( transition ) ), "audioresample", NULL );
+		if ( filter )
+			mlt_properties_set_data( properties, name, filter, 0, (mlt_destructor) mlt_filter_close, NULL );
+		else
+			mlt_log_warning( MLT_TRANSITION_SERVICE( transition ), "unable to resample track %d\n", track );
+	}
+	return filter;
+}
+
+/** Mixer transition processing.
+ *
+ * All frames between the a and b tracks are held by the transition, so the
+ * bus takes every one of them that has audio and hides it from the tractor.
+ * Each track passes through its own resampler, which does nothing while the
+ * track already delivers the rate of the bus.
+*/
+
+static mlt_frame transition_process( mlt_transition transition, mlt_frame a_frame, mlt_frame b_frame )
+{
+	mlt_properties properties = MLT_TRANSITION_PROPERTIES( transition );
+	int a_track = mlt_transition_get_a_track( transition );
+	int b_track = mlt_transition_get_b_track( transition );
+	int position = mlt_transition_get_position( transition, a_frame );
+	int length = mlt_transition_get_length( transition );
+	int threads = mlt_properties_get_int( properties, "threads" );
+	mixer_bus bus = calloc( 1, sizeof( *bus ) );
+	int i;
+
+	if ( a_track > b_track )
+	{
+		i = a_track;
+		a_track = b_track;
+		b_track = i;
+	}
+	a_track = MAX( a_track, 0 );
+	bus->transition = transition;
+	bus->tracks = calloc( b_track - a_track + 1, sizeof( mixer_track ) );
+
+	for ( i = a_track; i <= b_track; i++ )
+	{
+		mlt_frame frame = transition->frames[i];
+		mlt_properties frame_properties = frame ? MLT_FRAME_PROPERTIES( frame ) : NULL;
+
+		if ( !frame )
+			continue;
+		if ( frame != a_frame || mlt_frame_is_test_audio( frame ) )
+		{
+			int hide = mlt_properties_get_int( frame_properties, "hide" );
+			if ( mlt_frame_is_test_audio( frame ) || ( hide & 2 ) )
+				continue;
+			if ( frame != a_frame )
+				mlt_properties_set_int( frame_properties, "hide", hide | 2 );
+		}
+		mlt_filter resampler = get_track_resampler( transition, i );
+		if ( resampler )
+			mlt_filter_process( resampler, frame );
+		mixer_track *track = &bus->tracks[ bus->count++ ];
+		track->frame = frame;
+		track->track = i;
+		get_track_gain( properties, i, position, length, track->gain_start );
+		get_track_gain( properties, i, position + 1, length, track->gain_end );
+	}
+
+	if ( threads <= 0 )
+		threads = mlt_slices_count_normal();
+	bus->threads = CLAMP( threads, 1, MAX( bus->count, 1 ) );
+
+	mlt_properties_set_data( MLT_FRAME_PROPERTIES( a_frame ), "mixer.bus", bus, 0, (mlt_destructor) bus_close, NULL );
+	mlt_frame_push_audio( a_frame, bus );
+	mlt_frame_push_audio( a_frame, transition_get_audio );
+
+	// Ensure transition_get_audio is called if the a track is blank.
+	mlt_properties_set_int( MLT_FRAME_PROPERTIES( a_frame ), "test_audio", 0 );
+
+	return a_frame;
+}
+
+/** Constructor for the transition.
+*/
+
+mlt_transition transition_mixer_init( mlt_profile profile, mlt_service_type type, const char *id, char *arg )
+{
+	mlt_transition transition = mlt_transition_new();
+	if ( transition )
+	{
+		transition->process = transition_process;
+		mlt_properties properties = MLT_TRANSITION_PROPERTIES( transition );
+		// The bus includes blank tracks so that it is always active
+		mlt_properties_set_int( properties, "accepts_blanks", 1 );
+		mlt_properties_set_int( properties, "threads", arg ? atoi( arg ) : 0 );
+		// Inform apps and framework that this is an audio only transition
+		mlt_properties_set_int( properties, "_transition_type", 2 );
+	}
+	return transition;
+}
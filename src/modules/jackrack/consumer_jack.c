@@ -25,7 +25,6 @@
 #include <sys/time.h>
 #include <unistd.h>
 #include <jack/jack.h>
-#include <jack/ringbuffer.h>
 
 #define BUFFER_LEN (204800 * 6)
 
@@ -52,7 +51,8 @@ struct consumer_jack_s
 	pthread_mutex_t refresh_mutex;
 	int refresh_count;
 	int counter;
-	jack_ringbuffer_t **ringbuffers;
+	int channels;
+	mlt_audio_ring *rings;
 	jack_port_t **ports;
 };
 
@@ -197,17 +197,17 @@ static int consumer_stop( mlt_consumer parent )
 		// Cleanup JACK
 		if ( self->playing )
 			jack_deactivate( self->jack );
-		if ( self->ringbuffers )
+		if ( self->rings )
 		{
-			int n = mlt_properties_get_int( MLT_CONSUMER_PROPERTIES( parent ), "channels" );
+			int n = self->channels;
 			while ( n-- )
 			{
-				jack_ringbuffer_free( self->ringbuffers[n] );
+				mlt_audio_ring_close( self->rings[n] );
 				jack_port_unregister( self->jack, self->ports[n] );
 			}
-			mlt_pool_release( self->ringbuffers );
+			mlt_pool_release( self->rings );
 		}
-		self->ringbuffers = NULL;
+		self->rings = NULL;
 		if ( self->ports )
 			mlt_pool_release( self->ports );
 		self->ports = NULL;
@@ -226,28 +226,19 @@ static int jack_process( jack_nframes_t frames, void * data )
 {
 	int error = 0;
 	consumer_jack self = (consumer_jack) data;
-	mlt_properties properties = MLT_CONSUMER_PROPERTIES( &self->parent );
-	int channels = mlt_properties_get_int( properties, "channels" );
 	int i;
 
-	if ( !self->ringbuffers )
+	if ( !self->rings )
 		return 1;
 
-	for ( i = 0; i < channels; i++ )
-	{
-		size_t jack_size = ( frames * sizeof(float) );
-		size_t ring_size = jack_ringbuffer_read_space( self->ringbuffers[i] );
-		char *dest = jack_port_get_buffer( self->ports[i], frames );
-
-		jack_ringbuffer_read( self->ringbuffers[i], dest, ring_size < jack_size ? ring_size : jack_size );
-		if ( ring_size < jack_size )
-			memset( dest + ring_size, 0, jack_size - ring_size );
-	}
+	// Take what is buffered, the rest is silence
+	for ( i = 0; i < self->channels; i++ )
+		mlt_audio_ring_read( self->rings[i], jack_port_get_buffer( self->ports[i], frames ), frames );
 
 	return error;
 }
 
-static void initialise_jack_ports( consumer_jack self )
+static int initialise_jack_ports( consumer_jack self )
 {
 	int i;
 	char mlt_name[20], con_name[30];
@@ -257,8 +248,24 @@ static void initialise_jack_ports( consumer_jack self )
 	// Propagate these for the Jack processing callback
 	int channels = mlt_properties_get_int( properties, "channels" );
 
-	// Allocate buffers and ports
-	self->ringbuffers = mlt_pool_alloc( sizeof( jack_ringbuffer_t *) * channels );
+	// Allocate a ring per port before the process callback can see them
+	mlt_audio_ring *rings = mlt_pool_alloc( sizeof( mlt_audio_ring ) * channels );
+	int error = rings == NULL;
+	for ( i = 0; !error && i < channels; i++ )
+	{
+		rings[i] = mlt_audio_ring_init( mlt_audio_float, 1, (int) jack_get_sample_rate( self->jack ), BUFFER_LEN );
+		error = rings[i] == NULL;
+	}
+	if ( error )
+	{
+		mlt_log_error( MLT_CONSUMER_SERVICE( &self->parent ), "Failed to allocate the audio buffers\n" );
+		while ( rings && i-- )
+			mlt_audio_ring_close( rings[i] );
+		mlt_pool_release( rings );
+		return error;
+	}
+	self->channels = channels;
+	self->rings = rings;
 	self->ports = mlt_pool_alloc( sizeof(jack_port_t *) * channels );
 
 	// Start Jack processing - required before registering ports
@@ -270,7 +277,6 @@ static void initialise_jack_ports( consumer_jack self )
 	// Register Jack ports
 	for ( i = 0; i < channels; i++ )
 	{
-		self->ringbuffers[i] = jack_ringbuffer_create( BUFFER_LEN * sizeof(float) );
 		snprintf( mlt_name, sizeof( mlt_name ), "out_%d", i + 1 );
 		self->ports[i] = jack_port_register( self->jack, mlt_name, JACK_DEFAULT_AUDIO_TYPE,
 				JackPortIsOutput | JackPortIsTerminal, 0 );
@@ -297,6 +303,7 @@ static void initialise_jack_ports( consumer_jack self )
 	}
 	if ( ports )
 		jack_free( ports );
+	return error;
 }
 
 static int consumer_play_audio( consumer_jack self, mlt_frame frame, int init_audio, int *duration )
@@ -325,14 +332,12 @@ static int consumer_play_audio( consumer_jack self, mlt_frame frame, int init_au
 	if ( init_audio == 1 )
 	{
 		self->playing = 0;
-		initialise_jack_ports( self );
-		init_audio = 0;
+		init_audio = initialise_jack_ports( self ) ? 2 : 0;
 	}
 
-	if ( init_audio == 0 && ( speed == 1.0 || speed == 0.0 ) )
+	if ( init_audio == 0 && self->rings && ( speed == 1.0 || speed == 0.0 ) )
 	{
 		int i;
-		size_t mlt_size = samples * sizeof(float);
 		float volume = mlt_properties_get_double( properties, "volume" );
 
 		if ( !scrub && speed == 0.0 )
@@ -346,13 +351,13 @@ static int consumer_play_audio( consumer_jack self, mlt_frame frame, int init_au
 				*p++ *= volume;
 		}
 
-		// Write into output ringbuffer
-		for ( i = 0; i < channels; i++ )
-		{
-			size_t ring_size = jack_ringbuffer_write_space( self->ringbuffers[i] );
-			if ( ring_size >= mlt_size )
-				jack_ringbuffer_write( self->ringbuffers[i], (char*)( buffer + i * samples ), mlt_size );
-		}
+		// Write into the output rings, truncating all channels alike when full
+		int space = samples;
+		for ( i = 0; i < self->channels; i++ )
+			space = MIN( space, mlt_audio_ring_writable( self->rings[i] ) );
+		for ( i = 0; i < self->channels && i < channels; i++ )
+			mlt_audio_ring_write( self->rings[i], buffer + i * samples, space );
+		mlt_audio_ring_publish_stats( self->rings[0], properties );
 	}
 
 	return init_audio;
@@ -37,8 +37,8 @@ lff_init (lff_t * lff, unsigned int size, size_t object_size)
 {
   lff->size = size;
   lff->object_size = object_size;
-  lff->read_index = 0;
-  lff->write_index = 0;
+  atomic_init (&lff->read_index, 0);
+  atomic_init (&lff->write_index, 0);
   lff->data = g_malloc (object_size * size);
 }
 
@@ -70,15 +70,20 @@ lff_destroy (lff_t * lff)
 /** read an element from the fifo into data.
 returns 0 on success, non-zero if there were no elements to read */
 int lff_read (lff_t * lff, void * data) {
-  if (lff->read_index == lff->write_index) {
+  unsigned int ri = atomic_load_explicit (&lff->read_index, memory_order_relaxed);
+
+  /* acquire pairs with the writer's release so the element is complete */
+  if (ri == atomic_load_explicit (&lff->write_index, memory_order_acquire)) {
     return -1;
   } else {
-    memcpy (data, ((char *)lff->data) + (lff->read_index * lff->object_size),
+    memcpy (data, ((char *)lff->data) + (ri * lff->object_size),
             lff->object_size);
-    lff->read_index++;
-    if (lff->read_index >= lff->size) {
-      lff->read_index = 0;
+    ri++;
+    if (ri >= lff->size) {
+      ri = 0;
     }
+    /* release so the writer does not reuse the slot before it is copied */
+    atomic_store_explicit (&lff->read_index, ri, memory_order_release);
     return 0;
   }
 }
@@ -86,31 +91,19 @@ int lff_read (lff_t * lff, void * data) {
 /** write an element from data to the fifo.
 returns 0 on success, non-zero if there was no space */
 int lff_write (lff_t * lff, void * data) {
-  static unsigned int ri;
-  
-  /* got to read read_index only once for safety */
-  ri = lff->read_index;
-
-  /* lots of logic for when we're allowed to write to the fifo which basically
-     boils down to "don't write if we're one element behind the read index" */  
-  if ((ri > lff->write_index && ri - lff->write_index > 1) ||
-      (lff->write_index >= ri && lff->write_index != lff->size - 1) ||
-      (lff->write_index >= ri && lff->write_index == lff->size - 1 && ri != 0)) { 
+  unsigned int wi = atomic_load_explicit (&lff->write_index, memory_order_relaxed);
+  unsigned int next = wi + 1 >= lff->size ? 0 : wi + 1;
 
-/*  if ((ri > lff->write_index && ri - lff->write_index > 1) ||
-      (lff->write_index >= ri && (lff->write_index != lff->size - 1 || ri != 0))) { */
+  /* don't write if we're one element behind the read index */
+  if (next == atomic_load_explicit (&lff->read_index, memory_order_acquire)) {
+    return -1;
+  }
 
-    memcpy (((char *)lff->data) + (lff->write_index * lff->object_size),
-            data, lff->object_size);
+  memcpy (((char *)lff->data) + (wi * lff->object_size),
+          data, lff->object_size);
 
-    /* FIXME: is this safe? */
-    lff->write_index++;
-    if (lff->write_index >= lff->size) {
-      lff->write_index = 0;
-    }
+  /* publish the element */
+  atomic_store_explicit (&lff->write_index, next, memory_order_release);
 
-    return 0;
-  } else {
-    return -1;
-  }
+  return 0;
 }
@@ -25,6 +25,9 @@
 #ifndef __JLH_LOCK_FREE_FIFO_H__
 #define __JLH_LOCK_FREE_FIFO_H__
 
+#include <stddef.h>
+#include <stdatomic.h>
+
 /** lock free fifo ring buffer structure */
 typedef struct lock_free_fifo {
   /** Size of the ringbuffer (in elements) */
@@ -34,9 +37,9 @@ typedef struct lock_free_fifo {
   /** the size of an element */
   size_t object_size;
   /** the current position of the reader */
-  unsigned int read_index;
+  atomic_uint read_index;
   /** the current position of the writer */
-  unsigned int write_index;
+  atomic_uint write_index;
 } lff_t;
 
 void lff_init (lff_t * lff, unsigned int size, size_t object_size);
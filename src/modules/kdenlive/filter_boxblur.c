@@ -21,71 +21,227 @@
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
 #include <framework/mlt_profile.h>
+#include <framework/mlt_slices.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <stdint.h>
 
 
-static void PreCompute(uint8_t *image, int32_t *rgba, int width, int height)
+/** The number of pixel columns in one tile of the vertical pass.
+ * Each tile keeps its running sums in a small array, and one row of a tile
+ * of horizontal sums fills a 4 KiB page.
+*/
+#define TILE_WIDTH 256
+
+struct sliced_desc
 {
-	register int x, y, z;
-	int32_t pts[4];
-	
-	for (y = 0; y < height; y++)
+	uint8_t *image;
+	int32_t *sums;
+	int width;
+	int height;
+	int boxw;
+	int boxh;
+	int divw;
+	int divh;
+	int repeat_edges;
+	int normalize_rows;
+};
+
+static const uint8_t zero_pixel[4];
+static const int32_t zero_row[ TILE_WIDTH * 4 ];
+
+/** Get pixel k of a row for the horizontal window.
+ *
+ * With repeat_edges, pixels outside the image repeat the edge pixel.
+ * Otherwise they count as black and transparent, and so does the first
+ * pixel, as in the summed-area table this filter used to build, so the edges
+ * darken.
+*/
+
+static inline const uint8_t *row_pixel( struct sliced_desc *ctx, const uint8_t *src, int k )
+{
+	if ( ctx->repeat_edges )
+		return src + 4 * CLAMP( k, 0, ctx->width - 1 );
+	return k < 1 || k >= ctx->width ? zero_pixel : src + 4 * k;
+}
+
+/** Get row k of a tile of horizontal sums for the vertical window, in the
+ * same way as row_pixel().
+*/
+
+static inline const int32_t *column_row( struct sliced_desc *ctx, const int32_t *sums, int k )
+{
+	if ( ctx->repeat_edges )
+		return sums + ctx->width * 4 * CLAMP( k, 0, ctx->height - 1 );
+	return k < 1 || k >= ctx->height ? zero_row : sums + ctx->width * 4 * k;
+}
+
+/** Horizontal pass: sum a sliding window of 2 * boxw pixels for every
+ * pixel of a band of rows. Each step adds the pixel entering the window
+ * and subtracts the one leaving it, so the cost does not depend on boxw.
+*/
+
+static int blur_rows_proc( int id, int index, int jobs, void *cookie )
+{
+	(void) id; // unused
+	struct sliced_desc *ctx = (struct sliced_desc*) cookie;
+	int width = ctx->width;
+	int boxw = ctx->boxw;
+	int slice_line_start, slice_height = mlt_slices_size_slice( jobs, index, ctx->height, &slice_line_start );
+	int x, y, z, k;
+
+	for ( y = slice_line_start; y < slice_line_start + slice_height; y++ )
 	{
-		for (x = 0; x < width; x++)
+		uint8_t *src = ctx->image + y * width * 4;
+		int32_t *dst = ctx->sums + y * width * 4;
+		int32_t sum[4] = { 0, 0, 0, 0 };
+
+		// Prime the window for x = 0, which covers -boxw + 1 .. boxw.
+		for ( k = -boxw + 1; k <= boxw; k++ )
 		{
-			pts[0] = image[0];
-			pts[1] = image[1];
-			pts[2] = image[2];
-			pts[3] = image[3];
-			for (z = 0; z < 4; z++)
+			const uint8_t *p = row_pixel( ctx, src, k );
+			for ( z = 0; z < 4; z++ )
+				sum[z] += p[z];
+		}
+
+		// Only the window edges need checking, so split the row in three.
+		int left = MIN( boxw, width );
+		int right = MAX( width - boxw - 1, left );
+		for ( x = 0; x < left; x++ )
+		{
+			const uint8_t *in = row_pixel( ctx, src, x + boxw + 1 );
+			const uint8_t *out = row_pixel( ctx, src, x - boxw + 1 );
+			for ( z = 0; z < 4; z++ )
 			{
-				if (x > 0) pts[z] += rgba[-4];
-				if (y > 0) pts[z] += rgba[width * -4];
-				if (x>0 && y>0) pts[z] -= rgba[(width + 1) * -4];
-				*rgba++ = pts[z];
+				*dst++ = sum[z];
+				sum[z] += in[z] - out[z];
 			}
-			image += 4;
+		}
+		const uint8_t *in = src + 4 * ( x + boxw + 1 );
+		const uint8_t *out = src + 4 * ( x - boxw + 1 );
+		for ( ; x < right; x++, in += 4, out += 4 )
+		{
+			dst[0] = sum[0]; sum[0] += in[0] - out[0];
+			dst[1] = sum[1]; sum[1] += in[1] - out[1];
+			dst[2] = sum[2]; sum[2] += in[2] - out[2];
+			dst[3] = sum[3]; sum[3] += in[3] - out[3];
+			dst += 4;
+		}
+		for ( ; x < width; x++ )
+		{
+			in = row_pixel( ctx, src, x + boxw + 1 );
+			out = row_pixel( ctx, src, x - boxw + 1 );
+			for ( z = 0; z < 4; z++ )
+			{
+				*dst++ = sum[z];
+				sum[z] += in[z] - out[z];
+			}
+		}
+
+		// Average now if the sums of both passes could overflow.
+		if ( ctx->normalize_rows )
+		{
+			dst = ctx->sums + y * width * 4;
+			for ( x = 0; x < width * 4; x++ )
+				dst[x] = ( dst[x] + ctx->divw ) / ( ctx->divw * 2 );
 		}
 	}
+	return 0;
 }
 
-static inline int32_t GetRGBA(int32_t *rgba, unsigned int w, unsigned int h, unsigned int x, int offsetx, unsigned int y, int offsety, unsigned int z)
-{
-	int xtheo = x + offsetx;
-	int ytheo = y + offsety;
-	return rgba[4 * (CLAMP(xtheo, 0, w-1) + CLAMP(ytheo, 0, h-1) * w) + z];
-}
+/** Vertical pass: slide a window of 2 * boxh rows down each tile of
+ * columns, summing the horizontal sums and writing the averaged pixels
+ * back to the image.
+*/
 
-static void DoBoxBlur(uint8_t *image, int32_t *rgba, unsigned int width, unsigned int height, unsigned int boxw, unsigned int boxh)
+static int blur_columns_proc( int id, int index, int jobs, void *cookie )
 {
-	register int x, y;
-	float mul = 1.f / ((boxw*2) * (boxh*2));
+	(void) id; // unused
+	struct sliced_desc *ctx = (struct sliced_desc*) cookie;
+	int width = ctx->width;
+	int height = ctx->height;
+	int boxh = ctx->boxh;
+	int stride = width * 4;
+	int tiles = ( width + TILE_WIDTH - 1 ) / TILE_WIDTH;
+	int tile_start, tile_count = mlt_slices_size_slice( jobs, index, tiles, &tile_start );
+	float mul = 1.f / ( ( ctx->normalize_rows ? 1.f : ctx->divw * 2.f ) * ( ctx->divh * 2.f ) );
+	int32_t sum[ TILE_WIDTH * 4 ];
+	int tile, i, y, k;
 
-	for (y = 0; y < height; y++)
+	for ( tile = tile_start; tile < tile_start + tile_count; tile++ )
 	{
-		for (x = 0; x < width; x++)
+		int x0 = tile * TILE_WIDTH;
+		int n = MIN( TILE_WIDTH, width - x0 ) * 4;
+		int32_t *sums = ctx->sums + x0 * 4;
+		uint8_t *dst = ctx->image + x0 * 4;
+
+		// Prime the window for y = 0, which covers -boxh + 1 .. boxh.
+		for ( i = 0; i < n; i++ )
+			sum[i] = 0;
+		for ( k = -boxh + 1; k <= boxh; k++ )
 		{
-			*image++ = (GetRGBA(rgba, width, height, x, +boxw, y, +boxh, 0)
-			          + GetRGBA(rgba, width, height, x, -boxw, y, -boxh, 0)
-			          - GetRGBA(rgba, width, height, x, -boxw, y, +boxh, 0)
-			          - GetRGBA(rgba, width, height, x, +boxw, y, -boxh, 0)) * mul;
-			*image++ = (GetRGBA(rgba, width, height, x, +boxw, y, +boxh, 1)
-			          + GetRGBA(rgba, width, height, x, -boxw, y, -boxh, 1)
-			          - GetRGBA(rgba, width, height, x, -boxw, y, +boxh, 1)
-			          - GetRGBA(rgba, width, height, x, +boxw, y, -boxh, 1)) * mul;
-			*image++ = (GetRGBA(rgba, width, height, x, +boxw, y, +boxh, 2)
-			          + GetRGBA(rgba, width, height, x, -boxw, y, -boxh, 2)
-			          - GetRGBA(rgba, width, height, x, -boxw, y, +boxh, 2)
-			          - GetRGBA(rgba, width, height, x, +boxw, y, -boxh, 2)) * mul;
-			*image++ = (GetRGBA(rgba, width, height, x, +boxw, y, +boxh, 3)
-			          + GetRGBA(rgba, width, height, x, -boxw, y, -boxh, 3)
-			          - GetRGBA(rgba, width, height, x, -boxw, y, +boxh, 3)
-			          - GetRGBA(rgba, width, height, x, +boxw, y, -boxh, 3)) * mul;
+			const int32_t *p = column_row( ctx, sums, k );
+			for ( i = 0; i < n; i++ )
+				sum[i] += p[i];
+		}
+		for ( y = 0; y < height; y++ )
+		{
+			const int32_t *in = column_row( ctx, sums, y + boxh + 1 );
+			const int32_t *out = column_row( ctx, sums, y - boxh + 1 );
+			if ( n == TILE_WIDTH * 4 )
+			{
+				// A constant trip count lets the compiler vectorise these.
+				for ( i = 0; i < TILE_WIDTH * 4; i++ )
+					dst[i] = sum[i] * mul;
+				for ( i = 0; i < TILE_WIDTH * 4; i++ )
+					sum[i] += in[i] - out[i];
+			}
+			else
+			{
+				for ( i = 0; i < n; i++ )
+				{
+					dst[i] = sum[i] * mul;
+					sum[i] += in[i] - out[i];
+				}
+			}
+			dst += stride;
 		}
 	}
+	return 0;
+}
+
+/** Blur an rgba image with a box of 2 * boxw by 2 * boxh pixels, repeating
+ * the blur to approximate a gaussian when passes is greater than 1.
+*/
+
+static void box_blur( uint8_t *image, int width, int height, int boxw, int boxh, int passes, int repeat_edges )
+{
+	struct sliced_desc desc = {
+		.image = image,
+		.sums = mlt_pool_alloc( width * height * 4 * sizeof(int32_t) ),
+		.width = width,
+		.height = height,
+		// Larger windows would only add edge pixels or nothing.
+		.boxw = CLAMP( boxw, 1, width ),
+		.boxh = CLAMP( boxh, 1, height ),
+		.repeat_edges = repeat_edges
+	};
+	// Without repeat_edges, the average is over the full box, also outside the image.
+	desc.divw = repeat_edges ? desc.boxw : MAX( boxw, 1 );
+	desc.divh = repeat_edges ? desc.boxh : MAX( boxh, 1 );
+	int tiles = ( width + TILE_WIDTH - 1 ) / TILE_WIDTH;
+	int jobs = MIN( tiles, mlt_slices_count_normal() );
+
+	desc.normalize_rows = 255LL * ( desc.boxw * 2 ) * ( desc.boxh * 2 ) > INT32_MAX;
+
+	while ( passes-- > 0 )
+	{
+		mlt_slices_run_normal( 0, blur_rows_proc, &desc );
+		mlt_slices_run_normal( jobs, blur_columns_proc, &desc );
+	}
+	mlt_pool_release( desc.sums );
 }
 
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
@@ -127,8 +283,8 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	{
 		// Get the image
 		*format = mlt_image_rgb24a;
-		int error = mlt_frame_get_image( frame, image, format, width, height, 1 );
-		
+		error = mlt_frame_get_image( frame, image, format, width, height, 1 );
+
 		// Only process if we have no error and a valid colour space
 		if ( error == 0 )
 		{
@@ -136,11 +292,9 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 			boxw *= mlt_profile_scale_width(profile, *width);
 			boxh *= mlt_profile_scale_height(profile, *height);
 			if (boxw || boxh) {
-				int size = mlt_image_format_size( *format, *width, *height, NULL );
-				int32_t *rgba = mlt_pool_alloc( 4 * size );
-				PreCompute( *image, rgba, *width, *height );
-				DoBoxBlur( *image, rgba, *width, *height, MAX(1, boxw), MAX(1, boxh) );
-				mlt_pool_release( rgba );
+				int passes = mlt_properties_get_int( properties, "passes" );
+				int repeat_edges = mlt_properties_get_int( properties, "repeat_edges" );
+				box_blur( *image, *width, *height, boxw, boxh, MAX(1, passes), repeat_edges );
 			}
 		}
 	}
@@ -171,6 +325,7 @@ mlt_filter filter_boxblur_init( mlt_profile profile, mlt_service_type type, cons
 		mlt_properties_set( MLT_FILTER_PROPERTIES( filter ), "hori", "1" );
 		mlt_properties_set( MLT_FILTER_PROPERTIES( filter ), "vert", "1" );
 		mlt_properties_set( MLT_FILTER_PROPERTIES( filter ), "blur", NULL );
+		mlt_properties_set_int( MLT_FILTER_PROPERTIES( filter ), "passes", 1 );
 	}
 	return filter;
 }
@@ -19,6 +19,7 @@
 
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
+#include <framework/mlt_cpu.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -26,18 +27,19 @@
 #include <ctype.h>
 #include <string.h>
 
+#if defined(USE_SSE) && defined(ARCH_X86_64)
+#include <immintrin.h>
+#endif
+
 #define MAX_CHANNELS 6
 #define EPSILON 0.00001
 
+// Beyond this the tanh approximation below reaches 1
+#define TANH_LIMIT 4.97f
+
 /* The following normalise functions come from the normalize utility:
    Copyright (C) 1999--2002 Chris Vaill */
 
-#define samp_width 16
-
-#ifndef ROUND
-# define ROUND(x) floor((x) + 0.5)
-#endif
-
 #define DBFSTOAMP(x) pow(10,(x)/20.0)
 
 /** Return nonzero if the two strings are equal, ignoring case, up to
@@ -63,19 +65,104 @@ int strncaseeq(const char *s1, const char *s2, size_t n)
  
   With limiter level = 0, this is equivalent to a tanh() function;
   with limiter level = 1, this is equivalent to clipping.
+
+  This is written without branches as
+    sign(x) * ( min(|x|, lev) + (1-lev) * tanh(max(|x| - lev, 0) / (1-lev)) )
+  using a [7/6] Pade approximation of tanh that is within 1e-4 of it.
 */
-static inline double limiter( double x, double lmtr_lvl )
+static inline float limiter( float x, float lmtr_lvl, float scale, float inv_scale )
 {
-	double xp = x;
+	float a = fabsf( x );
+	float e = fminf( fmaxf( a - lmtr_lvl, 0.0f ) * inv_scale, TANH_LIMIT );
+	float e2 = e * e;
+	float t = e * ( 135135.0f + e2 * ( 17325.0f + e2 * ( 378.0f + e2 ) ) )
+		/ ( 135135.0f + e2 * ( 62370.0f + e2 * ( 3150.0f + e2 * 28.0f ) ) );
+	return copysignf( fminf( a, lmtr_lvl ) + scale * fminf( t, 1.0f ), x );
+}
+
+/** Apply a gain that ramps linearly over a plane of samples.
 
-	if (x < -lmtr_lvl)
-		xp = tanh((x + lmtr_lvl) / (1-lmtr_lvl)) * (1-lmtr_lvl) - lmtr_lvl;
-	else if (x > lmtr_lvl)
-		xp = tanh((x - lmtr_lvl) / (1-lmtr_lvl)) * (1-lmtr_lvl) + lmtr_lvl;
+  The limiter is applied to the samples where the gain is above unity.
+*/
+static void apply_gain_c( float *p, int samples, float gain, float step, int limit, float lmtr_lvl )
+{
+	float scale = 1.0f - lmtr_lvl;
+	float inv_scale = scale > 0.0f ? 1.0f / scale : 1e30f;
+	int i;
 
-	return xp;
+	if ( limit )
+	{
+		for ( i = 0; i < samples; i++ )
+		{
+			float g = gain + i * step;
+			float x = p[i] * g;
+			p[i] = g > 1.0f ? limiter( x, lmtr_lvl, scale, inv_scale ) : x;
+		}
+	}
+	else
+	{
+		for ( i = 0; i < samples; i++ )
+			p[i] *= gain + i * step;
+	}
 }
 
+#if defined(USE_SSE) && defined(ARCH_X86_64)
+__attribute__((target("avx2,fma")))
+static void apply_gain_fma( float *p, int samples, float gain, float step, int limit, float lmtr_lvl )
+{
+	const float scale = 1.0f - lmtr_lvl;
+	const float inv_scale = scale > 0.0f ? 1.0f / scale : 1e30f;
+	const __m256 steps = _mm256_set1_ps( step * 8 );
+	const __m256 one = _mm256_set1_ps( 1.0f );
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 sign_mask = _mm256_set1_ps( -0.0f );
+	const __m256 level = _mm256_set1_ps( lmtr_lvl );
+	const __m256 vscale = _mm256_set1_ps( scale );
+	const __m256 vinv_scale = _mm256_set1_ps( inv_scale );
+	const __m256 tanh_limit = _mm256_set1_ps( TANH_LIMIT );
+	__m256 g = _mm256_fmadd_ps( _mm256_setr_ps( 0, 1, 2, 3, 4, 5, 6, 7 ), _mm256_set1_ps( step ), _mm256_set1_ps( gain ) );
+	int i;
+
+	for ( i = 0; i + 8 <= samples; i += 8 )
+	{
+		__m256 x = _mm256_mul_ps( _mm256_loadu_ps( p + i ), g );
+		if ( limit )
+		{
+			__m256 sign = _mm256_and_ps( x, sign_mask );
+			__m256 a = _mm256_andnot_ps( sign_mask, x );
+			__m256 e = _mm256_min_ps( _mm256_mul_ps( _mm256_max_ps( _mm256_sub_ps( a, level ), zero ), vinv_scale ), tanh_limit );
+			__m256 e2 = _mm256_mul_ps( e, e );
+			__m256 num = _mm256_fmadd_ps( e2, _mm256_add_ps( e2, _mm256_set1_ps( 378.0f ) ), _mm256_set1_ps( 17325.0f ) );
+			num = _mm256_mul_ps( e, _mm256_fmadd_ps( e2, num, _mm256_set1_ps( 135135.0f ) ) );
+			__m256 den = _mm256_fmadd_ps( e2, _mm256_set1_ps( 28.0f ), _mm256_set1_ps( 3150.0f ) );
+			den = _mm256_fmadd_ps( e2, den, _mm256_set1_ps( 62370.0f ) );
+			den = _mm256_fmadd_ps( e2, den, _mm256_set1_ps( 135135.0f ) );
+			__m256 t = _mm256_min_ps( _mm256_div_ps( num, den ), one );
+			__m256 y = _mm256_or_ps( _mm256_fmadd_ps( vscale, t, _mm256_min_ps( a, level ) ), sign );
+			x = _mm256_blendv_ps( x, y, _mm256_cmp_ps( g, one, _CMP_GT_OQ ) );
+		}
+		_mm256_storeu_ps( p + i, x );
+		g = _mm256_add_ps( g, steps );
+	}
+	// Leave the AVX state clean before any SSE code runs
+	_mm256_zeroupper();
+
+	if ( i < samples )
+		apply_gain_c( p + i, samples - i, gain + i * step, step, limit, lmtr_lvl );
+}
+#endif
+
+static void apply_gain( float *p, int samples, float gain, float step, int limit, float lmtr_lvl )
+{
+#if defined(USE_SSE) && defined(ARCH_X86_64)
+	if ( mlt_cpu_has( mlt_cpu_avx2 | mlt_cpu_fma ) )
+	{
+		apply_gain_fma( p, samples, gain, step, limit, lmtr_lvl );
+		return;
+	}
+#endif
+	apply_gain_c( p, samples, gain, step, limit, lmtr_lvl );
+}
 
 /** Takes a full smoothing window, and returns the value of the center
     element, smoothed.
@@ -101,54 +188,34 @@ static inline double get_smoothed_data( double *buf, int count )
 	return smoothed;
 }
 
-/** Get the max power level (using RMS) and peak level of the audio segment.
+/** Get the max power level (using RMS) of planar float audio in the
+    range 0.0 -- 1.0.
  */
-double signal_max_power( int16_t *buffer, int channels, int samples, int16_t *peak )
+static double signal_max_power( float *buffer, int channels, int samples )
 {
-	// Determine numeric limits
-	int bytes_per_samp = (samp_width - 1) / 8 + 1;
-	int16_t max = (1 << (bytes_per_samp * 8 - 1)) - 1;
-	int16_t min = -max - 1;
-
-	double *sums = (double *) calloc( channels, sizeof(double) );
+	double maxpow = 0;
 	int c, i;
-	int16_t sample;
-	double pow, maxpow = 0;
-
-	/* initialize peaks to effectively -inf and +inf */
-	int16_t max_sample = min;
-	int16_t min_sample = max;
-  
-	for ( i = 0; i < samples; i++ )
+
+	for ( c = 0; c < channels; c++, buffer += samples )
 	{
-		for ( c = 0; c < channels; c++ )
+		// Accumulate in eight lanes so that this vectorises
+		float sums[8] = { 0 };
+		double pow = 0;
+
+		for ( i = 0; i + 8 <= samples; i += 8 )
 		{
-			sample = *buffer++;
-			sums[ c ] += (double) sample * (double) sample;
-			
-			/* track peak */
-			if ( sample > max_sample )
-				max_sample = sample;
-			else if ( sample < min_sample )
-				min_sample = sample;
+			int k;
+			for ( k = 0; k < 8; k++ )
+				sums[k] += buffer[i + k] * buffer[i + k];
 		}
-	}
-	for ( c = 0; c < channels; c++ )
-	{
-		pow = sums[ c ] / (double) samples;
+		for ( ; i < samples; i++ )
+			pow += buffer[i] * buffer[i];
+		for ( i = 0; i < 8; i++ )
+			pow += sums[i];
+		pow /= (double) samples;
 		if ( pow > maxpow )
 			maxpow = pow;
 	}
-			
-	free( sums );
-	
-	/* scale the pow value to be in the range 0.0 -- 1.0 */
-	maxpow /= ( (double) min * (double) min);
-
-	if ( -min_sample > max_sample )
-		*peak = min_sample / (double) min;
-	else
-		*peak = max_sample / (double) max;
 
 	return sqrt( maxpow );
 }
@@ -175,9 +242,7 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 	double limiter_level = 0.5; /* -6 dBFS */
 	int normalise =  mlt_properties_get_int( instance_props, "normalise" );
 	double amplitude =  mlt_properties_get_double( instance_props, "amplitude" );
-	int i, j;
-	double sample;
-	int16_t peak;
+	int i;
 
 	// Use animated value for gain if "level" property is set 
 	char* level_property = mlt_properties_get( filter_props, "level" );
@@ -192,9 +257,13 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 	if ( mlt_properties_get( instance_props, "limiter" ) != NULL )
 		limiter_level = mlt_properties_get_double( instance_props, "limiter" );
 	
-	// Get the producer's audio
-	*format = normalise? mlt_audio_s16 : mlt_audio_f32le;
+	// Get the producer's audio as planar float
+	*format = mlt_audio_float;
 	mlt_frame_get_audio( frame, buffer, format, frequency, channels, samples );
+	if ( *format != mlt_audio_float && frame->convert_audio )
+		frame->convert_audio( frame, buffer, format, mlt_audio_float );
+	if ( *format != mlt_audio_float || *samples <= 0 )
+		return 0;
 
 	mlt_service_lock( MLT_FILTER_SERVICE( filter ) );
 
@@ -208,7 +277,7 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 			int smooth_index = mlt_properties_get_int( filter_props, "_smooth_index" );
 			
 			// Compute the signal power and put into smoothing buffer
-			smooth_buffer[ smooth_index ] = signal_max_power( *buffer, *channels, *samples, &peak );
+			smooth_buffer[ smooth_index ] = signal_max_power( *buffer, *channels, *samples );
 
 			if ( smooth_buffer[ smooth_index ] > EPSILON )
 			{
@@ -220,7 +289,7 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 		}
 		else
 		{
-			gain *= amplitude / signal_max_power( *buffer, *channels, *samples, &peak );
+			gain *= amplitude / signal_max_power( *buffer, *channels, *samples );
 		}
 	}
 
@@ -246,37 +315,14 @@ static int filter_get_audio( mlt_frame frame, void **buffer, mlt_audio_format *f
 
 	mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
 
-	// Ramp from the previous gain to the current
-	gain = previous_gain;
-
-	// Apply the gain
-	if ( normalise )
-	{
-		int16_t *p = *buffer;
-		// Determine numeric limits
-		int bytes_per_samp = (samp_width - 1) / 8 + 1;
-		int samplemax = (1 << (bytes_per_samp * 8 - 1)) - 1;
-
-		for ( i = 0; i < *samples; i++, gain += gain_step ) {
-			for ( j = 0; j < *channels; j++ ) {
-				sample = *p * gain;
-				*p = ROUND( sample );
-				if ( gain > 1.0 && normalise ) {
-					/* use limiter function instead of clipping */
-					*p = ROUND( samplemax * limiter( sample / (double) samplemax, limiter_level ) );
-				}
-				p++;
-			}
-		}
-	}
-	else
+	// Ramp from the previous gain to the current over every plane, limiting
+	// when normalising above unity
+	if ( previous_gain != 1.0 || gain_step != 0.0 || normalise )
 	{
 		float *p = *buffer;
-		for ( i = 0; i < *samples; i++, gain += gain_step ) {
-			for ( j = 0; j < *channels; j++, p++ ) {
-				p[0] *= gain;
-			}
-		}
+		int limit = normalise && ( previous_gain > 1.0 || previous_gain + gain_step * *samples > 1.0 );
+		for ( i = 0; i < *channels; i++, p += *samples )
+			apply_gain( p, *samples, previous_gain, gain_step, limit, limiter_level );
 	}
 	return 0;
 }
@@ -19,10 +19,56 @@
 
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
+#include <framework/mlt_slices.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 
+struct sliced_desc
+{
+	uint8_t *image;
+	int width;
+	int height;
+	int noise;
+	double contrast;
+	double brightness;
+	unsigned int seed;
+};
+
+/** A small linear congruential generator, so each line has its own
+ * reproducible noise sequence regardless of how the image is sliced.
+*/
+
+static inline int line_rand( unsigned int *seed )
+{
+	*seed = *seed * 1103515245 + 12345;
+	return ( *seed >> 16 ) & 0x7fff;
+}
+
+static int sliced_proc( int id, int index, int jobs, void* cookie )
+{
+	(void) id; // unused
+	struct sliced_desc* ctx = ( (struct sliced_desc*) cookie );
+	int slice_line_start, slice_height = mlt_slices_size_slice( jobs, index, ctx->height, &slice_line_start );
+	int x = 0, y = 0, pix = 0;
+
+	for ( y = slice_line_start; y < slice_line_start + slice_height; y++ )
+	{
+		uint8_t* pixel = ctx->image + y * ctx->width * 2;
+		unsigned int seed = ctx->seed + y * 2654435761u;
+		for ( x = 0; x < ctx->width; x++, pixel += 2 )
+		{
+			if (*pixel > 20)
+			{
+				pix = MIN ( MAX ( ( (double)*pixel -127.0  ) * ctx->contrast + 127.0 + ctx->brightness , 0 ) , 255 ) ;
+				if ( ctx->noise > 0 ) pix -= ( line_rand( &seed ) % ctx->noise - ctx->noise );
+
+				*pixel = MIN ( MAX ( pix , 0 ) , 255 );
+			}
+		}
+	}
+	return 0;
+}
 
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
 {
@@ -36,31 +82,19 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 
 	if ( error == 0 && *image )
 	{
-		int h = *height;
-		int w = *width;
-
 		double position = mlt_filter_get_progress( filter, frame );
-		srand(position*10000);
-
-		int noise = mlt_properties_anim_get_int( properties, "noise", pos, len );
-		double contrast = mlt_properties_anim_get_double( properties, "contrast", pos, len ) / 100.0;
-		double brightness = 127.0 * (mlt_properties_anim_get_double( properties, "brightness", pos, len ) -100.0 ) / 100.0;
-		
-		int x = 0,y = 0,pix = 0;
-		for ( x = 0; x < w; x++ )
+		struct sliced_desc desc =
 		{
-			for( y = 0; y < h; y++ )
-			{
-				uint8_t* pixel = (*image + (y) * w * 2 + (x) * 2 );
-				if (*pixel > 20)
-				{
-					pix = MIN ( MAX ( ( (double)*pixel -127.0  ) * contrast + 127.0 + brightness , 0 ) , 255 ) ;
-					if ( noise > 0 ) pix -= ( rand() % noise - noise );
+			.image = *image,
+			.width = *width,
+			.height = *height,
+			.noise = mlt_properties_anim_get_int( properties, "noise", pos, len ),
+			.contrast = mlt_properties_anim_get_double( properties, "contrast", pos, len ) / 100.0,
+			.brightness = 127.0 * (mlt_properties_anim_get_double( properties, "brightness", pos, len ) -100.0 ) / 100.0,
+			.seed = position * 10000
+		};
 
-					*pixel = MIN ( MAX ( pix , 0 ) , 255 );
-				}
-			}
-		}
+		mlt_slices_run_normal( 0, sliced_proc, &desc );
 	}
 
 	return error;
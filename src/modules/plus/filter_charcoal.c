@@ -20,6 +20,7 @@
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
 #include <framework/mlt_profile.h>
+#include <framework/mlt_slices.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -63,6 +64,79 @@ static inline int sqrti( int n )
 	return p;
 }
 
+struct sliced_desc
+{
+	uint8_t *image;
+	uint8_t *temp;
+	int width;
+	int height;
+	int x_scatter;
+	int y_scatter;
+	float scale;
+	float mix;
+	int invert;
+};
+
+static int sliced_proc( int id, int index, int jobs, void* cookie )
+{
+	(void) id; // unused
+	struct sliced_desc* ctx = ( (struct sliced_desc*) cookie );
+	int slice_line_start, slice_height = mlt_slices_size_slice( jobs, index, ctx->height, &slice_line_start );
+	uint8_t *image = ctx->image;
+	int width = ctx->width;
+	int height = ctx->height;
+	int x_scatter = ctx->x_scatter;
+	int y_scatter = ctx->y_scatter;
+
+	// We'll process pixel by pixel
+	int x = 0;
+	int y = 0;
+
+	uint8_t *p = ctx->temp + slice_line_start * width * 2;
+	uint8_t *q = image + slice_line_start * width * 2;
+
+	// Calculations are carried out on a 3x3 matrix
+	int matrix[ 3 ][ 3 ];
+
+	// Used to carry out the matrix calculations
+	int sum1;
+	int sum2;
+	float sum;
+	int val;
+
+	// Loop for each row
+	for ( y = slice_line_start; y < slice_line_start + slice_height; y ++ )
+	{
+		// Loop for each pixel
+		for ( x = 0; x < width; x ++ )
+		{
+			// Populate the matrix
+			matrix[ 0 ][ 0 ] = get_Y( image, width, height, x - x_scatter, y - y_scatter );
+			matrix[ 0 ][ 1 ] = get_Y( image, width, height, x            , y - y_scatter );
+			matrix[ 0 ][ 2 ] = get_Y( image, width, height, x + x_scatter, y - y_scatter );
+			matrix[ 1 ][ 0 ] = get_Y( image, width, height, x - x_scatter, y             );
+			matrix[ 1 ][ 2 ] = get_Y( image, width, height, x + x_scatter, y             );
+			matrix[ 2 ][ 0 ] = get_Y( image, width, height, x - x_scatter, y + y_scatter );
+			matrix[ 2 ][ 1 ] = get_Y( image, width, height, x            , y + y_scatter );
+			matrix[ 2 ][ 2 ] = get_Y( image, width, height, x + x_scatter, y + y_scatter );
+
+			// Do calculations
+			sum1 = (matrix[2][0] - matrix[0][0]) + ( (matrix[2][1] - matrix[0][1]) << 1 ) + (matrix[2][2] - matrix[2][0]);
+			sum2 = (matrix[0][2] - matrix[0][0]) + ( (matrix[1][2] - matrix[1][0]) << 1 ) + (matrix[2][2] - matrix[2][0]);
+			sum = ctx->scale * sqrti( sum1 * sum1 + sum2 * sum2 );
+
+			// Assign value
+			*p ++ = !ctx->invert ? ( sum >= 16 && sum <= 235 ? 251 - sum : sum < 16 ? 235 : 16 ) :
+								   ( sum >= 16 && sum <= 235 ? sum : sum < 16 ? 16 : 235 );
+			q ++;
+			val = 128 + ctx->mix * ( *q ++ - 128 );
+			val = val < 16 ? 16 : val > 240 ? 240 : val;
+			*p ++ = val;
+		}
+	}
+	return 0;
+}
+
 /** Do it :-).
 */
 
@@ -95,54 +169,22 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 			y_scatter = MAX(1, lrint(y_scatter * scale_y));
 		}
 
-		// We'll process pixel by pixel
-		int x = 0;
-		int y = 0;
-
 		// We need to create a new frame as this effect modifies the input
 		uint8_t *temp = mlt_pool_alloc( *width * *height * 2 );
-		uint8_t *p = temp;
-		uint8_t *q = *image;
 
-		// Calculations are carried out on a 3x3 matrix
-		int matrix[ 3 ][ 3 ];
-
-		// Used to carry out the matrix calculations
-		int sum1;
-		int sum2;
-		float sum;
-		int val;
-
-		// Loop for each row
-		for ( y = 0; y < *height; y ++ )
+		struct sliced_desc desc =
 		{
-			// Loop for each pixel
-			for ( x = 0; x < *width; x ++ )
-			{
-				// Populate the matrix
-				matrix[ 0 ][ 0 ] = get_Y( *image, *width, *height, x - x_scatter, y - y_scatter );
-				matrix[ 0 ][ 1 ] = get_Y( *image, *width, *height, x            , y - y_scatter );
-				matrix[ 0 ][ 2 ] = get_Y( *image, *width, *height, x + x_scatter, y - y_scatter );
-				matrix[ 1 ][ 0 ] = get_Y( *image, *width, *height, x - x_scatter, y             );
-				matrix[ 1 ][ 2 ] = get_Y( *image, *width, *height, x + x_scatter, y             );
-				matrix[ 2 ][ 0 ] = get_Y( *image, *width, *height, x - x_scatter, y + y_scatter );
-				matrix[ 2 ][ 1 ] = get_Y( *image, *width, *height, x            , y + y_scatter );
-				matrix[ 2 ][ 2 ] = get_Y( *image, *width, *height, x + x_scatter, y + y_scatter );
-
-				// Do calculations
-				sum1 = (matrix[2][0] - matrix[0][0]) + ( (matrix[2][1] - matrix[0][1]) << 1 ) + (matrix[2][2] - matrix[2][0]);
-				sum2 = (matrix[0][2] - matrix[0][0]) + ( (matrix[1][2] - matrix[1][0]) << 1 ) + (matrix[2][2] - matrix[2][0]);
-				sum = scale * sqrti( sum1 * sum1 + sum2 * sum2 );
-
-				// Assign value
-				*p ++ = !invert ? ( sum >= 16 && sum <= 235 ? 251 - sum : sum < 16 ? 235 : 16 ) :
-								  ( sum >= 16 && sum <= 235 ? sum : sum < 16 ? 16 : 235 );
-				q ++;
-				val = 128 + mix * ( *q ++ - 128 );
-				val = val < 16 ? 16 : val > 240 ? 240 : val;
-				*p ++ = val;
-			}
-		}
+			.image = *image,
+			.temp = temp,
+			.width = *width,
+			.height = *height,
+			.x_scatter = x_scatter,
+			.y_scatter = y_scatter,
+			.scale = scale,
+			.mix = mix,
+			.invert = invert
+		};
+		mlt_slices_run_normal( 0, sliced_proc, &desc );
 
 		// Return the created image
 		*image = temp;
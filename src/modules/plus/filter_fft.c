@@ -21,29 +21,178 @@
 #include <stdlib.h> // calloc(), free()
 #include <string.h> // memset(), memmove()
 #include <math.h>   // sqrt()
+#include <stdint.h>
+#include <pthread.h>
 #include <fftw3.h>
+#if defined(USE_SSE2) && defined(ARCH_X86_64)
+#include <emmintrin.h>
+#endif
 
 // Private Constants
 static const float MAX_S16_AMPLITUDE = 32768.0;
 static const int MIN_WINDOW_SIZE = 500;
+static const int MAX_WINDOW_COUNT = 16;
 static const double PI = 3.14159265358979323846;
 
 // Private Types
+
+/** A plan and window function shared by every instance with the same
+ *  window size and count.
+ */
+typedef struct shared_plan_s
+{
+	int window_size;
+	int window_count;
+	fftw_plan plan;
+	float* hann;
+	struct shared_plan_s* next;
+} shared_plan;
+
+/** The result of a transform, attached to the frame so that other instances
+ *  that see the same samples can reuse it.
+ */
+typedef struct
+{
+	uint64_t hash;
+	float bins[];
+} shared_result;
+
 typedef struct
 {
 	int initialized;
 	unsigned int window_size;
+	int window_count;
+	int hop_size;
+	int span;
 	double* fft_in;
 	fftw_complex* fft_out;
-	fftw_plan fft_plan;
+	shared_plan* plan;
 	int bin_count;
 	int sample_buff_count;
 	float* sample_buff;
-	float* hann;
 	float* out_bins;
+	char result_name[32];
 	mlt_position expected_pos;
 } private_data;
 
+// The FFTW planner is not thread safe, but executing a plan is.
+static pthread_mutex_t g_plan_mutex = PTHREAD_MUTEX_INITIALIZER;
+static shared_plan* g_plans = NULL;
+static int g_wisdom_loaded = 0;
+
+static void close_plans( void* unused )
+{
+	pthread_mutex_lock( &g_plan_mutex );
+	while ( g_plans )
+	{
+		shared_plan* next = g_plans->next;
+		fftw_destroy_plan( g_plans->plan );
+		fftw_free( g_plans->hann );
+		free( g_plans );
+		g_plans = next;
+	}
+	g_wisdom_loaded = 0;
+	pthread_mutex_unlock( &g_plan_mutex );
+}
+
+/** Get a cached plan for a batch of window_count transforms.
+ *
+ * If MLT_FFTW_WISDOM names a file, plans are measured instead of estimated
+ * and the wisdom is loaded from and saved to that file, so the cost of
+ * measuring is only paid once per machine.
+ */
+
+static shared_plan* get_plan( int window_size, int window_count )
+{
+	const char* wisdom = getenv( "MLT_FFTW_WISDOM" );
+	shared_plan* plan = NULL;
+
+	pthread_mutex_lock( &g_plan_mutex );
+	for ( plan = g_plans; plan; plan = plan->next )
+	{
+		if ( plan->window_size == window_size && plan->window_count == window_count )
+			break;
+	}
+	if ( !plan )
+	{
+		int bin_count = window_size / 2 + 1;
+		double* in = fftw_alloc_real( window_size * window_count );
+		fftw_complex* out = fftw_alloc_complex( bin_count * window_count );
+
+		if ( wisdom && !g_wisdom_loaded )
+		{
+			fftw_import_wisdom_from_filename( wisdom );
+			g_wisdom_loaded = 1;
+		}
+		plan = calloc( 1, sizeof( *plan ) );
+		if ( plan && in && out )
+		{
+			plan->plan = fftw_plan_many_dft_r2c( 1, &window_size, window_count,
+					in, NULL, 1, window_size, out, NULL, 1, bin_count,
+					wisdom ? FFTW_MEASURE : FFTW_ESTIMATE );
+			plan->hann = (float*) fftw_malloc( window_size * sizeof( float ) );
+		}
+		if ( plan && plan->plan && plan->hann )
+		{
+			int i;
+			for ( i = 0; i < window_size; i++ )
+				plan->hann[i] = 0.5 * ( 1 - cos( 2 * PI * i / window_size ) );
+			plan->window_size = window_size;
+			plan->window_count = window_count;
+			if ( !g_plans )
+				mlt_factory_register_for_clean_up( &g_plans, close_plans );
+			plan->next = g_plans;
+			g_plans = plan;
+			if ( wisdom )
+				fftw_export_wisdom_to_filename( wisdom );
+		}
+		else if ( plan )
+		{
+			if ( plan->plan )
+				fftw_destroy_plan( plan->plan );
+			fftw_free( plan->hann );
+			free( plan );
+			plan = NULL;
+		}
+		fftw_free( in );
+		fftw_free( out );
+	}
+	pthread_mutex_unlock( &g_plan_mutex );
+
+	return plan;
+}
+
+static uint64_t hash_samples( const float* samples, int count )
+{
+	const uint32_t* words = (const uint32_t*) samples;
+	uint64_t hash = 14695981039346656037ULL;
+	int i;
+	for ( i = 0; i < count; i++ )
+	{
+		hash ^= words[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/** Apply the window function to every window of the batch.
+ */
+
+static void apply_window( double* restrict out, const float* restrict in, const float* restrict window, int size )
+{
+	int i = 0;
+#if defined(USE_SSE2) && defined(ARCH_X86_64)
+	for ( ; i + 4 <= size; i += 4 )
+	{
+		__m128 x = _mm_mul_ps( _mm_loadu_ps( in + i ), _mm_loadu_ps( window + i ) );
+		_mm_storeu_pd( out + i, _mm_cvtps_pd( x ) );
+		_mm_storeu_pd( out + i + 2, _mm_cvtps_pd( _mm_movehl_ps( x, x ) ) );
+	}
+#endif
+	for ( ; i < size; i++ )
+		out[i] = in[i] * window[i];
+}
+
 static int initFft( mlt_filter filter )
 {
 	int error = 0;
@@ -52,35 +201,32 @@ static int initFft( mlt_filter filter )
 	if( private->window_size < MIN_WINDOW_SIZE )
 	{
 		private->window_size = mlt_properties_get_int( filter_properties, "window_size" );
+		private->window_count = CLAMP( mlt_properties_get_int( filter_properties, "window_count" ), 1, MAX_WINDOW_COUNT );
 		if( private->window_size >= MIN_WINDOW_SIZE )
 		{
 			private->initialized = 1;
 			private->bin_count = private->window_size / 2 + 1;
+			// Successive windows overlap by half
+			private->hop_size = private->window_size / 2;
+			private->span = private->window_size + ( private->window_count - 1 ) * private->hop_size;
 			private->sample_buff_count = 0;
 			private->out_bins = mlt_pool_alloc( private->bin_count * sizeof(*private->out_bins));
+			snprintf( private->result_name, sizeof(private->result_name), "fft.%d.%d", private->window_size, private->window_count );
 
 			// Initialize sample buffer
-			private->sample_buff = mlt_pool_alloc( private->window_size * sizeof(*private->sample_buff));
-			memset( private->sample_buff, 0, sizeof(*private->sample_buff) * private->window_size );
+			private->sample_buff = mlt_pool_alloc( private->span * sizeof(*private->sample_buff));
+			memset( private->sample_buff, 0, sizeof(*private->sample_buff) * private->span );
 
 			// Initialize fftw variables
-			private->fft_in = fftw_alloc_real( private->window_size );
-			private->fft_out = fftw_alloc_complex( private->bin_count );
-			private->fft_plan = fftw_plan_dft_r2c_1d( private->window_size, private->fft_in, private->fft_out, FFTW_ESTIMATE );
-
-			// Initialize the hanning window function
-			private->hann = mlt_pool_alloc( private->window_size * sizeof(*private->hann));
-			int i = 0;
-			for ( i = 0; i < private->window_size; i++ )
-			{
-				private->hann[i] = 0.5 * (1 - cos( 2 * PI * i / private->window_size ) );
-			}
+			private->fft_in = fftw_alloc_real( private->window_size * private->window_count );
+			private->fft_out = fftw_alloc_complex( private->bin_count * private->window_count );
+			private->plan = get_plan( private->window_size, private->window_count );
 
 			mlt_properties_set_int( filter_properties, "bin_count", private->bin_count );
 			mlt_properties_set_data( filter_properties, "bins", private->out_bins, 0, 0, 0 );
 		}
 
-		if( private->window_size < MIN_WINDOW_SIZE || !private->fft_in || !private->fft_out || !private->fft_plan )
+		if( private->window_size < MIN_WINDOW_SIZE || !private->fft_in || !private->fft_out || !private->plan )
 		{
 			mlt_log_error( MLT_FILTER_SERVICE( filter ), "Unable to initialize FFT\n" );
 			error = 1;
@@ -90,10 +236,44 @@ static int initFft( mlt_filter filter )
 	return error;
 }
 
+static void transform( private_data* private )
+{
+	int window_size = private->window_size;
+	int bin_count = private->bin_count;
+	float scale = 4.0 / window_size / private->window_count;
+	int w = 0;
+	int bin = 0;
+
+	// Copy each window to the fft input while applying the window function
+	for( w = 0; w < private->window_count; w++ )
+	{
+		apply_window( private->fft_in + w * window_size,
+			private->sample_buff + w * private->hop_size,
+			private->plan->hann, window_size );
+	}
+
+	// Perform the whole batch of FFTs
+	fftw_execute_dft_r2c( private->plan->plan, private->fft_in, private->fft_out );
+
+	// Average the magnitudes of the windows
+	for( bin = 0; bin < bin_count; bin++ )
+	{
+		double sum = 0.0;
+		for( w = 0; w < private->window_count; w++ )
+		{
+			fftw_complex* out = private->fft_out + w * bin_count;
+			sum += sqrt( out[bin][0] * out[bin][0] + out[bin][1] * out[bin][1] );
+		}
+		// Scale to 0.0 - 1.0
+		private->out_bins[bin] = scale * sum;
+	}
+}
+
 static int filter_get_audio( mlt_frame frame, void** buffer, mlt_audio_format* format, int* frequency, int* channels, int* samples )
 {
 	mlt_filter filter = (mlt_filter)mlt_frame_pop_audio( frame );
 	mlt_properties filter_properties = MLT_FILTER_PROPERTIES( filter );
+	mlt_properties frame_properties = MLT_FRAME_PROPERTIES( frame );
 	private_data* private = (private_data*)filter->child;
 	int c = 0;
 	int s = 0;
@@ -116,10 +296,12 @@ static int filter_get_audio( mlt_frame frame, void** buffer, mlt_audio_format* f
 
 	if( !initFft( filter ) )
 	{
+		int span = private->span;
+
 		if( private->expected_pos != mlt_frame_get_position( frame ) )
 		{
 			// Reset the sample buffer when seeking occurs.
-			memset( private->sample_buff, 0, sizeof(*private->sample_buff) * private->window_size );
+			memset( private->sample_buff, 0, sizeof(*private->sample_buff) * span );
 			private->sample_buff_count = 0;
 			mlt_log_info( MLT_FILTER_SERVICE(filter), "Buffer Reset %d:%d\n",
 							private->expected_pos,
@@ -129,51 +311,50 @@ static int filter_get_audio( mlt_frame frame, void** buffer, mlt_audio_format* f
 
 		int new_samples = 0;
 		int old_samples = 0;
-		if( *samples >= private->window_size )
+		if( *samples >= span )
 		{
 			// Ignore samples that don't fit in the window
-			new_samples = private->window_size;
+			new_samples = span;
 			old_samples = 0;
 		}
 		else
 		{
 			new_samples = *samples;
 			// Shift the previous samples (discarding oldest samples)
-			old_samples = private->window_size - new_samples;
+			old_samples = span - new_samples;
 			memmove( private->sample_buff, private->sample_buff + new_samples, sizeof(*private->sample_buff) * old_samples);
 		}
 
 		// Zero out the space for the new samples
-		memset( private->sample_buff + old_samples, 0, sizeof(*private->sample_buff) * new_samples );
+		float* dst = private->sample_buff + old_samples;
+		memset( dst, 0, sizeof(*private->sample_buff) * new_samples );
 
 		// Copy the new samples into the sample buffer
 		if( *format == mlt_audio_s16 )
 		{
 			int16_t* aud = (int16_t*)*buffer;
+			// Scale to +/-1
+			float scale = 1.0 / MAX_S16_AMPLITUDE / *channels;
 			// For each sample, add all channels
 			for( c = 0; c < *channels; c++ )
 			{
 				for( s = 0; s < new_samples; s++ )
 				{
-					double sample = aud[s * *channels + c];
-					// Scale to +/-1
-					sample /= MAX_S16_AMPLITUDE;
-					sample /= (double)*channels;
-					private->sample_buff[old_samples + s] += sample;
+					dst[s] += scale * aud[s * *channels + c];
 				}
 			}
 		}
 		else if( *format == mlt_audio_float )
 		{
 			float* aud = (float*)*buffer;
+			float scale = 1.0 / *channels;
 			// For each sample, add all channels
 			for( c = 0; c < *channels; c++ )
 			{
+				const float* src = aud + c * *samples;
 				for( s = 0; s < new_samples; s++ )
 				{
-					double sample = aud[c * *samples + s];
-					sample /= (double)*channels;
-					private->sample_buff[old_samples + s] += sample;
+					dst[s] += scale * src[s];
 				}
 			}
 		}
@@ -187,24 +368,24 @@ static int filter_get_audio( mlt_frame frame, void** buffer, mlt_audio_format* f
 			private->sample_buff_count = private->window_size;
 		}
 
-		// Copy samples to fft input while applying window function
-		for (s = 0; s < private->window_size; s++)
+		// Reuse the transform of another instance that saw the same samples
+		int result_size = sizeof(shared_result) + private->bin_count * sizeof(float);
+		uint64_t hash = hash_samples( private->sample_buff, span );
+		shared_result* result = mlt_properties_get_data( frame_properties, private->result_name, NULL );
+		if( result && result->hash == hash )
 		{
-			private->fft_in[s] = private->sample_buff[s] * private->hann[s];
+			memcpy( private->out_bins, result->bins, private->bin_count * sizeof(float) );
 		}
-
-		// Perform the FFT
-		fftw_execute( private->fft_plan );
-
-		// Convert to magnitudes
-		int bin = 0;
-		for( bin = 0; bin < private->bin_count; bin++ )
+		else
 		{
-			// Convert FFT output to magnitudes
-			private->out_bins[bin] = sqrt( private->fft_out[bin][0] * private->fft_out[bin][0]
-												+ private->fft_out[bin][1] * private->fft_out[bin][1] );
-			// Scale to 0.0 - 1.0
-			private->out_bins[bin] = (4.0 * private->out_bins[bin]) / (float)private->window_size;
+			transform( private );
+			result = mlt_pool_alloc( result_size );
+			if( result )
+			{
+				result->hash = hash;
+				memcpy( result->bins, private->out_bins, private->bin_count * sizeof(float) );
+				mlt_properties_set_data( frame_properties, private->result_name, result, result_size, mlt_pool_release, NULL );
+			}
 		}
 
 		private->expected_pos++;
@@ -236,9 +417,7 @@ static void filter_close( mlt_filter filter )
 	{
 		fftw_free( private->fft_in );
 		fftw_free( private->fft_out );
-		fftw_destroy_plan( private->fft_plan );
 		mlt_pool_release( private->sample_buff );
-		mlt_pool_release( private->hann );
 		mlt_pool_release( private->out_bins );
 		free( private );
 	}
@@ -260,6 +439,7 @@ mlt_filter filter_fft_init( mlt_profile profile, mlt_service_type type, const ch
 		mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
 		mlt_properties_set_int( properties, "_filter_private", 1 );
 		mlt_properties_set_int( properties, "window_size", 2048 );
+		mlt_properties_set_int( properties, "window_count", 1 );
 		mlt_properties_set_double( properties, "window_level", 0.0 );
 		mlt_properties_set_double( properties, "bin_width", 0.0 );
 		mlt_properties_set_int( properties, "bin_count", 0 );
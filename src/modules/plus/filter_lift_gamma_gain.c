@@ -107,25 +107,32 @@ static void refresh_lut( mlt_filter filter, mlt_frame frame )
 	}
 }
 
-static void apply_lut( mlt_filter filter, uint8_t* image, mlt_image_format format, int width, int height )
+struct sliced_desc
 {
-	private_data* self = (private_data*)filter->child;
-	uint8_t* rlut = malloc( sizeof(self->rlut) );
-	uint8_t* glut = malloc( sizeof(self->glut) );
-	uint8_t* blut = malloc( sizeof(self->blut) );
-	int total = width * height + 1;
-	uint8_t* sample = image;
+	uint8_t *image;
+	mlt_image_format format;
+	int width;
+	int height;
+	uint8_t rlut[256];
+	uint8_t glut[256];
+	uint8_t blut[256];
+};
 
-	// Copy the LUT so that we can be frame-thread safe.
-	mlt_service_lock( MLT_FILTER_SERVICE( filter ) );
-	memcpy( rlut, self->rlut, sizeof(self->rlut) );
-	memcpy( glut, self->glut, sizeof(self->glut) );
-	memcpy( blut, self->blut, sizeof(self->blut) );
-	mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
+static int sliced_proc( int id, int index, int jobs, void* cookie )
+{
+	(void) id; // unused
+	struct sliced_desc* ctx = ( (struct sliced_desc*) cookie );
+	int slice_line_start, slice_height = mlt_slices_size_slice( jobs, index, ctx->height, &slice_line_start );
+	int total = ctx->width * slice_height + 1;
+	uint8_t* rlut = ctx->rlut;
+	uint8_t* glut = ctx->glut;
+	uint8_t* blut = ctx->blut;
+	uint8_t* sample;
 
-	switch( format )
+	switch( ctx->format )
 	{
 	case mlt_image_rgb24:
+		sample = ctx->image + slice_line_start * ctx->width * 3;
 		while( --total )
 		{
 			*sample = rlut[ *sample ];
@@ -137,6 +144,7 @@ static void apply_lut( mlt_filter filter, uint8_t* image, mlt_image_format forma
 		}
 		break;
 	case mlt_image_rgb24a:
+		sample = ctx->image + slice_line_start * ctx->width * 4;
 		while( --total )
 		{
 			*sample = rlut[ *sample ];
@@ -149,12 +157,35 @@ static void apply_lut( mlt_filter filter, uint8_t* image, mlt_image_format forma
 		}
 		break;
 	default:
-		mlt_log_error( MLT_FILTER_SERVICE( filter ), "Invalid image format: %s\n", mlt_image_format_name( format ) );
 		break;
 	}
-	free( rlut );
-	free( glut );
-	free( blut );
+	return 0;
+}
+
+static void apply_lut( mlt_filter filter, uint8_t* image, mlt_image_format format, int width, int height )
+{
+	private_data* self = (private_data*)filter->child;
+	struct sliced_desc desc;
+
+	if ( format != mlt_image_rgb24 && format != mlt_image_rgb24a )
+	{
+		mlt_log_error( MLT_FILTER_SERVICE( filter ), "Invalid image format: %s\n", mlt_image_format_name( format ) );
+		return;
+	}
+
+	desc.image = image;
+	desc.format = format;
+	desc.width = width;
+	desc.height = height;
+
+	// Copy the LUT so that we can be frame-thread safe.
+	mlt_service_lock( MLT_FILTER_SERVICE( filter ) );
+	memcpy( desc.rlut, self->rlut, sizeof(self->rlut) );
+	memcpy( desc.glut, self->glut, sizeof(self->glut) );
+	memcpy( desc.blut, self->blut, sizeof(self->blut) );
+	mlt_service_unlock( MLT_FILTER_SERVICE( filter ) );
+
+	mlt_slices_run_normal( 0, sliced_proc, &desc );
 }
 
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
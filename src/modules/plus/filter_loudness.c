@@ -22,9 +22,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
 #include <ebur128.h>
 
 #define MAX_RESULT_SIZE 512
+#define MIN_CHUNK_SECONDS 10
 
 typedef struct
 {
@@ -90,6 +92,222 @@ static void init_apply_data( mlt_filter filter )
 	}
 }
 
+typedef struct
+{
+	mlt_filter filter;
+	mlt_producer *producers;
+	int threads;
+	mlt_position start;
+	mlt_position length;
+	mlt_position chunk_length;
+	int chunks;
+	int next_chunk;
+	pthread_mutex_t mutex;
+	int channels;
+	int frequency;
+	double fps;
+	ebur128_state **states;
+} parallel_analysis;
+
+typedef struct
+{
+	parallel_analysis *analysis;
+	mlt_producer producer;
+} parallel_worker;
+
+static void store_results( mlt_filter filter, double loudness, double range, double peak )
+{
+	char result[MAX_RESULT_SIZE];
+
+	snprintf( result, MAX_RESULT_SIZE, "L: %lf\tR: %lf\tP %lf", loudness, range, peak );
+	result[ MAX_RESULT_SIZE - 1 ] = '\0';
+	mlt_log_info( MLT_FILTER_SERVICE( filter ), "Stored results: %s\n", result );
+	mlt_properties_set( MLT_FILTER_PROPERTIES( filter ), "results", result );
+}
+
+/** Make an independent copy of the service the filter is attached to.
+ *
+ * The copy is made through XML so that it has its own producers and decoders.
+ * The copy of this filter and the filters after it are removed from the copy.
+ */
+
+static mlt_producer clone_input( mlt_filter filter, const char *xml, int filter_index )
+{
+	mlt_profile profile = mlt_service_profile( MLT_FILTER_SERVICE( filter ) );
+	mlt_producer producer = mlt_factory_producer( profile, "xml-string", xml );
+
+	if ( producer )
+	{
+		mlt_service service = MLT_PRODUCER_SERVICE( producer );
+		mlt_filter copy;
+		while ( ( copy = mlt_service_filter( service, filter_index ) ) )
+			mlt_service_detach( service, copy );
+	}
+	return producer;
+}
+
+/** Analyze chunks of the input until there are none left.
+*/
+
+static void *analyze_chunks( void *arg )
+{
+	parallel_worker *worker = arg;
+	parallel_analysis *analysis = worker->analysis;
+	int chunk;
+
+	while ( 1 )
+	{
+		pthread_mutex_lock( &analysis->mutex );
+		chunk = analysis->next_chunk++;
+		pthread_mutex_unlock( &analysis->mutex );
+		if ( chunk >= analysis->chunks )
+			break;
+
+		ebur128_state *state = analysis->states[ chunk ];
+		mlt_position first = chunk * analysis->chunk_length;
+		mlt_position last = MIN( first + analysis->chunk_length, analysis->length );
+		mlt_position pos;
+
+		for ( pos = first; pos < last; pos++ )
+		{
+			mlt_frame frame = NULL;
+			mlt_producer_seek( worker->producer, analysis->start + pos );
+			if ( mlt_service_get_frame( MLT_PRODUCER_SERVICE( worker->producer ), &frame, 0 ) || !frame )
+				break;
+
+			mlt_audio_format format = mlt_audio_f32le;
+			int frequency = analysis->frequency;
+			int channels = analysis->channels;
+			int samples = mlt_sample_calculator( analysis->fps, frequency, mlt_frame_get_position( frame ) );
+			void *buffer = NULL;
+			mlt_frame_get_audio( frame, &buffer, &format, &frequency, &channels, &samples );
+			if ( buffer && format == mlt_audio_f32le && channels == analysis->channels )
+				ebur128_add_frames_float( state, buffer, samples );
+			mlt_frame_close( frame );
+		}
+	}
+	return NULL;
+}
+
+/** Measure the whole range of the filter at once.
+ *
+ * The range is split into chunks that are analyzed by several threads, each
+ * with its own copy of the input, into independent histogram mode states.
+ * The states are merged to compute the results. Blocks that straddle the
+ * chunk boundaries are not measured, which is negligible with chunks of at
+ * least MIN_CHUNK_SECONDS.
+ *
+ * Returns true if the analysis could not be done this way.
+ */
+
+static int analyze_parallel( mlt_filter filter, mlt_frame frame, int threads, int channels, int frequency )
+{
+	mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
+	mlt_service input = mlt_properties_get_data( properties, "service", NULL );
+	mlt_profile profile = mlt_service_profile( MLT_FILTER_SERVICE( filter ) );
+	parallel_analysis analysis;
+	int filter_index = -1;
+	int error = 1;
+	int i;
+
+	mlt_service_type type = input ? mlt_service_identify( input ) : invalid_type;
+
+	if ( !profile || ( type != producer_type && type != tractor_type && type != playlist_type && type != multitrack_type ) )
+		return error;
+	for ( i = 0; filter_index < 0 && mlt_service_filter( input, i ); i++ )
+		if ( mlt_service_filter( input, i ) == filter )
+			filter_index = i;
+	if ( filter_index < 0 )
+		return error;
+
+	memset( &analysis, 0, sizeof( analysis ) );
+	analysis.filter = filter;
+	analysis.channels = channels;
+	analysis.frequency = frequency;
+	analysis.fps = mlt_profile_fps( profile );
+	analysis.length = mlt_filter_get_length2( filter, frame );
+	// Frame positions are already relative to the in point, as the seeks are
+	analysis.start = mlt_frame_get_position( frame ) - mlt_filter_get_position( filter, frame );
+	if ( analysis.length <= 0 )
+		return error;
+
+	// Give every thread two chunks on average to even out the load
+	analysis.chunk_length = MAX( ( analysis.length + threads * 2 - 1 ) / ( threads * 2 ), lrint( analysis.fps * MIN_CHUNK_SECONDS ) );
+	analysis.chunks = ( analysis.length + analysis.chunk_length - 1 ) / analysis.chunk_length;
+	threads = MIN( threads, analysis.chunks );
+
+	// Serialize the input once and load one copy of it per thread
+	mlt_consumer consumer = mlt_factory_consumer( profile, "xml", "string" );
+	char *xml = NULL;
+	if ( consumer )
+	{
+		mlt_consumer_connect( consumer, input );
+		mlt_consumer_start( consumer );
+		if ( mlt_properties_get( MLT_CONSUMER_PROPERTIES( consumer ), "string" ) )
+			xml = strdup( mlt_properties_get( MLT_CONSUMER_PROPERTIES( consumer ), "string" ) );
+		mlt_consumer_close( consumer );
+	}
+	if ( !xml )
+		return error;
+
+	parallel_worker *workers = calloc( threads, sizeof( parallel_worker ) );
+	pthread_t *thread_ids = calloc( threads, sizeof( pthread_t ) );
+	analysis.states = calloc( analysis.chunks, sizeof( ebur128_state* ) );
+	for ( i = 0; i < threads; i++ )
+	{
+		workers[i].analysis = &analysis;
+		workers[i].producer = clone_input( filter, xml, filter_index );
+		if ( !workers[i].producer )
+			break;
+	}
+	analysis.threads = i;
+	for ( i = 0; i < analysis.chunks; i++ )
+	{
+		analysis.states[i] = ebur128_init( (unsigned int) channels, (unsigned long) frequency,
+			EBUR128_MODE_I | EBUR128_MODE_LRA | EBUR128_MODE_SAMPLE_PEAK | EBUR128_MODE_HISTOGRAM );
+		if ( !analysis.states[i] )
+			analysis.threads = 0;
+	}
+
+	if ( analysis.threads > 0 )
+	{
+		mlt_log_info( MLT_FILTER_SERVICE( filter ), "Analyzing %d frames in %d chunks with %d threads\n",
+			analysis.length, analysis.chunks, analysis.threads );
+		pthread_mutex_init( &analysis.mutex, NULL );
+		for ( i = 1; i < analysis.threads; i++ )
+			pthread_create( &thread_ids[i], NULL, analyze_chunks, &workers[i] );
+		analyze_chunks( &workers[0] );
+		for ( i = 1; i < analysis.threads; i++ )
+			pthread_join( thread_ids[i], NULL );
+		pthread_mutex_destroy( &analysis.mutex );
+
+		double loudness = 0.0;
+		double range = 0.0;
+		double peak = 0.0;
+		ebur128_loudness_global_multiple( analysis.states, analysis.chunks, &loudness );
+		ebur128_loudness_range_multiple( analysis.states, analysis.chunks, &range );
+		for ( i = 0; i < analysis.chunks * channels; i++ )
+		{
+			double tmpPeak = 0.0;
+			ebur128_sample_peak( analysis.states[ i / channels ], i % channels, &tmpPeak );
+			peak = MAX( peak, tmpPeak );
+		}
+		store_results( filter, loudness, range, peak );
+		error = 0;
+	}
+
+	for ( i = 0; i < analysis.chunks; i++ )
+		if ( analysis.states[i] )
+			ebur128_destroy( &analysis.states[i] );
+	for ( i = 0; i < threads; i++ )
+		mlt_producer_close( workers[i].producer );
+	free( analysis.states );
+	free( thread_ids );
+	free( workers );
+	free( xml );
+	return error;
+}
+
 static void analyze( mlt_filter filter, mlt_frame frame, void **buffer, mlt_audio_format *format, int *frequency, int *channels, int *samples )
 {
 	private_data* private = (private_data*)filter->child;
@@ -105,6 +323,9 @@ static void analyze( mlt_filter filter, mlt_frame frame, void **buffer, mlt_audi
 	// Analyze Audio
 	if( !private->analyze && pos == 0 )
 	{
+		int threads = mlt_properties_get_int( MLT_FILTER_PROPERTIES( filter ), "analysis_threads" );
+		if ( threads > 1 && !analyze_parallel( filter, frame, threads, *channels, *frequency ) )
+			return;
 		init_analyze_data( filter, *channels, *frequency );
 	}
 
@@ -114,13 +335,11 @@ static void analyze( mlt_filter filter, mlt_frame frame, void **buffer, mlt_audi
 
 		if ( pos + 1 == mlt_filter_get_length2( filter, frame ) )
 		{
-			mlt_properties properties = MLT_FILTER_PROPERTIES( filter );
 			double loudness = 0.0;
 			double range = 0.0;
 			double tmpPeak = 0.0;
 			double peak = 0.0;
 			int i = 0;
-			char result[MAX_RESULT_SIZE];
 			ebur128_loudness_global( private->analyze->state, &loudness );
 			ebur128_loudness_range( private->analyze->state, &range );
 
@@ -133,10 +352,7 @@ static void analyze( mlt_filter filter, mlt_frame frame, void **buffer, mlt_audi
 				}
 			}
 
-			snprintf( result, MAX_RESULT_SIZE, "L: %lf\tR: %lf\tP %lf", loudness, range, peak );
-			result[ MAX_RESULT_SIZE - 1 ] = '\0';
-			mlt_log_info( MLT_FILTER_SERVICE( filter ), "Stored results: %s\n", result );
-			mlt_properties_set( properties, "results", result );
+			store_results( filter, loudness, range, peak );
 			destroy_analyze_data( filter );
 		}
 
@@ -21,6 +21,7 @@
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
 #include <framework/mlt_tokeniser.h>
+#include <framework/mlt_slices.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -58,6 +59,34 @@ static void fill_channel_lut(int lut[], char* channel_table_str)
 	mlt_tokeniser_close( tokeniser );
 }
 
+struct sliced_desc
+{
+	uint8_t *image;
+	int width;
+	int height;
+	int *r_lut;
+	int *g_lut;
+	int *b_lut;
+};
+
+static int sliced_proc( int id, int index, int jobs, void* cookie )
+{
+	(void) id; // unused
+	struct sliced_desc* ctx = ( (struct sliced_desc*) cookie );
+	int slice_line_start, slice_height = mlt_slices_size_slice( jobs, index, ctx->height, &slice_line_start );
+	int i = ctx->width * slice_height + 1;
+	uint8_t *p = ctx->image + slice_line_start * ctx->width * 3;
+	uint8_t *r = p;
+
+	while ( --i )
+	{
+		*p ++ = ctx->r_lut[ *r ++ ];
+		*p ++ = ctx->g_lut[ *r ++ ];
+		*p ++ = ctx->b_lut[ *r ++ ];
+	}
+	return 0;
+}
+
 /** Do it :-).
 */
 static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format *format, int *width, int *height, int writable )
@@ -86,15 +115,16 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 		fill_channel_lut( b_lut, b_str );
 
 		// Apply look-up tables into image
-		int i = *width * *height + 1;
-		uint8_t *p = *image;
-		uint8_t *r = *image;
-		while ( --i )
+		struct sliced_desc desc =
 		{
-			*p ++ = r_lut[ *r ++ ];
-			*p ++ = g_lut[ *r ++ ];
-			*p ++ = b_lut[ *r ++ ];
-		}
+			.image = *image,
+			.width = *width,
+			.height = *height,
+			.r_lut = r_lut,
+			.g_lut = g_lut,
+			.b_lut = b_lut
+		};
+		mlt_slices_run_normal( 0, sliced_proc, &desc );
 	}
 
 	return error;
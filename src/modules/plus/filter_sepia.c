@@ -19,11 +19,53 @@
 
 #include <framework/mlt_filter.h>
 #include <framework/mlt_frame.h>
+#include <framework/mlt_slices.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 
+struct sliced_desc
+{
+	uint8_t *image;
+	int width;
+	int height;
+	int u;
+	int v;
+};
+
+static int sliced_proc( int id, int index, int jobs, void* cookie )
+{
+	(void) id; // unused
+	struct sliced_desc* ctx = ( (struct sliced_desc*) cookie );
+	int slice_line_start, h = mlt_slices_size_slice( jobs, index, ctx->height, &slice_line_start );
+	uint8_t *p = ctx->image + slice_line_start * ctx->width * 2;
+	int uneven = ctx->width % 2;
+	int w = ( ctx->width - uneven ) / 2;
+	int u = ctx->u;
+	int v = ctx->v;
+	int t;
+
+	// Loop through the slice
+	while( h -- )
+	{
+		t = w;
+		while( t -- )
+		{
+			p ++;
+			*p ++ = u;
+			p ++;
+			*p ++ = v;
+		}
+		if ( uneven )
+		{
+			p ++;
+			*p ++ = u;
+		}
+	}
+	return 0;
+}
+
 /** Do it :-).
 */
 
@@ -42,34 +84,18 @@ static int filter_get_image( mlt_frame frame, uint8_t **image, mlt_image_format
 	// Only process if we have no error and a valid colour space
 	if ( error == 0 && *image )
 	{
-		// We modify the whole image
-		uint8_t *p = *image;
-		int h = *height;
-		int uneven = *width % 2;
-		int w = ( *width - uneven ) / 2;
-		int t;
-
 		// Get u and v values
-		int u = mlt_properties_anim_get_int( properties, "u", position, length );
-		int v = mlt_properties_anim_get_int( properties, "v", position, length );
-
-		// Loop through image
-		while( h -- )
+		struct sliced_desc desc =
 		{
-			t = w;
-			while( t -- )
-			{
-				p ++;
-				*p ++ = u;
-				p ++;
-				*p ++ = v;
-			}
-			if ( uneven )
-			{
-				p ++;
-				*p ++ = u;
-			}
-		}
+			.image = *image,
+			.width = *width,
+			.height = *height,
+			.u = mlt_properties_anim_get_int( properties, "u", position, length ),
+			.v = mlt_properties_anim_get_int( properties, "v", position, length )
+		};
+
+		// We modify the whole image
+		mlt_slices_run_normal( 0, sliced_proc, &desc );
 	}
 
 	return error;
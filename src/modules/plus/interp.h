@@ -320,6 +320,133 @@ int interpBC_b32(unsigned char *sl, int w, int h, float x, float y, float o, uns
 	return 0;
 }
 
+//------------------------------------------------------
+//nearest neighbour, 16 bit values in packed color 64 bit format
+//(native endian rgba64), otherwise the same as interpNN_b32
+int interpNN_b64(unsigned char *sl8, int w, int h, float x, float y, float o, unsigned char *v8, int is_atop)
+{
+	uint16_t *sl = (uint16_t*) sl8;
+	uint16_t *v = (uint16_t*) v8;
+#ifdef TEST_XY_LIMITS
+	if ((x<0)||(x>=w)||(y<0)||(y>=h)) return -1;
+#endif
+	int p = (int) rintf(x) * 4 + (int) rintf(y) * 4 * w;
+	float alpha_sl = (float) sl[p + 3] / 65535.0f * o;
+	float alpha_v = (float) v[3] / 65535.0f;
+	float alpha = alpha_sl + alpha_v - alpha_sl * alpha_v;
+	v[3] = is_atop? sl[p + 3] : (65535 * alpha);
+	alpha = alpha_sl / alpha;
+	v[0] = v[0] * (1.0f - alpha) + sl[p] * alpha;
+	v[1] = v[1] * (1.0f - alpha) + sl[p + 1] * alpha;
+	v[2] = v[2] * (1.0f - alpha) + sl[p + 2] * alpha;
+
+	return 0;
+}
+
+//------------------------------------------------------
+//bilinear, 16 bit values in packed color 64 bit format
+int interpBL_b64(unsigned char *sl8, int w, int h, float x, float y, float o, unsigned char *v8, int is_atop)
+{
+	uint16_t *sl = (uint16_t*) sl8;
+	uint16_t *v = (uint16_t*) v8;
+	int m,n,k,l,k1,l1,c;
+	float a,b,fx,fy;
+
+#ifdef TEST_XY_LIMITS
+	if ((x<0)||(x>=w)||(y<0)||(y>=h)) return -1;
+#endif
+
+	m=(int)floorf(x);
+	if (m + 2 > w) m = w - 2;
+	n=(int)floorf(y);
+	if (n + 2 > h) n = h - 2;
+	fx = x - (float)m;
+	fy = y - (float)n;
+
+	k=4*(n*w+m); l=4*((n+1)*w+m);
+	k1=k+4; l1=l+4;
+
+	a=sl[k+3]+(sl[k1+3]-sl[k+3])*fx;
+	b=sl[l+3]+(sl[l1+3]-sl[l+3])*fx;
+
+	float alpha_sl = a+(b-a)*fy;
+	float alpha_v = (float) v[3] / 65535.0f;
+	if (is_atop) v[3] = alpha_sl;
+	alpha_sl = alpha_sl / 65535.0f * o;
+	float alpha = alpha_sl + alpha_v - alpha_sl * alpha_v;
+	if (!is_atop) v[3] = 65535 * alpha;
+	alpha = alpha_sl / alpha;
+
+	for (c=0;c<3;c++)
+	{
+		a=sl[k+c]+(sl[k1+c]-sl[k+c])*fx;
+		b=sl[l+c]+(sl[l1+c]-sl[l+c])*fx;
+		v[c]= v[c] * (1.0f - alpha) + (a+(b-a)*fy) * alpha;
+	}
+
+	return 0;
+}
+
+//------------------------------------------------------
+//bicubic "smooth", 16 bit values in packed color 64 bit format
+int interpBC_b64(unsigned char *sl8, int w, int h, float x, float y, float o, unsigned char *v8, int is_atop)
+{
+	uint16_t *sl = (uint16_t*) sl8;
+	uint16_t *v = (uint16_t*) v8;
+	int i,j,b,l,m,n;
+	float k;
+	float p[4],p1[4],p2[4],p3[4],p4[4];
+	float alpha = 1.0;
+
+#ifdef TEST_XY_LIMITS
+	if ((x<0)||(x>=w)||(y<0)||(y>=h)) return -1;
+#endif
+
+	m=(int)ceilf(x)-2; if (m<0) m=0; if ((m+5)>w) m=w-4;
+	n=(int)ceilf(y)-2; if (n<0) n=0; if ((n+5)>h) n=h-4;
+
+	for (b=3;b>-1;b--)
+	{
+		for (i=0;i<4;i++)
+		{
+			l=m+(i+n)*w;
+			p1[i]=sl[4*l+b];
+			p2[i]=sl[4*(l+1)+b];
+			p3[i]=sl[4*(l+2)+b];
+			p4[i]=sl[4*(l+3)+b];
+		}
+		for (j=1;j<4;j++)
+			for (i=3;i>=j;i--)
+			{
+				k=(y-i-n)/j;
+				p1[i]=p1[i]+k*(p1[i]-p1[i-1]);
+				p2[i]=p2[i]+k*(p2[i]-p2[i-1]);
+				p3[i]=p3[i]+k*(p3[i]-p3[i-1]);
+				p4[i]=p4[i]+k*(p4[i]-p4[i-1]);
+			}
+
+		p[0]=p1[3]; p[1]=p2[3]; p[2]=p3[3]; p[3]=p4[3];
+		for (j=1;j<4;j++)
+			for (i=3;i>=j;i--)
+				p[i]=p[i]+(x-i-m)/j*(p[i]-p[i-1]);
+
+		if (p[3] < 0.0f) p[3] = 0.0f;
+		if (p[3] > 65535.0f) p[3] = 65535.0f;
+
+		if (b == 3) {
+			float alpha_sl = (float) p[3] / 65535.0f * o;
+			float alpha_v = (float) v[3] / 65535.0f;
+			alpha = alpha_sl + alpha_v - alpha_sl * alpha_v;
+			v[3] = is_atop? p[3] : (65535 * alpha);
+			alpha = alpha_sl / alpha;
+		} else {
+			v[b] = v[b] * (1.0f - alpha) + p[3] * alpha;
+		}
+	}
+
+	return 0;
+}
+
 //------------------------------------------------------
 //bikubicna interpolacija  "sharp"
 //za byte (char) vrednosti
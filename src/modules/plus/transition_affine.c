@@ -395,6 +395,7 @@ struct sliced_desc
 	double dz, mix;
 	double x_offset, y_offset;
 	int b_alpha;
+	int bpp;
 	double minima, xmax, ymax;
 };
 
@@ -408,7 +409,7 @@ static int sliced_proc( int id, int index, int jobs, void* cookie )
 	double dx, dy;
 	int i, j;
 
-	ctx.a_image += (index * height_slice) * (ctx.a_width * 4);
+	ctx.a_image += (index * height_slice) * (ctx.a_width * ctx.bpp);
 	for (i = 0, y = ctx.lower_y; i < ctx.a_height; i++, y++) {
 		if (i >= starty && i < (starty + height_slice)) {
 			for (j = 0, x = ctx.lower_x; j < ctx.a_width; j++, x++) {
@@ -416,7 +417,7 @@ static int sliced_proc( int id, int index, int jobs, void* cookie )
 				dy = MapY( ctx.affine.matrix, x, y ) / ctx.dz + ctx.y_offset;
 				if (dx >= ctx.minima && dx <= ctx.xmax && dy >= ctx.minima && dy <= ctx.ymax)
 					ctx.interp(ctx.b_image, ctx.b_width, ctx.b_height, dx, dy, ctx.mix, ctx.a_image, ctx.b_alpha);
-				ctx.a_image += 4;
+				ctx.a_image += ctx.bpp;
 			}
 		}
 	}
@@ -482,8 +483,10 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 		*height = normalised_height;
 	}
 	
-	// Fetch the a frame image
-	*format = mlt_image_rgb24a;
+	// Fetch the a frame image, keeping 16 bits per component when requested
+	if ( *format != mlt_image_rgba64 )
+		*format = mlt_image_rgb24a;
+	b_format = *format;
 	int error = mlt_frame_get_image( a_frame, image, format, width, height, 1 );
 	if (error || !image)
 		return error;
@@ -601,8 +604,9 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 	}
 
 	// Check that both images are of the correct format and process
-	if ( *format == mlt_image_rgb24a && b_format == mlt_image_rgb24a )
+	if ( ( *format == mlt_image_rgb24a || *format == mlt_image_rgba64 ) && b_format == *format )
 	{
+		int is_rgba64 = *format == mlt_image_rgba64;
 		double sw, sh;
 		// Get values from the transition
 		double scale_x = mlt_properties_anim_get_double( properties, "scale_x", position, length );
@@ -613,7 +617,7 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 		struct sliced_desc desc = {
 			.a_image = *image,
 			.b_image = b_image,
-			.interp = interpBL_b32,
+			.interp = is_rgba64 ? interpBL_b64 : interpBL_b32,
 			.a_width = *width,
 			.a_height = *height,
 			.b_width = b_width,
@@ -624,6 +628,7 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 			.x_offset = (double) b_width / 2.0,
 			.y_offset = (double) b_height / 2.0,
 			.b_alpha = mlt_properties_get_int( properties, "b_alpha" ),
+			.bpp = is_rgba64 ? 8 : 4,
 			// Affine boundaries
 			.minima = 0,
 			.xmax = b_width - 1,
@@ -700,7 +705,7 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 		// Set the interpolation function
 		if ( interps == NULL || strcmp( interps, "nearest" ) == 0 || strcmp( interps, "neighbor" ) == 0 || strcmp( interps, "tiles" ) == 0 || strcmp( interps, "fast_bilinear" ) == 0 )
 		{
-			desc.interp = interpNN_b32;
+			desc.interp = is_rgba64 ? interpNN_b64 : interpNN_b32;
 			// uses lrintf. Values should be >= -0.5 and < max + 0.5
 			desc.minima -= 0.5;
 			desc.xmax += 0.49;
@@ -708,14 +713,14 @@ static int transition_get_image( mlt_frame a_frame, uint8_t **image, mlt_image_f
 		}
 		else if ( strcmp( interps, "bilinear" ) == 0 )
 		{
-			desc.interp = interpBL_b32;
+			desc.interp = is_rgba64 ? interpBL_b64 : interpBL_b32;
 			// uses floorf.
 		}
 		else if ( strcmp( interps, "bicubic" ) == 0 ||  strcmp( interps, "hyper" ) == 0 || strcmp( interps, "sinc" ) == 0 || strcmp( interps, "lanczos" ) == 0 || strcmp( interps, "spline" ) == 0 )
 		{
 			// TODO: lanczos 8x8
 			// TODO: spline 4x4 or 6x6
-			desc.interp = interpBC_b32;
+			desc.interp = is_rgba64 ? interpBC_b64 : interpBC_b32;
 			// uses ceilf. Values should be > -1 and <= max.
 			desc.minima -= 1;
 		}
@@ -48,9 +48,9 @@ static void refresh_length( mlt_properties properties, producer_qimage self )
 	}
 }
 
-static void on_property_changed( mlt_service owner, mlt_producer producer, char *name )
+static void on_properties_changed( mlt_service owner, mlt_producer producer, mlt_properties names )
 {
-	if ( !strcmp( name, "ttl" ) )
+	if ( mlt_properties_get( names, "ttl" ) )
 		refresh_length( MLT_PRODUCER_PROPERTIES(producer), producer->child );
 }
 
@@ -111,7 +111,7 @@ mlt_producer producer_qimage_init( mlt_profile profile, mlt_service_type type, c
 		}
 		else
 		{
-			mlt_events_listen( properties, self, "property-changed", (mlt_listener) on_property_changed );
+			mlt_events_listen( properties, self, "properties-changed", (mlt_listener) on_properties_changed );
 		}
 		return producer;
 	}
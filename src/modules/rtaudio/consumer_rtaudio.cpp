@@ -63,10 +63,7 @@ public:
 	int                   joined;
 	int                   running;
 	int                   out_channels;
-	uint8_t               audio_buffer[4096 * 10];
-	int                   audio_avail;
-	pthread_mutex_t       audio_mutex;
-	pthread_cond_t        audio_cond;
+	mlt_audio_ring        audio_ring;
 	pthread_mutex_t       video_mutex;
 	pthread_cond_t        video_cond;
 	int                   playing;
@@ -84,7 +81,7 @@ public:
 		, queue(NULL)
 		, joined(0)
 		, running(0)
-		, audio_avail(0)
+		, audio_ring(NULL)
 		, playing(0)
 		, refresh_count(0)
 		, is_purge(false)
@@ -98,8 +95,6 @@ public:
 		mlt_deque_close( queue );
 
 		// Destroy mutexes
-		pthread_mutex_destroy( &audio_mutex );
-		pthread_cond_destroy( &audio_cond );
 		pthread_mutex_destroy( &video_mutex );
 		pthread_cond_destroy( &video_cond );
 		pthread_mutex_destroy( &refresh_mutex );
@@ -109,6 +104,9 @@ public:
 			rt->closeStream();
 		delete rt;
 		rt = NULL;
+
+		// The stream is closed so nothing reads the ring any more
+		mlt_audio_ring_close( audio_ring );
 	}
 
 	bool create_rtaudio( RtAudio::Api api, int channels, int frequency )
@@ -181,6 +179,11 @@ public:
 			}
 		}
 
+		// Hold as much audio as the former fixed 40 KiB buffer did
+		mlt_audio_ring_close( audio_ring );
+		audio_ring = mlt_audio_ring_init( mlt_audio_s16, channels, frequency, 4096 * 10 / ( channels * sizeof( int16_t ) ) );
+		out_channels = channels;
+
 		try {
 			if ( rt->isStreamOpen() ) {
 				 rt->closeStream();
@@ -272,8 +275,6 @@ public:
 		mlt_properties_set_double( properties, "volume", 1.0 );
 
 		// This is the initialisation of the consumer
-		pthread_mutex_init( &audio_mutex, NULL );
-		pthread_cond_init( &audio_cond, NULL);
 		pthread_mutex_init( &video_mutex, NULL );
 		pthread_cond_init( &video_cond, NULL);
 
@@ -335,11 +336,6 @@ public:
 			pthread_cond_broadcast( &video_cond );
 			pthread_mutex_unlock( &video_mutex );
 
-			// Unlatch the audio callback
-			pthread_mutex_lock( &audio_mutex );
-			pthread_cond_broadcast( &audio_cond );
-			pthread_mutex_unlock( &audio_mutex );
-
 			if ( rt && rt->isStreamOpen() )
 			try {
 				// Stop the stream
@@ -506,7 +502,8 @@ public:
 		while( mlt_deque_count( queue ) )
 			mlt_frame_close( (mlt_frame) mlt_deque_pop_back( queue ) );
 
-		audio_avail = 0;
+		if ( audio_ring )
+			mlt_audio_ring_flush( audio_ring );
 	}
 
 	int callback( int16_t *outbuf, int16_t *inbuf,
@@ -514,36 +511,12 @@ public:
 	{
 		mlt_properties properties = MLT_CONSUMER_PROPERTIES( getConsumer() );
 		double volume = mlt_properties_get_double( properties, "volume" );
-		int len = mlt_audio_format_size( mlt_audio_s16, samples, out_channels );
-
-		pthread_mutex_lock( &audio_mutex );
-
-		// Block until audio received
-		while ( running && len > audio_avail )
-			pthread_cond_wait( &audio_cond, &audio_mutex );
-
-		if ( audio_avail >= len )
-		{
-			// Place in the audio buffer
-			memcpy( outbuf, audio_buffer, len );
-
-			// Remove len from the audio available
-			audio_avail -= len;
 
-			// Remove the samples
-			memmove( audio_buffer, audio_buffer + len, audio_avail );
-		}
+		// Take what is buffered, the rest is silence
+		if ( audio_ring )
+			samples = mlt_audio_ring_read( audio_ring, outbuf, samples );
 		else
-		{
-			// Just to be safe, wipe the stream first
-			memset( outbuf, 0, len );
-
-			// Copy what we have
-			memcpy( outbuf, audio_buffer, audio_avail );
-
-			// No audio left
-			audio_avail = 0;
-		}
+			memset( outbuf, 0, mlt_audio_format_size( mlt_audio_s16, samples, out_channels ) );
 
 		if ( volume != 1.0 )
 		{
@@ -556,9 +529,6 @@ public:
 		// We're definitely playing now
 		playing = 1;
 
-		pthread_cond_broadcast( &audio_cond );
-		pthread_mutex_unlock( &audio_mutex );
-
 		return 0;
 	}
 
@@ -600,62 +570,49 @@ public:
 			}
 		}
 
-		if ( init_audio == 0 )
+		if ( init_audio == 0 && audio_ring )
 		{
 			mlt_properties properties = MLT_FRAME_PROPERTIES( frame );
+			int16_t *remapped = NULL;
 			int samples_copied = 0;
-			int dst_stride = out_channels * sizeof( *pcm );
+			bool silent = !scrub && mlt_properties_get_double( properties, "_speed" ) != 1;
 
-			pthread_mutex_lock( &audio_mutex );
+			// Match the channel count of the device
+			if ( !silent && channels != out_channels )
+			{
+				int dst_stride = out_channels * sizeof( *pcm );
+				int16_t *dest = remapped = (int16_t*) mlt_pool_alloc( samples * dst_stride );
+				int i = samples + 1;
+				while ( --i )
+				{
+					memcpy( dest, pcm, dst_stride );
+					pcm += channels;
+					dest += out_channels;
+				}
+				pcm = remapped;
+			}
 
 			while ( running && samples_copied < samples )
 			{
-				int sample_space = ( sizeof( audio_buffer ) - audio_avail ) / dst_stride;
+				int sample_space = mlt_audio_ring_wait( audio_ring, 1, 100 );
 
-				while ( running && sample_space == 0 )
-				{
-					pthread_cond_wait( &audio_cond, &audio_mutex );
-					sample_space = ( sizeof( audio_buffer ) - audio_avail ) / dst_stride;
-				}
-				if ( running )
+				if ( running && sample_space > 0 )
 				{
 					int samples_to_copy = samples - samples_copied;
 					if ( samples_to_copy > sample_space )
 					{
 						samples_to_copy = sample_space;
 					}
-					int dst_bytes = samples_to_copy * dst_stride;
 
-					if ( scrub || mlt_properties_get_double( properties, "_speed" ) == 1 )
-					{
-						if ( channels == out_channels )
-						{
-							memcpy( &audio_buffer[ audio_avail ], pcm, dst_bytes );
-							pcm += samples_to_copy * channels;
-						}
-						else
-						{
-							int16_t *dest = (int16_t*) &audio_buffer[ audio_avail ];
-							int i = samples_to_copy + 1;
-							while ( --i )
-							{
-								memcpy( dest, pcm, dst_stride );
-								pcm += channels;
-								dest += out_channels;
-							}
-						}
-					}
+					if ( silent )
+						mlt_audio_ring_write_silence( audio_ring, samples_to_copy );
 					else
-					{
-						memset( &audio_buffer[ audio_avail ], 0, dst_bytes );
-						pcm += samples_to_copy * channels;
-					}
-					audio_avail += dst_bytes;
+						mlt_audio_ring_write( audio_ring, pcm + samples_copied * out_channels, samples_to_copy );
 					samples_copied += samples_to_copy;
 				}
-				pthread_cond_broadcast( &audio_cond );
 			}
-			pthread_mutex_unlock( &audio_mutex );
+			mlt_pool_release( remapped );
+			mlt_audio_ring_publish_stats( audio_ring, MLT_CONSUMER_PROPERTIES( getConsumer() ) );
 		}
 
 		return init_audio;
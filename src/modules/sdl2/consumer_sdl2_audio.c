@@ -25,6 +25,8 @@
 #include <framework/mlt_factory.h>
 #include <framework/mlt_filter.h>
 #include <framework/mlt_log.h>
+#include <framework/mlt_pool.h>
+#include <framework/mlt_audio_ring.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -48,13 +50,12 @@ struct consumer_sdl_s
 	pthread_t thread;
 	int joined;
 	atomic_int running;
-	uint8_t audio_buffer[ 4096 * 10 ];
-	int audio_avail;
-	pthread_mutex_t audio_mutex;
-	pthread_cond_t audio_cond;
+	mlt_audio_ring audio_ring;
+	SDL_AudioDeviceID audio_device;
 	pthread_mutex_t video_mutex;
 	pthread_cond_t video_cond;
 	int out_channels;
+	int out_frequency;
 	atomic_int playing;
 
 	pthread_cond_t refresh_cond;
@@ -106,8 +107,6 @@ mlt_consumer consumer_sdl2_audio_init( mlt_profile profile, mlt_service_type typ
 		mlt_properties_set_double( self->properties, "volume", 1.0 );
 
 		// This is the initialisation of the consumer
-		pthread_mutex_init( &self->audio_mutex, NULL );
-		pthread_cond_init( &self->audio_cond, NULL);
 		pthread_mutex_init( &self->video_mutex, NULL );
 		pthread_cond_init( &self->video_cond, NULL);
 
@@ -221,14 +220,13 @@ int consumer_stop( mlt_consumer parent )
 		pthread_cond_broadcast( &self->video_cond );
 		pthread_mutex_unlock( &self->video_mutex );
 
-		// Unlatch the audio callback
-		pthread_mutex_lock( &self->audio_mutex );
-		pthread_cond_broadcast( &self->audio_cond );
-		pthread_mutex_unlock( &self->audio_mutex );
 #ifdef _WIN32
 		if ( !self->no_quit_subsystem )
 #endif
-		SDL_QuitSubSystem( SDL_INIT_AUDIO );
+		{
+			SDL_QuitSubSystem( SDL_INIT_AUDIO );
+			self->audio_device = 0;
+		}
 	}
 
 	return 0;
@@ -266,37 +264,27 @@ static void sdl_fill_audio( void *udata, uint8_t *stream, int len )
 	// Get the volume
 	double volume = mlt_properties_get_double( self->properties, "volume" );
 
-	// Wipe the stream first
-	memset( stream, 0, len );
+	if ( !self->audio_ring )
+	{
+		memset( stream, 0, len );
+		return;
+	}
 
-	pthread_mutex_lock( &self->audio_mutex );
-	int bytes = MIN(len, self->audio_avail);
+	// Take what is buffered, the rest is silence
+	int samples = mlt_audio_ring_read( self->audio_ring, stream, len / ( self->out_channels * sizeof( int16_t ) ) );
 
-	// Place in the audio buffer
+	// Adjust the volume in place
 	if ( volume != 1.0 ) {
-		// Adjust the volume while copying.
-		int16_t *src = (int16_t*) self->audio_buffer;
 		int16_t *dst = (int16_t*) stream;
-		int i = bytes / sizeof(*dst) + 1;
+		int i = samples * self->out_channels + 1;
 		while (--i) {
-			*dst++ = CLAMP(volume * src[0], -32768, 32767);
-			src++;
+			*dst = CLAMP(volume * dst[0], -32768, 32767);
+			dst++;
 		}
-	} else {
-		memcpy( stream, self->audio_buffer, bytes );
 	}
 
-	// Remove len from the audio available
-	self->audio_avail -= bytes;
-
-	// Remove the samples
-	memmove( self->audio_buffer, self->audio_buffer + bytes, self->audio_avail );
-
 	// We're definitely playing now
 	self->playing = 1;
-
-	pthread_cond_broadcast( &self->audio_cond );
-	pthread_mutex_unlock( &self->audio_mutex );
 }
 
 static int consumer_play_audio( consumer_sdl self, mlt_frame frame, int init_audio, int64_t *duration )
@@ -354,83 +342,79 @@ static int consumer_play_audio( consumer_sdl self, mlt_frame frame, int init_aud
 				mlt_log_info( MLT_CONSUMER_SERVICE( self ), "Unable to output %d channels. Change to %d\n", request.channels, got.channels );
 			}
 				mlt_log_info( MLT_CONSUMER_SERVICE( self ), "Audio Opened: driver=%s channels=%d frequency=%d\n", SDL_GetCurrentAudioDriver(), got.channels, got.freq );
+			if ( !self->audio_ring || got.channels != self->out_channels || got.freq != self->out_frequency )
+			{
+				// The callback of a previous device may still be reading the old ring
+				if ( self->audio_device )
+					SDL_CloseAudioDevice( self->audio_device );
+
+				// Hold as much audio as the former fixed 40 KiB buffer did
+				mlt_audio_ring_close( self->audio_ring );
+				self->audio_ring = mlt_audio_ring_init( mlt_audio_s16, got.channels, got.freq,
+					4096 * 10 / ( got.channels * sizeof( int16_t ) ) );
+			}
+			else
+			{
+				mlt_audio_ring_flush( self->audio_ring );
+			}
+			self->out_channels = got.channels;
+			self->out_frequency = got.freq;
+			self->audio_device = dev;
 			SDL_PauseAudioDevice( dev, 0 );
 			init_audio = 0;
-			self->out_channels = got.channels;
 		}
 	}
 
-	if ( init_audio == 0 )
+	if ( init_audio == 0 && self->audio_ring )
 	{
 		mlt_properties properties = MLT_FRAME_PROPERTIES( frame );
+		int16_t *remapped = NULL;
 		int samples_copied = 0;
-		int dst_stride = self->out_channels * sizeof( *pcm );
+		int silent = !scrub && mlt_properties_get_double( properties, "_speed" ) != 1;
 
-		pthread_mutex_lock( &self->audio_mutex );
-
-		while ( self->running && samples_copied < samples )
+		// Match the channel count of the device
+		if ( !silent && channels != self->out_channels )
 		{
-			int sample_space = ( sizeof( self->audio_buffer ) - self->audio_avail ) / dst_stride;
-			while ( self->running && sample_space == 0 )
+			int dst_stride = self->out_channels * sizeof( *pcm );
+			int16_t *dest = remapped = mlt_pool_alloc( samples * dst_stride );
+			int i = samples + 1;
+			while ( --i )
 			{
-				struct timeval now;
-				struct timespec tm;
+				memcpy( dest, pcm, dst_stride );
+				pcm += channels;
+				dest += self->out_channels;
+			}
+			pcm = remapped;
+		}
 
-				gettimeofday( &now, NULL );
-				tm.tv_sec = now.tv_sec + 1;
-				tm.tv_nsec = now.tv_usec * 1000;
-				pthread_cond_timedwait( &self->audio_cond, &self->audio_mutex, &tm );
-				sample_space = ( sizeof( self->audio_buffer ) - self->audio_avail ) / dst_stride;
+		while ( self->running && samples_copied < samples )
+		{
+			int sample_space = mlt_audio_ring_wait( self->audio_ring, 1, 1000 );
 
-				if ( sample_space == 0 )
-				{
-					mlt_log_warning( MLT_CONSUMER_SERVICE(&self->parent), "audio timed out\n" );
-					pthread_mutex_unlock( &self->audio_mutex );
+			if ( sample_space == 0 )
+			{
+				mlt_log_warning( MLT_CONSUMER_SERVICE(&self->parent), "audio timed out\n" );
+				mlt_pool_release( remapped );
 #ifdef _WIN32
-					self->no_quit_subsystem = 1;
+				self->no_quit_subsystem = 1;
 #endif
-					return 1;
-				}
+				return 1;
 			}
 			if ( self->running )
 			{
 				int samples_to_copy = samples - samples_copied;
 				if ( samples_to_copy > sample_space )
-				{
 					samples_to_copy = sample_space;
-				}
-				int dst_bytes = samples_to_copy * dst_stride;
 
-				if ( scrub || mlt_properties_get_double( properties, "_speed" ) == 1 )
-				{
-					if ( channels == self->out_channels )
-					{
-						memcpy( &self->audio_buffer[ self->audio_avail ], pcm, dst_bytes );
-						pcm += samples_to_copy * channels;
-					}
-					else
-					{
-						int16_t *dest = (int16_t*) &self->audio_buffer[ self->audio_avail ];
-						int i = samples_to_copy + 1;
-						while ( --i )
-						{
-							memcpy( dest, pcm, dst_stride );
-							pcm += channels;
-							dest += self->out_channels;
-						}
-					}
-				}
+				if ( silent )
+					mlt_audio_ring_write_silence( self->audio_ring, samples_to_copy );
 				else
-				{
-					memset( &self->audio_buffer[ self->audio_avail ], 0, dst_bytes );
-					pcm += samples_to_copy * channels;
-				}
-				self->audio_avail += dst_bytes;
+					mlt_audio_ring_write( self->audio_ring, pcm + samples_copied * self->out_channels, samples_to_copy );
 				samples_copied += samples_to_copy;
 			}
-			pthread_cond_broadcast( &self->audio_cond );
 		}
-		pthread_mutex_unlock( &self->audio_mutex );
+		mlt_pool_release( remapped );
+		mlt_audio_ring_publish_stats( self->audio_ring, MLT_CONSUMER_PROPERTIES( &self->parent ) );
 	}
 	else
 	{
@@ -691,9 +675,8 @@ static void *consumer_thread( void *arg )
 		frame = NULL;
 	}
 
-	pthread_mutex_lock( &self->audio_mutex );
-	self->audio_avail = 0;
-	pthread_mutex_unlock( &self->audio_mutex );
+	if ( self->audio_ring )
+		mlt_audio_ring_flush( self->audio_ring );
 
 	return NULL;
 }
@@ -715,9 +698,10 @@ static void consumer_close( mlt_consumer parent )
 	// Close the queue
 	mlt_deque_close( self->queue );
 
+	// The audio device is closed by now
+	mlt_audio_ring_close( self->audio_ring );
+
 	// Destroy mutexes
-	pthread_mutex_destroy( &self->audio_mutex );
-	pthread_cond_destroy( &self->audio_cond );
 	pthread_mutex_destroy( &self->video_mutex );
 	pthread_cond_destroy( &self->video_cond );
 	pthread_mutex_destroy( &self->refresh_mutex );
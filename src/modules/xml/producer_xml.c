@@ -438,10 +438,12 @@ static void on_start_tractor( deserialise_context context, const xmlChar *name,
 	track_service( context->destructors, service, (mlt_destructor) mlt_tractor_close );
 	mlt_properties_set_lcnumeric( MLT_SERVICE_PROPERTIES( service ), context->lc_numeric );
 
+	mlt_properties_begin_batch( properties );
 	for ( ; atts != NULL && *atts != NULL; atts += 2 )
 		mlt_properties_set_string( MLT_SERVICE_PROPERTIES( service ), (const char*) atts[0], atts[1] == NULL ? "" : (const char*) atts[1] );
 
 	mlt_properties_set_int( MLT_TRACTOR_PROPERTIES( tractor ), "global_feed", 1 );
+	mlt_properties_end_batch( properties );
 
 	if ( mlt_properties_get( properties, "id" ) != NULL )
 		mlt_properties_set_data( context->producer_map, mlt_properties_get( properties, "id" ), service, 0, NULL, NULL );
@@ -528,6 +530,7 @@ static void on_start_playlist( deserialise_context context, const xmlChar *name,
 
 	track_service( context->destructors, service, (mlt_destructor) mlt_playlist_close );
 
+	mlt_properties_begin_batch( properties );
 	for ( ; atts != NULL && *atts != NULL; atts += 2 )
 	{
 		mlt_properties_set_string( properties, (const char*) atts[0], atts[1] == NULL ? "" : (const char*) atts[1] );
@@ -536,6 +539,7 @@ static void on_start_playlist( deserialise_context context, const xmlChar *name,
 		if ( xmlStrcmp( atts[ 0 ], _x("out") ) == 0 )
 			mlt_properties_set_string( properties, "_xml.out", ( const char* )atts[ 1 ] );
 	}
+	mlt_properties_end_batch( properties );
 
 	if ( mlt_properties_get( properties, "id" ) != NULL )
 		mlt_properties_set_data( context->producer_map, mlt_properties_get( properties, "id" ), service, 0, NULL, NULL );
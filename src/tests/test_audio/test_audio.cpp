@@ -18,6 +18,7 @@
 
 #include <QString>
 #include <QtTest>
+#include <cmath>
 
 #include <mlt++/Mlt.h>
 using namespace Mlt;
@@ -26,6 +27,64 @@ class TestAudio : public QObject
 {
 	Q_OBJECT
 
+public:
+	TestAudio()
+	{
+		Factory::init();
+	}
+
+private:
+	static const int ConvertSamples = 1920;
+
+	static mlt_frame make_audio_frame(mlt_audio_format format, int channels)
+	{
+		mlt_frame frame = mlt_frame_init(NULL);
+		int size = mlt_audio_format_size(format, ConvertSamples, channels);
+		void* buffer = mlt_pool_alloc(size);
+		memset(buffer, 0, size);
+		mlt_frame_set_audio(frame, buffer, format, size, mlt_pool_release);
+		mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "audio_frequency", 48000);
+		mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "audio_channels", channels);
+		mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "audio_samples", ConvertSamples);
+		return frame;
+	}
+
+	// A 1 kHz tone at half scale. A jitter moves the start of every odd frame
+	// by that many samples while the stream stays contiguous.
+	static mlt_frame make_tone_frame(int frequency, int channels, int position, int jitter = 0)
+	{
+		int samples = mlt_sample_calculator(25, frequency, position) + (position % 2 ? -jitter : jitter);
+		int64_t start = mlt_sample_calculator_to_now(25, frequency, position) + (position % 2 ? jitter : 0);
+		mlt_frame frame = mlt_frame_init(NULL);
+		int size = mlt_audio_format_size(mlt_audio_float, samples, channels);
+		float* buffer = (float*) mlt_pool_alloc(size);
+		for (int c = 0; c < channels; c++)
+			for (int i = 0; i < samples; i++)
+				buffer[c * samples + i] = 0.5 * sin(2.0 * M_PI * 1000.0 * (start + i) / frequency);
+		mlt_frame_set_audio(frame, buffer, mlt_audio_float, size, mlt_pool_release);
+		mlt_frame_set_position(frame, position);
+		mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "audio_frequency", frequency);
+		mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "audio_channels", channels);
+		mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "audio_samples", samples);
+		return frame;
+	}
+
+	// A producer whose tone is always 44.1 kHz, whatever rate is requested
+	static int fixed_rate_get_frame(mlt_producer producer, mlt_frame_ptr frame, int index)
+	{
+		*frame = make_tone_frame(44100, 2, mlt_producer_position(producer));
+		mlt_producer_prepare_next(producer);
+		return 0;
+	}
+
+	static float peak_level(const float* data, int samples)
+	{
+		float peak = 0;
+		for (int i = 0; i < samples; i++)
+			peak = qMax(peak, qAbs(data[i]));
+		return peak;
+	}
+
 private Q_SLOTS:
 
 	void DefaultConstructor()
@@ -51,6 +110,417 @@ private Q_SLOTS:
 		free(data);
 		a.set_data(nullptr);
 	}
+
+	void ConvertAudio_data()
+	{
+		QTest::addColumn<int>("from");
+		QTest::addColumn<int>("to");
+		QTest::addColumn<int>("channels");
+		for (int channels = 2; channels <= 32; channels *= 16)
+			for (int from = mlt_audio_s16; from <= mlt_audio_u8; from++)
+				for (int to = mlt_audio_s16; to <= mlt_audio_u8; to++)
+					if (from != to)
+						QTest::newRow(QString("%1 -> %2 x%3")
+							.arg(mlt_audio_format_name(mlt_audio_format(from)))
+							.arg(mlt_audio_format_name(mlt_audio_format(to)))
+							.arg(channels).toLatin1().constData()) << from << to << channels;
+	}
+
+	void ConvertAudio()
+	{
+		QFETCH(int, from);
+		QFETCH(int, to);
+		QFETCH(int, channels);
+		Profile profile;
+		Filter filter(profile, "audioconvert");
+		QVERIFY(filter.is_valid());
+
+		QBENCHMARK {
+			Frame frame(make_audio_frame(mlt_audio_format(from), channels));
+			mlt_frame_close(frame.get_frame());
+			filter.process(frame);
+			mlt_audio_format format = mlt_audio_format(to);
+			int frequency = 48000;
+			int frame_channels = channels;
+			int samples = ConvertSamples;
+			void* data = frame.get_audio(format, frequency, frame_channels, samples);
+			QVERIFY(data != nullptr);
+			QCOMPARE(int(format), to);
+			QCOMPARE(samples, ConvertSamples);
+		}
+	}
+
+	void ConvertAudioRoundTrip()
+	{
+		Profile profile;
+		Filter filter(profile, "audioconvert");
+		QVERIFY(filter.is_valid());
+
+		for (int to = mlt_audio_s32; to <= mlt_audio_f32le; to++) {
+			const int channels = 3;
+			Frame frame(make_audio_frame(mlt_audio_s16, channels));
+			mlt_frame_close(frame.get_frame());
+			int16_t* input = (int16_t*) mlt_properties_get_data(frame.get_properties(), "audio", NULL);
+			for (int i = 0; i < ConvertSamples * channels; i++)
+				input[i] = (i * 97) % 65536 - 32768;
+			QVector<int16_t> expected(input, input + ConvertSamples * channels);
+			filter.process(frame);
+
+			mlt_audio_format format = mlt_audio_format(to);
+			int frequency = 48000;
+			int frame_channels = channels;
+			int samples = ConvertSamples;
+			frame.get_audio(format, frequency, frame_channels, samples);
+			QCOMPARE(int(format), to);
+			format = mlt_audio_s16;
+			int16_t* output = (int16_t*) frame.get_audio(format, frequency, frame_channels, samples);
+			QCOMPARE(format, mlt_audio_s16);
+			for (int i = 0; i < ConvertSamples * channels; i++) {
+				// Float scales by 32767 on the way back, so allow one step.
+				if (to == mlt_audio_float || to == mlt_audio_f32le)
+					QVERIFY(qAbs(output[i] - expected[i]) <= 1);
+				else
+					QCOMPARE(output[i], expected[i]);
+			}
+		}
+	}
+
+	void Resample_data()
+	{
+		QTest::addColumn<QString>("quality");
+		QTest::addColumn<int>("from");
+		QTest::addColumn<int>("to");
+		const char* qualities[] = {"fast", "medium", "best"};
+		for (const char* quality : qualities) {
+			QTest::newRow(QString("%1 44100 -> 48000").arg(quality).toLatin1().constData()) << QString(quality) << 44100 << 48000;
+			QTest::newRow(QString("%1 48000 -> 44100").arg(quality).toLatin1().constData()) << QString(quality) << 48000 << 44100;
+		}
+	}
+
+	void Resample()
+	{
+		QFETCH(QString, quality);
+		QFETCH(int, from);
+		QFETCH(int, to);
+		Profile profile;
+		Filter filter(profile, "audioresample");
+		QVERIFY(filter.is_valid());
+		filter.set("frequency", to);
+		filter.set("quality", quality.toLatin1().constData());
+		int position = 0;
+		double sine = 0, cosine = 0;
+
+		QBENCHMARK {
+			// The producer does not deliver exactly the samples of each frame.
+			Frame frame(make_tone_frame(from, 2, position, 8));
+			mlt_frame_close(frame.get_frame());
+			filter.process(frame);
+			mlt_audio_format format = mlt_audio_float;
+			int frequency = to;
+			int channels = 2;
+			int samples = mlt_sample_calculator(25, to, position);
+			int expected = samples;
+			float* data = (float*) frame.get_audio(format, frequency, channels, samples);
+			QVERIFY(data != nullptr);
+			QCOMPARE(format, mlt_audio_float);
+			QCOMPARE(frequency, to);
+			QCOMPARE(samples, expected);
+			// The level of the tone survives once the filter window is full.
+			if (position > 0) {
+				QVERIFY(qAbs(peak_level(data, samples) - 0.5f) < 0.01f);
+
+				// Fit the tone at its phase in the output stream. A gap or a
+				// jump in the stream leaves a large residual or moves the phase.
+				int64_t start = mlt_sample_calculator_to_now(25, to, position);
+				double a = 0, b = 0;
+				for (int i = 0; i < samples; i++) {
+					double w = 2.0 * M_PI * 1000.0 * (start + i) / to;
+					a += 2.0 * data[i] * sin(w) / samples;
+					b += 2.0 * data[i] * cos(w) / samples;
+				}
+				double signal = 0, noise = 0;
+				for (int i = 0; i < samples; i++) {
+					double w = 2.0 * M_PI * 1000.0 * (start + i) / to;
+					double fit = a * sin(w) + b * cos(w);
+					signal += fit * fit;
+					noise += (data[i] - fit) * (data[i] - fit);
+				}
+				QVERIFY(10.0 * log10(signal / noise) > 50.0);
+				if (position > 1)
+					QVERIFY(qAbs(a - sine) < 1e-4 && qAbs(b - cosine) < 1e-4);
+				sine = a;
+				cosine = b;
+			}
+			position++;
+		}
+	}
+
+	void MixerSumsTracksWithGainAndPan()
+	{
+		Profile profile("dv_pal");
+		Tractor tractor(profile);
+		Producer a(profile, "tone");
+		Producer b(profile, "tone");
+		// Two tones in phase with a peak of 0.5
+		a.set("level", -6.0206);
+		b.set("level", -6.0206);
+		tractor.set_track(a, 0);
+		tractor.set_track(b, 1);
+		Transition mixer(profile, "mixer");
+		QVERIFY(mixer.is_valid());
+		tractor.plant_transition(mixer, 0, 1);
+		auto mix = [&](float& left, float& right) {
+			Frame* frame = tractor.get_frame();
+			mlt_audio_format format = mlt_audio_float;
+			int frequency = 48000;
+			int channels = 2;
+			int samples = 1920;
+			float* data = (float*) frame->get_audio(format, frequency, channels, samples);
+			QVERIFY(data != nullptr);
+			QCOMPARE(format, mlt_audio_float);
+			QCOMPARE(samples, 1920);
+			left = peak_level(data, samples);
+			right = peak_level(data + samples, samples);
+			delete frame;
+		};
+		float left, right;
+
+		// Unity gain sums both tracks.
+		mix(left, right);
+		QVERIFY(qAbs(left - 1.0f) < 0.01f);
+		QVERIFY(qAbs(right - 1.0f) < 0.01f);
+		QCOMPARE(mixer.get_int("meter.position"), 0);
+		QVERIFY(qAbs(mixer.get_double("meter.0.peak") - 0.5) < 0.01);
+		QVERIFY(qAbs(mixer.get_double("meter.0.rms") - 0.5 / M_SQRT2) < 0.01);
+		QVERIFY(qAbs(mixer.get_double("meter.1.peak") - 0.5) < 0.01);
+
+		// The gain scales a track and its meter, and the pan removes it from the opposite side.
+		mixer.set("gain.1", 0.5);
+		mixer.set("pan.1", 1.0);
+		mix(left, right);
+		QVERIFY(qAbs(left - 0.5f) < 0.01f);
+		QVERIFY(qAbs(right - 0.75f) < 0.01f);
+		QCOMPARE(mixer.get_int("meter.position"), 1);
+		QVERIFY(qAbs(mixer.get_double("meter.0.peak") - 0.5) < 0.01);
+		QVERIFY(qAbs(mixer.get_double("meter.1.peak") - 0.25) < 0.01);
+		// The meter averages the silent left and the right channel.
+		QVERIFY(qAbs(mixer.get_double("meter.1.rms") - 0.25 / 2) < 0.01);
+	}
+
+	void MixerResamplesTracksAtAnotherRate()
+	{
+		Profile profile("dv_pal");
+		Tractor tractor(profile);
+		Producer a(profile, "tone");
+		a.set("level", -6.0206);
+		mlt_producer fixed = mlt_producer_new(profile.get_profile());
+		fixed->get_frame = fixed_rate_get_frame;
+		Producer b(fixed);
+		mlt_producer_close(fixed);
+		tractor.set_track(a, 0);
+		tractor.set_track(b, 1);
+		Transition mixer(profile, "mixer");
+		tractor.plant_transition(mixer, 0, 1);
+		mixer.set("gain.0", 0.0);
+
+		for (int position = 0; position < 3; position++) {
+			Frame* frame = tractor.get_frame();
+			mlt_audio_format format = mlt_audio_float;
+			int frequency = 48000;
+			int channels = 2;
+			int samples = 1920;
+			float* data = (float*) frame->get_audio(format, frequency, channels, samples);
+			QVERIFY(data != nullptr);
+			QCOMPARE(frequency, 48000);
+			QCOMPARE(samples, 1920);
+			// The 44.1 kHz track fills the whole 48 kHz frame instead of
+			// leaving its last samples silent.
+			double square = 0;
+			for (int i = samples - 100; i < samples; i++)
+				square += data[i] * data[i];
+			QVERIFY(qAbs(sqrt(square / 100) - 0.5 / M_SQRT2) < 0.02);
+			QVERIFY(qAbs(mixer.get_double("meter.1.peak") - 0.5) < 0.01);
+			QVERIFY(qAbs(mixer.get_double("meter.1.rms") - 0.5 / M_SQRT2) < 0.01);
+			delete frame;
+		}
+	}
+
+	void AudioRingRoundTrip()
+	{
+		mlt_audio_ring ring = mlt_audio_ring_init(mlt_audio_s16, 2, 48000, 100);
+		QVERIFY(ring != nullptr);
+		QCOMPARE(mlt_audio_ring_size(ring), 100);
+		QCOMPARE(mlt_audio_ring_writable(ring), 100);
+		int16_t in[2 * 60], out[2 * 60];
+		int next = 0, expect = 0;
+		// Wrap around the end of the buffer several times.
+		for (int n = 0; n < 10; n++) {
+			for (int i = 0; i < 60; i++, next++) {
+				in[2 * i] = next;
+				in[2 * i + 1] = -next;
+			}
+			QCOMPARE(mlt_audio_ring_write(ring, in, 60), 60);
+			QCOMPARE(mlt_audio_ring_readable(ring), 60);
+			QCOMPARE(mlt_audio_ring_read(ring, out, 60), 60);
+			for (int i = 0; i < 60; i++, expect++) {
+				QCOMPARE(int(out[2 * i]), expect);
+				QCOMPARE(int(out[2 * i + 1]), -expect);
+			}
+		}
+		mlt_audio_ring_close(ring);
+	}
+
+	void AudioRingStats()
+	{
+		mlt_audio_ring ring = mlt_audio_ring_init(mlt_audio_s16, 1, 1000, 100);
+		int16_t buffer[150];
+		mlt_audio_ring_stats stats;
+		memset(buffer, 1, sizeof(buffer));
+
+		// Running dry before playback starts is not an underrun.
+		QCOMPARE(mlt_audio_ring_read(ring, buffer, 10), 0);
+		QCOMPARE(int(buffer[0]), 0);
+		// Writes that do not fit are truncated and counted.
+		QCOMPARE(mlt_audio_ring_write(ring, buffer, 150), 100);
+		QCOMPARE(mlt_audio_ring_read(ring, buffer, 60), 60);
+		QCOMPARE(mlt_audio_ring_read(ring, buffer, 60), 40);
+		QCOMPARE(mlt_audio_ring_read(ring, buffer, 60), 0);
+		mlt_audio_ring_get_stats(ring, &stats, 1);
+		QCOMPARE(stats.underruns, int64_t(1));
+		QCOMPARE(stats.overruns, int64_t(1));
+		QCOMPARE(stats.silence, int64_t(10 + 20 + 60));
+		QCOMPARE(stats.max_fill, 100);
+		QCOMPARE(stats.min_fill, 0);
+
+		// A flush discards the buffered audio without counting an underrun.
+		mlt_audio_ring_write_silence(ring, 50);
+		mlt_audio_ring_flush(ring);
+		QCOMPARE(mlt_audio_ring_read(ring, buffer, 10), 0);
+		mlt_audio_ring_get_stats(ring, &stats, 0);
+		QCOMPARE(stats.underruns, int64_t(1));
+
+		Properties properties;
+		mlt_audio_ring_write_silence(ring, 50);
+		mlt_audio_ring_publish_stats(ring, properties.get_properties());
+		QCOMPARE(properties.get_double("audio_latency"), 50.0);
+		QCOMPARE(properties.get_int("audio_underruns"), 1);
+		mlt_audio_ring_close(ring);
+	}
+
+	void AudioRingIndexWraparound()
+	{
+		const int size = 1 << 20;
+		mlt_audio_ring ring = mlt_audio_ring_init(mlt_audio_u8, 1, 48000, size);
+		QVERIFY(ring != nullptr);
+		QVector<uint8_t> buffer(size);
+
+		// Leave a flush behind, then move the indices more than 2^31 samples past it.
+		mlt_audio_ring_write_silence(ring, 10);
+		mlt_audio_ring_flush(ring);
+		QCOMPARE(mlt_audio_ring_read(ring, buffer.data(), 10), 0);
+		for (int i = 0; i < 2100; i++) {
+			QCOMPARE(mlt_audio_ring_write_silence(ring, size), size);
+			QCOMPARE(mlt_audio_ring_read(ring, buffer.data(), size), size);
+		}
+		buffer[0] = 1;
+		QCOMPARE(mlt_audio_ring_write(ring, buffer.data(), 1), 1);
+		QCOMPARE(mlt_audio_ring_read(ring, buffer.data() + 1, 1), 1);
+		QCOMPARE(int(buffer[1]), 1);
+		QCOMPARE(mlt_audio_ring_readable(ring), 0);
+
+		// A flush still works after the wraparound.
+		mlt_audio_ring_write_silence(ring, 100);
+		mlt_audio_ring_flush(ring);
+		QCOMPARE(mlt_audio_ring_write(ring, buffer.data(), 1), 1);
+		QCOMPARE(mlt_audio_ring_read(ring, buffer.data(), 10), 1);
+		mlt_audio_ring_close(ring);
+	}
+
+	void AudioSummaryQuery()
+	{
+		Profile profile("dv_pal");
+		Producer producer(profile, "tone:");
+		producer.set("level", -6);
+		producer.set("length", 100);
+		producer.set("out", 99);
+		mlt_audio_summary summary = mlt_audio_summary_get(producer.get_producer());
+		QVERIFY(summary != nullptr);
+		QCOMPARE(mlt_audio_summary_wait(summary), 0);
+		QCOMPARE(mlt_audio_summary_samples(summary), int64_t(64000));
+		QCOMPARE(mlt_audio_summary_available(summary), int64_t(64000));
+
+		// A -6 dB sine peaks at 0.5 with an RMS of 0.35.
+		float min, max, rms;
+		QCOMPARE(mlt_audio_summary_query(summary, -1, 1000, 50000, &min, &max, &rms), 0);
+		QVERIFY(qAbs(max - 0.501) < 0.001);
+		QVERIFY(qAbs(min + 0.501) < 0.001);
+		QVERIFY(qAbs(rms - 0.354) < 0.001);
+		// Beyond the end is not available.
+		QVERIFY(mlt_audio_summary_query(summary, 0, 0, 64001, &min, &max, &rms) != 0);
+		// The same resource shares the summary.
+		mlt_audio_summary other = mlt_audio_summary_init(producer.get_producer(), 16000, 2);
+		QCOMPARE(other, summary);
+		mlt_audio_summary_close(other);
+	}
+
+	void AvformatAudioCacheServesRepeatedFrames()
+	{
+		// One second of a 48 kHz mono ramp as 16-bit PCM WAV
+		const int frequency = 48000;
+		QTemporaryFile file(QDir::tempPath() + "/XXXXXX.wav");
+		QVERIFY(file.open());
+		QDataStream stream(&file);
+		stream.setByteOrder(QDataStream::LittleEndian);
+		stream.writeRawData("RIFF", 4);
+		stream << quint32(36 + frequency * 2);
+		stream.writeRawData("WAVEfmt ", 8);
+		stream << quint32(16) << quint16(1) << quint16(1) << quint32(frequency) << quint32(frequency * 2) << quint16(2) << quint16(16);
+		stream.writeRawData("data", 4);
+		stream << quint32(frequency * 2);
+		for (int i = 0; i < frequency; i++)
+			stream << qint16(i % 30000);
+		file.close();
+
+		Profile profile("dv_pal");
+		Producer producer(profile, "avformat", file.fileName().toUtf8().constData());
+		if (!producer.is_valid())
+			QSKIP("avformat is not available");
+		auto first_sample = [&](int position) {
+			producer.seek(position);
+			Frame* frame = producer.get_frame();
+			mlt_audio_format format = mlt_audio_s16;
+			int rate = frequency;
+			int channels = 1;
+			int samples = mlt_sample_calculator(25, frequency, position);
+			int16_t* data = (int16_t*) frame->get_audio(format, rate, channels, samples);
+			int sample = data && format == mlt_audio_s16 ? data[0] : -1;
+			delete frame;
+			return sample;
+		};
+		auto expected = [&](int position) {
+			return int(mlt_sample_calculator_to_now(25, frequency, position) % 30000);
+		};
+
+		// Sequential playback decodes without looking up the cache.
+		for (int position = 0; position < 10; position++)
+			QCOMPARE(first_sample(position), expected(position));
+		QCOMPARE(producer.get_int64("_audio_cache_hits"), int64_t(0));
+		QCOMPARE(producer.get_int64("_audio_cache_misses"), int64_t(0));
+
+		// Going back is served from the cache, also for the following frames.
+		QCOMPARE(first_sample(3), expected(3));
+		QCOMPARE(first_sample(4), expected(4));
+		QCOMPARE(first_sample(5), expected(5));
+		QCOMPARE(producer.get_int64("_audio_cache_hits"), int64_t(3));
+		QCOMPARE(producer.get_int64("_audio_cache_misses"), int64_t(0));
+
+		// A frame that was not delivered yet is a miss. The decoder seeks to
+		// it and then continues sequentially.
+		QCOMPARE(first_sample(10), expected(10));
+		QCOMPARE(first_sample(11), expected(11));
+		QCOMPARE(producer.get_int64("_audio_cache_hits"), int64_t(3));
+		QCOMPARE(producer.get_int64("_audio_cache_misses"), int64_t(1));
+	}
 };
 
 QTEST_APPLESS_MAIN(TestAudio)
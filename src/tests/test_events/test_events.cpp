@@ -51,6 +51,17 @@ private:
         self->checkOwner(owner);
     }
 
+    static void onBatchPropertyChanged(mlt_properties, int* count, char*)
+    {
+        ++count[0];
+    }
+
+    static void onPropertiesChanged(mlt_properties, int* count, mlt_properties names)
+    {
+        ++count[1];
+        count[2] = mlt_properties_count(names);
+    }
+
 private Q_SLOTS:
     
     void ListenToPropertyChanged()
@@ -93,7 +104,74 @@ private Q_SLOTS:
         producer.set("foo", 1);
         delete event;
     }
-  
+
+    void FireEventById()
+    {
+        Profile profile;
+        Filter filter(profile, "brightness");
+        QVERIFY(filter.is_valid());
+        m_properties = filter.get_properties();
+        int id = mlt_events_id("property-changed");
+        QVERIFY(id >= 0);
+        QCOMPARE(mlt_events_id("property-changed"), id);
+        QVERIFY(mlt_events_id("some-other-event") != id);
+        QCOMPARE(mlt_events_fire_id(m_properties, id, "foo", NULL), 0);
+        Event* event = filter.listen("property-changed", this, (mlt_transmitter) onPropertyChanged);
+        QVERIFY(event != nullptr);
+        QCOMPARE(mlt_events_fire_id(m_properties, id, "foo", NULL), 1);
+        delete event;
+        QCOMPARE(mlt_events_fire_id(m_properties, id, "foo", NULL), 0);
+    }
+
+    void BatchCoalescesPropertiesChanged()
+    {
+        Profile profile;
+        Filter filter(profile, "brightness");
+        int count[3] = {0, 0, 0};
+        Event* event = filter.listen("property-changed", count, (mlt_transmitter) onBatchPropertyChanged);
+        Event* batch = filter.listen("properties-changed", count, (mlt_transmitter) onPropertiesChanged);
+        mlt_properties_begin_batch(filter.get_properties());
+        filter.set("foo", 1);
+        mlt_properties_begin_batch(filter.get_properties());
+        filter.set("bar", 1);
+        filter.set("foo", 2);
+        mlt_properties_end_batch(filter.get_properties());
+        QCOMPARE(count[0], 3);
+        QCOMPARE(count[1], 0);
+        mlt_properties_end_batch(filter.get_properties());
+        QCOMPARE(count[0], 3);
+        QCOMPARE(count[1], 1);
+        QCOMPARE(count[2], 2);
+        QCOMPARE(filter.get_int("foo"), 2);
+        filter.set("foo", 3);
+        QCOMPARE(count[0], 4);
+        QCOMPARE(count[1], 2);
+        QCOMPARE(count[2], 1);
+        delete batch;
+        delete event;
+    }
+
+    void PrivateNamesDoNotFirePropertiesChanged()
+    {
+        Profile profile;
+        Filter filter(profile, "brightness");
+        int count[3] = {0, 0, 0};
+        Event* event = filter.listen("property-changed", count, (mlt_transmitter) onBatchPropertyChanged);
+        Event* batch = filter.listen("properties-changed", count, (mlt_transmitter) onPropertiesChanged);
+        filter.set("_foo", 1);
+        QCOMPARE(count[0], 1);
+        QCOMPARE(count[1], 0);
+        mlt_properties_begin_batch(filter.get_properties());
+        filter.set("_foo", 2);
+        filter.set("bar", 1);
+        mlt_properties_end_batch(filter.get_properties());
+        QCOMPARE(count[0], 3);
+        QCOMPARE(count[1], 1);
+        QCOMPARE(count[2], 1);
+        delete batch;
+        delete event;
+    }
+
 };
 
 QTEST_APPLESS_MAIN(TestEvents)
@@ -25,7 +25,15 @@ class TestFrame: public QObject
     Q_OBJECT
 
 public:
-    TestFrame() {}
+    TestFrame()
+    {
+        repo = Factory::init();
+    }
+
+    ~TestFrame()
+    {
+        Factory::close();
+    }
 
 private Q_SLOTS:
     void FrameConstructorAddsReference()
@@ -93,6 +101,35 @@ private Q_SLOTS:
         QCOMPARE(f1.ref_count(), 2);
         mlt_frame_close(frame);
     }
+
+    void AccountsImageMemoryInThePool()
+    {
+        int64_t before = mlt_pool_used(mlt_memory_image);
+        mlt_frame frame = mlt_frame_init(NULL);
+        int size = 1920 * 1080 * 2;
+        uint8_t* image = (uint8_t*) mlt_pool_alloc(size);
+        QVERIFY(mlt_pool_used(mlt_memory_other) >= size);
+        mlt_frame_set_image(frame, image, size, mlt_pool_release);
+        QVERIFY(mlt_pool_used(mlt_memory_image) >= before + size);
+        QVERIFY(mlt_pool_peak(mlt_memory_image) >= before + size);
+        mlt_pool_stat();
+        QVERIFY(mlt_properties_get_int64(mlt_global_properties(), "memory.image") >= before + size);
+        mlt_frame_close(frame);
+        QCOMPARE(mlt_pool_used(mlt_memory_image), before);
+    }
+
+    void OverBudgetWhenPoolUseExceedsIt()
+    {
+        void* block = mlt_pool_alloc(1 << 20);
+        mlt_pool_set_budget(1024);
+        QVERIFY(mlt_pool_over_budget());
+        mlt_pool_set_budget(0);
+        QVERIFY(!mlt_pool_over_budget());
+        mlt_pool_release(block);
+    }
+
+private:
+    Repository* repo;
 };
 
 QTEST_APPLESS_MAIN(TestFrame)
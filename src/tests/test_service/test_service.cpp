@@ -69,6 +69,149 @@ private Q_SLOTS:
         QCOMPARE(mlt_service_identify(MLT_CONSUMER_SERVICE(consumer)), consumer_type);
     }
 
+    void ReusesNeighbourFramesWhenPlayingSequentially()
+    {
+        Profile profile;
+        Producer producer(profile, "color", "red");
+        producer.set("_need_previous_next", 1);
+
+        Frame* first = producer.get_frame();
+        Frame* second = producer.get_frame();
+        mlt_frame next = (mlt_frame) first->get_data("next frame");
+        mlt_frame previous = (mlt_frame) second->get_data("previous frame");
+        QVERIFY(next != nullptr);
+        QVERIFY(previous != nullptr);
+        QCOMPARE(mlt_frame_get_position(next), mlt_position(1));
+        QCOMPARE(mlt_frame_get_position(previous), mlt_position(0));
+        // The neighbours wrap the same shared frame.
+        Frame* third = producer.get_frame();
+        mlt_frame next_source = (mlt_frame) mlt_properties_get_data(MLT_FRAME_PROPERTIES((mlt_frame) second->get_data("next frame")), "_neighbour", NULL);
+        mlt_frame previous_source = (mlt_frame) mlt_properties_get_data(MLT_FRAME_PROPERTIES((mlt_frame) third->get_data("previous frame")), "_neighbour", NULL);
+        QVERIFY(next_source != nullptr);
+        QCOMPARE(next_source, previous_source);
+        // The output frame itself is served from the same window.
+        QCOMPARE((mlt_frame) third->get_data("_neighbour"), next_source);
+        QCOMPARE(mlt_frame_get_position(third->get_frame()), mlt_position(2));
+
+        uint8_t* image = nullptr;
+        mlt_image_format format = mlt_image_yuv422;
+        int width = profile.width();
+        int height = profile.height();
+        QCOMPARE(mlt_frame_get_image((mlt_frame) third->get_data("previous frame"), &image, &format, &width, &height, 0), 0);
+        QVERIFY(image != nullptr);
+        delete first;
+        delete second;
+        delete third;
+    }
+
+    void TracesTimeSpentPerService()
+    {
+        Profile profile;
+        Producer producer(profile, "color", "red");
+        Filter filter(profile, "brightness");
+        producer.attach(filter);
+        mlt_trace_reset();
+        mlt_trace_enable(1);
+        Frame* frame = producer.get_frame();
+        uint8_t* image = nullptr;
+        mlt_image_format format = mlt_image_yuv422;
+        int width = profile.width();
+        int height = profile.height();
+        QCOMPARE(mlt_frame_get_image(frame->get_frame(), &image, &format, &width, &height, 0), 0);
+        delete frame;
+        mlt_trace_enable(0);
+
+        QTemporaryFile file;
+        QVERIFY(file.open());
+        QCOMPARE(mlt_trace_write_summary(file.fileName().toUtf8().constData()), 0);
+        QByteArray summary = file.readAll();
+        QVERIFY(summary.contains("color"));
+        QVERIFY(summary.contains("brightness"));
+        QVERIFY(summary.contains("get_image"));
+        mlt_trace_reset();
+    }
+
+    void RenderCacheHashFollowsTheServiceNetwork()
+    {
+        Profile profile;
+        Playlist playlist(profile);
+        Producer red(profile, "color:red");
+        Producer white(profile, "color:white");
+        playlist.append(red, 0, 9);
+        uint64_t hash = mlt_render_cache_hash(playlist.get_service(), 5);
+        QCOMPARE(mlt_render_cache_hash(playlist.get_service(), 5), hash);
+        QVERIFY(mlt_render_cache_hash(playlist.get_service(), 6) != hash);
+
+        // Moving a clip within the playlist keeps its hash
+        playlist.insert(white, 0, 0, 4);
+        QCOMPARE(mlt_render_cache_hash(playlist.get_service(), 10), hash);
+
+        // Changing a property does not
+        red.set("resource", "blue");
+        QVERIFY(mlt_render_cache_hash(playlist.get_service(), 10) != hash);
+    }
+
+    void RenderCacheReusesImages()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        Profile profile;
+        Producer producer(profile, "color:red");
+        uint64_t hash = mlt_render_cache_hash(producer.get_service(), 0);
+        QByteArray rendered;
+        for (int i = 0; i < 2; i++) {
+            Frame* frame = producer.get_frame();
+            mlt_render_cache_attach(frame->get_frame(), dir.path().toUtf8().constData(), hash, 0);
+            uint8_t* image = nullptr;
+            mlt_image_format format = mlt_image_rgb24a;
+            int width = profile.width();
+            int height = profile.height();
+            QCOMPARE(mlt_frame_get_image(frame->get_frame(), &image, &format, &width, &height, 0), 0);
+            QCOMPARE(frame->get_int("render_cache.hit"), i);
+            QByteArray pixels((const char*) image, width * height * 4);
+            if (i)
+                QCOMPARE(pixels, rendered);
+            rendered = pixels;
+            delete frame;
+            producer.seek(0);
+        }
+    }
+
+    void RenderCacheEvictsLeastRecentlyUsed()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        Profile profile;
+        Producer producer(profile, "color:red");
+        int64_t limit = 0;
+        auto render = [&](uint64_t hash) {
+            Frame* frame = producer.get_frame();
+            mlt_render_cache_attach(frame->get_frame(), dir.path().toUtf8().constData(), hash, limit);
+            uint8_t* image = nullptr;
+            mlt_image_format format = mlt_image_rgb24a;
+            int width = profile.width();
+            int height = profile.height();
+            mlt_frame_get_image(frame->get_frame(), &image, &format, &width, &height, 0);
+            int hit = frame->get_int("render_cache.hit");
+            delete frame;
+            producer.seek(0);
+            return hit;
+        };
+        render(1);
+        QFileInfo file(QDir(dir.path()).entryInfoList(QDir::Files).first());
+        limit = file.size() * 4;
+        for (uint64_t hash = 2; hash <= 20; hash++) {
+            render(hash);
+            QVERIFY(render(1));
+        }
+        qint64 total = 0;
+        for (auto& info : QDir(dir.path()).entryInfoList(QDir::Files))
+            total += info.size();
+        QVERIFY(total <= limit);
+        QVERIFY(render(20));
+        QVERIFY(!render(5));
+    }
+
 private:
     Repository* repo;
 };